@@ -0,0 +1,61 @@
+#include <stdlib.h>
+
+#include <atomic>
+#include <new>
+
+#include "alloc_stats.hpp"
+
+static std::atomic<uint64_t> _alloc_count(0);
+static std::atomic<uint64_t> _alloc_bytes(0);
+
+uint64_t GetAllocationCount() {
+    return _alloc_count.load(std::memory_order_relaxed);
+}
+
+uint64_t GetAllocatedBytes() {
+    return _alloc_bytes.load(std::memory_order_relaxed);
+}
+
+static void *CountedAlloc(size_t size) {
+    _alloc_count.fetch_add(1, std::memory_order_relaxed);
+    _alloc_bytes.fetch_add(size, std::memory_order_relaxed);
+    void *p = malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void *operator new(size_t size) {
+    return CountedAlloc(size);
+}
+
+void *operator new[](size_t size) {
+    return CountedAlloc(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t&) noexcept {
+    _alloc_count.fetch_add(1, std::memory_order_relaxed);
+    _alloc_bytes.fetch_add(size, std::memory_order_relaxed);
+    return malloc(size ? size : 1);
+}
+
+void *operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return operator new(size, std::nothrow);
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
+void operator delete[](void *p) noexcept {
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+    free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept {
+    free(p);
+}
@@ -0,0 +1,15 @@
+#ifndef endlesstunnel_alloc_stats_hpp
+#define endlesstunnel_alloc_stats_hpp
+
+#include <stdint.h>
+
+// Counts heap allocations made through operator new (alloc_stats.cpp replaces the global
+// operators). Cheap enough to be always on: one relaxed atomic add per allocation.
+
+// number of allocations since the process started
+uint64_t GetAllocationCount();
+
+// number of bytes requested by those allocations
+uint64_t GetAllocatedBytes();
+
+#endif
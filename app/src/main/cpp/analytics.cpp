@@ -0,0 +1,331 @@
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include "analytics.hpp"
+#include "log.hpp"
+#include "lz4.hpp"
+#include "profiler.hpp"
+
+// how often the background thread gathers records
+#define ANALYTICS_FLUSH_INTERVAL_MS 100
+
+// how long Suspend() and Sync() wait for the background thread to write what it has
+#define ANALYTICS_SUSPEND_TIMEOUT_MS 500
+
+// records per compressed block
+#define ANALYTICS_BLOCK_RECORDS 2730  // ~64KB
+
+static thread_local void *_thread_buffer = NULL;
+
+AnalyticsLog *AnalyticsLog::GetInstance() {
+    static AnalyticsLog instance;
+    return &instance;
+}
+
+AnalyticsLog::AnalyticsLog() : mRunning(false), mDropped(0), mFrameTimeNs(0), mBufferCount(0) {
+    memset(mBuffers, 0, sizeof(mBuffers));
+    mMaxFileBytes = mMaxTotalBytes = 0;
+    mFd = -1;
+    mFileBytes = 0;
+    mFileIndex = 0;
+    mSyncRequested = mSyncDone = 0;
+}
+
+AnalyticsLog::ThreadBuffer *AnalyticsLog::RegisterThread() {
+    std::lock_guard<std::mutex> guard(mLock);
+    int n = mBufferCount.load(std::memory_order_relaxed);
+    if (n == ANALYTICS_MAX_THREADS) {
+        return NULL;
+    }
+    // buffers live as long as the process (threads may outlive a Stop()/Start() cycle)
+    ThreadBuffer *b = new ThreadBuffer;
+    // touch every page now, rather than page-faulting in Log()
+    memset(b->records, 0, sizeof(b->records));
+    b->head.store(0, std::memory_order_relaxed);
+    b->tail.store(0, std::memory_order_relaxed);
+    b->thread = (uint16_t) n;
+    mBuffers[n] = b;
+    mBufferCount.store(n + 1, std::memory_order_release);
+    return b;
+}
+
+bool AnalyticsLog::AttachThread() {
+    if (!_thread_buffer) {
+        _thread_buffer = GetInstance()->RegisterThread();
+    }
+    return _thread_buffer != NULL;
+}
+
+void AnalyticsLog::Log(GameEvent type, uint32_t a, float x, float y) {
+    AnalyticsLog *self = GetInstance();
+    ThreadBuffer *b = (ThreadBuffer*) _thread_buffer;
+    if (!b) {
+        if (self->mRunning.load(std::memory_order_relaxed)) {
+            self->mDropped.fetch_add(1, std::memory_order_relaxed);
+        }
+        return;
+    }
+
+    uint32_t head = b->head.load(std::memory_order_relaxed);
+    if (head - b->tail.load(std::memory_order_acquire) == ANALYTICS_THREAD_BUFFER) {
+        self->mDropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    AnalyticsRecord *r = &b->records[head & (ANALYTICS_THREAD_BUFFER - 1)];
+    r->time_ns = self->mFrameTimeNs.load(std::memory_order_relaxed);
+    r->type = (uint16_t) type;
+    r->thread = b->thread;
+    r->a = a;
+    r->x = x;
+    r->y = y;
+    b->head.store(head + 1, std::memory_order_release);
+}
+
+bool AnalyticsLog::Start(const char *dir, size_t max_file_bytes, size_t max_total_bytes) {
+    if (mRunning.load()) {
+        return true;
+    }
+
+    mDir = dir;
+    mMaxFileBytes = max_file_bytes;
+    mMaxTotalBytes = max_total_bytes;
+
+    // continue numbering after the newest existing file
+    mFileIndex = 0;
+    DIR *d = opendir(dir);
+    if (d) {
+        struct dirent *ent;
+        unsigned idx;
+        while ((ent = readdir(d)) != NULL) {
+            if (sscanf(ent->d_name, "analytics_%u.bin", &idx) == 1 && idx + 1 > mFileIndex) {
+                mFileIndex = idx + 1;
+            }
+        }
+        closedir(d);
+    }
+
+    if (!OpenNextFile()) {
+        return false;
+    }
+
+    mPending.reserve(ANALYTICS_BLOCK_RECORDS * 2);
+    mCompressed.resize(sizeof(AnalyticsBlockHeader) +
+            Lz4CompressBound(ANALYTICS_BLOCK_RECORDS * sizeof(AnalyticsRecord)));
+
+    mRunning.store(true);
+    mFlushThread = std::thread(&AnalyticsLog::FlushThreadMain, this);
+    return true;
+}
+
+void AnalyticsLog::Stop() {
+    if (!mRunning.load()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> guard(mLock);
+        mRunning.store(false);
+    }
+    mWake.notify_one();
+    // it may be parked
+    mGate.Open();
+    mFlushThread.join();
+
+    if (mFd >= 0) {
+        close(mFd);
+        mFd = -1;
+    }
+}
+
+void AnalyticsLog::Suspend() {
+    if (!mRunning.load()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> guard(mLock);
+        mGate.Close();
+    }
+    mWake.notify_one();
+    // it writes everything out before parking; if it's that slow, it gets there eventually
+    if (!mGate.WaitParked(1, ANALYTICS_SUSPEND_TIMEOUT_MS)) {
+        LOGW("AnalyticsLog: flush thread not parked after %d ms.", ANALYTICS_SUSPEND_TIMEOUT_MS);
+    }
+}
+
+void AnalyticsLog::Flush() {
+    if (!mRunning.load()) {
+        return;
+    }
+    std::lock_guard<std::mutex> guard(mWriteLock);
+    Gather();
+    while (!mPending.empty()) {
+        WriteBlock();
+    }
+}
+
+bool AnalyticsLog::Sync() {
+    if (!mRunning.load()) {
+        return true;
+    }
+    std::unique_lock<std::mutex> lock(mLock);
+    uint64_t request = ++mSyncRequested;
+    mWake.notify_one();
+    // a parked thread has written everything already
+    bool done = mSynced.wait_for(lock, std::chrono::milliseconds(ANALYTICS_SUSPEND_TIMEOUT_MS),
+                                 [this, request] { return mSyncDone >= request ||
+                                                          mGate.IsClosed(); });
+    if (!done) {
+        LOGW("AnalyticsLog: flush not done after %d ms.", ANALYTICS_SUSPEND_TIMEOUT_MS);
+    }
+    return done;
+}
+
+void AnalyticsLog::Resume() {
+    mGate.Open();
+}
+
+bool AnalyticsLog::OpenNextFile() {
+    if (mFd >= 0) {
+        close(mFd);
+    }
+
+    std::string path = mDir + "/analytics_" + std::to_string(mFileIndex++) + ".bin";
+    mFd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (mFd < 0) {
+        return false;
+    }
+
+    AnalyticsFileHeader h = { ANALYTICS_MAGIC, ANALYTICS_VERSION, sizeof(AnalyticsRecord), 0 };
+    mFileBytes = write(mFd, &h, sizeof(h)) == sizeof(h) ? sizeof(h) : 0;
+
+    EnforceCap();
+    return true;
+}
+
+void AnalyticsLog::EnforceCap() {
+    struct File {
+        unsigned index;
+        size_t size;
+    };
+    std::vector<File> files;
+    size_t total = 0;
+
+    DIR *d = opendir(mDir.c_str());
+    if (!d) {
+        return;
+    }
+    struct dirent *ent;
+    unsigned idx;
+    while ((ent = readdir(d)) != NULL) {
+        struct stat st;
+        std::string path = mDir + "/" + ent->d_name;
+        if (sscanf(ent->d_name, "analytics_%u.bin", &idx) == 1 && stat(path.c_str(), &st) == 0) {
+            files.push_back({ idx, (size_t) st.st_size });
+            total += st.st_size;
+        }
+    }
+    closedir(d);
+
+    // oldest first; never delete the current file (the last one)
+    std::sort(files.begin(), files.end(), [](const File& a, const File& b) {
+        return a.index < b.index;
+    });
+    for (size_t i = 0; i + 1 < files.size() && total > mMaxTotalBytes; i++) {
+        std::string path = mDir + "/analytics_" + std::to_string(files[i].index) + ".bin";
+        unlink(path.c_str());
+        total -= files[i].size;
+    }
+}
+
+void AnalyticsLog::Gather() {
+    int n = mBufferCount.load(std::memory_order_acquire);
+    for (int i = 0; i < n; i++) {
+        ThreadBuffer *b = mBuffers[i];
+        uint32_t tail = b->tail.load(std::memory_order_relaxed);
+        uint32_t head = b->head.load(std::memory_order_acquire);
+        for (; tail != head; tail++) {
+            mPending.push_back(b->records[tail & (ANALYTICS_THREAD_BUFFER - 1)]);
+        }
+        b->tail.store(tail, std::memory_order_release);
+    }
+}
+
+void AnalyticsLog::WriteBlock() {
+    size_t count = std::min(mPending.size(), (size_t) ANALYTICS_BLOCK_RECORDS);
+    if (!count) {
+        return;
+    }
+
+    const uint8_t *raw = (const uint8_t*) mPending.data();
+    size_t raw_size = count * sizeof(AnalyticsRecord);
+    uint8_t *out = mCompressed.data() + sizeof(AnalyticsBlockHeader);
+    size_t comp_size = Lz4CompressBlock(raw, raw_size, out,
+            mCompressed.size() - sizeof(AnalyticsBlockHeader));
+    if (comp_size == 0 || comp_size >= raw_size) {
+        memcpy(out, raw, raw_size);
+        comp_size = raw_size;
+    }
+
+    AnalyticsBlockHeader h = { (uint32_t) raw_size, (uint32_t) comp_size };
+    memcpy(mCompressed.data(), &h, sizeof(h));
+
+    size_t total = sizeof(h) + comp_size;
+    if (mFileBytes + total > mMaxFileBytes && mFileBytes > sizeof(AnalyticsFileHeader)) {
+        OpenNextFile();
+    }
+    if (mFd >= 0 && write(mFd, mCompressed.data(), total) == (ssize_t) total) {
+        mFileBytes += total;
+    } else {
+        mDropped.fetch_add(count, std::memory_order_relaxed);
+    }
+
+    mPending.erase(mPending.begin(), mPending.begin() + count);
+}
+
+void AnalyticsLog::FlushThreadMain() {
+    SamplingProfiler::GetInstance()->RegisterThread("analytics");
+
+    bool running = true;
+    while (running) {
+        // the Sync() calls this pass serves: those made before it gathers
+        uint64_t sync;
+        {
+            std::unique_lock<std::mutex> lock(mLock);
+            mWake.wait_for(lock, std::chrono::milliseconds(ANALYTICS_FLUSH_INTERVAL_MS),
+                           [this] { return !mRunning.load() || mGate.IsClosed() ||
+                                           mSyncRequested != mSyncDone; });
+            running = mRunning.load();
+            sync = mSyncRequested != mSyncDone ? mSyncRequested : 0;
+        }
+        bool suspending = running && mGate.IsClosed();
+
+        {
+            std::lock_guard<std::mutex> guard(mWriteLock);
+            Gather();
+
+            // full blocks now; whatever is left only when stopping, suspending or syncing
+            while (mPending.size() >= ANALYTICS_BLOCK_RECORDS ||
+                    ((!running || suspending || sync) && !mPending.empty())) {
+                WriteBlock();
+            }
+        }
+
+        if (sync) {
+            {
+                std::lock_guard<std::mutex> guard(mLock);
+                mSyncDone = sync;
+            }
+            mSynced.notify_all();
+        }
+
+        if (suspending) {
+            mGate.Pass();
+        }
+    }
+}
@@ -0,0 +1,148 @@
+#ifndef endlesstunnel_analytics_hpp
+#define endlesstunnel_analytics_hpp
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "suspend.hpp"
+
+enum class GameEvent : uint16_t {
+    Collision = 1,    // a: lives left
+    CloseCall = 2,    // a: obstacle cell
+    BonusPickup = 3,  // a: score after pickup
+    LevelUp = 4,      // a: new level
+};
+
+// One event, as stored in the log (before compression).
+struct AnalyticsRecord {
+    uint64_t time_ns;   // CLOCK_MONOTONIC, of the frame
+    uint16_t type;      // GameEvent
+    uint16_t thread;    // small per-log thread number
+    uint32_t a;         // event-specific
+    float x, y;         // where it happened (player position)
+};
+
+static_assert(sizeof(AnalyticsRecord) == 24, "AnalyticsRecord layout changed; bump the version");
+
+// On-disk format: a file header, then blocks. Each block is a block header followed by
+// comp_size bytes: an LZ4 block that decompresses to raw_size bytes of AnalyticsRecords, or
+// the records as-is if comp_size == raw_size (incompressible).
+#define ANALYTICS_MAGIC 0x4c4e4154  // "TANL"
+#define ANALYTICS_VERSION 1
+
+struct AnalyticsFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t reserved;
+};
+
+struct AnalyticsBlockHeader {
+    uint32_t raw_size;
+    uint32_t comp_size;
+};
+
+// records each thread can buffer between two flushes (power of two)
+#define ANALYTICS_THREAD_BUFFER 4096
+
+// max threads that can log
+#define ANALYTICS_MAX_THREADS 8
+
+// Gameplay event log. Log() just copies a record into the calling thread's own ring buffer
+// (no locks, no allocation, no I/O); a background thread periodically gathers the records,
+// compresses them in blocks and appends them to the current file. Files are rotated once they
+// reach a size, and the oldest ones are deleted to keep the total under a cap.
+//
+// Threads get their buffer in AttachThread(), once, before they log anything: allocating it
+// (and faulting its pages in) takes far longer than a Log().
+class AnalyticsLog {
+    public:
+        static AnalyticsLog *GetInstance();
+
+        // files go to dir/analytics_<n>.bin
+        bool Start(const char *dir, size_t max_file_bytes, size_t max_total_bytes);
+
+        // flushes everything and stops the background thread
+        void Stop();
+
+        // has the background thread flush everything and park until Resume() (while the app is
+        // paused: it may not come back). Log() can still be called in the meantime. Waits at
+        // most ANALYTICS_SUSPEND_TIMEOUT_MS for it.
+        void Suspend();
+        void Resume();
+
+        // writes everything logged so far, partial blocks included, from the calling thread. For
+        // when the process may be killed without a Stop().
+        void Flush();
+
+        // same, but has the background thread do it, and waits at most
+        // ANALYTICS_SUSPEND_TIMEOUT_MS for it (so that the game thread does no I/O). Returns
+        // false if it timed out.
+        bool Sync();
+
+        // gives the calling thread its buffer; it keeps it for the life of the process. Returns
+        // false if there are ANALYTICS_MAX_THREADS already.
+        static bool AttachThread();
+
+        // hot path. Drops the event if the thread's buffer is full, or the thread never called
+        // AttachThread() (see GetDropped()).
+        static void Log(GameEvent type, uint32_t a, float x, float y);
+
+        // Events are stamped with the time of the frame they happened in (reading the clock
+        // would cost more than the rest of Log()). The engine sets it at the start of each frame.
+        static void SetFrameTime(uint64_t time_ns) {
+            GetInstance()->mFrameTimeNs.store(time_ns, std::memory_order_relaxed);
+        }
+
+        uint64_t GetDropped() const { return mDropped.load(std::memory_order_relaxed); }
+
+    private:
+        // single producer (the owning thread), single consumer (the flush thread)
+        struct ThreadBuffer {
+            std::atomic<uint32_t> head;  // next record to write
+            std::atomic<uint32_t> tail;  // next record to read
+            uint16_t thread;
+            AnalyticsRecord records[ANALYTICS_THREAD_BUFFER];
+        };
+
+        AnalyticsLog();
+
+        ThreadBuffer *RegisterThread();
+        void FlushThreadMain();
+        void Gather();
+        void WriteBlock();
+        bool OpenNextFile();
+        void EnforceCap();
+
+        std::atomic<bool> mRunning;
+        std::atomic<uint64_t> mDropped;
+        std::atomic<uint64_t> mFrameTimeNs;
+
+        std::mutex mLock;              // thread registration, and waking the flush thread
+        std::mutex mWriteLock;         // gathering and writing: the flush thread, or Flush()
+        std::condition_variable mWake;
+        std::condition_variable mSynced;
+        uint64_t mSyncRequested;       // Sync() calls so far (under mLock)
+        uint64_t mSyncDone;            // how many of them the flush thread has served
+        ThreadBuffer *mBuffers[ANALYTICS_MAX_THREADS];
+        std::atomic<int> mBufferCount;
+
+        std::thread mFlushThread;
+        ParkingGate mGate;
+        std::string mDir;
+        size_t mMaxFileBytes, mMaxTotalBytes;
+        int mFd;
+        size_t mFileBytes;
+        uint32_t mFileIndex;
+
+        std::vector<AnalyticsRecord> mPending;  // gathered, not yet written
+        std::vector<uint8_t> mCompressed;
+};
+
+#endif
@@ -0,0 +1,285 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "benchmark.hpp"
+
+// frames to keep going after the last recorded one, so pending GPU results can come in
+#define BENCH_DRAIN_FRAMES 8
+
+// tags carry the scenario's position in the queue, so late GPU results of a previous
+// scenario can't be mistaken for the current one's
+#define BENCH_TAG_FRAME_BITS 24
+#define BENCH_TAG_FRAME_MASK ((1u << BENCH_TAG_FRAME_BITS) - 1)
+
+static const BenchScenario _scenarios[] = {
+    //  name               tris  anim  warm  frames reps  cpu    gpu    allocs draws
+    { "triangles_1",         1, true,   60,   300,   8,  4.0f,  4.0f,  0.0f,  1.0f },
+    { "triangles_100",     100, true,   60,   300,   8,  4.0f,  4.0f,  0.0f,  1.0f },
+    { "triangles_1000",   1000, true,   60,   300,   8,  6.0f,  8.0f,  0.0f,  1.0f },
+    { "triangles_10000", 10000, true,   60,   150,   8, 12.0f, 16.0f,  0.0f,  1.0f },
+    { "menu_idle",           1, false,  60,   300,   8,  1.0f,  0.5f,  0.0f,  0.0f },
+};
+
+#define BENCH_SCENARIO_COUNT ((int) (sizeof(_scenarios) / sizeof(_scenarios[0])))
+
+const BenchScenario *BenchmarkRunner::FindScenario(const char *name) {
+    for (int i = 0; i < BENCH_SCENARIO_COUNT; i++) {
+        if (0 == strcmp(_scenarios[i].name, name)) {
+            return &_scenarios[i];
+        }
+    }
+    return nullptr;
+}
+
+BenchmarkRunner::BenchmarkRunner() {
+    mNext = 0;
+    mConfigured = false;
+    mChanged = false;
+    mPassed = true;
+    mFrame = 0;
+    mRepetition = 0;
+    mDrainFrames = 0;
+}
+
+bool BenchmarkRunner::Configure(const char *scenarios, const char *out_dir) {
+    mQueue.clear();
+    mNext = 0;
+    mOutDir = out_dir;
+    mPassed = true;
+
+    std::string list(scenarios);
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t end = list.find(',', start);
+        if (end == std::string::npos) {
+            end = list.size();
+        }
+        std::string name = list.substr(start, end - start);
+        start = end + 1;
+
+        if (name.empty()) {
+            continue;
+        } else if (name == "all") {
+            for (int i = 0; i < BENCH_SCENARIO_COUNT; i++) {
+                mQueue.push_back(&_scenarios[i]);
+            }
+        } else if (const BenchScenario *s = FindScenario(name.c_str())) {
+            mQueue.push_back(s);
+        } else {
+            fprintf(stderr, "benchmark: unknown scenario '%s', skipped.\n", name.c_str());
+        }
+    }
+
+    mConfigured = !mQueue.empty();
+    if (mConfigured) {
+        StartScenario();
+    }
+    return mConfigured;
+}
+
+const BenchScenario *BenchmarkRunner::GetScenario() const {
+    return IsActive() ? mQueue[mNext] : nullptr;
+}
+
+bool BenchmarkRunner::ScenarioChanged() {
+    bool changed = mChanged;
+    mChanged = false;
+    return changed;
+}
+
+bool BenchmarkRunner::IsRecording() const {
+    return IsActive() && mDrainFrames == 0 && mFrame >= 0;
+}
+
+void BenchmarkRunner::StartScenario() {
+    mFrames.clear();
+    if (!IsActive()) {
+        return;
+    }
+    const BenchScenario *s = mQueue[mNext];
+    mFrames.reserve((size_t) s->frames * s->repetitions);
+    mRepetition = 0;
+    mFrame = -s->warmup_frames;
+    mDrainFrames = 0;
+    mChanged = true;
+}
+
+uint32_t BenchmarkRunner::GetNextTag() const {
+    return ((uint32_t) mNext << BENCH_TAG_FRAME_BITS) | (uint32_t) mFrames.size();
+}
+
+uint32_t BenchmarkRunner::AddFrame(const BenchFrame& frame) {
+    if (!IsActive()) {
+        return BENCH_NO_TAG;
+    }
+    const BenchScenario *s = mQueue[mNext];
+
+    if (mDrainFrames > 0) {
+        if (--mDrainFrames == 0) {
+            if (!WriteResults(s)) {
+                mPassed = false;
+            }
+            mNext++;
+            StartScenario();
+        }
+        return BENCH_NO_TAG;
+    }
+
+    if (mFrame < 0) {
+        // warming up
+        mFrame++;
+        return BENCH_NO_TAG;
+    }
+
+    uint32_t tag = GetNextTag();
+    mFrames.push_back(frame);
+
+    if (++mFrame == s->frames) {
+        if (++mRepetition < s->repetitions) {
+            mFrame = -s->warmup_frames;
+        } else {
+            mDrainFrames = BENCH_DRAIN_FRAMES;
+        }
+    }
+    return tag;
+}
+
+void BenchmarkRunner::SetGpuTime(uint32_t tag, float ms) {
+    if (tag == BENCH_NO_TAG) {
+        return;
+    }
+    size_t frame = tag & BENCH_TAG_FRAME_MASK;
+    if ((tag >> BENCH_TAG_FRAME_BITS) == mNext && frame < mFrames.size()) {
+        mFrames[frame].gpu_ms = ms;
+    }
+}
+
+struct BenchSummary {
+    int count;
+    float mean, p50, p95, max;
+};
+
+// summary of values[begin, end), ignoring negative (unknown) values
+static BenchSummary Summarize(const std::vector<float>& values, size_t begin, size_t end) {
+    std::vector<float> v;
+    v.reserve(end - begin);
+    for (size_t i = begin; i < end; i++) {
+        if (values[i] >= 0.0f) {
+            v.push_back(values[i]);
+        }
+    }
+
+    BenchSummary s = { (int) v.size(), 0.0f, 0.0f, 0.0f, 0.0f };
+    if (v.empty()) {
+        return s;
+    }
+    std::sort(v.begin(), v.end());
+    double sum = 0.0;
+    for (float x : v) {
+        sum += x;
+    }
+    s.mean = (float) (sum / v.size());
+    s.p50 = v[(v.size() - 1) / 2];
+    s.p95 = v[(size_t) ((v.size() - 1) * 0.95)];
+    s.max = v.back();
+    return s;
+}
+
+static void WriteSummary(FILE *f, const char *name, const BenchSummary& s, bool last) {
+    fprintf(f, "\"%s\": {\"count\": %d, \"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, "
+               "\"max\": %.4f}%s", name, s.count, s.mean, s.p50, s.p95, s.max, last ? "" : ", ");
+}
+
+static void WriteArray(FILE *f, const char *name, const std::vector<float>& values,
+                       size_t begin, size_t end) {
+    fprintf(f, "      \"%s\": [", name);
+    for (size_t i = begin; i < end; i++) {
+        if (values[i] < 0.0f) {
+            fprintf(f, "%snull", i > begin ? ", " : "");
+        } else {
+            fprintf(f, "%s%.4g", i > begin ? ", " : "", values[i]);
+        }
+    }
+    fprintf(f, "],\n");
+}
+
+#define BENCH_METRICS 5
+
+static const char *_metric_names[BENCH_METRICS] = {
+    "cpu_ms", "gpu_ms", "swap_ms", "allocs", "draw_calls"
+};
+
+bool BenchmarkRunner::WriteResults(const BenchScenario *s) {
+    // one column per metric
+    std::vector<float> metrics[BENCH_METRICS];
+    for (const BenchFrame& fr : mFrames) {
+        metrics[0].push_back(fr.cpu_ms);
+        metrics[1].push_back(fr.gpu_ms);
+        metrics[2].push_back(fr.swap_ms);
+        metrics[3].push_back((float) fr.allocs);
+        metrics[4].push_back((float) fr.draw_calls);
+    }
+
+    BenchSummary total[BENCH_METRICS];
+    for (int m = 0; m < BENCH_METRICS; m++) {
+        total[m] = Summarize(metrics[m], 0, mFrames.size());
+    }
+
+    // thresholds apply to the p95 over all repetitions
+    const float limits[BENCH_METRICS] = {
+        s->max_cpu_ms, s->max_gpu_ms, -1.0f, s->max_allocs, s->max_draw_calls
+    };
+    bool passed = true;
+    std::string failures;
+    for (int m = 0; m < BENCH_METRICS; m++) {
+        if (limits[m] >= 0.0f && total[m].count > 0 && total[m].p95 > limits[m]) {
+            passed = false;
+            failures += std::string(failures.empty() ? "\"" : ", \"") + _metric_names[m] + "\"";
+        }
+    }
+
+    std::string path = mOutDir + "/bench_" + s->name + ".json";
+    FILE *f = fopen(path.c_str(), "w");
+    if (!f) {
+        fprintf(stderr, "benchmark: can't write %s\n", path.c_str());
+        return false;
+    }
+
+    fprintf(f, "{\n  \"scenario\": \"%s\",\n  \"triangles\": %d,\n  \"animate\": %s,\n",
+            s->name, s->triangles, s->animate ? "true" : "false");
+    fprintf(f, "  \"warmup_frames\": %d,\n  \"frames\": %d,\n  \"repetitions\": %d,\n",
+            s->warmup_frames, s->frames, s->repetitions);
+    fprintf(f, "  \"thresholds_p95\": {\"cpu_ms\": %.2f, \"gpu_ms\": %.2f, \"allocs\": %.0f, "
+               "\"draw_calls\": %.0f},\n", s->max_cpu_ms, s->max_gpu_ms, s->max_allocs,
+            s->max_draw_calls);
+
+    fprintf(f, "  \"runs\": [\n");
+    for (int r = 0; r < s->repetitions; r++) {
+        size_t begin = (size_t) r * s->frames;
+        size_t end = std::min(begin + s->frames, mFrames.size());
+        fprintf(f, "    {\n");
+        for (int m = 0; m < BENCH_METRICS; m++) {
+            WriteArray(f, _metric_names[m], metrics[m], begin, end);
+        }
+        fprintf(f, "      \"summary\": {");
+        for (int m = 0; m < BENCH_METRICS; m++) {
+            WriteSummary(f, _metric_names[m], Summarize(metrics[m], begin, end),
+                         m == BENCH_METRICS - 1);
+        }
+        fprintf(f, "}\n    }%s\n", r == s->repetitions - 1 ? "" : ",");
+    }
+    fprintf(f, "  ],\n");
+
+    fprintf(f, "  \"summary\": {");
+    for (int m = 0; m < BENCH_METRICS; m++) {
+        WriteSummary(f, _metric_names[m], total[m], m == BENCH_METRICS - 1);
+    }
+    fprintf(f, "},\n");
+    fprintf(f, "  \"failures\": [%s],\n  \"passed\": %s\n}\n", failures.c_str(),
+            passed ? "true" : "false");
+
+    bool ok = (0 == fclose(f));
+    return ok && passed;
+}
@@ -0,0 +1,97 @@
+#ifndef endlesstunnel_benchmark_hpp
+#define endlesstunnel_benchmark_hpp
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// GPU timer tag of a frame that isn't recorded (warm-up, drain, or no benchmark running); no
+// recorded frame gets it
+#define BENCH_NO_TAG 0xffffffffu
+
+// Whole-engine benchmark scenarios. The engine sets itself up as the scenario describes and
+// runs it for a fixed number of frames; max values are thresholds on the 95th percentile
+// (a negative threshold isn't checked).
+struct BenchScenario {
+    const char *name;
+    int triangles;         // rotating triangles drawn each frame
+    bool animate;          // false: nothing moves, so nothing gets redrawn (idle screen)
+    int warmup_frames;     // run before each repetition, not recorded
+    int frames;            // recorded frames per repetition
+    int repetitions;
+    float max_cpu_ms;
+    float max_gpu_ms;
+    float max_allocs;      // heap allocations per frame
+    float max_draw_calls;
+};
+
+// what was measured for one frame; gpu_ms is negative if it's not known (yet)
+struct BenchFrame {
+    float cpu_ms;          // frame start to swap
+    float gpu_ms;
+    float swap_ms;         // time blocked in eglSwapBuffers
+    uint32_t allocs;
+    uint32_t draw_calls;
+};
+
+// Runs a list of scenarios, one after the other, and writes each one's results to
+// <out_dir>/bench_<name>.json (all frames of all repetitions, plus summaries and thresholds).
+class BenchmarkRunner {
+    public:
+        BenchmarkRunner();
+
+        // scenarios is a comma separated list of scenario names, or "all". Unknown names are
+        // skipped. Returns false if there's nothing to run.
+        bool Configure(const char *scenarios, const char *out_dir);
+
+        // is there a scenario running, or waiting to run?
+        bool IsActive() const { return mNext < mQueue.size(); }
+
+        // scenario currently running (nullptr if none)
+        const BenchScenario *GetScenario() const;
+
+        // true once, when a new scenario starts: the caller must set it up before drawing
+        bool ScenarioChanged();
+
+        // is the current frame recorded (i.e. not a warm-up frame)?
+        bool IsRecording() const;
+
+        // tag the next recorded frame will get (only meaningful while IsRecording())
+        uint32_t GetNextTag() const;
+
+        // adds the current frame. Returns its tag, to match a GPU time later (BENCH_NO_TAG if
+        // the frame isn't recorded).
+        uint32_t AddFrame(const BenchFrame& frame);
+
+        // fills in a frame's GPU time, once known (ignored for BENCH_NO_TAG)
+        void SetGpuTime(uint32_t tag, float ms);
+
+        // true when all scenarios are done
+        bool IsFinished() const { return mConfigured && !IsActive(); }
+
+        // results of the scenarios that ran; false if any of them exceeded a threshold
+        bool Passed() const { return mPassed; }
+
+        static const BenchScenario *FindScenario(const char *name);
+
+    private:
+        std::vector<const BenchScenario*> mQueue;
+        size_t mNext;
+        std::string mOutDir;
+        bool mConfigured;
+        bool mChanged;
+        bool mPassed;
+
+        // frame number within the current repetition (negative while warming up)
+        int mFrame;
+        int mRepetition;
+        std::vector<BenchFrame> mFrames;  // all repetitions of the current scenario
+
+        // frames needed for outstanding GPU results before the scenario can be written
+        int mDrainFrames;
+
+        void StartScenario();
+        bool WriteResults(const BenchScenario *s);
+};
+
+#endif
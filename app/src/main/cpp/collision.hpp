@@ -0,0 +1,60 @@
+#ifndef endlesstunnel_collision_hpp
+#define endlesstunnel_collision_hpp
+
+#include "obstacle.hpp"
+
+// Player vs. obstacle tests. The player is a point: it hits an obstacle when it's within a box's
+// depth and in a cell with a box, and has a close call when it gets through an obstacle that
+// it would have hit had it been CLOSE_CALL_CALC_DELTA further to any side.
+//
+// Everything is a cell lookup and a mask test, so there's nothing to loop over.
+template <class Grid>
+class BasicObstacleCollision {
+    public:
+        typedef typename Grid::Mask Mask;
+        typedef BasicObstacle<Grid> ObstacleType;
+
+        // how far from the player close calls are looked for; well within the neighbouring
+        // cells, so those are all that needs checking
+        static constexpr float CLOSE_CALL_DELTA = 0.2f * Grid::CELL_SIZE;
+        static_assert(CLOSE_CALL_DELTA < Grid::CELL_SIZE, "close calls reach beyond neighbours");
+
+        // is the player (at y along the tunnel) within the obstacle's boxes' depth?
+        static bool IsWithin(const ObstacleType& o, float y) {
+            return y >= o.y - 0.5f * Grid::BOX_SIZE && y <= o.y + 0.5f * Grid::BOX_SIZE;
+        }
+
+        static bool Collides(const ObstacleType& o, float x, float y, float z) {
+            return IsWithin(o, y) && 0 != (o.mask & Grid::CellAt(x, z));
+        }
+
+        static bool CollidesWithBonus(const ObstacleType& o, float x, float y, float z) {
+            return o.HasBonus() && y >= o.y - 0.5f * Grid::BONUS_SIZE &&
+                   y <= o.y + 0.5f * Grid::BONUS_SIZE &&
+                   Grid::ColAt(x) == o.bonusCol && Grid::RowAt(z) == o.bonusRow;
+        }
+
+        static bool IsCloseCall(const ObstacleType& o, float x, float y, float z) {
+            if (!IsWithin(o, y)) {
+                return false;
+            }
+            int col = Grid::ColAt(x), row = Grid::RowAt(z);
+            Mask cell = Grid::CellBit(col, row);
+            // in a box, or nothing around: most tests end here
+            if ((o.mask & cell) || !(o.mask & Grid::NEIGHBOURS[row * Grid::SIZE + col])) {
+                return false;
+            }
+            Mask around = Grid::CellAt(x - CLOSE_CALL_DELTA, z) |
+                          Grid::CellAt(x + CLOSE_CALL_DELTA, z) |
+                          Grid::CellAt(x, z - CLOSE_CALL_DELTA) |
+                          Grid::CellAt(x, z + CLOSE_CALL_DELTA);
+            return 0 != (o.mask & around);
+        }
+};
+
+typedef BasicObstacleCollision<DefaultGrid> ObstacleCollision;
+
+static_assert(ObstacleCollision::CLOSE_CALL_DELTA == CLOSE_CALL_CALC_DELTA,
+              "grid config out of sync with macros");
+
+#endif
@@ -23,7 +23,6 @@ extern "C" {
     #include <jni.h>
     #include <errno.h>
     #include <android/sensor.h>
-    #include <android/log.h>
     #include <unistd.h>
     #include <stdlib.h>
     #include <android/input.h>
@@ -31,16 +30,7 @@ extern "C" {
     #include <game-activity/native_app_glue/android_native_app_glue.h>
 }
 
-#define DEBUG_TAG "EndlessTunnel:Native"
-#define LOGD(...) ((void)__android_log_print(ANDROID_LOG_DEBUG, DEBUG_TAG, __VA_ARGS__))
-#define LOGI(...) ((void)__android_log_print(ANDROID_LOG_INFO, DEBUG_TAG, __VA_ARGS__))
-#define LOGW(...) ((void)__android_log_print(ANDROID_LOG_WARN, DEBUG_TAG, __VA_ARGS__))
-#define LOGE(...) ((void)__android_log_print(ANDROID_LOG_ERROR, DEBUG_TAG, __VA_ARGS__))
-#define ABORT_GAME { LOGE("*** GAME ABORTING."); *((volatile char*)0) = 'a'; }
-#define DEBUG_BLIP LOGD("[ BLIP ]: %s:%d", __FILE__, __LINE__)
-
-#define MY_ASSERT(cond) { if (!(cond)) { LOGE("ASSERTION FAILED: %s", #cond); \
-   ABORT_GAME; } }
+#include "log.hpp"
 
 #define BUFFER_OFFSET(i) ((char*)NULL + (i))
 
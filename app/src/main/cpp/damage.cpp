@@ -0,0 +1,175 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "common.hpp"
+#include "damage.hpp"
+
+#include <EGL/eglext.h>
+
+DamageTracker::DamageTracker() {
+    mDisplay = EGL_NO_DISPLAY;
+    mSurface = EGL_NO_SURFACE;
+    mWidth = mHeight = 0;
+    mHasBufferAge = false;
+    mSetDamageRegion = mSwapWithDamage = NULL;
+    mCurrent = 0;
+    Invalidate();
+}
+
+static bool _has_extension(const char *exts, const char *name) {
+    return exts && strstr(exts, name) != NULL;
+}
+
+void DamageTracker::Init(EGLDisplay display, EGLSurface surface) {
+    mDisplay = display;
+    mSurface = surface;
+
+    const char *exts = eglQueryString(display, EGL_EXTENSIONS);
+    mHasBufferAge = _has_extension(exts, "EGL_EXT_buffer_age") ||
+            _has_extension(exts, "EGL_KHR_partial_update");
+
+    mSetDamageRegion = _has_extension(exts, "EGL_KHR_partial_update") ?
+            (void*) eglGetProcAddress("eglSetDamageRegionKHR") : NULL;
+
+    mSwapWithDamage = NULL;
+    if (_has_extension(exts, "EGL_KHR_swap_buffers_with_damage")) {
+        mSwapWithDamage = (void*) eglGetProcAddress("eglSwapBuffersWithDamageKHR");
+    } else if (_has_extension(exts, "EGL_EXT_swap_buffers_with_damage")) {
+        mSwapWithDamage = (void*) eglGetProcAddress("eglSwapBuffersWithDamageEXT");
+    }
+
+    LOGD("DamageTracker: buffer age %s, partial update %s, swap with damage %s",
+         mHasBufferAge ? "yes" : "no", mSetDamageRegion ? "yes" : "no",
+         mSwapWithDamage ? "yes" : "no");
+    Invalidate();
+}
+
+void DamageTracker::SetSurfaceSize(int width, int height) {
+    mWidth = width;
+    mHeight = height;
+    Invalidate();
+}
+
+void DamageTracker::Invalidate() {
+    for (int i = 0; i < DAMAGE_HISTORY; i++) {
+        mHistory[i].count = 0;
+        mHistory[i].full = true;
+    }
+}
+
+DamageRect DamageTracker::Bounds(const FrameDamage& d) {
+    int x0 = d.rects[0].x, y0 = d.rects[0].y;
+    int x1 = x0 + d.rects[0].w, y1 = y0 + d.rects[0].h;
+    for (int i = 1; i < d.count; i++) {
+        x0 = std::min(x0, d.rects[i].x);
+        y0 = std::min(y0, d.rects[i].y);
+        x1 = std::max(x1, d.rects[i].x + d.rects[i].w);
+        y1 = std::max(y1, d.rects[i].y + d.rects[i].h);
+    }
+    return { x0, y0, x1 - x0, y1 - y0 };
+}
+
+void DamageTracker::Merge(FrameDamage *dst, const DamageRect& r) {
+    if (dst->full || r.w <= 0 || r.h <= 0) {
+        return;
+    }
+    if (dst->count == DAMAGE_MAX_RECTS) {
+        // out of room: collapse everything into one rect
+        dst->rects[0] = Bounds(*dst);
+        dst->count = 1;
+    }
+    dst->rects[dst->count++] = r;
+}
+
+void DamageTracker::AddDamage(const DamageRect& r) {
+    // clip to the surface
+    int x0 = std::max(r.x, 0), y0 = std::max(r.y, 0);
+    int x1 = std::min(r.x + r.w, mWidth), y1 = std::min(r.y + r.h, mHeight);
+    if (x1 > x0 && y1 > y0) {
+        Merge(&mHistory[mCurrent], { x0, y0, x1 - x0, y1 - y0 });
+    }
+}
+
+void DamageTracker::AddDamageNdc(float min_x, float min_y, float max_x, float max_y) {
+    // one pixel of margin on each side, for rasterization rounding
+    int x0 = (int) floorf((min_x + 1.0f) * 0.5f * mWidth) - 1;
+    int y0 = (int) floorf((min_y + 1.0f) * 0.5f * mHeight) - 1;
+    int x1 = (int) ceilf((max_x + 1.0f) * 0.5f * mWidth) + 1;
+    int y1 = (int) ceilf((max_y + 1.0f) * 0.5f * mHeight) + 1;
+    AddDamage({ x0, y0, x1 - x0, y1 - y0 });
+}
+
+void DamageTracker::ToEglRects(const FrameDamage& d, EGLint *out) const {
+    for (int i = 0; i < d.count; i++) {
+        out[i * 4 + 0] = d.rects[i].x;
+        out[i * 4 + 1] = d.rects[i].y;
+        out[i * 4 + 2] = d.rects[i].w;
+        out[i * 4 + 3] = d.rects[i].h;
+    }
+}
+
+bool DamageTracker::BeginFrame(DamageRect *repaint) {
+    const FrameDamage& cur = mHistory[mCurrent];
+    if (!cur.full && cur.count == 0) {
+        // static frame
+        return false;
+    }
+
+    // which older frames does the back buffer lack? (age 1 = it has the previous frame)
+    EGLint age = 0;
+    if (mHasBufferAge && !eglQuerySurface(mDisplay, mSurface, EGL_BUFFER_AGE_KHR, &age)) {
+        age = 0;
+    }
+
+    FrameDamage region = cur;
+    if (age <= 0 || age > DAMAGE_HISTORY) {
+        region.full = true;
+    }
+    for (int i = 1; i < age && !region.full; i++) {
+        const FrameDamage& old = mHistory[(mCurrent - i + DAMAGE_HISTORY) % DAMAGE_HISTORY];
+        if (old.full) {
+            region.full = true;
+        }
+        for (int j = 0; j < old.count; j++) {
+            Merge(&region, old.rects[j]);
+        }
+    }
+
+    if (region.full) {
+        region.count = 1;
+        region.rects[0] = { 0, 0, mWidth, mHeight };
+    }
+
+    if (mSetDamageRegion) {
+        EGLint rects[DAMAGE_MAX_RECTS * 4];
+        ToEglRects(region, rects);
+        ((PFNEGLSETDAMAGEREGIONKHRPROC) mSetDamageRegion)(mDisplay, mSurface, rects, region.count);
+    }
+
+    *repaint = Bounds(region);
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(repaint->x, repaint->y, repaint->w, repaint->h);
+    return true;
+}
+
+EGLBoolean DamageTracker::Swap() {
+    glDisable(GL_SCISSOR_TEST);
+
+    const FrameDamage& cur = mHistory[mCurrent];
+    EGLBoolean ret;
+    if (mSwapWithDamage && !cur.full) {
+        EGLint rects[DAMAGE_MAX_RECTS * 4];
+        ToEglRects(cur, rects);
+        ret = ((PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC) mSwapWithDamage)(mDisplay, mSurface, rects,
+                cur.count);
+    } else {
+        ret = eglSwapBuffers(mDisplay, mSurface);
+    }
+
+    // start collecting damage for the next frame
+    mCurrent = (mCurrent + 1) % DAMAGE_HISTORY;
+    mHistory[mCurrent].count = 0;
+    mHistory[mCurrent].full = false;
+    return ret;
+}
@@ -0,0 +1,76 @@
+#ifndef endlesstunnel_damage_hpp
+#define endlesstunnel_damage_hpp
+
+#include <EGL/egl.h>
+
+// a rectangle in surface pixels, with the origin at the bottom-left corner (like glScissor)
+struct DamageRect {
+    int x, y, w, h;
+};
+
+// max rectangles we track per frame; beyond that they are merged into their bounding box
+#define DAMAGE_MAX_RECTS 8
+
+// how many past frames of damage we remember (buffer ages beyond this mean a full repaint)
+#define DAMAGE_HISTORY 4
+
+// Tracks which parts of the surface changed, so that we only repaint and swap those.
+//
+// Each frame, whatever draws something that moved/changed reports the area it covered before
+// and after the change with AddDamage(). BeginFrame() works out what has to be repainted in
+// the current back buffer (its own damage plus that of the frames since the buffer was last
+// used, per EGL_EXT_buffer_age), tells EGL about it (EGL_KHR_partial_update) and sets the
+// scissor to it. Swap() then tells the compositor what changed
+// (EGL_KHR_swap_buffers_with_damage). Without the extensions we fall back to full repaints.
+class DamageTracker {
+    public:
+        DamageTracker();
+
+        // queries extension support. Must be called again whenever the surface is recreated.
+        void Init(EGLDisplay display, EGLSurface surface);
+
+        // also invalidates the whole surface
+        void SetSurfaceSize(int width, int height);
+
+        // repaint everything on the next frames
+        void Invalidate();
+
+        void AddDamage(const DamageRect& r);
+
+        // damage from normalized device coordinates ([-1, 1] on both axes)
+        void AddDamageNdc(float min_x, float min_y, float max_x, float max_y);
+
+        // Sets up the back buffer for repainting. Returns false if nothing changed since the last
+        // frame, in which case nothing should be drawn nor swapped. Otherwise, the scissor test
+        // is enabled and set to the region to repaint (also returned in *repaint).
+        bool BeginFrame(DamageRect *repaint);
+
+        // swaps with damage, and disables the scissor test. Same return value as eglSwapBuffers.
+        EGLBoolean Swap();
+
+    private:
+        struct FrameDamage {
+            DamageRect rects[DAMAGE_MAX_RECTS];
+            int count;
+            bool full;
+        };
+
+        EGLDisplay mDisplay;
+        EGLSurface mSurface;
+        int mWidth, mHeight;
+        bool mHasBufferAge;
+
+        // entry points, looked up with eglGetProcAddress (NULL if not supported)
+        void *mSetDamageRegion;
+        void *mSwapWithDamage;
+
+        // mHistory[mCurrent] is the frame being built, older ones go backwards
+        FrameDamage mHistory[DAMAGE_HISTORY];
+        int mCurrent;
+
+        static void Merge(FrameDamage *dst, const DamageRect& r);
+        static DamageRect Bounds(const FrameDamage& d);
+        void ToEglRects(const FrameDamage& d, EGLint *out) const;
+};
+
+#endif
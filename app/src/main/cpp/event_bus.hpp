@@ -0,0 +1,149 @@
+#ifndef endlesstunnel_event_bus_hpp
+#define endlesstunnel_event_bus_hpp
+
+#include <stddef.h>
+#include <stdint.h>
+#include <new>
+#include <tuple>
+#include <type_traits>
+
+// max bytes of captured state a delegate can hold inline
+#define DELEGATE_STORAGE_SIZE (2 * sizeof(void*))
+
+// A callable taking const E&, stored inline (no heap allocation, unlike std::function).
+// Either a member function bound to an object, or a small trivially copyable functor/lambda.
+template <typename E>
+class Delegate {
+    public:
+        Delegate() : mInvoke(nullptr) {}
+
+        // binds obj->Method
+        template <typename T, void (T::*Method)(const E&)>
+        static Delegate Bind(T *obj) {
+            Delegate d;
+            new (d.mStorage) T*(obj);
+            d.mInvoke = [](const void *storage, const E& ev) {
+                T *o = *(T* const*) storage;
+                (o->*Method)(ev);
+            };
+            return d;
+        }
+
+        // wraps a lambda (or any functor); its captures must fit in DELEGATE_STORAGE_SIZE
+        template <typename F>
+        static Delegate From(F fn) {
+            static_assert(sizeof(F) <= DELEGATE_STORAGE_SIZE, "functor too big for a Delegate");
+            static_assert(std::is_trivially_copyable<F>::value &&
+                          std::is_trivially_destructible<F>::value,
+                          "Delegate functors must be trivially copyable");
+            Delegate d;
+            new (d.mStorage) F(fn);
+            d.mInvoke = [](const void *storage, const E& ev) {
+                (*(const F*) storage)(ev);
+            };
+            return d;
+        }
+
+        void operator()(const E& ev) const { mInvoke(mStorage, ev); }
+        explicit operator bool() const { return mInvoke != nullptr; }
+
+    private:
+        alignas(void*) unsigned char mStorage[DELEGATE_STORAGE_SIZE];
+        void (*mInvoke)(const void *storage, const E& ev);
+};
+
+// Typed event bus. The set of event types is fixed at compile time; each type gets its own
+// contiguous subscriber list and its own deferred queue, both fixed-size, so neither
+// subscribing nor publishing ever allocates.
+//
+// Publish() dispatches immediately. Post() only queues the event; queued events are
+// dispatched by Drain<E>() (or Drain(), for all types), at points of the frame the engine
+// chooses. Events of the same type are always delivered in the order they were posted.
+//
+// Not thread-safe: everything happens on the game thread.
+template <size_t MaxSubscribers, size_t QueueSize, typename... Events>
+class EventBus {
+    public:
+        // returns false if there's no room for another subscriber
+        template <typename E>
+        bool Subscribe(Delegate<E> d) {
+            Channel<E>& ch = GetChannel<E>();
+            if (ch.count == MaxSubscribers) {
+                return false;
+            }
+            ch.subs[ch.count++] = d;
+            return true;
+        }
+
+        template <typename E>
+        void Publish(const E& ev) {
+            Channel<E>& ch = GetChannel<E>();
+            for (size_t i = 0; i < ch.count; i++) {
+                ch.subs[i](ev);
+            }
+        }
+
+        template <typename E>
+        bool IsFull() { return GetChannel<E>().queued == QueueSize; }
+
+        // returns false (and drops the event) if that type's queue is full
+        template <typename E>
+        bool Post(const E& ev) {
+            Channel<E>& ch = GetChannel<E>();
+            if (ch.queued == QueueSize) {
+                ch.dropped++;
+                return false;
+            }
+            ch.queue[ch.queued++] = ev;
+            return true;
+        }
+
+        // dispatches the queued events of type E. Events posted by subscribers while draining
+        // are dispatched too.
+        template <typename E>
+        void Drain() {
+            Channel<E>& ch = GetChannel<E>();
+            for (size_t i = 0; i < ch.queued; i++) {
+                Publish(ch.queue[i]);
+            }
+            ch.queued = 0;
+        }
+
+        // drains every type, in the order they were declared
+        void Drain() {
+            (Drain<Events>(), ...);
+        }
+
+        template <typename E>
+        uint32_t GetDropped() { return GetChannel<E>().dropped; }
+
+    private:
+        template <typename E>
+        struct Channel {
+            Delegate<E> subs[MaxSubscribers];
+            size_t count = 0;
+            E queue[QueueSize];
+            size_t queued = 0;
+            uint32_t dropped = 0;
+        };
+
+        // index of E in Events... (compile error if E isn't one of them)
+        template <typename E, typename First, typename... Rest>
+        static constexpr size_t IndexOf() {
+            if constexpr (std::is_same<E, First>::value) {
+                return 0;
+            } else {
+                static_assert(sizeof...(Rest) > 0, "event type not registered with this bus");
+                return 1 + IndexOf<E, Rest...>();
+            }
+        }
+
+        template <typename E>
+        Channel<E>& GetChannel() {
+            return std::get<IndexOf<E, Events...>()>(mChannels);
+        }
+
+        std::tuple<Channel<Events>...> mChannels;
+};
+
+#endif
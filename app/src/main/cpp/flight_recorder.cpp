@@ -0,0 +1,247 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "flight_recorder.hpp"
+#include "timing.hpp"
+
+#define FLIGHT_RECORDER_FILE_SIZE \
+    (sizeof(FlightRecorderHeader) + FLIGHT_RECORDER_RECORDS * sizeof(FlightRecord))
+
+FlightRecorder *FlightRecorder::GetInstance() {
+    static FlightRecorder instance;
+    return &instance;
+}
+
+FlightRecorder::FlightRecorder() {
+    mHeader = nullptr;
+    mRing = nullptr;
+}
+
+bool FlightRecorder::Open(const char *path) {
+    if (mHeader) {
+        return true;
+    }
+
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        return false;
+    }
+    if (0 != ftruncate(fd, FLIGHT_RECORDER_FILE_SIZE)) {
+        close(fd);
+        return false;
+    }
+    void *p = mmap(nullptr, FLIGHT_RECORDER_FILE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        return false;
+    }
+
+    // the file was just truncated, so it's all zeroes
+    FlightRecorderHeader *h = (FlightRecorderHeader*) p;
+    h->version = FLIGHT_RECORDER_VERSION;
+    h->record_size = sizeof(FlightRecord);
+    h->capacity = FLIGHT_RECORDER_RECORDS;
+    h->pid = (uint32_t) getpid();
+    h->start_ns = TimeNowNs();
+    h->start_time = (uint64_t) time(nullptr);
+    h->magic = FLIGHT_RECORDER_MAGIC;
+    mRing = (FlightRecord*) (h + 1);
+    mHeader = h;
+    return true;
+}
+
+void FlightRecorder::Close() {
+    if (mHeader) {
+        // other threads may still record; leave it mapped
+        mHeader->clean = 1;
+        msync(mHeader, FLIGHT_RECORDER_FILE_SIZE, MS_ASYNC);
+    }
+}
+
+void FlightRecorder::SetCleanExit(bool clean) {
+    if (mHeader) {
+        mHeader->clean = clean ? 1 : 0;
+    }
+}
+
+FlightRecord *FlightRecorder::Claim(FlightRecordKind kind, uint16_t arg, int64_t ts_ns,
+                                    uint32_t *seq) {
+    uint64_t n = mHeader->head.fetch_add(1, std::memory_order_relaxed);
+    FlightRecord *r = &mRing[n % FLIGHT_RECORDER_RECORDS];
+    r->seq = 0;
+    // keep the compiler from moving the other stores above the one clearing seq
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    r->kind = (uint16_t) kind;
+    r->arg = arg;
+    r->ts_ns = ts_ns;
+    *seq = (uint32_t) (n + 1);
+    return r;
+}
+
+// A crash or kill stops the thread at a precise point, after which all of its earlier stores
+// reach the page cache: only the compiler could reorder them, hence a signal fence.
+void FlightRecorder::Publish(FlightRecord *r, uint32_t seq) {
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    r->seq = seq;
+}
+
+void FlightRecorder::RecordFrame(int64_t ts_ns, const FlightFrame& frame) {
+    if (!mHeader) {
+        return;
+    }
+    uint32_t seq;
+    FlightRecord *r = Claim(FlightRecordKind::Frame, 0, ts_ns, &seq);
+    r->frame = frame;
+    Publish(r, seq);
+}
+
+void FlightRecorder::RecordCommand(int32_t cmd) {
+    if (!mHeader) {
+        return;
+    }
+    uint32_t seq;
+    FlightRecord *r = Claim(FlightRecordKind::Command, (uint16_t) cmd, TimeNowNs(), &seq);
+    memset(r->text, 0, sizeof(r->text));
+    Publish(r, seq);
+}
+
+void FlightRecorder::RecordGlError(uint32_t error) {
+    if (!mHeader) {
+        return;
+    }
+    uint32_t seq;
+    FlightRecord *r = Claim(FlightRecordKind::GlError, (uint16_t) error, TimeNowNs(), &seq);
+    memset(r->text, 0, sizeof(r->text));
+    Publish(r, seq);
+}
+
+void FlightRecorder::RecordAbort(const char *file, int line) {
+    if (!mHeader) {
+        return;
+    }
+    // just the file's name; it may fill the field, without a terminator
+    const char *slash = strrchr(file, '/');
+    uint32_t seq;
+    FlightRecord *r = Claim(FlightRecordKind::Abort, (uint16_t) line, TimeNowNs(), &seq);
+    strncpy(r->text, slash ? slash + 1 : file, sizeof(r->text));
+    // a crash, even after SetCleanExit(true) (the app stopped, say)
+    mHeader->clean = 0;
+    Publish(r, seq);
+}
+
+static bool ReadFile(const char *path, std::vector<uint8_t> *out) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    bool ok = fstat(fd, &st) == 0 && (size_t) st.st_size >= sizeof(FlightRecorderHeader);
+    if (ok) {
+        out->resize(st.st_size);
+        ok = read(fd, out->data(), out->size()) == (ssize_t) out->size();
+    }
+    close(fd);
+    return ok;
+}
+
+static const FlightRecorderHeader *ValidHeader(const std::vector<uint8_t>& data) {
+    const FlightRecorderHeader *h = (const FlightRecorderHeader*) data.data();
+    if (h->magic != FLIGHT_RECORDER_MAGIC || h->version != FLIGHT_RECORDER_VERSION ||
+            h->record_size != sizeof(FlightRecord) || h->capacity == 0 ||
+            data.size() < sizeof(*h) + (size_t) h->capacity * sizeof(FlightRecord)) {
+        return nullptr;
+    }
+    return h;
+}
+
+bool FlightRecorder::WasInterrupted(const char *path) {
+    std::vector<uint8_t> data;
+    if (!ReadFile(path, &data)) {
+        return false;
+    }
+    const FlightRecorderHeader *h = ValidHeader(data);
+    return h && !h->clean;
+}
+
+int FlightRecorder::DecodeToJson(const char *path, const char *json_path) {
+    std::vector<uint8_t> data;
+    if (!ReadFile(path, &data)) {
+        return -1;
+    }
+    const FlightRecorderHeader *h = ValidHeader(data);
+    if (!h) {
+        return -1;
+    }
+    FILE *f = fopen(json_path, "w");
+    if (!f) {
+        return -1;
+    }
+
+    // timestamps in the Chrome format are in microseconds, like Trace's
+    const FlightRecord *ring = (const FlightRecord*) (h + 1);
+    const int pid = (int) h->pid;
+    fprintf(f, "{\"traceEvents\":[\n");
+    fprintf(f, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":"
+            "\"flight recorder, pid %d, started at %llu%s\"}}", pid, pid,
+            (unsigned long long) h->start_time, h->clean ? "" : ", interrupted");
+
+    uint64_t head = h->head.load(std::memory_order_relaxed);
+    uint64_t first = head > h->capacity ? head - h->capacity : 0;
+    int decoded = 0;
+    for (uint64_t n = first; n < head; n++) {
+        const FlightRecord& r = ring[n % h->capacity];
+        if (r.seq != (uint32_t) (n + 1)) {
+            // being written when the process died (or overwritten since)
+            continue;
+        }
+        double ts = r.ts_ns / 1000.0;
+        switch ((FlightRecordKind) r.kind) {
+            case FlightRecordKind::Frame:
+                fprintf(f, ",\n{\"name\":\"frame\",\"ph\":\"X\",\"pid\":%d,\"tid\":1,\"ts\":%.3f,"
+                        "\"dur\":%u,\"args\":{\"frame\":%u,\"draw_calls\":%u,"
+                        "\"input_events\":%u}}", pid, ts, r.frame.cpu_us, r.frame.number,
+                        r.frame.draw_calls, r.frame.input_events);
+                if (r.frame.swap_us) {
+                    fprintf(f, ",\n{\"name\":\"swap\",\"ph\":\"X\",\"pid\":%d,\"tid\":1,"
+                            "\"ts\":%.3f,\"dur\":%u}", pid, ts + r.frame.cpu_us,
+                            r.frame.swap_us);
+                }
+                break;
+            case FlightRecordKind::Command:
+                fprintf(f, ",\n{\"name\":\"command\",\"ph\":\"i\",\"s\":\"p\",\"pid\":%d,"
+                        "\"tid\":1,\"ts\":%.3f,\"args\":{\"cmd\":%u}}", pid, ts, r.arg);
+                break;
+            case FlightRecordKind::GlError:
+                fprintf(f, ",\n{\"name\":\"gl_error\",\"ph\":\"i\",\"s\":\"t\",\"pid\":%d,"
+                        "\"tid\":1,\"ts\":%.3f,\"args\":{\"error\":\"0x%04x\"}}", pid, ts, r.arg);
+                break;
+            case FlightRecordKind::Abort: {
+                char file[sizeof(r.text) + 1];
+                for (size_t i = 0; i <= sizeof(r.text); i++) {
+                    char c = i < sizeof(r.text) ? r.text[i] : 0;
+                    // it goes in a JSON string
+                    file[i] = c == '"' || c == '\\' || (c && (c < ' ' || c > '~')) ? '?' : c;
+                }
+                fprintf(f, ",\n{\"name\":\"abort\",\"ph\":\"i\",\"s\":\"g\",\"pid\":%d,"
+                        "\"tid\":1,\"ts\":%.3f,\"args\":{\"file\":\"%s\",\"line\":%u}}", pid, ts,
+                        file, r.arg);
+                break;
+            }
+            default:
+                continue;
+        }
+        decoded++;
+    }
+    fprintf(f, "\n]}\n");
+
+    bool ok = ferror(f) == 0;
+    fclose(f);
+    return ok ? decoded : -1;
+}
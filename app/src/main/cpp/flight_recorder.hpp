@@ -0,0 +1,104 @@
+#ifndef endlesstunnel_flight_recorder_hpp
+#define endlesstunnel_flight_recorder_hpp
+
+#include <stdint.h>
+#include <atomic>
+
+#define FLIGHT_RECORDER_MAGIC 0x524c4654  // "TFLR"
+#define FLIGHT_RECORDER_VERSION 1
+
+// records in the ring: a bit over a minute of frames at 60 Hz, plus the odd event
+#define FLIGHT_RECORDER_RECORDS 4096
+
+enum class FlightRecordKind : uint16_t {
+    Frame = 1,
+    Command = 2,  // lifecycle command (arg: APP_CMD_*)
+    GlError = 3,  // arg: the GL error code
+    Abort = 4,    // ABORT_GAME (arg: line; text: file)
+};
+
+struct FlightFrame {
+    uint32_t number;
+    uint32_t cpu_us;        // DoFrame() start to swap
+    uint32_t swap_us;       // time blocked in eglSwapBuffers() (0 if nothing was drawn)
+    uint16_t draw_calls;
+    uint16_t input_events;
+};
+
+// One entry of the ring. seq is written last (and is 0 while the rest is being written), so a
+// record cut short by a crash is recognizably incomplete.
+struct FlightRecord {
+    uint32_t seq;           // position in the recording's history, plus 1
+    uint16_t kind;          // FlightRecordKind
+    uint16_t arg;
+    int64_t ts_ns;          // CLOCK_MONOTONIC
+    union {
+        FlightFrame frame;
+        char text[16];
+    };
+};
+
+// Layout of the recorder file: this header, then the ring of records.
+struct FlightRecorderHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t capacity;
+    uint32_t pid;
+    uint32_t clean;         // the process may end without it being a crash (see SetCleanExit)
+    uint64_t start_ns;      // CLOCK_MONOTONIC
+    uint64_t start_time;    // seconds since the epoch
+    std::atomic<uint64_t> head;  // records written so far
+    uint8_t reserved[16];
+};
+
+static_assert(sizeof(FlightRecord) == 32, "FlightRecord layout changed; bump the version");
+static_assert(sizeof(FlightRecorderHeader) == 64, "header must be one cache line");
+
+// Flight recorder: the last FLIGHT_RECORDER_RECORDS frames and events (lifecycle commands, GL
+// errors, aborts) in a ring, in a memory-mapped file. Recording is a handful of plain stores
+// into the mapping, with no system calls, and since the pages belong to the file rather than
+// to the process, they survive it being killed or crashing. On the next launch, the engine
+// finds the file wasn't closed cleanly and decodes it into a trace (DecodeToJson()).
+//
+// Any thread may record: slots are claimed with an atomic increment of the header's head.
+class FlightRecorder {
+    public:
+        static FlightRecorder *GetInstance();
+
+        // Whether the recording at path ended without Close() or SetCleanExit(true), i.e. the
+        // process crashed or was killed while running.
+        static bool WasInterrupted(const char *path);
+
+        // Writes the recording at path as a trace in the Chrome trace event format. Returns
+        // the number of records decoded, or -1 if the file can't be read or written.
+        static int DecodeToJson(const char *path, const char *json_path);
+
+        // creates (or truncates) the recorder file and maps it
+        bool Open(const char *path);
+
+        // marks the recording as ended cleanly
+        void Close();
+
+        // While set, the process ending isn't a crash: the system kills stopped apps at will.
+        // RecordAbort() clears it.
+        void SetCleanExit(bool clean);
+
+        // These do nothing until Open() succeeds.
+        void RecordFrame(int64_t ts_ns, const FlightFrame& frame);
+        void RecordCommand(int32_t cmd);
+        void RecordGlError(uint32_t error);
+        void RecordAbort(const char *file, int line);
+
+    private:
+        FlightRecorder();
+
+        FlightRecorderHeader *mHeader;
+        FlightRecord *mRing;
+
+        // returns the claimed record, with seq cleared; Publish() makes it valid
+        FlightRecord *Claim(FlightRecordKind kind, uint16_t arg, int64_t ts_ns, uint32_t *seq);
+        static void Publish(FlightRecord *r, uint32_t seq);
+};
+
+#endif
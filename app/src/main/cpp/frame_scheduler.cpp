@@ -0,0 +1,155 @@
+#include "frame_scheduler.hpp"
+#include "log.hpp"
+#include "timing.hpp"
+
+#ifdef __ANDROID__
+#include <android/choreographer.h>
+#else
+#include <errno.h>
+#include <poll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#endif
+
+// nominal vsync period, used until we have measured the real one (and as the fake vsync rate)
+#define NOMINAL_VSYNC_PERIOD_NS 16666667ll
+
+FrameScheduler::FrameScheduler() {
+    mCallback = NULL;
+    mCallbackData = NULL;
+    mPending = false;
+    mLastFrameNs = 0;
+    mPeriodNs = NOMINAL_VSYNC_PERIOD_NS;
+#ifdef __ANDROID__
+    mChoreographer = NULL;
+#else
+    mTimerFd = -1;
+    mTimerStartNs = 0;
+    mTicks = 0;
+    mRequestNs = 0;
+#endif
+}
+
+FrameScheduler::~FrameScheduler() {
+    Stop();
+}
+
+void FrameScheduler::Dispatch(int64_t frame_time_ns) {
+    if (mLastFrameNs) {
+        int64_t delta = frame_time_ns - mLastFrameNs;
+        // ignore gaps where we skipped vsyncs (or weren't animating at all)
+        if (delta > 0 && delta < 2 * NOMINAL_VSYNC_PERIOD_NS) {
+            // low-pass filter, so one late callback doesn't throw the estimate off
+            mPeriodNs += (delta - mPeriodNs) / 8;
+        }
+    }
+    mLastFrameNs = frame_time_ns;
+    mPending = false;
+    if (mCallback) {
+        mCallback(frame_time_ns, mCallbackData);
+    }
+}
+
+#ifdef __ANDROID__
+
+bool FrameScheduler::Start(FrameCallback cb, void *data) {
+    mCallback = cb;
+    mCallbackData = data;
+    mChoreographer = AChoreographer_getInstance();
+    if (!mChoreographer) {
+        LOGE("FrameScheduler: no choreographer (thread has no looper?)");
+        return false;
+    }
+    LOGD("FrameScheduler: using AChoreographer.");
+    return true;
+}
+
+void FrameScheduler::Stop() {
+    // there's no way to cancel a posted choreographer callback, so we just forget about it
+    mCallback = NULL;
+    mChoreographer = NULL;
+}
+
+void FrameScheduler::OnChoreographerFrame(int64_t frame_time_ns, void *data) {
+    FrameScheduler *self = (FrameScheduler*) data;
+    self->Dispatch(frame_time_ns);
+}
+
+void FrameScheduler::RequestFrame() {
+    if (mPending || !mChoreographer) {
+        return;
+    }
+    mPending = true;
+    AChoreographer_postFrameCallback64(mChoreographer, OnChoreographerFrame, this);
+}
+
+#else
+
+bool FrameScheduler::Start(FrameCallback cb, void *data) {
+    mCallback = cb;
+    mCallbackData = data;
+
+    mTimerFd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (mTimerFd < 0) {
+        LOGE("FrameScheduler: timerfd_create failed, errno %d", errno);
+        return false;
+    }
+
+    struct itimerspec spec;
+    spec.it_interval.tv_sec = 0;
+    spec.it_interval.tv_nsec = NOMINAL_VSYNC_PERIOD_NS;
+    spec.it_value = spec.it_interval;
+    mTimerStartNs = (int64_t) TimeNowNs();
+    mTicks = 0;
+    if (timerfd_settime(mTimerFd, 0, &spec, NULL) < 0) {
+        LOGE("FrameScheduler: timerfd_settime failed, errno %d", errno);
+        Stop();
+        return false;
+    }
+
+    LOGD("FrameScheduler: using fake vsync (timerfd, %lld ns).", NOMINAL_VSYNC_PERIOD_NS);
+    return true;
+}
+
+void FrameScheduler::Stop() {
+    mCallback = NULL;
+    if (mTimerFd >= 0) {
+        close(mTimerFd);
+        mTimerFd = -1;
+    }
+}
+
+void FrameScheduler::RequestFrame() {
+    if (!mPending) {
+        mPending = true;
+        mRequestNs = (int64_t) TimeNowNs();
+    }
+}
+
+bool FrameScheduler::WaitAndDispatch(int timeout_ms) {
+    if (mTimerFd < 0) {
+        return false;
+    }
+
+    struct pollfd pfd = { mTimerFd, POLLIN, 0 };
+    if (poll(&pfd, 1, timeout_ms) <= 0) {
+        return false;
+    }
+
+    uint64_t expirations = 0;
+    if (read(mTimerFd, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+        return false;
+    }
+
+    // like a real vsync, the frame time is when the tick was due, not when we woke up. And
+    // like the choreographer's, the callback is for the first vsync after the request: a tick
+    // that went by while the last frame was still running is too late to start this one.
+    mTicks += expirations;
+    int64_t frame_time_ns = mTimerStartNs + (int64_t) mTicks * NOMINAL_VSYNC_PERIOD_NS;
+    if (mPending && frame_time_ns >= mRequestNs) {
+        Dispatch(frame_time_ns);
+    }
+    return true;
+}
+
+#endif
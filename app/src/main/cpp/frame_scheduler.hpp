@@ -0,0 +1,56 @@
+#ifndef endlesstunnel_frame_scheduler_hpp
+#define endlesstunnel_frame_scheduler_hpp
+
+#include <stdint.h>
+
+// Starts frames from display vsync. On Android, this uses AChoreographer, whose callbacks are
+// dispatched by the thread's ALooper (so the game loop just needs to poll the looper). On
+// other platforms, a timerfd ticking at a fixed rate stands in for vsync, and the loop calls
+// WaitAndDispatch() instead.
+class FrameScheduler {
+    public:
+        // frame_time_ns is the vsync timestamp, in the CLOCK_MONOTONIC time base
+        typedef void (*FrameCallback)(int64_t frame_time_ns, void *data);
+
+        FrameScheduler();
+        ~FrameScheduler();
+
+        // must be called on the thread that will run the frames (it needs a looper on Android)
+        bool Start(FrameCallback cb, void *data);
+        void Stop();
+
+        // asks for one callback on the next vsync. Does nothing if one is already pending.
+        void RequestFrame();
+
+        bool IsFramePending() const { return mPending; }
+
+        // vsync period, as measured between consecutive callbacks (nominal 60Hz until known)
+        int64_t GetVsyncPeriodNs() const { return mPeriodNs; }
+
+#ifndef __ANDROID__
+        // blocks until the next fake vsync (or timeout), then runs the callback if a frame
+        // was requested. Returns false on timeout or error.
+        bool WaitAndDispatch(int timeout_ms);
+#endif
+
+    private:
+        FrameCallback mCallback;
+        void *mCallbackData;
+        bool mPending;
+        int64_t mLastFrameNs;
+        int64_t mPeriodNs;
+
+#ifdef __ANDROID__
+        struct AChoreographer *mChoreographer;
+        static void OnChoreographerFrame(int64_t frame_time_ns, void *data);
+#else
+        int mTimerFd;
+        int64_t mTimerStartNs;
+        uint64_t mTicks;
+        int64_t mRequestNs;  // when the pending frame was requested
+#endif
+
+        void Dispatch(int64_t frame_time_ns);
+};
+
+#endif
@@ -0,0 +1,60 @@
+#include "frame_stats.hpp"
+#include "log.hpp"
+#include "trace.hpp"
+
+void FrameStats::Accum::Add(double v) {
+    sum += v;
+    if (v > max) {
+        max = v;
+    }
+    count++;
+}
+
+FrameStats::FrameStats() {
+    mLastInputLatencyNs = 0;
+    Reset();
+}
+
+void FrameStats::Reset() {
+    mFrames = mEstimated = 0;
+    mCpu = mSwap = mPresent = mInput = { 0.0, 0.0, 0 };
+}
+
+void FrameStats::Add(const FrameTiming& t) {
+    Trace *trace = Trace::GetInstance();
+
+    if (t.swap_start_ns && t.cpu_start_ns) {
+        mCpu.Add(NsToMs(t.swap_start_ns - t.cpu_start_ns));
+    }
+    if (t.swap_end_ns && t.swap_start_ns) {
+        mSwap.Add(NsToMs(t.swap_end_ns - t.swap_start_ns));
+    }
+    if (t.actual_present_ns > 0 && t.vsync_ns) {
+        double ms = NsToMs(t.actual_present_ns - t.vsync_ns);
+        mPresent.Add(ms);
+        trace->Counter("present_latency_ms", t.actual_present_ns, ms);
+    }
+    if (t.actual_present_ns > 0 && t.input_ns) {
+        mLastInputLatencyNs = t.actual_present_ns - t.input_ns;
+        double ms = NsToMs(mLastInputLatencyNs);
+        mInput.Add(ms);
+        trace->Counter("input_to_display_ms", t.actual_present_ns, ms);
+    }
+    if (t.estimated) {
+        mEstimated++;
+    }
+
+    if (++mFrames >= FRAME_STATS_WINDOW) {
+        Report();
+        Reset();
+    }
+}
+
+void FrameStats::Report() {
+    #define AVG(a) ((a).count ? (a).sum / (a).count : 0.0)
+    LOGD("FrameStats: %u frames: cpu %.2f/%.2f ms, swap %.2f/%.2f ms, "
+         "vsync-to-present %.2f/%.2f ms, input-to-display %.2f/%.2f ms (%u samples)%s",
+         mFrames, AVG(mCpu), mCpu.max, AVG(mSwap), mSwap.max, AVG(mPresent), mPresent.max,
+         AVG(mInput), mInput.max, mInput.count, mEstimated ? " [present times estimated]" : "");
+    #undef AVG
+}
@@ -0,0 +1,53 @@
+#ifndef endlesstunnel_frame_stats_hpp
+#define endlesstunnel_frame_stats_hpp
+
+#include <stdint.h>
+
+// Everything we know about one frame. Times are in nanoseconds, CLOCK_MONOTONIC time base;
+// 0 means "unknown".
+struct FrameTiming {
+    uint64_t frame;               // our frame counter
+    int64_t vsync_ns;             // vsync that started the frame
+    int64_t input_ns;             // oldest input event consumed by the frame
+    int64_t cpu_start_ns;         // DoFrame() start
+    int64_t swap_start_ns;        // eglSwapBuffers() call
+    int64_t swap_end_ns;          // eglSwapBuffers() return
+    int64_t requested_present_ns; // when we asked for the frame to be presented
+    int64_t actual_present_ns;    // when it actually hit the display
+    int64_t gpu_composition_done_ns; // when the compositor's GPU work for it finished
+    bool estimated;               // present times are estimated, not reported by the system
+};
+
+// how many frames we aggregate before reporting
+#define FRAME_STATS_WINDOW 120
+
+// Collects completed frames, sends per-frame counters to the trace and logs a summary
+// (averages and maximums) every FRAME_STATS_WINDOW frames.
+class FrameStats {
+    public:
+        FrameStats();
+
+        // adds a frame whose present timestamps are known (or given up on)
+        void Add(const FrameTiming& t);
+
+        // input-to-display latency of the last frame that had input, in ns (0 if unknown)
+        int64_t GetLastInputLatencyNs() const { return mLastInputLatencyNs; }
+
+    private:
+        struct Accum {
+            double sum;
+            double max;
+            uint32_t count;
+            void Add(double v);
+        };
+
+        uint32_t mFrames;
+        uint32_t mEstimated;
+        Accum mCpu, mSwap, mPresent, mInput;
+        int64_t mLastInputLatencyNs;
+
+        void Report();
+        void Reset();
+};
+
+#endif
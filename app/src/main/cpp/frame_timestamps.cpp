@@ -0,0 +1,146 @@
+#include <cstring>
+
+#include "frame_timestamps.hpp"
+#include "log.hpp"
+
+#include <EGL/eglext.h>
+
+EglFrameTimestamps::EglFrameTimestamps() {
+    mDisplay = EGL_NO_DISPLAY;
+    mSurface = EGL_NO_SURFACE;
+    mNextId = 0;
+    mNextIdValid = false;
+    memset(mPending, 0, sizeof(mPending));
+    mNext = 0;
+    mNameCount = 0;
+    mGetNextFrameId = mGetFrameTimestamps = NULL;
+}
+
+bool EglFrameTimestamps::Init(EGLDisplay display, EGLSurface surface) {
+    mDisplay = display;
+    mSurface = surface;
+    memset(mPending, 0, sizeof(mPending));
+
+    const char *exts = eglQueryString(display, EGL_EXTENSIONS);
+    if (!exts || !strstr(exts, "EGL_ANDROID_get_frame_timestamps")) {
+        LOGD("EglFrameTimestamps: extension not supported.");
+        return false;
+    }
+
+    mGetNextFrameId = (void*) eglGetProcAddress("eglGetNextFrameIdANDROID");
+    mGetFrameTimestamps = (void*) eglGetProcAddress("eglGetFrameTimestampsANDROID");
+    PFNEGLGETFRAMETIMESTAMPSUPPORTEDANDROIDPROC is_supported =
+            (PFNEGLGETFRAMETIMESTAMPSUPPORTEDANDROIDPROC)
+            eglGetProcAddress("eglGetFrameTimestampSupportedANDROID");
+    if (!mGetNextFrameId || !mGetFrameTimestamps || !is_supported) {
+        LOGW("EglFrameTimestamps: extension advertised but entry points missing.");
+        return false;
+    }
+
+    // asking for a timestamp the surface doesn't support fails the whole query
+    static const struct {
+        EGLint name;
+        int64_t FrameTiming::*field;
+    } timestamps[FRAME_TIMESTAMP_NAMES] = {
+        { EGL_REQUESTED_PRESENT_TIME_ANDROID, &FrameTiming::requested_present_ns },
+        { EGL_DISPLAY_PRESENT_TIME_ANDROID, &FrameTiming::actual_present_ns },
+        { EGL_FIRST_COMPOSITION_GPU_FINISHED_TIME_ANDROID, &FrameTiming::gpu_composition_done_ns },
+    };
+    mNameCount = 0;
+    bool has_present = false;
+    for (const auto& ts : timestamps) {
+        if (is_supported(display, surface, ts.name)) {
+            mNames[mNameCount] = ts.name;
+            mFields[mNameCount] = ts.field;
+            mNameCount++;
+            has_present |= ts.name == EGL_DISPLAY_PRESENT_TIME_ANDROID;
+        }
+    }
+    if (!has_present) {
+        LOGD("EglFrameTimestamps: no display present time on this surface.");
+        return false;
+    }
+
+    if (EGL_FALSE == eglSurfaceAttrib(display, surface, EGL_TIMESTAMPS_ANDROID, EGL_TRUE)) {
+        LOGW("EglFrameTimestamps: can't enable timestamps, EGL error %d", eglGetError());
+        return false;
+    }
+
+    LOGD("EglFrameTimestamps: enabled (%d of %d timestamps).", mNameCount,
+         FRAME_TIMESTAMP_NAMES);
+    return true;
+}
+
+void EglFrameTimestamps::BeforeSwap() {
+    EGLuint64KHR id;
+    mNextIdValid = ((PFNEGLGETNEXTFRAMEIDANDROIDPROC) mGetNextFrameId)(mDisplay, mSurface, &id);
+    mNextId = id;
+}
+
+void EglFrameTimestamps::AfterSwap(const FrameTiming& t) {
+    // if the slot is still in use, its frame never got timestamps: drop it
+    Pending *p = &mPending[mNext];
+    mNext = (mNext + 1) % FRAME_TIMESTAMPS_PENDING;
+
+    p->used = true;
+    p->id_valid = mNextIdValid;
+    p->egl_id = mNextId;
+    p->timing = t;
+}
+
+void EglFrameTimestamps::Collect(FrameStats *stats) {
+    EGLnsecsANDROID values[FRAME_TIMESTAMP_NAMES];
+
+    // oldest first
+    for (unsigned i = 0; i < FRAME_TIMESTAMPS_PENDING; i++) {
+        Pending *p = &mPending[(mNext + i) % FRAME_TIMESTAMPS_PENDING];
+        if (!p->used) {
+            continue;
+        }
+
+        if (p->id_valid && ((PFNEGLGETFRAMETIMESTAMPSANDROIDPROC) mGetFrameTimestamps)(
+                mDisplay, mSurface, p->egl_id, mNameCount, mNames, values)) {
+            bool pending = false;
+            for (int n = 0; n < mNameCount; n++) {
+                pending |= values[n] == EGL_TIMESTAMP_PENDING_ANDROID;
+            }
+            if (pending) {
+                // not there yet; newer frames won't be either
+                break;
+            }
+            for (int n = 0; n < mNameCount; n++) {
+                p->timing.*mFields[n] = values[n] > 0 ? values[n] : 0;
+            }
+        }
+        // else: the frame is too old (or had no id); report what we have
+
+        stats->Add(p->timing);
+        p->used = false;
+    }
+}
+
+void SimulatedFrameTimestamps::AfterSwap(const FrameTiming& t) {
+    if (mCount == FRAME_TIMESTAMPS_PENDING) {
+        return;
+    }
+
+    FrameTiming *f = &mPending[mCount++];
+    *f = t;
+    f->estimated = true;
+
+    // first vsync after the swap is when the compositor latches the buffer...
+    int64_t base = t.vsync_ns ? t.vsync_ns : t.swap_end_ns;
+    int64_t periods = (t.swap_end_ns - base) / mVsyncPeriodNs + 1;
+    f->requested_present_ns = base + periods * mVsyncPeriodNs;
+
+    // ...and it's scanned out one vsync later
+    f->actual_present_ns = f->requested_present_ns + mVsyncPeriodNs;
+    f->gpu_composition_done_ns = 0;
+}
+
+void SimulatedFrameTimestamps::Collect(FrameStats *stats) {
+    for (unsigned i = 0; i < mCount; i++) {
+        stats->Add(mPending[i]);
+    }
+    mCount = 0;
+}
@@ -0,0 +1,89 @@
+#ifndef endlesstunnel_frame_timestamps_hpp
+#define endlesstunnel_frame_timestamps_hpp
+
+#include <EGL/egl.h>
+
+#include "frame_stats.hpp"
+
+// how many swapped frames we keep around waiting for their present timestamps
+#define FRAME_TIMESTAMPS_PENDING 8
+
+// timestamps we ask EGL_ANDROID_get_frame_timestamps for (those the surface supports)
+#define FRAME_TIMESTAMP_NAMES 3
+
+// Finds out when swapped frames actually reached the display, and hands them to FrameStats.
+class FrameTimestampProvider {
+    public:
+        virtual ~FrameTimestampProvider() {}
+        virtual const char *GetName() const = 0;
+
+        // to be called right before / right after eglSwapBuffers()
+        virtual void BeforeSwap() = 0;
+        virtual void AfterSwap(const FrameTiming& t) = 0;
+
+        // passes the frames whose timestamps are now known to stats
+        virtual void Collect(FrameStats *stats) = 0;
+};
+
+// Uses EGL_ANDROID_get_frame_timestamps. The timestamps for a frame are typically known a
+// couple of frames after it was swapped.
+class EglFrameTimestamps : public FrameTimestampProvider {
+    public:
+        EglFrameTimestamps();
+
+        // checks for the extension and which timestamps the surface supports, and enables them.
+        // Must be called again whenever the surface is recreated. Returns false if not
+        // supported, or if there's no display present time (the one we can't do without).
+        bool Init(EGLDisplay display, EGLSurface surface);
+
+        const char *GetName() const override { return "EGL_ANDROID_get_frame_timestamps"; }
+        void BeforeSwap() override;
+        void AfterSwap(const FrameTiming& t) override;
+        void Collect(FrameStats *stats) override;
+
+    private:
+        struct Pending {
+            bool used;
+            bool id_valid;
+            uint64_t egl_id;
+            FrameTiming timing;
+        };
+
+        EGLDisplay mDisplay;
+        EGLSurface mSurface;
+        uint64_t mNextId;
+        bool mNextIdValid;
+        Pending mPending[FRAME_TIMESTAMPS_PENDING];
+        unsigned mNext;
+
+        // the supported timestamps, and the FrameTiming field each one goes to
+        EGLint mNames[FRAME_TIMESTAMP_NAMES];
+        int64_t FrameTiming::*mFields[FRAME_TIMESTAMP_NAMES];
+        int mNameCount;
+
+        // entry points, looked up with eglGetProcAddress
+        void *mGetNextFrameId;
+        void *mGetFrameTimestamps;
+};
+
+// Estimates present times from the vsync period, assuming the frame is latched on the vsync
+// following the swap and shown one vsync later. For platforms without the EGL extension
+// (including Linux, where it's the only option).
+class SimulatedFrameTimestamps : public FrameTimestampProvider {
+    public:
+        SimulatedFrameTimestamps() : mVsyncPeriodNs(16666667), mCount(0) {}
+
+        void SetVsyncPeriod(int64_t period_ns) { mVsyncPeriodNs = period_ns; }
+
+        const char *GetName() const override { return "simulated"; }
+        void BeforeSwap() override {}
+        void AfterSwap(const FrameTiming& t) override;
+        void Collect(FrameStats *stats) override;
+
+    private:
+        int64_t mVsyncPeriodNs;
+        FrameTiming mPending[FRAME_TIMESTAMPS_PENDING];
+        unsigned mCount;
+};
+
+#endif
@@ -0,0 +1,106 @@
+#include <algorithm>
+#include <utility>
+
+#include "frame_work.hpp"
+#include "timing.hpp"
+
+FrameWorkQueue::FrameWorkQueue() {
+    mRunning = false;
+    mSeq = 0;
+    mLate = mOverruns = 0;
+}
+
+void FrameWorkQueue::Post(const char *name, WorkPriority priority, uint64_t deadline_ns,
+                          std::function<bool()> fn) {
+    Task t = { name, HashName(name), priority, mSeq++, deadline_ns, std::move(fn) };
+    if (mRunning) {
+        mPosted.push_back(std::move(t));
+    } else {
+        Insert(std::move(t));
+    }
+}
+
+void FrameWorkQueue::Insert(Task&& t) {
+    auto pos = std::upper_bound(mTasks.begin(), mTasks.end(), t, [](const Task& a,
+                                                                     const Task& b) {
+        return a.priority != b.priority ? a.priority < b.priority : a.seq < b.seq;
+    });
+    mTasks.insert(pos, std::move(t));
+}
+
+void FrameWorkQueue::Clear() {
+    mTasks.clear();
+    mPosted.clear();
+}
+
+uint64_t FrameWorkQueue::GetEstimateNs(const char *name) const {
+    const uint64_t *e = mEstimates.Find(HashName(name));
+    return e ? *e : FRAME_WORK_DEFAULT_ESTIMATE_NS;
+}
+
+uint64_t FrameWorkQueue::Run(uint64_t budget_ns, uint64_t limit_ns) {
+    uint64_t start = TimeNowNs();
+    if (mTasks.empty()) {
+        return 0;
+    }
+
+    // everything up to the last overdue task runs, budget or not
+    int forced = -1;
+    for (int i = 0; i < (int) mTasks.size(); i++) {
+        if (mTasks[i].deadline_ns && mTasks[i].deadline_ns <= start) {
+            forced = i;
+        }
+    }
+
+    limit_ns = std::max(limit_ns, budget_ns);
+    mRunning = true;
+    uint64_t now = start;
+    for (int ran = 0; !mTasks.empty(); ran++) {
+        Task& t = mTasks.front();
+        uint64_t *estimate = mEstimates.Find(t.hash);
+        uint64_t cost = estimate ? *estimate : FRAME_WORK_DEFAULT_ESTIMATE_NS;
+        uint64_t end = now - start + cost;
+        if (forced < 0 && end > budget_ns && (ran > 0 || end > limit_ns)) {
+            // a task that doesn't fit any slice comes down on its estimate each time, so that
+            // one slow run (the thread got preempted, say) can't keep it out for good
+            if (ran == 0 && estimate && limit_ns > 0) {
+                *estimate /= 2;
+            }
+            break;
+        }
+
+        uint64_t task_start = now;
+        bool done = t.fn();
+        now = TimeNowNs();
+        if (estimate) {
+            *estimate = now - task_start;
+        } else {
+            mEstimates.Insert(t.hash, now - task_start);
+        }
+
+        if (!done) {
+            // overdue work only gets one step per frame; other work, as many as fit
+            if (forced >= 0) {
+                break;
+            }
+            continue;
+        }
+        if (t.deadline_ns && now > t.deadline_ns) {
+            mLate++;
+        }
+        mTasks.erase(mTasks.begin());
+        forced--;
+    }
+    mRunning = false;
+
+    for (Task& t : mPosted) {
+        Insert(std::move(t));
+    }
+    mPosted.clear();
+
+    uint64_t used = now - start;
+    if (used > budget_ns) {
+        mOverruns++;
+    }
+    return used;
+}
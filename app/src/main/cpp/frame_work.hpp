@@ -0,0 +1,79 @@
+#ifndef endlesstunnel_frame_work_hpp
+#define endlesstunnel_frame_work_hpp
+
+#include <stdint.h>
+#include <functional>
+#include <vector>
+
+#include "name_hash.hpp"
+
+// what a task is assumed to cost until it has run once
+#define FRAME_WORK_DEFAULT_ESTIMATE_NS 2000000ull
+
+enum class WorkPriority { High, Normal, Low };
+
+// Work that has to happen on the GL thread but not all at once (shader compiles, program links,
+// buffer uploads), run in slices of each frame's spare time so that it doesn't cause spikes.
+//
+// Tasks run in priority order, then in the order they were posted, so a task may rely on the
+// ones posted before it at the same or a higher priority. Run() stops at the first task that
+// doesn't fit in what's left of the budget, judging by what it cost the last time a task by
+// that name ran. A task too big for any budget may go over it, up to the limit (the point past
+// which the next frame would be late), but only as the first task of a slice; one that doesn't
+// fit even that has its estimate halved, and tries again next time. Deadlines guarantee
+// progress: once a task is overdue, it and every task ahead of it run regardless.
+//
+// A task returns true when it's done; false means it did part of its work (an upload chunk,
+// say) and wants to run again: in the same slice if what it just took fits in the rest of the
+// budget, else in the next one.
+class FrameWorkQueue {
+    public:
+        FrameWorkQueue();
+
+        // The name must be a string literal. deadline_ns is on the TimeNowNs() clock (0: none).
+        // May be called from a running task.
+        void Post(const char *name, WorkPriority priority, uint64_t deadline_ns,
+                  std::function<bool()> fn);
+
+        // Runs tasks for up to budget_ns (or limit_ns, see above). Returns the time it took.
+        uint64_t Run(uint64_t budget_ns, uint64_t limit_ns = 0);
+
+        // drops the pending tasks (e.g. the context they were for is gone). Not from a task.
+        void Clear();
+
+        bool IsEmpty() const { return mTasks.empty() && mPosted.empty(); }
+        int GetPendingCount() const { return (int) (mTasks.size() + mPosted.size()); }
+
+        // what a task by that name is expected to cost
+        uint64_t GetEstimateNs(const char *name) const;
+
+        // tasks that finished after their deadline, and Run() calls that went over budget
+        uint32_t GetLateCount() const { return mLate; }
+        uint32_t GetOverrunCount() const { return mOverruns; }
+
+    private:
+        struct Task {
+            const char *name;
+            uint32_t hash;
+            WorkPriority priority;
+            uint64_t seq;
+            uint64_t deadline_ns;
+            std::function<bool()> fn;
+        };
+
+        // by priority, then seq
+        std::vector<Task> mTasks;
+        // posted by a running task; merged in when Run() is done
+        std::vector<Task> mPosted;
+        bool mRunning;
+        uint64_t mSeq;
+
+        // measured cost of the last slice of each task, by name hash
+        NameTable<uint64_t> mEstimates;
+
+        uint32_t mLate, mOverruns;
+
+        void Insert(Task&& t);
+};
+
+#endif
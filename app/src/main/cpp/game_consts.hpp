@@ -151,9 +151,60 @@
 #define MENUITEM_PULSE_AMOUNT 1.1f
 #define MENUITEM_PULSE_PERIOD 0.5f
 
+// the menu's "more" button multiplies the triangle count by 4, up to this
+#define MENU_MAX_TRIANGLES 1024
+
+// designer-made obstacle patterns (compiled from app/src/main/obstacles/patterns.txt)
+#define OBSTACLE_PATTERNS_ASSET "obstacles.bin"
+
 // save file name
 #define SAVE_FILE_NAME "tunnel.dat"
 
+// run statistics (high scores etc) file name
+#define STATS_FILE_NAME "runs.dat"
+
+// live counters page, in the app's internal data directory (see tools/counters_view.cpp)
+#define COUNTERS_FILE_NAME "counters"
+
+// sampling profiler output (see tools/profile_symbolize.cpp). The profiler is enabled with
+// adb shell setprop debug.gametest.profile <samples per second>
+#define PROFILE_FILE_NAME "profile.txt"
+#define PROFILE_PROPERTY "debug.gametest.profile"
+
+// overdraw measurement mode (see overdraw.hpp), one JSON report per frame. Enabled with
+// adb shell setprop debug.gametest.overdraw 1
+#define OVERDRAW_FILE_NAME "overdraw.jsonl"
+#define OVERDRAW_PROPERTY "debug.gametest.overdraw"
+
+// trace events recorded after startup (counters and spans, see trace.hpp), streamed to a file
+// in the Chrome trace format. Enabled with adb shell setprop debug.gametest.trace 1
+#define TRACE_FILE_NAME "trace.json"
+#define TRACE_PROPERTY "debug.gametest.trace"
+
+// gameplay analytics logs: size of each file, and cap on all of them together
+#define ANALYTICS_FILE_SIZE (1024 * 1024)
+#define ANALYTICS_TOTAL_SIZE (8 * 1024 * 1024)
+
+// flight recorder (see flight_recorder.hpp). If the previous session crashed or was killed,
+// its recording is decoded to the trace file on the next launch.
+#define FLIGHT_RECORDER_FILE_NAME "flight"
+#define FLIGHT_TRACE_FILE_NAME "flight_trace.json"
+
+// GL errors recorded per frame, so that a broken frame doesn't push the others out of the ring
+#define FLIGHT_MAX_GL_ERRORS 4
+
+// GL-thread work (see frame_work.hpp): frames, work included, should take at most this share of
+// the vsync period. A task too big for that may use the rest of it, less the margin.
+#define GL_WORK_TARGET_FRACTION 0.75
+#define GL_WORK_MARGIN_MS 1.0
+
+// when the GL objects must be ready, from when they're (re)created: the scene, then the UI
+#define GL_WORK_SCENE_DEADLINE_MS 150
+#define GL_WORK_UI_DEADLINE_MS 400
+
+// CPU time the process may use while paused (lifecycle commands, mostly) before we complain
+#define SUSPENDED_CPU_BUDGET_MS 20.0
+
 // checkpoint (save progress) every how many levels?
 #define LEVELS_PER_CHECKPOINT 4
 
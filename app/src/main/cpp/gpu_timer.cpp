@@ -0,0 +1,109 @@
+#include <cstring>
+
+#include "common.hpp"
+#include "gpu_timer.hpp"
+
+#ifndef GL_TIME_ELAPSED_EXT
+#define GL_TIME_ELAPSED_EXT 0x88BF
+#endif
+#ifndef GL_GPU_DISJOINT_EXT
+#define GL_GPU_DISJOINT_EXT 0x8FBB
+#endif
+
+typedef void (GL_APIENTRYP GetQueryObjectui64vProc)(GLuint id, GLenum pname, GLuint64 *params);
+
+GpuTimer::GpuTimer() {
+    mSupported = false;
+    mGetQueryObjectui64v = NULL;
+    memset(mQueries, 0, sizeof(mQueries));
+    memset(mTags, 0, sizeof(mTags));
+    mHead = mTail = mInFlight = 0;
+    mActive = false;
+}
+
+bool GpuTimer::Init() {
+    mHead = mTail = mInFlight = 0;
+    mActive = false;
+
+    const char *exts = (const char*) glGetString(GL_EXTENSIONS);
+    if (!exts || !strstr(exts, "GL_EXT_disjoint_timer_query")) {
+        LOGD("GpuTimer: GL_EXT_disjoint_timer_query not supported.");
+        mSupported = false;
+        return false;
+    }
+
+    mGetQueryObjectui64v = (void*) eglGetProcAddress("glGetQueryObjectui64vEXT");
+    if (!mGetQueryObjectui64v) {
+        LOGW("GpuTimer: extension advertised but entry points missing.");
+        mSupported = false;
+        return false;
+    }
+
+    glGenQueries(GPU_TIMER_QUERIES, mQueries);
+
+    // clear any disjoint event that happened before we started
+    GLint disjoint;
+    glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+
+    mSupported = true;
+    LOGD("GpuTimer: enabled.");
+    return true;
+}
+
+void GpuTimer::Shutdown() {
+    if (mSupported) {
+        glDeleteQueries(GPU_TIMER_QUERIES, mQueries);
+        memset(mQueries, 0, sizeof(mQueries));
+    }
+    mSupported = false;
+    mHead = mTail = mInFlight = 0;
+    mActive = false;
+}
+
+void GpuTimer::Begin(uint32_t tag) {
+    if (!mSupported || mActive || mInFlight == GPU_TIMER_QUERIES) {
+        return;
+    }
+    mTags[mHead] = tag;
+    glBeginQuery(GL_TIME_ELAPSED_EXT, mQueries[mHead]);
+    mActive = true;
+}
+
+void GpuTimer::End() {
+    if (!mActive) {
+        return;
+    }
+    glEndQuery(GL_TIME_ELAPSED_EXT);
+    mActive = false;
+    mHead = (mHead + 1) % GPU_TIMER_QUERIES;
+    mInFlight++;
+}
+
+bool GpuTimer::Poll(uint32_t *tag, float *ms) {
+    while (mInFlight > 0) {
+        GLuint available = 0;
+        glGetQueryObjectuiv(mQueries[mTail], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            return false;
+        }
+
+        GLuint64 elapsed_ns = 0;
+        ((GetQueryObjectui64vProc) mGetQueryObjectui64v)(mQueries[mTail], GL_QUERY_RESULT,
+                                                          &elapsed_ns);
+        uint32_t t = mTags[mTail];
+        mTail = (mTail + 1) % GPU_TIMER_QUERIES;
+        mInFlight--;
+
+        // if the GPU went through a disjoint event, none of the results so far are reliable
+        GLint disjoint = 0;
+        glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+        if (disjoint) {
+            continue;
+        }
+
+        *tag = t;
+        *ms = (float) (elapsed_ns / 1e6);
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,43 @@
+#ifndef endlesstunnel_gpu_timer_hpp
+#define endlesstunnel_gpu_timer_hpp
+
+#include <stdint.h>
+
+// queries in flight; results are typically available 2-3 frames later
+#define GPU_TIMER_QUERIES 4
+
+// Measures GPU time spent between Begin() and End() with GL_EXT_disjoint_timer_query.
+// Results are read back asynchronously (never stalling the pipeline) and tagged with the
+// value passed to Begin(), so the caller can match them to its frames.
+class GpuTimer {
+    public:
+        GpuTimer();
+
+        // needs a current context. Returns false if the extension isn't supported.
+        bool Init();
+
+        // deletes the queries. Needs the context that Init() was called with.
+        void Shutdown();
+
+        bool IsSupported() const { return mSupported; }
+
+        // starts timing. Does nothing if all the queries are still in flight.
+        void Begin(uint32_t tag);
+        void End();
+
+        // returns the oldest available result, if any. Results spanning a disjoint event
+        // (e.g. GPU frequency change) are discarded.
+        bool Poll(uint32_t *tag, float *ms);
+
+    private:
+        bool mSupported;
+        void *mGetQueryObjectui64v;
+        uint32_t mQueries[GPU_TIMER_QUERIES];
+        uint32_t mTags[GPU_TIMER_QUERIES];
+
+        // queries are issued at mHead and read back from mTail
+        int mHead, mTail, mInFlight;
+        bool mActive;
+};
+
+#endif
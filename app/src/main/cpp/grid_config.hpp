@@ -0,0 +1,102 @@
+#ifndef endlesstunnel_grid_config_hpp
+#define endlesstunnel_grid_config_hpp
+
+#include <math.h>
+#include <stdint.h>
+#include <array>
+#include <type_traits>
+
+#include "game_consts.hpp"
+
+// smallest unsigned type with at least Bits bits
+template <int Bits>
+struct GridMaskFor {
+    static_assert(Bits > 0 && Bits <= 64, "grid doesn't fit in a 64-bit mask");
+    typedef typename std::conditional<Bits <= 8, uint8_t,
+            typename std::conditional<Bits <= 16, uint16_t,
+            typename std::conditional<Bits <= 32, uint32_t, uint64_t>::type>::type>::type type;
+};
+
+// Obstacle grid geometry, as compile-time constants: Size x Size cells across a tunnel of
+// 2 * HalfW by 2 * HalfH. Obstacle, occlusion and collision code is templated on it, so
+// masks get the smallest type that fits (5x5 in a uint32_t, 8x8 in a uint64_t) and loops
+// over cells have constant bounds. Cells are bit (row * Size + col) of a mask; rows go up
+// (z), columns go right (x), as seen by the player.
+template <int Size, int HalfW = (int) TUNNEL_HALF_W, int HalfH = (int) TUNNEL_HALF_H>
+struct GridConfig {
+    typedef typename GridMaskFor<Size * Size>::type Mask;
+
+    static constexpr int SIZE = Size;
+    static constexpr int CELLS = Size * Size;
+    static constexpr float HALF_W = (float) HalfW;
+    static constexpr float HALF_H = (float) HalfH;
+
+    // same proportions as OBS_CELL_SIZE, OBS_BOX_SIZE and OBS_BONUS_SIZE
+    static constexpr float CELL_SIZE = 2.0f * HALF_W / Size;
+    static constexpr float BOX_SIZE = 0.8f * CELL_SIZE;
+    static constexpr float BONUS_SIZE = 0.3f * CELL_SIZE;
+
+    // one bit per column (or row) index
+    static constexpr unsigned AXIS_BITS = (1u << Size) - 1;
+
+    static constexpr Mask ALL_CELLS = (Mask) (CELLS == 64 ? ~0ull : (1ull << CELLS) - 1);
+
+    static constexpr Mask CellBit(int col, int row) {
+        return (Mask) (1ull << (row * Size + col));
+    }
+
+    static constexpr float CellCenterX(int col) { return -HALF_W + (col + 0.5f) * CELL_SIZE; }
+    static constexpr float CellCenterZ(int row) { return -HALF_H + (row + 0.5f) * CELL_SIZE; }
+
+    // cell containing a position (clamped to the grid)
+    static int ColAt(float x) { return Clamp((int) floorf((x + HALF_W) * (1.0f / CELL_SIZE))); }
+    static int RowAt(float z) { return Clamp((int) floorf((z + HALF_H) * (1.0f / CELL_SIZE))); }
+    static Mask CellAt(float x, float z) { return CellBit(ColAt(x), RowAt(z)); }
+
+    // the cells in the given columns and rows. cols fits in a row, so multiplying it by a
+    // bit per selected row can't carry from one row into the next.
+    static Mask Expand(unsigned cols, unsigned rows) {
+        return (Mask) (cols * ROW_SPREAD[rows & AXIS_BITS]);
+    }
+
+    static int Count(Mask m) { return __builtin_popcountll((uint64_t) m); }
+
+    // bit 0 of each row in rows set, i.e. bit r -> bit r * Size
+    static constexpr std::array<uint64_t, (1 << Size)> ROW_SPREAD = [] {
+        std::array<uint64_t, (1 << Size)> t{};
+        for (int rows = 0; rows < (1 << Size); rows++) {
+            for (int r = 0; r < Size; r++) {
+                if (rows & (1 << r)) {
+                    t[rows] |= 1ull << (r * Size);
+                }
+            }
+        }
+        return t;
+    }();
+
+    // each cell and the (up to) eight around it
+    static constexpr std::array<Mask, CELLS> NEIGHBOURS = [] {
+        std::array<Mask, CELLS> t{};
+        for (int cell = 0; cell < CELLS; cell++) {
+            int col = cell % Size, row = cell / Size;
+            for (int r = row - 1; r <= row + 1; r++) {
+                for (int c = col - 1; c <= col + 1; c++) {
+                    if (r >= 0 && r < Size && c >= 0 && c < Size) {
+                        t[cell] |= (Mask) (1ull << (r * Size + c));
+                    }
+                }
+            }
+        }
+        return t;
+    }();
+
+    private:
+        static int Clamp(int i) { return i < 0 ? 0 : (i >= Size ? Size - 1 : i); }
+};
+
+// the game's grid
+typedef GridConfig<OBS_GRID_SIZE> DefaultGrid;
+
+static_assert(DefaultGrid::CELL_SIZE == OBS_CELL_SIZE, "grid config out of sync with macros");
+
+#endif
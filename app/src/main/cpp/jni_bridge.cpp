@@ -0,0 +1,66 @@
+#include "jni_bridge.hpp"
+
+JavaRequestQueue::JavaRequestQueue() : mHead(0), mTail(0), mDropped(0) {
+    for (uint32_t i = 0; i < JAVA_REQUEST_QUEUE_SIZE; i++) {
+        mSlots[i].seq.store(i, std::memory_order_relaxed);
+    }
+}
+
+// Each slot carries a sequence number: seq == pos means the slot is free for the producer that
+// claims position pos; seq == pos + 1 means it holds the request written at pos.
+bool JavaRequestQueue::Push(JavaRequest type, int32_t a, int32_t b) {
+    uint32_t pos = mHead.load(std::memory_order_relaxed);
+    Slot *slot;
+
+    for (;;) {
+        slot = &mSlots[pos % JAVA_REQUEST_QUEUE_SIZE];
+        uint32_t seq = slot->seq.load(std::memory_order_acquire);
+        int32_t diff = (int32_t) (seq - pos);
+
+        if (diff == 0) {
+            if (mHead.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // full
+            mDropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        } else {
+            pos = mHead.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->data[0] = (int32_t) type;
+    slot->data[1] = a;
+    slot->data[2] = b;
+    slot->seq.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+size_t JavaRequestQueue::Drain(int32_t *out, size_t max_requests) {
+    size_t n = 0;
+
+    while (n < max_requests) {
+        Slot *slot = &mSlots[mTail % JAVA_REQUEST_QUEUE_SIZE];
+        if (slot->seq.load(std::memory_order_acquire) != mTail + 1) {
+            // empty (or the producer hasn't finished writing it yet)
+            break;
+        }
+
+        for (int i = 0; i < JAVA_REQUEST_INTS; i++) {
+            out[n * JAVA_REQUEST_INTS + i] = slot->data[i];
+        }
+        slot->seq.store(mTail + JAVA_REQUEST_QUEUE_SIZE, std::memory_order_release);
+        mTail++;
+        n++;
+    }
+
+    return n;
+}
+
+void JniBridge::Flush() {
+    size_t count = mQueue.Drain(mBatch, JAVA_REQUEST_QUEUE_SIZE);
+    if (count && mSink) {
+        mSink->Send(mBatch, count);
+    }
+}
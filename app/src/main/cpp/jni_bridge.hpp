@@ -0,0 +1,84 @@
+#ifndef endlesstunnel_jni_bridge_hpp
+#define endlesstunnel_jni_bridge_hpp
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+// Requests the native side can make to the Java side. The values must match the ones in
+// MainActivity.onNativeRequests().
+enum class JavaRequest : int32_t {
+    HapticFeedback = 1,  // a: HapticFeedbackConstants value
+    Vibrate = 2,         // a: duration in milliseconds
+    KeepScreenOn = 3,    // a: 0 or 1
+};
+
+// each request is sent as this many ints: type, a, b
+#define JAVA_REQUEST_INTS 3
+
+// max requests that can be queued between two flushes
+#define JAVA_REQUEST_QUEUE_SIZE 64
+
+// Bounded lock-free queue of outgoing Java requests (multiple producers, one consumer).
+// Push() never blocks nor allocates, so it is safe to call from the hot path. There's no JNI
+// in here (that's in jni_request_sink.hpp), so the queueing logic can be exercised on the host:
+// see tools/jni_bridge_check.cpp.
+class JavaRequestQueue {
+    public:
+        JavaRequestQueue();
+
+        // queues a request. Returns false (and drops it) if the queue is full.
+        bool Push(JavaRequest type, int32_t a = 0, int32_t b = 0);
+
+        // pops up to max_requests requests, flattened into out (JAVA_REQUEST_INTS ints each).
+        // Returns the number of requests popped. Consumer side only.
+        size_t Drain(int32_t *out, size_t max_requests);
+
+        // how many requests were dropped because the queue was full
+        uint32_t GetDropped() const { return mDropped.load(std::memory_order_relaxed); }
+
+    private:
+        struct Slot {
+            std::atomic<uint32_t> seq;
+            int32_t data[JAVA_REQUEST_INTS];
+        };
+
+        Slot mSlots[JAVA_REQUEST_QUEUE_SIZE];
+        std::atomic<uint32_t> mHead;  // next slot to write
+        uint32_t mTail;               // next slot to read (consumer only)
+        std::atomic<uint32_t> mDropped;
+};
+
+// Receives a batch of flattened requests. The JNI implementation calls into the activity;
+// a stub can be plugged in instead to test without a JVM.
+class JavaRequestSink {
+    public:
+        virtual ~JavaRequestSink() {}
+        virtual void Send(const int32_t *data, size_t count) = 0;
+};
+
+// Queues Java requests during the frame and sends them all with a single JNI call at the end.
+class JniBridge {
+    public:
+        JniBridge() : mSink(nullptr) {}
+
+        void SetSink(JavaRequestSink *sink) { mSink = sink; }
+
+        // may be called from any thread; never blocks
+        bool Post(JavaRequest type, int32_t a = 0, int32_t b = 0) {
+            return mQueue.Push(type, a, b);
+        }
+
+        // sends everything queued so far in one batch. Call once per frame.
+        void Flush();
+
+        // requests dropped because more than a queue's worth were posted between two flushes
+        uint32_t GetDropped() const { return mQueue.GetDropped(); }
+
+    private:
+        JavaRequestQueue mQueue;
+        JavaRequestSink *mSink;
+        int32_t mBatch[JAVA_REQUEST_QUEUE_SIZE * JAVA_REQUEST_INTS];
+};
+
+#endif
@@ -0,0 +1,98 @@
+#include "common.hpp"
+#include "jni_request_sink.hpp"
+
+bool JniRequestSink::Init(JNIEnv *env, jobject activity) {
+    mEnv = env;
+
+    jclass cls = env->GetObjectClass(activity);
+    if (!cls) {
+        LOGE("JniRequestSink: can't get activity class.");
+        return false;
+    }
+    mActivityClass = (jclass) env->NewGlobalRef(cls);
+    env->DeleteLocalRef(cls);
+
+    mOnNativeRequests = env->GetMethodID(mActivityClass, "onNativeRequests", "([II)V");
+    if (!mOnNativeRequests || env->ExceptionCheck()) {
+        LOGE("JniRequestSink: can't find MainActivity.onNativeRequests(int[], int).");
+        env->ExceptionClear();
+        Shutdown();
+        return false;
+    }
+
+    mActivity = env->NewGlobalRef(activity);
+
+    // the same array is reused for every batch
+    jintArray arr = env->NewIntArray(JAVA_REQUEST_QUEUE_SIZE * JAVA_REQUEST_INTS);
+    mBatchArray = (jintArray) env->NewGlobalRef(arr);
+    env->DeleteLocalRef(arr);
+
+    LOGD("JniRequestSink: initialized.");
+    return true;
+}
+
+void JniRequestSink::Shutdown() {
+    if (!mEnv) {
+        return;
+    }
+    if (mBatchArray) {
+        mEnv->DeleteGlobalRef(mBatchArray);
+    }
+    if (mActivity) {
+        mEnv->DeleteGlobalRef(mActivity);
+    }
+    if (mActivityClass) {
+        mEnv->DeleteGlobalRef(mActivityClass);
+    }
+    mBatchArray = nullptr;
+    mActivity = nullptr;
+    mActivityClass = nullptr;
+    mOnNativeRequests = nullptr;
+    mEnv = nullptr;
+}
+
+void JniRequestSink::Send(const int32_t *data, size_t count) {
+    if (!mOnNativeRequests) {
+        return;
+    }
+
+    mEnv->SetIntArrayRegion(mBatchArray, 0, (jint) (count * JAVA_REQUEST_INTS), data);
+    mEnv->CallVoidMethod(mActivity, mOnNativeRequests, mBatchArray, (jint) count);
+    if (mEnv->ExceptionCheck()) {
+        LOGE("JniRequestSink: exception in onNativeRequests.");
+        mEnv->ExceptionDescribe();
+        mEnv->ExceptionClear();
+    }
+}
+
+bool JniCallStringMethod(JNIEnv *env, jobject obj, const char *name, std::string *out) {
+    jclass cls = env->GetObjectClass(obj);
+    jmethodID method = cls ? env->GetMethodID(cls, name, "()Ljava/lang/String;") : nullptr;
+    if (cls) {
+        env->DeleteLocalRef(cls);
+    }
+    if (!method || env->ExceptionCheck()) {
+        LOGE("JniCallStringMethod: can't find %s().", name);
+        env->ExceptionClear();
+        return false;
+    }
+
+    jstring str = (jstring) env->CallObjectMethod(obj, method);
+    if (env->ExceptionCheck()) {
+        LOGE("JniCallStringMethod: exception in %s().", name);
+        env->ExceptionDescribe();
+        env->ExceptionClear();
+        return false;
+    }
+
+    out->clear();
+    if (str) {
+        const char *chars = env->GetStringUTFChars(str, nullptr);
+        if (chars) {
+            *out = chars;
+            env->ReleaseStringUTFChars(str, chars);
+        }
+        env->DeleteLocalRef(str);
+    }
+    return true;
+}
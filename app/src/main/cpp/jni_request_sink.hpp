@@ -0,0 +1,32 @@
+#ifndef endlesstunnel_jni_request_sink_hpp
+#define endlesstunnel_jni_request_sink_hpp
+
+#include <string>
+
+#include <jni.h>
+
+#include "jni_bridge.hpp"
+
+// Sends batches to MainActivity.onNativeRequests(int[], int). Classes, methods and the transfer
+// array are resolved/allocated once, in Init(), and kept as global refs.
+class JniRequestSink : public JavaRequestSink {
+    public:
+        // must be called on the thread that will later call Send()
+        bool Init(JNIEnv *env, jobject activity);
+        void Shutdown();
+
+        void Send(const int32_t *data, size_t count) override;
+
+    private:
+        JNIEnv *mEnv = nullptr;
+        jobject mActivity = nullptr;
+        jclass mActivityClass = nullptr;
+        jmethodID mOnNativeRequests = nullptr;
+        jintArray mBatchArray = nullptr;
+};
+
+// Calls a String method without arguments (e.g. MainActivity.getBenchmarkScenarios()) on obj.
+// Returns false if the method doesn't exist or throws; a null result is returned as "".
+bool JniCallStringMethod(JNIEnv *env, jobject obj, const char *name, std::string *out);
+
+#endif
@@ -0,0 +1,85 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cstring>
+
+#include "live_counters.hpp"
+#include "timing.hpp"
+
+LiveCounters *LiveCounters::GetInstance() {
+    static LiveCounters instance;
+    return &instance;
+}
+
+LiveCounters::LiveCounters() {
+    mPage = nullptr;
+    mUnpublished.value.store(0, std::memory_order_relaxed);
+    mUnpublished.kind = 0;
+    mUnpublished.reserved = 0;
+    memset(mUnpublished.name, 0, sizeof(mUnpublished.name));
+}
+
+bool LiveCounters::Open(const char *path) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mPage) {
+        return true;
+    }
+
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    if (0 != ftruncate(fd, sizeof(LiveCountersPage))) {
+        close(fd);
+        return false;
+    }
+    void *p = mmap(nullptr, sizeof(LiveCountersPage), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        return false;
+    }
+
+    // the file was just truncated, so it's all zeroes
+    mPage = (LiveCountersPage*) p;
+    mPage->header.version = LIVE_COUNTERS_VERSION;
+    mPage->header.pid = (uint32_t) getpid();
+    mPage->header.start_ns = TimeNowNs();
+    mPage->header.count.store(0, std::memory_order_relaxed);
+    // the magic goes last: readers ignore the file until it's there
+    std::atomic_thread_fence(std::memory_order_release);
+    mPage->header.magic = LIVE_COUNTERS_MAGIC;
+    return true;
+}
+
+void LiveCounters::Close() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mPage) {
+        // counters handed out so far still point into the page; leave it mapped
+        msync(mPage, sizeof(LiveCountersPage), MS_ASYNC);
+    }
+}
+
+LiveCounter *LiveCounters::Register(const char *name, LiveCounterKind kind) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (!mPage) {
+        return &mUnpublished;
+    }
+
+    uint32_t count = mPage->header.count.load(std::memory_order_relaxed);
+    for (uint32_t i = 0; i < count; i++) {
+        if (0 == strncmp(mPage->counters[i].name, name, LIVE_COUNTER_NAME_LEN)) {
+            return &mPage->counters[i];
+        }
+    }
+    if (count == LIVE_COUNTERS_MAX) {
+        return &mUnpublished;
+    }
+
+    LiveCounter *c = &mPage->counters[count];
+    c->kind = (uint32_t) kind;
+    strncpy(c->name, name, LIVE_COUNTER_NAME_LEN - 1);
+    c->value.store(0, std::memory_order_relaxed);
+    mPage->header.count.store(count + 1, std::memory_order_release);
+    return c;
+}
@@ -0,0 +1,71 @@
+#ifndef endlesstunnel_live_counters_hpp
+#define endlesstunnel_live_counters_hpp
+
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+
+#define LIVE_COUNTERS_MAGIC 0x544e4354  // "TCNT"
+#define LIVE_COUNTERS_VERSION 1
+#define LIVE_COUNTERS_MAX 63
+#define LIVE_COUNTER_NAME_LEN 48
+
+enum class LiveCounterKind : uint32_t {
+    Counter = 0,  // only goes up; readers show its rate
+    Gauge = 1,    // current value
+};
+
+// One named value. Writers update it with relaxed atomics; 64-bit aligned loads and stores are
+// single-copy atomic, so readers in another process never see torn values.
+struct LiveCounter {
+    std::atomic<int64_t> value;
+    uint32_t kind;
+    uint32_t reserved;
+    char name[LIVE_COUNTER_NAME_LEN];
+
+    void Add(int64_t n = 1) { value.fetch_add(n, std::memory_order_relaxed); }
+    void Set(int64_t v) { value.store(v, std::memory_order_relaxed); }
+};
+
+// Layout of the counters file: this header, followed by the counters. A counter is fully
+// written before count is increased (release), so readers must load count with acquire.
+struct LiveCountersHeader {
+    uint32_t magic;
+    uint32_t version;
+    std::atomic<uint32_t> count;
+    uint32_t pid;
+    uint64_t start_ns;  // CLOCK_MONOTONIC
+    uint8_t reserved[40];
+};
+
+struct LiveCountersPage {
+    LiveCountersHeader header;
+    LiveCounter counters[LIVE_COUNTERS_MAX];
+};
+
+static_assert(sizeof(LiveCounter) == 64, "counters must be one cache line each");
+static_assert(sizeof(LiveCountersHeader) == 64, "header must be one cache line");
+
+// A page of named counters in a memory-mapped file, so that another process (e.g.
+// tools/counters_view) can watch them at any rate without any cooperation from the game.
+class LiveCounters {
+    public:
+        static LiveCounters *GetInstance();
+
+        // creates (or truncates) the counters file and maps it
+        bool Open(const char *path);
+        void Close();
+
+        // registers a counter (or returns the one already registered with that name). Never
+        // returns null: if the page isn't open or is full, the counter isn't published.
+        LiveCounter *Register(const char *name, LiveCounterKind kind);
+
+    private:
+        LiveCounters();
+
+        LiveCountersPage *mPage;
+        std::mutex mMutex;  // registration only
+        LiveCounter mUnpublished;
+};
+
+#endif
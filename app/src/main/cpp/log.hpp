@@ -0,0 +1,36 @@
+#ifndef endlesstunnel_log_hpp
+#define endlesstunnel_log_hpp
+
+// Logging and assertions without the rest of common.hpp (GL, JNI, the app glue), so that the
+// modules that only need these also build on the host, for the tools. Off Android, the log
+// goes to stderr.
+
+#ifdef __ANDROID__
+#include <android/log.h>
+
+#define DEBUG_TAG "EndlessTunnel:Native"
+#define LOGD(...) ((void)__android_log_print(ANDROID_LOG_DEBUG, DEBUG_TAG, __VA_ARGS__))
+#define LOGI(...) ((void)__android_log_print(ANDROID_LOG_INFO, DEBUG_TAG, __VA_ARGS__))
+#define LOGW(...) ((void)__android_log_print(ANDROID_LOG_WARN, DEBUG_TAG, __VA_ARGS__))
+#define LOGE(...) ((void)__android_log_print(ANDROID_LOG_ERROR, DEBUG_TAG, __VA_ARGS__))
+#else
+#include <stdio.h>
+
+#define HOST_LOG(level, ...) ((void)(fprintf(stderr, level " " __VA_ARGS__), fputc('\n', stderr)))
+#define LOGD(...) HOST_LOG("D", __VA_ARGS__)
+#define LOGI(...) HOST_LOG("I", __VA_ARGS__)
+#define LOGW(...) HOST_LOG("W", __VA_ARGS__)
+#define LOGE(...) HOST_LOG("E", __VA_ARGS__)
+#endif
+
+#include "flight_recorder.hpp"
+
+#define ABORT_GAME { LOGE("*** GAME ABORTING."); \
+   FlightRecorder::GetInstance()->RecordAbort(__FILE__, __LINE__); \
+   *((volatile char*)0) = 'a'; }
+#define DEBUG_BLIP LOGD("[ BLIP ]: %s:%d", __FILE__, __LINE__)
+
+#define MY_ASSERT(cond) { if (!(cond)) { LOGE("ASSERTION FAILED: %s", #cond); \
+   ABORT_GAME; } }
+
+#endif
@@ -0,0 +1,168 @@
+#include <cstring>
+
+#include "lz4.hpp"
+
+#define LZ4_MIN_MATCH 4
+#define LZ4_HASH_BITS 12
+#define LZ4_MAX_OFFSET 65535
+
+// the format requires the last 5 bytes to be literals, and the last match to start at least
+// 12 bytes before the end of the block
+#define LZ4_LAST_LITERALS 5
+#define LZ4_MF_LIMIT 12
+
+static inline uint32_t _read32(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t _hash(uint32_t v) {
+    return (v * 2654435761u) >> (32 - LZ4_HASH_BITS);
+}
+
+// writes a length extension (the part that didn't fit in the token's 4 bits)
+static uint8_t *_write_length(uint8_t *op, size_t len) {
+    while (len >= 255) {
+        *op++ = 255;
+        len -= 255;
+    }
+    *op++ = (uint8_t) len;
+    return op;
+}
+
+size_t Lz4CompressBlock(const uint8_t *src, size_t src_size, uint8_t *dst, size_t dst_capacity) {
+    if (dst_capacity < Lz4CompressBound(src_size)) {
+        return 0;
+    }
+
+    uint32_t table[1 << LZ4_HASH_BITS];
+    memset(table, 0, sizeof(table));
+
+    const uint8_t *ip = src;
+    const uint8_t *anchor = src;  // start of pending literals
+    const uint8_t *const end = src + src_size;
+    const uint8_t *const match_limit = src_size > LZ4_MF_LIMIT ? end - LZ4_MF_LIMIT : src;
+    uint8_t *op = dst;
+
+    // position 0 can't be told apart from "empty" in the table; skip it
+    if (src_size > LZ4_MF_LIMIT) {
+        ip++;
+    }
+
+    while (ip < match_limit) {
+        uint32_t seq = _read32(ip);
+        uint32_t h = _hash(seq);
+        const uint8_t *ref = src + table[h];
+        table[h] = (uint32_t) (ip - src);
+
+        if (ref == src || ip - ref > LZ4_MAX_OFFSET || _read32(ref) != seq) {
+            ip++;
+            continue;
+        }
+
+        // extend the match forward (keeping the last literals out of it)
+        const uint8_t *mp = ip + LZ4_MIN_MATCH;
+        const uint8_t *rp = ref + LZ4_MIN_MATCH;
+        while (mp < end - LZ4_LAST_LITERALS && *mp == *rp) {
+            mp++;
+            rp++;
+        }
+
+        size_t lit_len = ip - anchor;
+        size_t match_len = (mp - ip) - LZ4_MIN_MATCH;
+
+        uint8_t *token = op++;
+        *token = (uint8_t) ((lit_len >= 15 ? 15 : lit_len) << 4);
+        if (lit_len >= 15) {
+            op = _write_length(op, lit_len - 15);
+        }
+        memcpy(op, anchor, lit_len);
+        op += lit_len;
+
+        uint16_t offset = (uint16_t) (ip - ref);
+        *op++ = (uint8_t) offset;
+        *op++ = (uint8_t) (offset >> 8);
+
+        *token |= (uint8_t) (match_len >= 15 ? 15 : match_len);
+        if (match_len >= 15) {
+            op = _write_length(op, match_len - 15);
+        }
+
+        ip = mp;
+        anchor = ip;
+    }
+
+    // last literals
+    size_t lit_len = end - anchor;
+    *op++ = (uint8_t) ((lit_len >= 15 ? 15 : lit_len) << 4);
+    if (lit_len >= 15) {
+        op = _write_length(op, lit_len - 15);
+    }
+    memcpy(op, anchor, lit_len);
+    op += lit_len;
+
+    return op - dst;
+}
+
+long Lz4DecompressBlock(const uint8_t *src, size_t src_size, uint8_t *dst, size_t dst_capacity) {
+    const uint8_t *ip = src;
+    const uint8_t *const iend = src + src_size;
+    uint8_t *op = dst;
+    uint8_t *const oend = dst + dst_capacity;
+
+    while (ip < iend) {
+        uint8_t token = *ip++;
+
+        size_t lit_len = token >> 4;
+        if (lit_len == 15) {
+            uint8_t b;
+            do {
+                if (ip >= iend) return -1;
+                b = *ip++;
+                lit_len += b;
+            } while (b == 255);
+        }
+        if (lit_len > (size_t) (iend - ip) || lit_len > (size_t) (oend - op)) {
+            return -1;
+        }
+        memcpy(op, ip, lit_len);
+        ip += lit_len;
+        op += lit_len;
+
+        if (ip == iend) {
+            // the last sequence has no match
+            break;
+        }
+
+        if (iend - ip < 2) return -1;
+        size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (size_t) (op - dst)) {
+            return -1;
+        }
+
+        size_t match_len = token & 15;
+        if (match_len == 15) {
+            uint8_t b;
+            do {
+                if (ip >= iend) return -1;
+                b = *ip++;
+                match_len += b;
+            } while (b == 255);
+        }
+        match_len += LZ4_MIN_MATCH;
+        if (match_len > (size_t) (oend - op)) {
+            return -1;
+        }
+
+        // byte by byte: the match may overlap what it's producing
+        const uint8_t *ref = op - offset;
+        for (size_t i = 0; i < match_len; i++) {
+            op[i] = ref[i];
+        }
+        op += match_len;
+    }
+
+    return op - dst;
+}
@@ -0,0 +1,22 @@
+#ifndef endlesstunnel_lz4_hpp
+#define endlesstunnel_lz4_hpp
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Minimal compressor/decompressor for the LZ4 block format (the raw block format, without
+// the frame format around it), so blocks we write can also be read by the standard lz4
+// tools and libraries. Greedy matching with a single-entry hash table: fast, decent ratio.
+
+// worst-case compressed size for src_size bytes of input
+static inline size_t Lz4CompressBound(size_t src_size) {
+    return src_size + src_size / 255 + 16;
+}
+
+// returns the compressed size, or 0 if dst_capacity is too small
+size_t Lz4CompressBlock(const uint8_t *src, size_t src_size, uint8_t *dst, size_t dst_capacity);
+
+// returns the decompressed size, or -1 if the input is malformed or doesn't fit in dst
+long Lz4DecompressBlock(const uint8_t *src, size_t src_size, uint8_t *dst, size_t dst_capacity);
+
+#endif
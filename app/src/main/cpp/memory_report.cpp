@@ -0,0 +1,233 @@
+#include <malloc.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "log.hpp"
+#include "alloc_stats.hpp"
+#include "memory_report.hpp"
+#include "profiler.hpp"
+#include "trace.hpp"
+
+static const char *_resource_kinds[] = { "buffer", "texture", "renderbuffer" };
+
+MemoryReporter::MemoryReporter() {
+    memset(mResources, 0, sizeof(mResources));
+    mResourceCount = 0;
+    mSurfWidth = mSurfHeight = 0;
+    mSurfColorBytes = mSurfDepthBytes = 0;
+    memset(&mLast, 0, sizeof(mLast));
+    mLastSeq = 0;
+    for (int i = 0; i < SHARED_COUNT; i++) {
+        mShared[i].store(0, std::memory_order_relaxed);
+    }
+    mSeq.store(0, std::memory_order_relaxed);
+    mStopSampler.store(false);
+}
+
+MemoryReporter::~MemoryReporter() {
+    Stop();
+}
+
+bool MemoryReporter::Start() {
+    if (mSampler.joinable()) {
+        return true;
+    }
+    mStopSampler.store(false);
+    mSampler = std::thread([this] { SamplerMain(); });
+    return true;
+}
+
+void MemoryReporter::Stop() {
+    if (!mSampler.joinable()) {
+        return;
+    }
+    mStopSampler.store(true);
+    // wakes it up if it's sleeping, or parked
+    mGate.Close();
+    mGate.Open();
+    mSampler.join();
+}
+
+void MemoryReporter::Suspend() {
+    if (mSampler.joinable()) {
+        mGate.Close();
+        mGate.WaitParked(1, MEMORY_SAMPLE_INTERVAL_MS);
+    }
+}
+
+void MemoryReporter::Resume() {
+    mGate.Open();
+}
+
+void MemoryReporter::SamplerMain() {
+    SamplingProfiler::GetInstance()->RegisterThread("memory");
+    while (!mStopSampler.load()) {
+        MemorySample s;
+        ReadFootprint(&s);
+        Publish(s);
+        mGate.Sleep(MEMORY_SAMPLE_INTERVAL_MS);
+        if (mStopSampler.load()) {
+            break;
+        }
+        mGate.Pass();
+    }
+}
+
+// a seqlock: readers retry (or give up) if the sequence changed while they were reading
+void MemoryReporter::Publish(const MemorySample& s) {
+    uint32_t seq = mSeq.load(std::memory_order_relaxed);
+    mSeq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    mShared[SHARED_RSS].store(s.rss_kb, std::memory_order_relaxed);
+    mShared[SHARED_PSS].store(s.pss_kb, std::memory_order_relaxed);
+    mShared[SHARED_PSS_ANON].store(s.pss_anon_kb, std::memory_order_relaxed);
+    mShared[SHARED_PSS_FILE].store(s.pss_file_kb, std::memory_order_relaxed);
+    mShared[SHARED_SWAP].store(s.swap_kb, std::memory_order_relaxed);
+    mShared[SHARED_HEAP].store(s.heap_kb, std::memory_order_relaxed);
+    mShared[SHARED_HEAP_FREE].store(s.heap_free_kb, std::memory_order_relaxed);
+    mSeq.store(seq + 2, std::memory_order_release);
+}
+
+bool MemoryReporter::TakePublished(MemorySample *s) {
+    uint32_t seq = mSeq.load(std::memory_order_acquire);
+    if (seq == mLastSeq || (seq & 1)) {
+        // nothing new, or being written: next frame
+        return false;
+    }
+    s->rss_kb = mShared[SHARED_RSS].load(std::memory_order_relaxed);
+    s->pss_kb = mShared[SHARED_PSS].load(std::memory_order_relaxed);
+    s->pss_anon_kb = mShared[SHARED_PSS_ANON].load(std::memory_order_relaxed);
+    s->pss_file_kb = mShared[SHARED_PSS_FILE].load(std::memory_order_relaxed);
+    s->swap_kb = mShared[SHARED_SWAP].load(std::memory_order_relaxed);
+    s->heap_kb = mShared[SHARED_HEAP].load(std::memory_order_relaxed);
+    s->heap_free_kb = mShared[SHARED_HEAP_FREE].load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (mSeq.load(std::memory_order_relaxed) != seq) {
+        return false;
+    }
+    mLastSeq = seq;
+    return true;
+}
+
+void MemoryReporter::TrackGpu(GpuResource kind, uint32_t id, uint64_t bytes, const char *name) {
+    for (int i = 0; i < mResourceCount; i++) {
+        if (mResources[i].kind == kind && mResources[i].id == id) {
+            mResources[i].bytes = bytes;
+            mResources[i].name = name;
+            return;
+        }
+    }
+    if (mResourceCount == MEMORY_MAX_GPU_RESOURCES) {
+        LOGW("MemoryReporter: too many GPU resources, %s not tracked.", name);
+        return;
+    }
+    mResources[mResourceCount++] = { kind, id, bytes, name };
+}
+
+void MemoryReporter::UntrackGpu(GpuResource kind, uint32_t id) {
+    for (int i = 0; i < mResourceCount; i++) {
+        if (mResources[i].kind == kind && mResources[i].id == id) {
+            mResources[i] = mResources[--mResourceCount];
+            return;
+        }
+    }
+}
+
+void MemoryReporter::SetSurface(int width, int height, int color_bytes, int depth_bytes) {
+    mSurfWidth = width;
+    mSurfHeight = height;
+    mSurfColorBytes = color_bytes;
+    mSurfDepthBytes = depth_bytes;
+}
+
+uint64_t MemoryReporter::GetSurfaceBytes() const {
+    uint64_t pixels = (uint64_t) mSurfWidth * mSurfHeight;
+    // the depth buffer isn't part of the swap chain
+    return pixels * (mSurfColorBytes * MEMORY_SURFACE_BUFFERS + mSurfDepthBytes);
+}
+
+uint64_t MemoryReporter::GetGpuBytes() const {
+    uint64_t total = GetSurfaceBytes();
+    for (int i = 0; i < mResourceCount; i++) {
+        total += mResources[i].bytes;
+    }
+    return total;
+}
+
+// smaps_rollup has the totals of /proc/self/smaps, without the cost of listing every mapping
+bool MemoryReporter::ReadSmapsRollup(MemorySample *s) {
+    FILE *f = fopen("/proc/self/smaps_rollup", "r");
+    if (!f) {
+        return false;
+    }
+
+    char line[128];
+    unsigned long long kb;
+    while (fgets(line, sizeof(line), f)) {
+        if (1 == sscanf(line, "Rss: %llu kB", &kb)) {
+            s->rss_kb = kb;
+        } else if (1 == sscanf(line, "Pss: %llu kB", &kb)) {
+            s->pss_kb = kb;
+        } else if (1 == sscanf(line, "Pss_Anon: %llu kB", &kb)) {
+            s->pss_anon_kb = kb;
+        } else if (1 == sscanf(line, "Pss_File: %llu kB", &kb)) {
+            s->pss_file_kb = kb;
+        } else if (1 == sscanf(line, "Swap: %llu kB", &kb)) {
+            s->swap_kb = kb;
+        }
+    }
+    fclose(f);
+    return true;
+}
+
+void MemoryReporter::ReadFootprint(MemorySample *s) {
+    memset(s, 0, sizeof(*s));
+    // pre-4.14 kernels don't have smaps_rollup; the RSS/PSS fields stay 0 there
+    ReadSmapsRollup(s);
+
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+    struct mallinfo2 mi = mallinfo2();
+#else
+    struct mallinfo mi = mallinfo();
+#endif
+    // large blocks are mmap'd separately (hblkhd) by some allocators
+    s->heap_kb = ((uint64_t) mi.uordblks + (uint64_t) mi.hblkhd) / 1024;
+    s->heap_free_kb = (uint64_t) mi.fordblks / 1024;
+}
+
+bool MemoryReporter::Sample(uint64_t now_ns, bool force) {
+    MemorySample s;
+    if (force) {
+        ReadFootprint(&s);
+    } else if (!TakePublished(&s)) {
+        return false;
+    }
+    s.gpu_kb = GetGpuBytes() / 1024;
+    mLast = s;
+
+    Trace *trace = Trace::GetInstance();
+    trace->Counter("mem_rss_kb", now_ns, (double) s.rss_kb);
+    trace->Counter("mem_pss_kb", now_ns, (double) s.pss_kb);
+    trace->Counter("mem_heap_kb", now_ns, (double) s.heap_kb);
+    trace->Counter("mem_gpu_kb", now_ns, (double) s.gpu_kb);
+    return true;
+}
+
+void MemoryReporter::LogBreakdown() const {
+    const MemorySample& s = mLast;
+    LOGI("Memory: RSS %llu KB, PSS %llu KB (anon %llu, file %llu), swap %llu KB",
+         (unsigned long long) s.rss_kb, (unsigned long long) s.pss_kb,
+         (unsigned long long) s.pss_anon_kb, (unsigned long long) s.pss_file_kb,
+         (unsigned long long) s.swap_kb);
+    LOGI("Memory: heap %llu KB in use, %llu KB free; %llu allocations so far",
+         (unsigned long long) s.heap_kb, (unsigned long long) s.heap_free_kb,
+         (unsigned long long) GetAllocationCount());
+    LOGI("Memory: GPU (estimated) %llu KB", (unsigned long long) (GetGpuBytes() / 1024));
+    LOGI("Memory:   window surface %dx%d: %llu KB", mSurfWidth, mSurfHeight,
+         (unsigned long long) (GetSurfaceBytes() / 1024));
+    for (int i = 0; i < mResourceCount; i++) {
+        const Resource& r = mResources[i];
+        LOGI("Memory:   %s %u (%s): %llu KB", _resource_kinds[(int) r.kind], r.id, r.name,
+             (unsigned long long) ((r.bytes + 1023) / 1024));
+    }
+}
@@ -0,0 +1,112 @@
+#ifndef endlesstunnel_memory_report_hpp
+#define endlesstunnel_memory_report_hpp
+
+#include <stdint.h>
+#include <atomic>
+#include <thread>
+
+#include "suspend.hpp"
+
+// max GPU resources that can be tracked
+#define MEMORY_MAX_GPU_RESOURCES 64
+
+// the process footprint is sampled this often
+#define MEMORY_SAMPLE_INTERVAL_MS 1000
+
+// buffers in the window surface's swap chain (triple buffering is the common case)
+#define MEMORY_SURFACE_BUFFERS 3
+
+enum class GpuResource : uint8_t {
+    Buffer,
+    Texture,
+    Renderbuffer,
+};
+
+// one sample of the process' memory footprint, in KB
+struct MemorySample {
+    uint64_t rss_kb;
+    uint64_t pss_kb;
+    uint64_t pss_anon_kb;
+    uint64_t pss_file_kb;
+    uint64_t swap_kb;
+    uint64_t heap_kb;       // in use by malloc
+    uint64_t heap_free_kb;  // held by malloc, but free
+    uint64_t gpu_kb;        // estimated: tracked resources + the window surface
+};
+
+// Keeps track of the engine's memory footprint: RSS/PSS from /proc/self/smaps_rollup, malloc
+// stats, and an estimate of GPU memory from the resources the engine tells it about (GL
+// doesn't report that). Samples go to the trace as counters; LogBreakdown() dumps everything.
+//
+// Reading smaps_rollup makes the kernel walk every mapping, so the footprint is read on a
+// background thread, which publishes it under a sequence number; Sample() on the game thread
+// only picks up the latest one. Everything else is the game thread's.
+class MemoryReporter {
+    public:
+        MemoryReporter();
+        ~MemoryReporter();
+
+        // starts and stops the sampling thread
+        bool Start();
+        void Stop();
+
+        // parks the sampling thread until Resume() (while the app is paused)
+        void Suspend();
+        void Resume();
+
+        // registers (or resizes) a GPU resource. name must be a literal.
+        void TrackGpu(GpuResource kind, uint32_t id, uint64_t bytes, const char *name);
+        void UntrackGpu(GpuResource kind, uint32_t id);
+
+        // window surface size and bytes per pixel of its color and depth buffers
+        void SetSurface(int width, int height, int color_bytes, int depth_bytes);
+
+        // takes the footprint the sampling thread published last, if it's new, or reads it
+        // right now if force (that's slow). Returns true if there's a new sample.
+        bool Sample(uint64_t now_ns, bool force = false);
+
+        const MemorySample& GetLastSample() const { return mLast; }
+
+        // estimated GPU memory, in bytes
+        uint64_t GetGpuBytes() const;
+
+        // logs the last sample and every tracked resource
+        void LogBreakdown() const;
+
+    private:
+        struct Resource {
+            GpuResource kind;
+            uint32_t id;
+            uint64_t bytes;
+            const char *name;
+        };
+
+        Resource mResources[MEMORY_MAX_GPU_RESOURCES];
+        int mResourceCount;
+
+        int mSurfWidth, mSurfHeight;
+        int mSurfColorBytes, mSurfDepthBytes;
+
+        MemorySample mLast;
+        uint32_t mLastSeq;
+
+        // the footprint, as the sampling thread read it (the process-wide fields of a
+        // MemorySample). mSeq is odd while it's being written.
+        enum { SHARED_RSS, SHARED_PSS, SHARED_PSS_ANON, SHARED_PSS_FILE, SHARED_SWAP, SHARED_HEAP,
+               SHARED_HEAP_FREE, SHARED_COUNT };
+        std::atomic<uint64_t> mShared[SHARED_COUNT];
+        std::atomic<uint32_t> mSeq;
+
+        std::thread mSampler;
+        std::atomic<bool> mStopSampler;
+        ParkingGate mGate;
+
+        uint64_t GetSurfaceBytes() const;
+        static void ReadFootprint(MemorySample *s);
+        static bool ReadSmapsRollup(MemorySample *s);
+        void Publish(const MemorySample& s);
+        bool TakePublished(MemorySample *s);
+        void SamplerMain();
+};
+
+#endif
@@ -0,0 +1,100 @@
+#ifndef endlesstunnel_name_hash_hpp
+#define endlesstunnel_name_hash_hpp
+
+#include <stdint.h>
+#include <type_traits>
+#include <vector>
+
+// 32-bit FNV-1a of a NUL-terminated name. constexpr, so that names written in the code
+// (uniforms, attributes, assets) are hashed by the compiler: see NAME_HASH.
+constexpr uint32_t HashName(const char *s) {
+    uint32_t h = 0x811c9dc5u;
+    while (*s) {
+        h = (h ^ (uint8_t) *s++) * 0x01000193u;
+    }
+    return h;
+}
+
+// the hash of a string literal, guaranteed to be computed at compile time
+#define NAME_HASH(s) (std::integral_constant<uint32_t, HashName(s)>::value)
+
+static_assert(HashName("") == 0x811c9dc5u && HashName("a") == 0xe40c292cu,
+              "not FNV-1a");
+
+// Flat hash table keyed by name hashes: open addressing with linear probing, at most half
+// full, so a lookup is a few probes into one array. Built once (Insert), then only read.
+template <typename T>
+class NameTable {
+    public:
+        NameTable() : mCount(0) {}
+
+        void Clear() {
+            mSlots.clear();
+            mCount = 0;
+        }
+
+        // Returns false if the hash is already in the table (with whatever value: a collision
+        // if the names differ, which the caller has to tell).
+        bool Insert(uint32_t hash, const T& value) {
+            if (2 * (mCount + 1) > (int) mSlots.size()) {
+                Grow();
+            }
+            size_t mask = mSlots.size() - 1;
+            for (size_t i = hash & mask; ; i = (i + 1) & mask) {
+                Slot& s = mSlots[i];
+                if (!s.used) {
+                    s.used = true;
+                    s.hash = hash;
+                    s.value = value;
+                    mCount++;
+                    return true;
+                }
+                if (s.hash == hash) {
+                    return false;
+                }
+            }
+        }
+
+        // null if not there
+        const T *Find(uint32_t hash) const {
+            if (mSlots.empty()) {
+                return nullptr;
+            }
+            size_t mask = mSlots.size() - 1;
+            for (size_t i = hash & mask; mSlots[i].used; i = (i + 1) & mask) {
+                if (mSlots[i].hash == hash) {
+                    return &mSlots[i].value;
+                }
+            }
+            return nullptr;
+        }
+        T *Find(uint32_t hash) {
+            return const_cast<T*>(static_cast<const NameTable*>(this)->Find(hash));
+        }
+
+        int GetCount() const { return mCount; }
+
+    private:
+        struct Slot {
+            uint32_t hash;
+            bool used;
+            T value;
+        };
+
+        std::vector<Slot> mSlots;  // size is a power of 2
+        int mCount;
+
+        void Grow() {
+            std::vector<Slot> old;
+            old.swap(mSlots);
+            mSlots.resize(old.empty() ? 8 : 2 * old.size(), Slot{ 0, false, T() });
+            mCount = 0;
+            for (const Slot& s : old) {
+                if (s.used) {
+                    Insert(s.hash, s.value);
+                }
+            }
+        }
+};
+
+#endif
@@ -14,12 +14,28 @@
  * limitations under the License.
  */
 
+#include <algorithm>
 #include <cstring>
 
 #include <string>
 #include <iostream>
 
+#include <sys/stat.h>
+#include <sys/system_properties.h>
+
+#include <android/asset_manager.h>
+#include <android/native_window.h>
+
+#include "alloc_stats.hpp"
+#include "analytics.hpp"
+#include "flight_recorder.hpp"
+#include "live_counters.hpp"
+#include "profiler.hpp"
+
+#include "game_consts.hpp"
 #include "native_engine.hpp"
+#include "timing.hpp"
+#include "trace.hpp"
 
 // verbose debug logs on?
 #define VERBOSE_LOGGING 1
@@ -40,18 +56,42 @@ NativeEngine::NativeEngine(struct android_app *app) {
     mApp = app;
     mHasFocus = mIsVisible = mHasWindow = false;
     mHasGLObjects = false;
+    mSceneReady = false;
     mEglDisplay = EGL_NO_DISPLAY;
     mEglSurface = EGL_NO_SURFACE;
     mEglContext = EGL_NO_CONTEXT;
     mEglConfig = 0;
     mSurfWidth = mSurfHeight = 0;
+    memset(mTriBounds, 0, sizeof(mTriBounds));
     mApiVersion = 0;
     mJniEnv = NULL;
     memset(&mState, 0, sizeof(mState));
     mIsFirstFrame = true;
+    mPausedAtNs = 0;
+    mVsyncNs = mFrameTimeNs = 0;
+    mDeltaT = 0.0f;
+    mGpuMs = -1.0f;
+    mFrameInputNs = 0;
+    mFrameInputEvents = 0;
+    mTimestamps = &mSimTimestamps;
+    mWindowWidth = mWindowHeight = 0;
+    mTriangleCount = 0;
+    mAnimate = true;
+    mDrawCalls = 0;
+    mFrameAllocs = 0;
+    mQuality.Subscribe(OnQualityChanged, this);
+    // the menu sees touches first, and passes on those it doesn't use to the scene
+    mEvents.Subscribe(Delegate<TouchScreenEvent>::Bind<NativeEngine,
+            &NativeEngine::OnMenuTouch>(this));
+    mMenuPointers = 0;
+    mEventDrops = 0;
     ogl_loaded = false;
     vs_loaded = false;
     fs_loaded = false;
+    vs = fs = program = 0;
+    vao = vbo = 0;
+    overdraw_program = 0;
+    mPatternsAsset = NULL;
     nn = 0;
 
     const float orig_x_[3] = { 0.0f,  -0.5f, 0.5f };
@@ -69,8 +109,57 @@ NativeEngine::NativeEngine(struct android_app *app) {
     MY_ASSERT(_singleton == NULL);
     _singleton = this;
 
+    // resolve the Java methods we call once, up front
+    if (mJniSink.Init(GetJniEnv(), app->activity->javaGameActivity)) {
+        mJniBridge.SetSink(&mJniSink);
+    }
+
+    RegisterCounters();
+    InitFlightRecorder();
+    mMemory.Start();
+    InitSuspend();
+    InitMenu();
+
+    // launched in benchmark mode?
+    std::string scenarios;
+    if (JniCallStringMethod(GetJniEnv(), app->activity->javaGameActivity,
+                            "getBenchmarkScenarios", &scenarios) && !scenarios.empty()) {
+        if (mBench.Configure(scenarios.c_str(), app->activity->internalDataPath)) {
+            LOGI("NativeEngine: benchmark mode, scenarios: %s", scenarios.c_str());
+        } else {
+            LOGE("NativeEngine: no valid benchmark scenarios in '%s'.", scenarios.c_str());
+        }
+    }
+
     VLOGD("NativeEngine: querying API level.");
     LOGD("NativeEngine: API version %d.", mApiVersion);
+
+    // Startup: the EGL display and the asset index don't depend on the window, so they are
+    // initialized in the background while we wait for APP_CMD_INIT_WINDOW. Surface and context
+    // are needed for the first frame; shaders and buffers are only created after it.
+    using Kind = StartupPipeline::Kind;
+    mStartup.Add("egl_display", Kind::Background, [this] { return InitDisplay(); });
+    mStartup.Add("asset_index", Kind::Background, [this] { return LoadAssetIndex(); });
+    mStartup.Add("obstacle_patterns", Kind::Background, [this] {
+        return mStartup.Wait("asset_index") && OpenObstaclePatterns();
+    });
+    mStartup.Add("stats_store", Kind::Background, [this] {
+        std::string path = std::string(mApp->activity->internalDataPath) + "/" + STATS_FILE_NAME;
+        return mStats.Open(path.c_str());
+    });
+    mStartup.Add("analytics", Kind::Background, [this] {
+        std::string dir = std::string(mApp->activity->internalDataPath) + "/analytics";
+        mkdir(dir.c_str(), 0700);
+        return AnalyticsLog::GetInstance()->Start(dir.c_str(), ANALYTICS_FILE_SIZE,
+                                                  ANALYTICS_TOTAL_SIZE);
+    });
+    mStartup.Add("egl_surface", Kind::Critical, [this] {
+        return mStartup.Wait("egl_display") && InitSurface();
+    });
+    mStartup.Add("egl_context", Kind::Critical, [this] { return InitContext(); });
+    mStartup.Add("egl_bind", Kind::Critical, [this] { return BindContext(); });
+    mStartup.Add("gl_objects", Kind::Deferred, [this] { return InitGLObjects(); });
+    mStartup.Begin();
 }
 
 NativeEngine* NativeEngine::GetInstance() {
@@ -81,6 +170,21 @@ NativeEngine* NativeEngine::GetInstance() {
 NativeEngine::~NativeEngine() {
     VLOGD("NativeEngine: destructor running");
     KillContext();
+    StopProfiler();
+    mMemory.Stop();
+    Trace::GetInstance()->StopStreaming();
+    mStartup.Wait("analytics");
+    AnalyticsLog::GetInstance()->Stop();
+    mStartup.Wait("obstacle_patterns");
+    mPatterns.Close();
+    if (mPatternsAsset) {
+        AAsset_close(mPatternsAsset);
+    }
+    LiveCounters::GetInstance()->Close();
+    mStartup.Wait("flight_recovery");
+    FlightRecorder::GetInstance()->Close();
+    mJniBridge.SetSink(NULL);
+    mJniSink.Shutdown();
     if (mJniEnv) {
         LOGD("Detaching current thread from JNI.");
         mApp->activity->vm->DetachCurrentThread();
@@ -136,9 +240,16 @@ void NativeEngine::process_input_events ()
     android_input_buffer* inputBuffer = android_app_swap_input_buffers(mApp);
 
     if (inputBuffer && inputBuffer->motionEventsCount) {
+        mCounters.input_events->Add(inputBuffer->motionEventsCount);
+        mFrameInputEvents += inputBuffer->motionEventsCount;
         for (uint32_t i = 0; i < inputBuffer->motionEventsCount; ++i) {
             GameActivityMotionEvent* motionEvent = &inputBuffer->motionEvents[i];
 
+            // for input-to-display latency
+            if (!mFrameInputNs || motionEvent->eventTime < mFrameInputNs) {
+                mFrameInputNs = motionEvent->eventTime;
+            }
+
             if (motionEvent->pointerCount > 0) {
                 const int action = motionEvent->action;
                 const int actionMasked = action & AMOTION_EVENT_ACTION_MASK;
@@ -150,12 +261,13 @@ void NativeEngine::process_input_events ()
 
                 ev.motion_event = motionEvent;
 
-                // use screen size as the motion range
+                // use the window size as the motion range: touches are in window pixels,
+                // while the surface may be smaller (see the render scale)
                 ev.min.x = 0.0f;
                 ev.min.y = 0.0f;
 
-                ev.max.x = static_cast<float>(mSurfWidth);
-                ev.max.y = static_cast<float>(mSurfHeight);
+                ev.max.x = static_cast<float>(mWindowWidth > 0 ? mWindowWidth : mSurfWidth);
+                ev.max.y = static_cast<float>(mWindowHeight > 0 ? mWindowHeight : mSurfHeight);
 
                 switch (actionMasked) {
                     case AMOTION_EVENT_ACTION_DOWN:
@@ -214,7 +326,7 @@ void NativeEngine::process_input_events ()
                                 pp.y = ev.norm_pos.y;
                             }
 
-                            this->callback_touch_screen_event(ev);
+                            PostTouch(ev);
                         }
                         break;
                     }
@@ -261,50 +373,119 @@ void NativeEngine::process_input_events ()
                             break;
                     }
 
-                    this->callback_touch_screen_event(ev);
+                    PostTouch(ev);
                 }
             }
         }
 
+        // dispatch before the motion events (which ev.motion_event points to) are cleared
+        mEvents.Drain<TouchScreenEvent>();
+        LogEventDrops();
+
         android_app_clear_motion_events(inputBuffer);
     }
 }
 
+void NativeEngine::PostTouch(const TouchScreenEvent& ev) {
+    if (mEvents.IsFull<TouchScreenEvent>()) {
+        // the motion events are still there, so the queued ones can go out now
+        mEvents.Drain<TouchScreenEvent>();
+    }
+    mEvents.Post(ev);
+}
+
+void NativeEngine::LogEventDrops() {
+    uint32_t touch = mEvents.GetDropped<TouchScreenEvent>();
+    uint32_t lifecycle = mEvents.GetDropped<LifecycleEvent>();
+    if (touch + lifecycle != mEventDrops) {
+        LOGW("NativeEngine: event queue full; %u touch and %u lifecycle events dropped so far.",
+             touch, lifecycle);
+        mEventDrops = touch + lifecycle;
+    }
+}
+
 void NativeEngine::GameLoop() {
     mApp->userData = this;
     mApp->onAppCmd = _handle_cmd_proxy;
 
-    g_vertex_buffer_data[0] = { 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, -0.5f, 0.0f, 0.0f };
-    g_vertex_buffer_data[1] = { 0.0f, 1.0f, 0.0f, 0.0f, -0.5f, 0.5f, 0.0f, 0.0f };
-    g_vertex_buffer_data[2] = { 0.0f, 0.0f, 1.0f, 0.0f, 0.5f, 0.5f, 0.0f, 0.0f };
+    SetTriangleCount(1);
+
+    // this thread does both the game logic and the rendering
+    SamplingProfiler::GetInstance()->RegisterThread("game");
+    StartProfiler();
+    // gameplay events are logged from here
+    AnalyticsLog::AttachThread();
+
+    // the choreographer needs this thread's looper, so start it from here
+    mFrameScheduler.Start(OnVsync, this);
+
+    // the hint session applies to the calling thread, which is the one doing the frame work
+    mPerfHint.Init(mFrameScheduler.GetVsyncPeriodNs());
 
     while (1) {
         int ident, events;
         struct android_poll_source* source;
 
-        // If not animating, block until we get an event; if animating, don't block.
-        while ((ident = ALooper_pollAll(IsAnimating() ? 0 : -1, NULL, &events,
-                (void**) &source)) >= 0) {
+        // As long as we have a window (and aren't paused), ask for a callback on the next vsync.
+        if (mHasWindow && !mSuspend.IsSuspended()) {
+            mFrameScheduler.RequestFrame();
+        }
+
+        // Block until something happens: an event, or the vsync callback (which the looper
+        // dispatches to OnVsync). Then handle whatever else is pending, without blocking.
+        int timeout = -1;
+        while ((ident = ALooper_pollOnce(timeout, NULL, &events, (void**) &source)) !=
+                ALOOPER_POLL_TIMEOUT && ident != ALOOPER_POLL_ERROR) {
+            timeout = 0;
 
             // process event
-            if (source != NULL) {
+            if (ident >= 0 && source != NULL) {
                 source->process(mApp, source);
             }
 
             // are we exiting?
             if (mApp->destroyRequested) {
+                mFrameScheduler.Stop();
+                mPerfHint.Shutdown();
                 return;
             }
         }
 
+        // let subsystems know about the lifecycle commands we just handled
+        mEvents.Drain<LifecycleEvent>();
+        LogEventDrops();
+
+        if (!mVsyncNs || mSuspend.IsSuspended()) {
+            // woken up by an event, not by vsync: no frame to draw yet. Or by a vsync that
+            // was requested before we were paused.
+            mVsyncNs = 0;
+            continue;
+        }
+
+        // simulation advances by the time between the vsyncs of consecutive frames
+        mDeltaT = mFrameTimeNs ? (float) ((mVsyncNs - mFrameTimeNs) / 1e9) : 0.0f;
+        if (mDeltaT > MAX_DELTA_T) {
+            mDeltaT = MAX_DELTA_T;
+        }
+        mFrameTimeNs = mVsyncNs;
+        mVsyncNs = 0;
+        AnalyticsLog::SetFrameTime(mFrameTimeNs);
+
+        // input is sampled right at the start of the frame
         this->process_input_events();
 
-//        if (IsAnimating()) {
-            DoFrame();
-//        }
+        DoFrame();
+
+        // send whatever the frame asked of the Java side, in one go
+        mJniBridge.Flush();
     }
 }
 
+void NativeEngine::OnVsync(int64_t frame_time_ns, void *data) {
+    NativeEngine *engine = (NativeEngine*) data;
+    engine->mVsyncNs = frame_time_ns;
+}
+
 JNIEnv* NativeEngine::GetJniEnv() {
     if (!mJniEnv) {
         LOGD("Attaching current thread to JNI.");
@@ -319,11 +500,64 @@ JNIEnv* NativeEngine::GetJniEnv() {
     return mJniEnv;
 }
 
+EngineEventBus* NativeEngine::GetEventBus() {
+    return &mEvents;
+}
+
+JniBridge* NativeEngine::GetJniBridge() {
+    return &mJniBridge;
+}
+
+PerformanceHint* NativeEngine::GetPerformanceHint() {
+    return &mPerfHint;
+}
+
+QualityController* NativeEngine::GetQualityController() {
+    return &mQuality;
+}
+
+MemoryReporter* NativeEngine::GetMemoryReporter() {
+    return &mMemory;
+}
+
+StatsStore* NativeEngine::GetStatsStore() {
+    // it's opened by the startup pipeline
+    if (!mStartup.Wait("stats_store")) {
+        LOGW("NativeEngine: run statistics unavailable.");
+    }
+    return &mStats;
+}
+
+const ObstaclePatternLibrary* NativeEngine::GetObstaclePatterns() {
+    // it's opened by the startup pipeline
+    mStartup.Wait("obstacle_patterns");
+    return &mPatterns;
+}
+
+void NativeEngine::OnQualityChanged(const QualitySettings& settings, int tier, void *data) {
+    NativeEngine *engine = (NativeEngine*) data;
+    LOGI("NativeEngine: quality tier %d (render scale %.2f, load %.2f, thermal %s)", tier,
+         settings.render_scale, engine->mQuality.GetLoad(),
+         ThermalStateName(engine->mPerfHint.GetThermalState()));
+
+    // Render scale: shrink the window's buffers and let the compositor scale them up. We pick
+    // the new surface size up in DoFrame, as with any other resize.
+    if (engine->mHasWindow && engine->mWindowWidth > 0) {
+        int32_t w = 0, h = 0;  // 0 means native size
+        if (settings.render_scale < 1.0f) {
+            w = (int32_t) (engine->mWindowWidth * settings.render_scale);
+            h = (int32_t) (engine->mWindowHeight * settings.render_scale);
+        }
+        ANativeWindow_setBuffersGeometry(engine->mApp->window, w, h, 0);
+    }
+}
+
 
 void NativeEngine::HandleCommand(int32_t cmd) {
     //SceneManager *mgr = SceneManager::GetInstance();
 
     VLOGD("NativeEngine: handling command %d.", cmd);
+    FlightRecorder::GetInstance()->RecordCommand(cmd);
     switch (cmd) {
         case APP_CMD_SAVE_STATE:
             // The system has asked us to save our current state.
@@ -331,12 +565,22 @@ void NativeEngine::HandleCommand(int32_t cmd) {
             mApp->savedState = malloc(sizeof(mState));
             *((NativeEngineSavedState*) mApp->savedState) = mState;
             mApp->savedStateSize = sizeof(mState);
+            // it may still be being opened in the background
+            mStartup.Wait("stats_store");
+            mStats.Sync();
+            // we may be killed without another word; don't lose the last partial block (the
+            // flush thread writes it, we only wait a little for it)
+            AnalyticsLog::GetInstance()->Sync();
             break;
         case APP_CMD_INIT_WINDOW:
             // We have a window!
             VLOGD("NativeEngine: APP_CMD_INIT_WINDOW");
             if (mApp->window != NULL) {
                 mHasWindow = true;
+                mWindowWidth = ANativeWindow_getWidth(mApp->window);
+                mWindowHeight = ANativeWindow_getHeight(mApp->window);
+                // the new window starts at full resolution; apply our render scale to it
+                OnQualityChanged(mQuality.GetSettings(), mQuality.GetTier(), this);
             }
             break;
         case APP_CMD_TERM_WINDOW:
@@ -355,19 +599,25 @@ void NativeEngine::HandleCommand(int32_t cmd) {
             break;
         case APP_CMD_PAUSE:
             VLOGD("NativeEngine: APP_CMD_PAUSE");
- //           mgr->OnPause();
+            Pause();
             break;
         case APP_CMD_RESUME:
             VLOGD("NativeEngine: APP_CMD_RESUME");
- //           mgr->OnResume();
+            Resume();
             break;
         case APP_CMD_STOP:
             VLOGD("NativeEngine: APP_CMD_STOP");
             mIsVisible = false;
+            StopProfiler();
+            // the system may kill us at any time now; that's not a crash
+            FlightRecorder::GetInstance()->SetCleanExit(true);
             break;
         case APP_CMD_START:
             VLOGD("NativeEngine: APP_CMD_START");
             mIsVisible = true;
+            // coming back from APP_CMD_STOP (the first time, the game loop started it already)
+            StartProfiler();
+            FlightRecorder::GetInstance()->SetCleanExit(false);
             break;
         case APP_CMD_WINDOW_RESIZED:
         case APP_CMD_CONFIG_CHANGED:
@@ -380,11 +630,13 @@ void NativeEngine::HandleCommand(int32_t cmd) {
             break;
         case APP_CMD_LOW_MEMORY:
             VLOGD("NativeEngine: APP_CMD_LOW_MEMORY");
+            mMemory.Sample(TimeNowNs(), true);
+            mMemory.LogBreakdown();
             // system told us we have low memory. So if we are not visible, let's
             // cooperate by deallocating all of our graphic resources.
             if (!mHasWindow) {
                 VLOGD("NativeEngine: trimming memory footprint (deleting GL objects).");
-                KillGLObjects();
+                TrimGLObjects();
             }
             break;
         default:
@@ -395,6 +647,8 @@ void NativeEngine::HandleCommand(int32_t cmd) {
     VLOGD("NativeEngine: STATUS: F%d, V%d, W%d, EGL: D %p, S %p, CTX %p, CFG %p",
         mHasFocus, mIsVisible, mHasWindow, mEglDisplay, mEglSurface, mEglContext,
         mEglConfig);
+
+    mEvents.Post(LifecycleEvent{ cmd });
 }
 
 
@@ -449,6 +703,19 @@ bool NativeEngine::InitSurface() {
         return false;
     }
 
+    // only repaint/swap what changed, if the device supports it
+    mDamage.Init(mEglDisplay, mEglSurface);
+
+    EGLint width = 0, height = 0;
+    eglQuerySurface(mEglDisplay, mEglSurface, EGL_WIDTH, &width);
+    eglQuerySurface(mEglDisplay, mEglSurface, EGL_HEIGHT, &height);
+    UpdateSurfaceMemory(width, height);
+
+    // find out when our frames reach the screen, if the device can tell us
+    mTimestamps = mEglTimestamps.Init(mEglDisplay, mEglSurface) ?
+            (FrameTimestampProvider*) &mEglTimestamps : &mSimTimestamps;
+    LOGD("NativeEngine: present timestamps: %s", mTimestamps->GetName());
+
     LOGD("NativeEngine: successfully initialized surface.");
     return true;
 }
@@ -479,6 +746,80 @@ bool NativeEngine::InitContext() {
     return true;
 }
 
+bool NativeEngine::BindContext() {
+    LOGD("NativeEngine: binding surface and context (display %p, surface %p, context %p)",
+         mEglDisplay, mEglSurface, mEglContext);
+
+    // bind them
+    if (EGL_FALSE == eglMakeCurrent(mEglDisplay, mEglSurface, mEglSurface, mEglContext)) {
+        EGLint err = eglGetError();
+        LOGE("NativeEngine: eglMakeCurrent failed, EGL error %d", err);
+        HandleEglError(err);
+        return false;
+    }
+
+    // configure our global OpenGL settings
+    ConfigureOpenGL();
+    return true;
+}
+
+bool NativeEngine::LoadAssetIndex() {
+    AAssetDir *dir = AAssetManager_openDir(mApp->activity->assetManager, "");
+    if (!dir) {
+        LOGE("NativeEngine: can't open assets directory.");
+        return false;
+    }
+
+    const char *name;
+    while ((name = AAssetDir_getNextFileName(dir)) != NULL) {
+        if (!mAssetIndex.Insert(HashName(name), name)) {
+            LOGE("NativeEngine: assets %s and %s have the same name hash.", name,
+                 mAssetIndex.Find(HashName(name))->c_str());
+        }
+    }
+    AAssetDir_close(dir);
+
+    LOGD("NativeEngine: asset index has %d entries.", mAssetIndex.GetCount());
+    return true;
+}
+
+bool NativeEngine::OpenObstaclePatterns() {
+    // a missing asset is found missing in the index, without going through the asset manager
+    const std::string *name = mAssetIndex.Find(HashName(OBSTACLE_PATTERNS_ASSET));
+    if (!name || *name != OBSTACLE_PATTERNS_ASSET) {
+        LOGW("NativeEngine: no obstacle patterns (%s).", OBSTACLE_PATTERNS_ASSET);
+        return true;
+    }
+    // AASSET_MODE_BUFFER maps uncompressed assets, so nothing is read or parsed here
+    mPatternsAsset = AAssetManager_open(mApp->activity->assetManager, name->c_str(),
+                                        AASSET_MODE_BUFFER);
+    if (!mPatternsAsset) {
+        LOGW("NativeEngine: no obstacle patterns (%s).", OBSTACLE_PATTERNS_ASSET);
+        return true;
+    }
+    if (!mPatterns.Open(AAsset_getBuffer(mPatternsAsset), AAsset_getLength(mPatternsAsset))) {
+        LOGE("NativeEngine: invalid obstacle patterns (%s).", OBSTACLE_PATTERNS_ASSET);
+        AAsset_close(mPatternsAsset);
+        mPatternsAsset = NULL;
+        return true;
+    }
+    LOGD("NativeEngine: %d obstacle patterns for %d levels.", mPatterns.GetPatternCount(),
+         mPatterns.GetLevelCount());
+    return true;
+}
+
+void NativeEngine::PresentFirstFrame() {
+    glClear(GL_COLOR_BUFFER_BIT);
+    if (EGL_FALSE == eglSwapBuffers(mEglDisplay, mEglSurface)) {
+        // reading the error clears it
+        EGLint err = eglGetError();
+        LOGW("NativeEngine: eglSwapBuffers failed, EGL error %d", err);
+        HandleEglError(err);
+        return;
+    }
+    mStartup.MarkFirstFrame();
+}
+
 void NativeEngine::ConfigureOpenGL() {
     glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
   //  glEnable(GL_DEPTH_TEST);
@@ -493,6 +834,14 @@ enum t_attrib_id {
     attrib_offset
 } t_attrib_id;
 
+// the triangles' vertex inputs (also the overdraw program's)
+static const ShaderInput TRIANGLE_ATTRIBS[] = {
+    SHADER_ATTRIBUTE("i_position", GL_FLOAT_VEC2, attrib_position),
+    SHADER_ATTRIBUTE("i_color", GL_FLOAT_VEC4, attrib_color),
+    SHADER_ATTRIBUTE("i_offset", GL_FLOAT_VEC2, attrib_offset),
+};
+#define TRIANGLE_ATTRIB_COUNT SHADER_INPUT_COUNT(TRIANGLE_ATTRIBS)
+
 void NativeEngine::load_vertex_shader ()
 {
     static const char* vertex_shader =
@@ -580,12 +929,14 @@ void NativeEngine::load_program ()
     glAttachShader(program, vs);
     glAttachShader(program, fs);
 
-    glBindAttribLocation(program, attrib_position, "i_position");
-    glBindAttribLocation(program, attrib_color, "i_color");
-    glBindAttribLocation(program, attrib_offset, "i_offset");
+    ProgramInterface::BindAttributes(program, TRIANGLE_ATTRIBS, TRIANGLE_ATTRIB_COUNT);
     glLinkProgram(program);
 
-    LOGD("opengl program linked\n");
+    if (!mProgramInterface.Build(program, TRIANGLE_ATTRIBS, TRIANGLE_ATTRIB_COUNT, nullptr, 0)) {
+        LOGE("NativeEngine: triangle program: %s", mProgramInterface.GetError().c_str());
+    } else {
+        LOGD("opengl program linked\n");
+    }
 
     glUseProgram(program);
 
@@ -610,7 +961,354 @@ void NativeEngine::setup_vertex_buffer ()
 
     LOGD("opengl vertex attribs ok\n");
 
-    glBufferData(GL_ARRAY_BUFFER, sizeof(g_vertex_buffer_data), g_vertex_buffer_data, GL_DYNAMIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, g_vertex_buffer_data.size() * sizeof(gl_vertex_t),
+                 g_vertex_buffer_data.data(), GL_DYNAMIC_DRAW);
+    mMemory.TrackGpu(GpuResource::Buffer, vbo, g_vertex_buffer_data.size() * sizeof(gl_vertex_t),
+                     "triangles");
+}
+
+void NativeEngine::RegisterCounters() {
+    // mapping a couple of pages is cheap enough to do before the first frame
+    std::string path = std::string(mApp->activity->internalDataPath) + "/" + COUNTERS_FILE_NAME;
+    if (!LiveCounters::GetInstance()->Open(path.c_str())) {
+        LOGW("NativeEngine: can't create counters page %s", path.c_str());
+    }
+
+    LiveCounters *lc = LiveCounters::GetInstance();
+    mCounters.frames = lc->Register("frames", LiveCounterKind::Counter);
+    mCounters.static_frames = lc->Register("static_frames", LiveCounterKind::Counter);
+    mCounters.frame_cpu_us = lc->Register("frame_cpu_us", LiveCounterKind::Gauge);
+    mCounters.swap_us = lc->Register("swap_us", LiveCounterKind::Counter);
+    mCounters.draw_calls = lc->Register("draw_calls", LiveCounterKind::Counter);
+    mCounters.allocations = lc->Register("allocations", LiveCounterKind::Counter);
+    mCounters.input_events = lc->Register("input_events", LiveCounterKind::Counter);
+    mCounters.overdraw_pct = lc->Register("overdraw_pct", LiveCounterKind::Gauge);
+}
+
+void NativeEngine::InitFlightRecorder() {
+    // Keep the previous session's recording if it was interrupted, and decode it in the
+    // background; the new recording starts now, so that startup is covered too.
+    std::string dir = mApp->activity->internalDataPath;
+    std::string path = dir + "/" + FLIGHT_RECORDER_FILE_NAME;
+    std::string prev = path + ".prev";
+    if (FlightRecorder::WasInterrupted(path.c_str()) && 0 == rename(path.c_str(), prev.c_str())) {
+        mStartup.Add("flight_recovery", StartupPipeline::Kind::Background, [dir, prev] {
+            std::string trace = dir + "/" + FLIGHT_TRACE_FILE_NAME;
+            int n = FlightRecorder::DecodeToJson(prev.c_str(), trace.c_str());
+            unlink(prev.c_str());
+            if (n < 0) {
+                LOGE("NativeEngine: can't decode the previous flight recording.");
+                return false;
+            }
+            LOGW("NativeEngine: the previous session ended abnormally; its last %d records "
+                 "are in %s", n, trace.c_str());
+            return true;
+        });
+    } else {
+        mStartup.Add("flight_recovery", StartupPipeline::Kind::Background, [] { return true; });
+    }
+
+    if (!FlightRecorder::GetInstance()->Open(path.c_str())) {
+        LOGW("NativeEngine: can't create flight recorder %s", path.c_str());
+    }
+}
+
+void NativeEngine::RecordFlightFrame(const FrameTiming& timing) {
+    FlightFrame frame;
+    frame.number = (uint32_t) timing.frame;
+    frame.cpu_us = (uint32_t) ((timing.swap_start_ns - timing.cpu_start_ns) / 1000);
+    frame.swap_us = timing.swap_end_ns > timing.swap_start_ns ?
+            (uint32_t) ((timing.swap_end_ns - timing.swap_start_ns) / 1000) : 0;
+    frame.draw_calls = (uint16_t) std::min(mDrawCalls, 0xffffu);
+    frame.input_events = (uint16_t) std::min(mFrameInputEvents, 0xffffu);
+    FlightRecorder::GetInstance()->RecordFrame(timing.cpu_start_ns, frame);
+    mFrameInputEvents = 0;
+}
+
+void NativeEngine::StartProfiler() {
+    char value[PROP_VALUE_MAX] = "";
+    __system_property_get(PROFILE_PROPERTY, value);
+    int rate = atoi(value);
+    SamplingProfiler *profiler = SamplingProfiler::GetInstance();
+    if (rate <= 0 || profiler->IsRunning()) {
+        return;
+    }
+
+    if (profiler->Start(rate)) {
+        LOGI("NativeEngine: profiling at %d Hz (%s).", rate, profiler->GetMode());
+    } else {
+        LOGE("NativeEngine: can't start the profiler.");
+    }
+}
+
+void NativeEngine::StopProfiler() {
+    SamplingProfiler *profiler = SamplingProfiler::GetInstance();
+    if (!profiler->IsRunning()) {
+        return;
+    }
+    std::string path = std::string(mApp->activity->internalDataPath) + "/" + PROFILE_FILE_NAME;
+    if (profiler->Stop(path.c_str())) {
+        LOGI("NativeEngine: profile (%llu samples, %u dropped) written to %s",
+             (unsigned long long) profiler->GetSampleCount(), profiler->GetDropped(),
+             path.c_str());
+    } else {
+        LOGE("NativeEngine: can't write profile to %s", path.c_str());
+    }
+}
+
+void NativeEngine::StartTrace() {
+    char value[PROP_VALUE_MAX] = "";
+    __system_property_get(TRACE_PROPERTY, value);
+    Trace *trace = Trace::GetInstance();
+    if (atoi(value) <= 0) {
+        // nobody would read the events: don't let them pile up
+        trace->SetEnabled(false);
+        trace->Clear();
+        return;
+    }
+    // the startup events are in startup_trace.json already
+    trace->Clear();
+    std::string path = std::string(mApp->activity->internalDataPath) + "/" + TRACE_FILE_NAME;
+    trace->StartStreaming(path.c_str());
+}
+
+void NativeEngine::InitMenu() {
+    // a bar of buttons along the bottom of the screen, under an empty spacer
+    mMenu.AddPanel(0, 1.0f, 0.78f, UiDirection::Column, 0.0f, 0.0f, 0);
+    mMenuPanel = mMenu.AddPanel(0, 0.9f, 0.16f, UiDirection::Row, 0.015f, 0.02f, 0x00000099);
+    mMenuAnimate = mMenu.AddButton(mMenuPanel, "Animate", 0.3f, 1.0f, 0x3a6ee8ff);
+    mMenuMore = mMenu.AddButton(mMenuPanel, "More", 0.3f, 1.0f, 0x34a853ff);
+    mMenuFewer = mMenu.AddButton(mMenuPanel, "Fewer", 0.3f, 1.0f, 0xea4335ff);
+    mMenu.SetAction(OnMenuAction, this);
+}
+
+void NativeEngine::UpdateMenu() {
+    // benchmarks measure the triangles alone. While the triangles stand still, the animate
+    // button pulses (and the menu is the only thing redrawn); otherwise frames are static
+    // as far as the menu is concerned.
+    mMenu.SetVisible(mMenuPanel, !mBench.IsActive());
+    mMenu.SetHighlight(mAnimate ? -1 : mMenuAnimate);
+    mMenu.Update(mDeltaT);
+
+    UiRect damage[UI_MAX_DAMAGE];
+    int count = mMenu.TakeDamage(damage);
+    for (int i = 0; i < count; i++) {
+        // whole pixels, rounded outwards
+        int x0 = (int) floorf(damage[i].x), y0 = (int) floorf(damage[i].y);
+        int x1 = (int) ceilf(damage[i].x + damage[i].w);
+        int y1 = (int) ceilf(damage[i].y + damage[i].h);
+        mDamage.AddDamage(DamageRect{ x0, y0, x1 - x0, y1 - y0 });
+    }
+}
+
+void NativeEngine::OnMenuTouch(const TouchScreenEvent& event) {
+    // touches are in window pixels, from the top; the menu is laid out on the surface (which
+    // may be smaller, see the render scale) from the bottom
+    float sx = mWindowWidth > 0 ? (float) mSurfWidth / mWindowWidth : 1.0f;
+    float sy = mWindowHeight > 0 ? (float) mSurfHeight / mWindowHeight : 1.0f;
+    UiPointer action = event.type == TouchScreenEvent::Type::Down ? UiPointer::Down :
+                       event.type == TouchScreenEvent::Type::Up ? UiPointer::Up : UiPointer::Move;
+    bool used = mMenu.OnPointer(action, event.id, event.pos.x * sx,
+                                mSurfHeight - event.pos.y * sy);
+
+    // a pointer belongs to whichever it went down on, until it's up: dragging from a button
+    // doesn't move the triangles, and dragging the triangles over a button doesn't stop
+    if (event.id >= 0 && event.id < 32) {
+        uint32_t bit = 1u << event.id;
+        if (action == UiPointer::Down) {
+            mMenuPointers = used ? mMenuPointers | bit : mMenuPointers & ~bit;
+        }
+        used = (mMenuPointers & bit) != 0;
+        if (action == UiPointer::Up) {
+            mMenuPointers &= ~bit;
+        }
+    }
+    if (!used) {
+        callback_touch_screen_event(event);
+    }
+}
+
+void NativeEngine::OnMenuAction(int widget, void *data) {
+    NativeEngine *engine = (NativeEngine*) data;
+    LOGD("NativeEngine: menu item %s", engine->mMenu.GetLabel(widget));
+    if (widget == engine->mMenuAnimate) {
+        engine->mAnimate = !engine->mAnimate;
+    } else if (widget == engine->mMenuMore) {
+        engine->SetTriangleCount(std::min(engine->mTriangleCount * 4, MENU_MAX_TRIANGLES));
+    } else if (widget == engine->mMenuFewer) {
+        engine->SetTriangleCount(std::max(engine->mTriangleCount / 4, 1));
+    }
+}
+
+void NativeEngine::InitSuspend() {
+    // in dependency order: frames log analytics events and are profiled, and everything is
+    // traced
+    mSuspend.Add("trace", [] {
+        // writes everything out too: a paused app can be killed
+        Trace::GetInstance()->Suspend();
+    }, [] {
+        Trace::GetInstance()->Resume();
+    });
+    mSuspend.Add("analytics", [this] {
+        mStartup.Wait("analytics");
+        // writes out the partial block too: a paused app can be killed
+        AnalyticsLog::GetInstance()->Suspend();
+    }, [] {
+        AnalyticsLog::GetInstance()->Resume();
+    });
+    mSuspend.Add("memory", [this] {
+        mMemory.Suspend();
+    }, [this] {
+        mMemory.Resume();
+    });
+    mSuspend.Add("profiler", [] {
+        SamplingProfiler::GetInstance()->Suspend();
+    }, [] {
+        SamplingProfiler::GetInstance()->Resume();
+    });
+    mSuspend.Add("frames", [this] {
+        // the game loop stops requesting vsync callbacks, and drops the one that may be
+        // pending
+        mVsyncNs = 0;
+    }, [this] {
+        // the simulation picks up where it left off: the first frame after resume has no
+        // time step, rather than one covering the pause
+        mFrameTimeNs = 0;
+        mDamage.Invalidate();
+    });
+}
+
+void NativeEngine::Pause() {
+    if (mSuspend.IsSuspended()) {
+        return;
+    }
+    mSuspend.Suspend();
+    mPausedAtNs = TimeNowNs();
+    LOGI("NativeEngine: paused (suspend took %.2f ms).", NsToMs(mSuspend.GetSuspendNs()));
+}
+
+void NativeEngine::Resume() {
+    if (!mSuspend.IsSuspended()) {
+        return;
+    }
+    mSuspend.Resume();
+    double cpu_ms = NsToMs(mSuspend.GetSuspendedCpuNs());
+    LOGI("NativeEngine: resumed after %.0f ms paused (resume took %.2f ms, %.2f ms CPU used "
+         "while paused).", NsToMs(TimeNowNs() - mPausedAtNs), NsToMs(mSuspend.GetResumeNs()),
+         cpu_ms);
+    if (cpu_ms > SUSPENDED_CPU_BUDGET_MS) {
+        LOGW("NativeEngine: %.2f ms CPU used while paused (budget %.2f ms): something wasn't "
+             "suspended.", cpu_ms, SUSPENDED_CPU_BUDGET_MS);
+    }
+}
+
+void NativeEngine::InitOverdraw() {
+    char value[PROP_VALUE_MAX] = "";
+    __system_property_get(OVERDRAW_PROPERTY, value);
+    if (atoi(value) <= 0) {
+        return;
+    }
+
+    std::string path = std::string(mApp->activity->internalDataPath) + "/" + OVERDRAW_FILE_NAME;
+    if (!mOverdraw.Init(path.c_str())) {
+        LOGE("NativeEngine: can't start overdraw mode: %s", mOverdraw.GetError().c_str());
+        return;
+    }
+
+    overdraw_program = glCreateProgram();
+    glAttachShader(overdraw_program, vs);
+    glAttachShader(overdraw_program, mOverdraw.GetCountingShader());
+    ProgramInterface::BindAttributes(overdraw_program, TRIANGLE_ATTRIBS, TRIANGLE_ATTRIB_COUNT);
+    glLinkProgram(overdraw_program);
+    GLint status = GL_FALSE;
+    glGetProgramiv(overdraw_program, GL_LINK_STATUS, &status);
+    if (status == GL_FALSE) {
+        char log[512] = "";
+        glGetProgramInfoLog(overdraw_program, sizeof(log), NULL, log);
+        LOGE("NativeEngine: overdraw program link failed: %s", log);
+    } else if (!mOverdrawInterface.Build(overdraw_program, TRIANGLE_ATTRIBS,
+                                         TRIANGLE_ATTRIB_COUNT, nullptr, 0)) {
+        LOGE("NativeEngine: overdraw program: %s", mOverdrawInterface.GetError().c_str());
+        status = GL_FALSE;
+    }
+    if (status == GL_FALSE) {
+        // the frames would be drawn with a broken program: no overdraw mode
+        glDeleteProgram(overdraw_program);
+        overdraw_program = 0;
+        mOverdrawInterface.Clear();
+        mOverdraw.Shutdown();
+        return;
+    }
+
+    LOGI("NativeEngine: overdraw mode, reports go to %s", path.c_str());
+}
+
+void NativeEngine::SetTriangleCount(int count) {
+    static const gl_vertex_t base[3] = {
+        { 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, -0.5f, 0.0f, 0.0f },
+        { 0.0f, 1.0f, 0.0f, 0.0f, -0.5f, 0.5f, 0.0f, 0.0f },
+        { 0.0f, 0.0f, 1.0f, 0.0f, 0.5f, 0.5f, 0.0f, 0.0f },
+    };
+
+    // one triangle per cell of a grid covering the screen (a single one is centered)
+    int grid = (int) ceilf(sqrtf((float) count));
+    mTriangleCount = count;
+    g_vertex_buffer_data.resize(count * 3);
+    for (int t = 0; t < count; t++) {
+        float ox = -1.0f + (2.0f * (t % grid) + 1.0f) / grid;
+        float oy = -1.0f + (2.0f * (t / grid) + 1.0f) / grid;
+        for (int i = 0; i < 3; i++) {
+            gl_vertex_t *v = &g_vertex_buffer_data[t * 3 + i];
+            *v = base[i];
+            v->offset_x = ox;
+            v->offset_y = oy;
+        }
+    }
+    mDamage.Invalidate();
+}
+
+void NativeEngine::StartBenchmarkScenario() {
+    const BenchScenario *s = mBench.GetScenario();
+    LOGI("NativeEngine: benchmark scenario %s (%d triangles, %s), %d x %d frames.", s->name,
+         s->triangles, s->animate ? "animated" : "static", s->repetitions, s->frames);
+    SetTriangleCount(s->triangles);
+    mAnimate = s->animate;
+}
+
+void NativeEngine::PollGpuTimer() {
+    uint32_t tag;
+    float gpu_ms;
+    while (mGpuTimer.Poll(&tag, &gpu_ms)) {
+        if (mBench.IsActive()) {
+            mBench.SetGpuTime(tag, gpu_ms);
+        } else {
+            mGpuMs = gpu_ms;
+        }
+    }
+}
+
+void NativeEngine::EndBenchmarkFrame(const FrameTiming& timing, bool drawn,
+                                     uint64_t gl_work_ns) {
+    if (!mBench.IsActive()) {
+        return;
+    }
+
+    BenchFrame frame;
+    // the same work as reported to the performance hint session, GL work queue included
+    frame.cpu_ms = (float) NsToMs(timing.swap_start_ns - timing.cpu_start_ns + gl_work_ns);
+    frame.swap_ms = drawn ? (float) NsToMs(timing.swap_end_ns - timing.swap_start_ns) : 0.0f;
+    // static frames don't give the GPU anything to do
+    frame.gpu_ms = drawn ? -1.0f : 0.0f;
+    frame.allocs = (uint32_t) (GetAllocationCount() - mFrameAllocs);
+    frame.draw_calls = mDrawCalls;
+    mBench.AddFrame(frame);
+
+    if (mBench.IsFinished()) {
+        LOGI("NativeEngine: benchmark finished, %s.", mBench.Passed() ? "passed" :
+             "FAILED (thresholds exceeded)");
+        mAnimate = true;
+        GameActivity_finish(mApp->activity);
+    }
 }
 
 bool NativeEngine::PrepareToRender() {
@@ -619,6 +1317,19 @@ bool NativeEngine::PrepareToRender() {
         if (mEglDisplay == EGL_NO_DISPLAY || mEglSurface == EGL_NO_SURFACE ||
             mEglContext == EGL_NO_CONTEXT) {
 
+            if (!mStartup.HasPresentedFirstFrame()) {
+                // first time around: go through the startup pipeline (the display is
+                // being initialized in the background)
+                if (!mStartup.RunCritical()) {
+                    LOGE("NativeEngine: startup failed to create surface/context.");
+                    return false;
+                }
+
+                // get something on screen as early as possible
+                PresentFirstFrame();
+                return false;
+            }
+
             // create display if needed
             if (!InitDisplay()) {
                 LOGE("NativeEngine: failed to create display.");
@@ -637,33 +1348,27 @@ bool NativeEngine::PrepareToRender() {
                 return false;
             }
 
-            LOGD("NativeEngine: binding surface and context (display %p, surface %p, context %p)",
-                 mEglDisplay, mEglSurface, mEglContext);
-
-            // bind them
-            if (EGL_FALSE == eglMakeCurrent(mEglDisplay, mEglSurface, mEglSurface, mEglContext)) {
-                LOGE("NativeEngine: eglMakeCurrent failed, EGL error %d", eglGetError());
-                HandleEglError(eglGetError());
+            if (!BindContext()) {
+                return false;
             }
-
-            // configure our global OpenGL settings
-            ConfigureOpenGL();
-
-            load_vertex_shader();
-            load_frag_shader();
-            load_program();
-            setup_vertex_buffer();
         }
 
         // now that we're sure we have a context and all, if we don't have the OpenGL 
         // objects ready, create them.
-/*        if (!mHasGLObjects) {
+        if (!mHasGLObjects) {
             LOGD("NativeEngine: creating OpenGL objects.");
-            if (!InitGLObjects()) {
+            if (!mStartup.HasRunDeferred()) {
+                // deferred startup stages (these include the GL objects); startup is over
+                // once they've put the scene on the screen (see DoFrame())
+                if (!mStartup.RunDeferred()) {
+                    LOGE("NativeEngine: unable to run deferred startup stages.");
+                    return false;
+                }
+            } else if (!InitGLObjects()) {
                 LOGE("NativeEngine: unable to initialize OpenGL objects.");
                 return false;
             }
-        } */
+        }
     } while (0);
 
     // ready to render
@@ -674,22 +1379,88 @@ void NativeEngine::KillGLObjects() {
     if (mHasGLObjects) {
 //        SceneManager *mgr = SceneManager::GetInstance();
 //        mgr->KillGraphics();
+        // the GL work that creates these may not all have run yet (see InitGLObjects())
+        if (vbo) {
+            mMemory.UntrackGpu(GpuResource::Buffer, vbo);
+            glDeleteBuffers(1, &vbo);
+            vbo = 0;
+        }
+        if (vao) {
+            glDeleteVertexArrays(1, &vao);
+            vao = 0;
+        }
+        if (program) {
+            glDeleteProgram(program);
+            program = 0;
+        }
+        mProgramInterface.Clear();
+        if (vs) {
+            glDeleteShader(vs);
+            vs = 0;
+        }
+        if (fs) {
+            glDeleteShader(fs);
+            fs = 0;
+        }
+        mGpuTimer.Shutdown();
+        if (overdraw_program) {
+            glDeleteProgram(overdraw_program);
+            overdraw_program = 0;
+            mOverdrawInterface.Clear();
+        }
+        mOverdraw.Shutdown();
+        mQuads.Shutdown();
+        mGlWork.Clear();
+        vs_loaded = fs_loaded = false;
         mHasGLObjects = false;
+        mSceneReady = false;
     }
 }
 
+void NativeEngine::TrimGLObjects() {
+    if (!mHasGLObjects || mEglContext == EGL_NO_CONTEXT) {
+        return;
+    }
+    // KillSurface() left no context current, and GL calls without one do nothing: make ours
+    // current without a surface
+    if (eglMakeCurrent(mEglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, mEglContext)) {
+        KillGLObjects();
+        eglMakeCurrent(mEglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    } else {
+        // no EGL_KHR_surfaceless_context: the objects go away with the context, which
+        // PrepareToRender() creates again
+        LOGD("NativeEngine: can't make the context current without a surface (EGL error "
+             "%d); killing it.", eglGetError());
+        KillContext();
+    }
+}
+
+void NativeEngine::UpdateSurfaceMemory(int width, int height) {
+    EGLint color_bits = 0, depth_bits = 0;
+    if (width > 0 && height > 0) {
+        eglGetConfigAttrib(mEglDisplay, mEglConfig, EGL_BUFFER_SIZE, &color_bits);
+        eglGetConfigAttrib(mEglDisplay, mEglConfig, EGL_DEPTH_SIZE, &depth_bits);
+    }
+    // 24-bit color is stored as RGBX
+    mMemory.SetSurface(width, height, color_bits > 16 ? 4 : color_bits / 8, (depth_bits + 7) / 8);
+}
+
 void NativeEngine::KillSurface() {
     LOGD("NativeEngine: killing surface.");
+    // the display may still be being initialized by the startup pipeline
+    mStartup.Wait("egl_display");
     eglMakeCurrent(mEglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
     if (mEglSurface != EGL_NO_SURFACE) {
         eglDestroySurface(mEglDisplay, mEglSurface);
         mEglSurface = EGL_NO_SURFACE;
     }
+    UpdateSurfaceMemory(0, 0);
     LOGD("NativeEngine: Surface killed successfully.");
 }
 
 void NativeEngine::KillContext() {
     LOGD("NativeEngine: killing context.");
+    mStartup.Wait("egl_display");
 
     // since the context is going away, we have to kill the GL objects
     KillGLObjects();
@@ -779,6 +1550,22 @@ void NativeEngine::DoFrame() {
         return;
     }
 
+    // subsystems only see budget changes between frames
+    mQuality.ApplyPending();
+
+    if (mBench.ScenarioChanged()) {
+        StartBenchmarkScenario();
+    }
+    mDrawCalls = 0;
+    mFrameAllocs = GetAllocationCount();
+
+    FrameTiming timing;
+    memset(&timing, 0, sizeof(timing));
+    timing.frame = nn;
+    timing.vsync_ns = mFrameTimeNs;
+    timing.input_ns = mFrameInputNs;
+    timing.cpu_start_ns = TimeNowNs();
+
     //    SceneManager *mgr = SceneManager::GetInstance();
 
         // how big is the surface? We query every frame because it's cheap, and some
@@ -795,6 +1582,9 @@ void NativeEngine::DoFrame() {
         mSurfHeight = height;
         //        mgr->SetScreenSize(mSurfWidth, mSurfHeight);
         glViewport(0, 0, mSurfWidth, mSurfHeight);
+        mDamage.SetSurfaceSize(mSurfWidth, mSurfHeight);
+        mMenu.SetSurfaceSize(mSurfWidth, mSurfHeight);
+        UpdateSurfaceMemory(mSurfWidth, mSurfHeight);
 
         return;
     }
@@ -808,28 +1598,110 @@ void NativeEngine::DoFrame() {
     // render!
 //    mgr->DoFrame();
 
- //   glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-    //glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    glClear(GL_COLOR_BUFFER_BIT);
-
     {
         static float rotate_by = 0.0f;
 
-        rotate_by = fmod(rotate_by + 3.1415f / 100.0f, 2.0f*3.1415f);
+        // half a turn per second or so, independent of the display's refresh rate
+        if (mAnimate) {
+            rotate_by = fmod(rotate_by + 3.1415f * 0.6f * mDeltaT, 2.0f*3.1415f);
+        }
         float s = sin(rotate_by);
         float c = cos(rotate_by);
 
+        // the same rotated triangle, scaled down to fit its grid cell
+        float scale = 1.0f / ceilf(sqrtf((float) mTriangleCount));
+        float x[3], y[3];
         for (int i = 0; i < 3; i++) {
-            g_vertex_buffer_data[i].x = orig_x[i] * c - orig_y[i] * s;
-            g_vertex_buffer_data[i].y = orig_x[i] * s + orig_y[i] * c;
+            x[i] = (orig_x[i] * c - orig_y[i] * s) * scale;
+            y[i] = (orig_x[i] * s + orig_y[i] * c) * scale;
         }
+
+        float bounds[4] = { 1e9f, 1e9f, -1e9f, -1e9f };
+        for (int t = 0; t < mTriangleCount; t++) {
+            gl_vertex_t *v = &g_vertex_buffer_data[t * 3];
+            for (int i = 0; i < 3; i++) {
+                v[i].x = x[i];
+                v[i].y = y[i];
+                bounds[0] = std::min(bounds[0], v[i].offset_x + x[i]);
+                bounds[1] = std::min(bounds[1], v[i].offset_y + y[i]);
+                bounds[2] = std::max(bounds[2], v[i].offset_x + x[i]);
+                bounds[3] = std::max(bounds[3], v[i].offset_y + y[i]);
+            }
+        }
+
+        // if the triangle moved, both where it was and where it is now need repainting
+        if (memcmp(bounds, mTriBounds, sizeof(bounds)) != 0) {
+            mDamage.AddDamageNdc(mTriBounds[0], mTriBounds[1], mTriBounds[2], mTriBounds[3]);
+            mDamage.AddDamageNdc(bounds[0], bounds[1], bounds[2], bounds[3]);
+            memcpy(mTriBounds, bounds, sizeof(bounds));
+        }
+    }
+
+    UpdateMenu();
+
+    // overdraw is measured over whole frames
+    if (mOverdraw.IsActive()) {
+        mDamage.Invalidate();
+    }
+
+    // restricts drawing to the damaged region (nothing at all if the frame is static)
+    DamageRect repaint;
+    if (!mDamage.BeginFrame(&repaint)) {
+        timing.swap_start_ns = timing.swap_end_ns = TimeNowNs();
+        mCounters.static_frames->Add();
+        mCounters.allocations->Set((int64_t) GetAllocationCount());
+        PollGpuTimer();
+        EndBenchmarkFrame(timing, false, RunGlWork(timing));
+        RecordFlightFrame(timing);
+        return;
     }
 
-  //  glBindVertexArray( vao );
+    // frames that aren't recorded (warm-up, drain) mustn't pass for recorded ones
+    mGpuTimer.Begin(mBench.IsRecording() ? mBench.GetNextTag() : BENCH_NO_TAG);
 
-    glBufferData(GL_ARRAY_BUFFER, sizeof(g_vertex_buffer_data), g_vertex_buffer_data, GL_DYNAMIC_DRAW);
+ //   glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    //glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glClear(GL_COLOR_BUFFER_BIT);
 
-    glDrawArrays(GL_TRIANGLES, 0, 3);
+    // in overdraw mode, passes draw into the meter's count target instead
+    bool overdraw = mOverdraw.BeginFrame(mSurfWidth, mSurfHeight, nn);
+
+    // the triangles' program and buffers may still be queued up in mGlWork
+    if (mSceneReady) {
+        // the quad batcher binds its own
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+
+        glBufferData(GL_ARRAY_BUFFER, g_vertex_buffer_data.size() * sizeof(gl_vertex_t),
+                     g_vertex_buffer_data.data(), GL_DYNAMIC_DRAW);
+        mMemory.TrackGpu(GpuResource::Buffer, vbo,
+                         g_vertex_buffer_data.size() * sizeof(gl_vertex_t), "triangles");
+
+        mOverdraw.BeginPass("triangles");
+        glUseProgram(overdraw ? overdraw_program : program);
+        glDrawArrays(GL_TRIANGLES, 0, mTriangleCount * 3);
+        mDrawCalls++;
+        mOverdraw.EndPass();
+    }
+
+    mOverdraw.BeginPass("menu");
+    mQuads.Begin(mSurfWidth, mSurfHeight);
+    mMenu.Draw(&mQuads);
+    mDrawCalls += mQuads.End(overdraw);
+    mOverdraw.EndPass();
+
+    if (overdraw) {
+        mOverdraw.EndFrame();
+        OverdrawReport report;
+        if (mOverdraw.Poll(&report)) {
+            uint64_t now = TimeNowNs();
+            Trace::GetInstance()->Counter("overdraw", now, report.GetOverdraw());
+            Trace::GetInstance()->Counter("fill", now, report.GetFill());
+            mCounters.overdraw_pct->Set((int64_t) (report.GetOverdraw() * 100.0f));
+        }
+    }
+
+    mGpuTimer.End();
 
     if ((nn % 50) == 0) {
         //LOGD("render frame %u\n", nn);
@@ -839,16 +1711,65 @@ void NativeEngine::DoFrame() {
     //LOGD("vs_loaded=%i   fs_loaded=%i\n", vs_loaded, fs_loaded);
 
     // swap buffers
-    if (EGL_FALSE == eglSwapBuffers(mEglDisplay, mEglSurface)) {
+    mTimestamps->BeforeSwap();
+    timing.swap_start_ns = TimeNowNs();
+    if (EGL_FALSE == mDamage.Swap()) {
         // failed to swap buffers... 
-        LOGW("NativeEngine: eglSwapBuffers failed, EGL error %d", eglGetError());
-        HandleEglError(eglGetError());
+        EGLint err = eglGetError();
+        LOGW("NativeEngine: eglSwapBuffers failed, EGL error %d", err);
+        HandleEglError(err);
+    } else {
+        timing.swap_end_ns = TimeNowNs();
+        mSimTimestamps.SetVsyncPeriod(mFrameScheduler.GetVsyncPeriodNs());
+        mTimestamps->AfterSwap(timing);
+        mFrameInputNs = 0;
+
+        // the first frame was only cleared; this is the first one with the triangles
+        if (mSceneReady && !mStartup.HasPresentedContent()) {
+            mStartup.MarkFirstContent();
+            std::string trace_path = std::string(mApp->activity->internalDataPath) +
+                    "/startup_trace.json";
+            mStartup.Finish(trace_path.c_str());
+            StartTrace();
+        }
+    }
+    mTimestamps->Collect(&mFrameStats);
+
+    uint64_t gl_work_ns = RunGlWork(timing);
+
+    // our work (not counting the time blocked in swap) vs. the frame budget
+    mPerfHint.UpdateTarget(mFrameScheduler.GetVsyncPeriodNs());
+    mPerfHint.ReportWork(timing.swap_start_ns - timing.cpu_start_ns + gl_work_ns);
+    mPerfHint.Poll(TimeNowNs());
+    mMemory.Sample(TimeNowNs());
+
+    mCounters.frames->Add();
+    mCounters.frame_cpu_us->Set((int64_t) (timing.swap_start_ns - timing.cpu_start_ns) / 1000);
+    if (timing.swap_end_ns) {
+        mCounters.swap_us->Add((int64_t) (timing.swap_end_ns - timing.swap_start_ns) / 1000);
+    }
+    mCounters.draw_calls->Add(mDrawCalls);
+    mCounters.allocations->Set((int64_t) GetAllocationCount());
+
+    PollGpuTimer();
+
+    // benchmarks run at a fixed quality, so that runs can be compared
+    if (!mBench.IsActive()) {
+        mQuality.Update((float) NsToMs(timing.swap_start_ns - timing.cpu_start_ns), mGpuMs,
+                        (float) NsToMs(mFrameScheduler.GetVsyncPeriodNs()),
+                        mPerfHint.GetThermalState());
     }
 
+    EndBenchmarkFrame(timing, true, gl_work_ns);
+
     // print out GL errors, if any
     GLenum e;
     static int errorsPrinted = 0;
+    int errorsRecorded = 0;
     while ((e = glGetError()) != GL_NO_ERROR) {
+        if (errorsRecorded++ < FLIGHT_MAX_GL_ERRORS) {
+            FlightRecorder::GetInstance()->RecordGlError(e);
+        }
         if (errorsPrinted < MAX_GL_ERRORS) {
             _log_opengl_error(e);
             ++errorsPrinted;
@@ -857,6 +1778,8 @@ void NativeEngine::DoFrame() {
             }
         }
     }
+
+    RecordFlightFrame(timing);
 }
 
 android_app* NativeEngine::GetAndroidApp() {
@@ -867,8 +1790,65 @@ bool NativeEngine::InitGLObjects() {
     if (!mHasGLObjects) {
 //        SceneManager *mgr = SceneManager::GetInstance();
 //        mgr->StartGraphics();
-        _log_opengl_error(glGetError());
+        // Created over the next frames, in their spare time (see RunGlWork()) rather than all
+        // at once: the scene first, then the menu (the overdraw meter's counting shader goes
+        // into the quad batcher's program, so it comes before).
+        uint64_t now = TimeNowNs();
+        uint64_t scene = now + (uint64_t) GL_WORK_SCENE_DEADLINE_MS * 1000000;
+        uint64_t ui = now + (uint64_t) GL_WORK_UI_DEADLINE_MS * 1000000;
+        mGlWork.Post("vertex_shader", WorkPriority::High, scene, [this] {
+            load_vertex_shader();
+            return true;
+        });
+        mGlWork.Post("fragment_shader", WorkPriority::High, scene, [this] {
+            load_frag_shader();
+            return true;
+        });
+        mGlWork.Post("program", WorkPriority::High, scene, [this] {
+            load_program();
+            return true;
+        });
+        mGlWork.Post("vertex_buffer", WorkPriority::High, scene, [this] {
+            setup_vertex_buffer();
+            mSceneReady = true;
+            mDamage.Invalidate();
+            return true;
+        });
+        mGlWork.Post("overdraw", WorkPriority::Normal, ui, [this] {
+            InitOverdraw();
+            return true;
+        });
+        mGlWork.Post("quads", WorkPriority::Normal, ui, [this] {
+            if (!mQuads.Init(mOverdraw.IsActive() ? mOverdraw.GetCountingShader() : 0)) {
+                LOGE("NativeEngine: can't init quad batcher: %s", mQuads.GetError().c_str());
+            }
+            mDamage.Invalidate();
+            return true;
+        });
+        mGlWork.Post("gpu_timer", WorkPriority::Normal, ui, [this] {
+            mGpuTimer.Init();
+            mGpuMs = -1.0f;
+            return true;
+        });
         mHasGLObjects = true;
     }
     return true;
 }
+
+uint64_t NativeEngine::RunGlWork(const FrameTiming& timing) {
+    if (mGlWork.IsEmpty()) {
+        return 0;
+    }
+    // what's left of the target after the frame's own work, swap included
+    uint64_t period = mFrameScheduler.GetVsyncPeriodNs();
+    uint64_t target = (uint64_t) (period * GL_WORK_TARGET_FRACTION);
+    uint64_t limit = period - (uint64_t) (GL_WORK_MARGIN_MS * 1000000);
+    uint64_t start = TimeNowNs();
+    uint64_t elapsed = start - timing.cpu_start_ns;
+    uint64_t used = mGlWork.Run(target > elapsed ? target - elapsed : 0,
+                                limit > elapsed ? limit - elapsed : 0);
+    if (used) {
+        Trace::GetInstance()->Complete("gl_work", start, used);
+    }
+    return used;
+}
@@ -17,8 +17,32 @@
 #define endlesstunnel_native_engine_hpp
 
 #include <list>
+#include <string>
 #include <utility>
+#include <vector>
 #include "common.hpp"
+#include "benchmark.hpp"
+#include "damage.hpp"
+#include "event_bus.hpp"
+#include "frame_scheduler.hpp"
+#include "frame_stats.hpp"
+#include "frame_timestamps.hpp"
+#include "frame_work.hpp"
+#include "gpu_timer.hpp"
+#include "jni_bridge.hpp"
+#include "jni_request_sink.hpp"
+#include "live_counters.hpp"
+#include "memory_report.hpp"
+#include "obstacle_patterns.hpp"
+#include "overdraw.hpp"
+#include "perf_hint.hpp"
+#include "program_interface.hpp"
+#include "quad_batch.hpp"
+#include "quality.hpp"
+#include "stats_store.hpp"
+#include "startup.hpp"
+#include "suspend.hpp"
+#include "ui.hpp"
 
 struct NativeEngineSavedState {};
 
@@ -55,6 +79,19 @@ struct TouchScreenEvent {
     uint32_t pointer_index;
 };
 
+// an Android lifecycle command (APP_CMD_*), after the engine has handled it
+struct LifecycleEvent {
+    int32_t cmd;
+};
+
+// Engine events: at most 8 subscribers per type, and 128 events of each type queued per frame:
+// one touch event per pointer of each motion event the input buffer holds (16 of them, of up
+// to GAMEACTIVITY_MAX_NUM_POINTERS_IN_MOTION_EVENT pointers). Touch events are dispatched at the
+// end of input processing (their motion_event pointer is only valid until then), or earlier if
+// the queue fills up anyway; lifecycle events once the looper has no more events pending.
+#define ENGINE_EVENT_QUEUE_SIZE 128
+typedef EventBus<8, ENGINE_EVENT_QUEUE_SIZE, TouchScreenEvent, LifecycleEvent> EngineEventBus;
+
 class NativeEngine {
     public:
         // create an engine
@@ -67,6 +104,27 @@ class NativeEngine {
         // returns the JNI environment
         JNIEnv *GetJniEnv();
 
+        // returns the bus engine events are dispatched through
+        EngineEventBus *GetEventBus();
+
+        // returns the bridge used to post (batched) requests to the Java side
+        JniBridge *GetJniBridge();
+
+        // returns the performance hint session (which also tracks the thermal state)
+        PerformanceHint *GetPerformanceHint();
+
+        // returns the quality controller, which subsystems subscribe to for their budgets
+        QualityController *GetQualityController();
+
+        // returns the memory reporter (footprint samples, GPU resource tracking)
+        MemoryReporter *GetMemoryReporter();
+
+        // returns the persistent run statistics (high scores, etc)
+        StatsStore *GetStatsStore();
+
+        // returns the obstacle pattern library (not open if the asset is missing)
+        const ObstaclePatternLibrary *GetObstaclePatterns();
+
         // returns the Android app object
         android_app* GetAndroidApp();
 
@@ -84,14 +142,38 @@ class NativeEngine {
     private:
         bool ogl_loaded, vs_loaded, fs_loaded;
         GLuint vs, fs, program;
+        ProgramInterface mProgramInterface;
         GLuint vao, vbo;
-        gl_vertex_t g_vertex_buffer_data[3];
+        std::vector<gl_vertex_t> g_vertex_buffer_data;
+
+        // the menu, drawn over the triangles in one batch (hidden in benchmark mode)
+        QuadBatcher mQuads;
+        UiTree mMenu;
+        int mMenuPanel, mMenuAnimate, mMenuMore, mMenuFewer;
+        void InitMenu();
+        void UpdateMenu();
+        // touches go to the menu first; the scene gets those the menu doesn't use
+        void OnMenuTouch(const TouchScreenEvent& event);
+        uint32_t mMenuPointers;  // bit i: pointer id i went down on a button
+        static void OnMenuAction(int widget, void *data);
+
+        // overdraw mode: the triangles' vertex shader with the meter's counting shader
+        OverdrawMeter mOverdraw;
+        GLuint overdraw_program;
+        ProgramInterface mOverdrawInterface;
+        void InitOverdraw();
 
         // variables to track Android lifecycle:
         bool mHasFocus, mIsVisible, mHasWindow;
 
-        // are our OpenGL objects (textures, etc) currently loaded?
+        // are our OpenGL objects (textures, etc) currently loaded? (or queued up to be, in
+        // mGlWork; mSceneReady once the triangles can be drawn)
         bool mHasGLObjects;
+        bool mSceneReady;
+
+        // GL work spread over the frames' spare time, run after each frame's swap
+        FrameWorkQueue mGlWork;
+        uint64_t RunGlWork(const FrameTiming& timing);
 
         // android API version (0 if not yet queried)
         int mApiVersion;
@@ -110,6 +192,37 @@ class NativeEngine {
         // known surface size
         int mSurfWidth, mSurfHeight;
 
+        // tells the memory reporter how big the window surface is
+        void UpdateSurfaceMemory(int width, int height);
+
+        // which parts of the surface need repainting; static frames aren't drawn at all
+        DamageTracker mDamage;
+
+        // bounding box (NDC) of the triangles, as drawn in the previous frame
+        float mTriBounds[4];
+
+        // the triangle is drawn this many times, scaled down on a grid (for benchmarking)
+        int mTriangleCount;
+        void SetTriangleCount(int count);
+
+        // do the triangles rotate? If not, frames are static and nothing gets redrawn.
+        bool mAnimate;
+
+        // glDraw* calls issued in the current frame
+        uint32_t mDrawCalls;
+
+        // GPU time of the drawn frames, a few frames late. Goes to the benchmark while one is
+        // running; otherwise the latest is kept for the quality controller (-1 if unknown)
+        GpuTimer mGpuTimer;
+        float mGpuMs;
+        void PollGpuTimer();
+
+        // benchmark mode: runs the scenarios requested by the activity, then finishes it
+        BenchmarkRunner mBench;
+        uint64_t mFrameAllocs;
+        void StartBenchmarkScenario();
+        void EndBenchmarkFrame(const FrameTiming& timing, bool drawn, uint64_t gl_work_ns);
+
         // android_app structure
         struct android_app* mApp;
 
@@ -119,9 +232,82 @@ class NativeEngine {
         // JNI environment
         JNIEnv *mJniEnv;
 
+        // outgoing Java requests, flushed once per frame
+        JniRequestSink mJniSink;
+        JniBridge mJniBridge;
+
         // is this the first frame we're drawing?
         bool mIsFirstFrame;
 
+        // Subsystems parked on APP_CMD_PAUSE, resumed on APP_CMD_RESUME. While paused, no
+        // frames are requested and the simulation clock stands still.
+        SuspendCoordinator mSuspend;
+        uint64_t mPausedAtNs;
+        void InitSuspend();
+        void Pause();
+        void Resume();
+
+        // frames are started from vsync. mVsyncNs is the timestamp of the vsync we were
+        // woken up for (0 if none yet), mFrameTimeNs the one of the frame being drawn.
+        FrameScheduler mFrameScheduler;
+        int64_t mVsyncNs;
+        int64_t mFrameTimeNs;
+        static void OnVsync(int64_t frame_time_ns, void *data);
+
+        // simulation time step for the current frame, in seconds
+        float mDeltaT;
+
+        // timestamp of the oldest input event handled in this frame (0 if none), and how many
+        int64_t mFrameInputNs;
+        uint32_t mFrameInputEvents;
+
+        // per-frame timings, including when frames reached the display (from EGL if the
+        // device supports it, estimated otherwise)
+        FrameStats mFrameStats;
+        EglFrameTimestamps mEglTimestamps;
+        SimulatedFrameTimestamps mSimTimestamps;
+        FrameTimestampProvider *mTimestamps;
+
+        // tells the platform how long our frames take vs. the vsync period, watches thermals
+        PerformanceHint mPerfHint;
+
+        // scales workload budgets (including our render resolution) to load and thermals
+        QualityController mQuality;
+        static void OnQualityChanged(const QualitySettings& settings, int tier, void *data);
+
+        // live counters, for external viewers
+        struct {
+            LiveCounter *frames;
+            LiveCounter *static_frames;  // nothing changed, so nothing was drawn
+            LiveCounter *frame_cpu_us;   // last frame
+            LiveCounter *swap_us;
+            LiveCounter *draw_calls;
+            LiveCounter *allocations;
+            LiveCounter *input_events;
+            LiveCounter *overdraw_pct;   // fragments per pixel drawn x 100 (overdraw mode)
+        } mCounters;
+        void RegisterCounters();
+
+        // the last frames and lifecycle commands, in a file that survives a crash
+        void InitFlightRecorder();
+        void RecordFlightFrame(const FrameTiming& timing);
+
+        // starts the sampling profiler if PROFILE_PROPERTY is set; StopProfiler() writes the
+        // profile out. Runs while the app is visible (APP_CMD_START to APP_CMD_STOP), so each
+        // profile covers the last time it was.
+        void StartProfiler();
+        void StopProfiler();
+
+        // once startup is over, streams the trace to TRACE_FILE_NAME if TRACE_PROPERTY is set,
+        // and otherwise stops recording it
+        void StartTrace();
+
+        // memory footprint, sampled once a second and logged in detail on low memory
+        MemoryReporter mMemory;
+
+        // size of the window at full resolution (we may render at a fraction of it)
+        int mWindowWidth, mWindowHeight;
+
         // initialize the display
         bool InitDisplay();
 
@@ -131,6 +317,35 @@ class NativeEngine {
         // initialize context. Requires display to have been initialized first.
         bool InitContext();
 
+        // binds surface and context to this thread and sets up global GL state
+        bool BindContext();
+
+        // names of the files in the root of the APK's assets directory, by NAME_HASH. Assets
+        // are looked up here before they're opened (see OpenObstaclePatterns()).
+        NameTable<std::string> mAssetIndex;
+        bool LoadAssetIndex();
+
+        // run statistics, opened in the background at startup
+        StatsStore mStats;
+
+        // obstacle patterns, used straight from the (uncompressed, so mapped) asset
+        ObstaclePatternLibrary mPatterns;
+        AAsset *mPatternsAsset;
+        bool OpenObstaclePatterns();
+
+        // clears and swaps once, so something reaches the screen before the GL objects exist.
+        // That's the startup pipeline's first frame; its first content is the first frame
+        // drawn once mSceneReady is set (see DoFrame()).
+        void PresentFirstFrame();
+
+        EngineEventBus mEvents;
+        uint32_t mEventDrops;  // events dropped (queue full) so far, as last logged
+
+        // queues a touch event, dispatching those already queued if there's no room: a
+        // dropped Up would leave its pointer down for good
+        void PostTouch(const TouchScreenEvent& ev);
+        void LogEventDrops();
+
         std::list< std::pair<int32_t, Position> > previous_positions;
         void process_input_events ();
 
@@ -146,6 +361,9 @@ class NativeEngine {
         bool InitGLObjects();
         void KillGLObjects();
 
+        // KillGLObjects() for when we have no window (so no current context), on low memory
+        void TrimGLObjects();
+
         void ConfigureOpenGL();
 
         bool PrepareToRender();
@@ -154,6 +372,10 @@ class NativeEngine {
 
         bool IsAnimating();
 
+        // startup orchestration. Declared last so that it is destroyed first: its background
+        // stages reference other members.
+        StartupPipeline mStartup;
+
     public:
         // these are public for simplicity because we have internal static callbacks
         void HandleCommand(int32_t cmd);
@@ -0,0 +1,52 @@
+#ifndef endlesstunnel_obstacle_hpp
+#define endlesstunnel_obstacle_hpp
+
+#include <stdint.h>
+
+#include "grid_config.hpp"
+
+// An obstacle: a grid of boxes filling a cross-section of the tunnel, at some position along it.
+template <class Grid>
+class BasicObstacle {
+    public:
+        typedef typename Grid::Mask Mask;
+
+        // one bit per cell with a box (see GridConfig)
+        Mask mask;
+
+        // cell of the bonus, if any (-1 if none). There's never a box in that cell.
+        int bonusCol, bonusRow;
+
+        // position along the tunnel (of the boxes' centers)
+        float y;
+
+        BasicObstacle() { Reset(); }
+
+        void Reset() {
+            mask = 0;
+            bonusCol = bonusRow = -1;
+            y = 0.0f;
+        }
+
+        static Mask CellBit(int col, int row) { return Grid::CellBit(col, row); }
+
+        bool HasBox(int col, int row) const { return 0 != (mask & CellBit(col, row)); }
+
+        void SetBox(int col, int row, bool present) {
+            mask = present ? (Mask) (mask | CellBit(col, row)) : (Mask) (mask & ~CellBit(col, row));
+        }
+
+        int GetBoxCount() const { return Grid::Count(mask); }
+
+        bool HasBonus() const { return bonusCol >= 0; }
+
+        // center of a cell on the tunnel's cross-section
+        static float GetCellCenterX(int col) { return Grid::CellCenterX(col); }
+        static float GetCellCenterZ(int row) { return Grid::CellCenterZ(row); }
+};
+
+// the game's obstacles
+typedef BasicObstacle<DefaultGrid> Obstacle;
+typedef DefaultGrid::Mask ObstacleMask;
+
+#endif
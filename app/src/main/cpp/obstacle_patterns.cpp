@@ -0,0 +1,140 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "obstacle_patterns.hpp"
+
+ObstaclePatternLibrary::ObstaclePatternLibrary() {
+    mHeader = NULL;
+    mPatterns = NULL;
+    mLevels = NULL;
+    mAliases = NULL;
+    mNames = NULL;
+    mMapped = NULL;
+    mMappedSize = 0;
+}
+
+ObstaclePatternLibrary::~ObstaclePatternLibrary() {
+    Close();
+}
+
+bool ObstaclePatternLibrary::Open(const void *data, size_t size) {
+    Close();
+    if (!data || ((uintptr_t) data & 3) || size < sizeof(ObstaclePatternHeader)) {
+        return false;
+    }
+
+    const ObstaclePatternHeader *h = (const ObstaclePatternHeader*) data;
+    if (h->magic != OBS_PATTERNS_MAGIC || h->version != OBS_PATTERNS_VERSION ||
+            h->grid_size != OBS_GRID_SIZE || h->file_size != size ||
+            h->pattern_count == 0 || h->pattern_count > 0xffff || h->level_count == 0 ||
+            h->names_size == 0) {
+        return false;
+    }
+
+    // the sections must add up to the file exactly (64-bit, so that nothing overflows)
+    uint64_t patterns = sizeof(ObstaclePatternHeader);
+    uint64_t levels = patterns + (uint64_t) h->pattern_count * sizeof(ObstaclePattern);
+    uint64_t aliases = levels + (uint64_t) h->level_count * sizeof(ObstaclePatternLevel);
+    uint64_t names = aliases + (uint64_t) h->alias_count * sizeof(ObstaclePatternAlias);
+    if (names + h->names_size != size) {
+        return false;
+    }
+
+    const uint8_t *base = (const uint8_t*) data;
+    const ObstaclePatternLevel *lv = (const ObstaclePatternLevel*) (base + levels);
+    const char *nm = (const char*) (base + names);
+    if (nm[h->names_size - 1] != 0) {
+        return false;
+    }
+    // only the level tables are checked here (there are few of them); pattern indices and
+    // name offsets are checked as they are used
+    for (uint32_t i = 0; i < h->level_count; i++) {
+        if (lv[i].count == 0 || lv[i].count > h->alias_count ||
+                lv[i].first > h->alias_count - lv[i].count) {
+            return false;
+        }
+    }
+
+    mHeader = h;
+    mPatterns = (const ObstaclePattern*) (base + patterns);
+    mLevels = lv;
+    mAliases = (const ObstaclePatternAlias*) (base + aliases);
+    mNames = nm;
+    return true;
+}
+
+bool ObstaclePatternLibrary::OpenFile(const char *path) {
+    Close();
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    void *p = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (p == MAP_FAILED) {
+        return false;
+    }
+
+    if (!Open(p, st.st_size)) {
+        munmap(p, st.st_size);
+        return false;
+    }
+    mMapped = p;
+    mMappedSize = st.st_size;
+    return true;
+}
+
+void ObstaclePatternLibrary::Close() {
+    if (mMapped) {
+        munmap(mMapped, mMappedSize);
+        mMapped = NULL;
+        mMappedSize = 0;
+    }
+    mHeader = NULL;
+    mPatterns = NULL;
+    mLevels = NULL;
+    mAliases = NULL;
+    mNames = NULL;
+}
+
+const char *ObstaclePatternLibrary::GetName(const ObstaclePattern& p) const {
+    return p.name < mHeader->names_size ? mNames + p.name : "";
+}
+
+const ObstaclePattern *ObstaclePatternLibrary::Pick(int level, uint64_t random) const {
+    if (!mHeader) {
+        return NULL;
+    }
+    if (level < 0) {
+        level = 0;
+    } else if (level >= (int) mHeader->level_count) {
+        level = mHeader->level_count - 1;
+    }
+
+    // the high half picks an entry (multiply-shift instead of a modulo), the low one between
+    // the entry's pattern and its alias
+    const ObstaclePatternLevel& l = mLevels[level];
+    uint32_t i = (uint32_t) (((random >> 32) * l.count) >> 32);
+    const ObstaclePatternAlias& a = mAliases[l.first + i];
+    uint32_t u = (uint32_t) random & (OBS_PATTERN_ONE - 1);
+    uint32_t index = u < a.threshold ? a.pattern : a.alias;
+    return index < mHeader->pattern_count ? &mPatterns[index] : NULL;
+}
+
+void ObstaclePatternLibrary::Apply(const ObstaclePattern& p, Obstacle *o) {
+    uint64_t mask = ((uint64_t) p.mask_hi << 32) | p.mask_lo;
+    o->mask = (ObstacleMask) mask & DefaultGrid::ALL_CELLS;
+    if (p.bonus_cell >= 0 && p.bonus_cell < OBS_GRID_SIZE * OBS_GRID_SIZE) {
+        o->bonusCol = p.bonus_cell % OBS_GRID_SIZE;
+        o->bonusRow = p.bonus_cell / OBS_GRID_SIZE;
+        o->SetBox(o->bonusCol, o->bonusRow, false);
+    } else {
+        o->bonusCol = o->bonusRow = -1;
+    }
+}
@@ -0,0 +1,107 @@
+#ifndef endlesstunnel_obstacle_patterns_hpp
+#define endlesstunnel_obstacle_patterns_hpp
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "obstacle.hpp"
+
+// Flat binary library of designer-made obstacle patterns (written by tools/obstacle_compiler
+// from text definitions). Everything is little-endian and laid out so that it can be used
+// straight from a mapped file: the header, then the patterns, the per-level tables and their
+// alias entries, and the names.
+
+#define OBS_PATTERNS_MAGIC 0x5441504fu  // "OPAT"
+#define OBS_PATTERNS_VERSION 1
+
+// max_level of patterns allowed at every level from min_level on
+#define OBS_PATTERN_ANY_LEVEL 0xff
+
+// alias thresholds are fractions of this
+#define OBS_PATTERN_ONE (1u << 31)
+
+struct ObstaclePatternHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint8_t grid_size;        // must be OBS_GRID_SIZE
+    uint8_t reserved;
+    uint32_t pattern_count;
+    uint32_t level_count;     // the last level's table is used for all the levels after it
+    uint32_t alias_count;
+    uint32_t names_size;
+    uint32_t file_size;
+    uint32_t reserved2;
+};
+
+// The mask is split in two words (boxes of cells 0-31 and 32-63), so that the 4-byte alignment
+// uncompressed assets get in the APK is enough.
+struct ObstaclePattern {
+    uint32_t mask_lo, mask_hi;
+    uint32_t name;            // offset into the names
+    uint16_t weight;
+    uint8_t min_level, max_level;
+    int16_t bonus_cell;       // row * OBS_GRID_SIZE + col, or -1
+    uint16_t reserved;
+    uint32_t reserved2;
+};
+
+// a level's patterns, as alias_count entries from first on
+struct ObstaclePatternLevel {
+    uint32_t first, count;
+};
+
+// Walker's alias method: entry i picks its pattern with probability threshold /
+// OBS_PATTERN_ONE, and the alias pattern otherwise
+struct ObstaclePatternAlias {
+    uint32_t threshold;
+    uint16_t pattern, alias;
+};
+
+static_assert(sizeof(ObstaclePatternHeader) == 32, "unexpected header layout");
+static_assert(sizeof(ObstaclePattern) == 24, "unexpected pattern layout");
+static_assert(sizeof(ObstaclePatternLevel) == 8, "unexpected level layout");
+static_assert(sizeof(ObstaclePatternAlias) == 8, "unexpected alias layout");
+
+// Read-only view of a pattern library. Open() only checks the header and the sizes, so it
+// costs the same however many patterns there are; Pick() is O(1).
+class ObstaclePatternLibrary {
+    public:
+        ObstaclePatternLibrary();
+        ~ObstaclePatternLibrary();
+
+        // uses a library already in memory (e.g. AAsset_getBuffer()), which must stay valid
+        // and be at least 4-byte aligned
+        bool Open(const void *data, size_t size);
+
+        // maps a library file
+        bool OpenFile(const char *path);
+
+        void Close();
+
+        bool IsOpen() const { return mHeader != NULL; }
+        int GetPatternCount() const { return mHeader ? (int) mHeader->pattern_count : 0; }
+        int GetLevelCount() const { return mHeader ? (int) mHeader->level_count : 0; }
+
+        const ObstaclePattern& GetPattern(int index) const { return mPatterns[index]; }
+        const char *GetName(const ObstaclePattern& p) const;
+
+        // picks a pattern for the level, according to the weights of the patterns allowed
+        // there. random should be uniformly distributed over all 64 bits. NULL if not open.
+        const ObstaclePattern *Pick(int level, uint64_t random) const;
+
+        // sets up the obstacle's boxes and bonus from the pattern (its position is kept)
+        static void Apply(const ObstaclePattern& p, Obstacle *o);
+
+    private:
+        const ObstaclePatternHeader *mHeader;
+        const ObstaclePattern *mPatterns;
+        const ObstaclePatternLevel *mLevels;
+        const ObstaclePatternAlias *mAliases;
+        const char *mNames;
+
+        // mapping made by OpenFile(), if any
+        void *mMapped;
+        size_t mMappedSize;
+};
+
+#endif
@@ -0,0 +1,3 @@
+#include "occlusion.hpp"
+
+template class BasicObstacleOcclusion<DefaultGrid>;
@@ -0,0 +1,340 @@
+#ifndef endlesstunnel_occlusion_hpp
+#define endlesstunnel_occlusion_hpp
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "obstacle.hpp"
+
+// where the player looks from; the view looks down the tunnel (+y)
+struct OcclusionView {
+    float eye_x, eye_y, eye_z;
+    float tan_half_fov_x, tan_half_fov_z;
+};
+
+// how many of the nearest obstacles in front of each one are tested against it exactly
+#define OCCLUSION_NEAREST 3
+
+// resolution of the coverage buffer, in each direction (a multiple of 64); 8 KB on the stack
+#define OCCLUSION_COVERAGE_SIZE 256
+
+// Conservative visibility of obstacle boxes: removes the boxes that are outside of the view
+// cone, or that are entirely hidden behind nearer boxes. Since boxes are smaller than their
+// cells, rows of boxes have gaps; a box is only considered hidden if it can't be seen through
+// any of them.
+//
+// Everything is projected onto the view plane, in tangent space (x / depth, z / depth from the
+// eye), where a box's front face is a rectangle, and a box's silhouette fits in the hull of its
+// two faces. Obstacles are visited front to back, and each one's boxes are tested two ways:
+//
+// - against a coverage buffer: a bitmap of the view where a pixel is set once it's entirely
+//   inside the front face of a box already visited. A box is hidden if every pixel its hull
+//   touches is set. That's linear in the number of boxes, whatever the number of obstacles,
+//   and catches boxes hidden by several nearer ones together, but it's only as precise as
+//   the pixels, which far away are bigger than the gaps between boxes.
+//
+// - exactly, against each of the OCCLUSION_NEAREST obstacles just in front (where the pixels
+//   are too coarse): projected onto the front face of a nearer obstacle, each column (row) of
+//   a farther one either fits in the span of one of its columns (rows) of boxes, or it
+//   doesn't, independently of the other axis. So each pair of obstacles reduces to a column
+//   map and a row map, and the hidden cells are the occluder's mask shuffled through them.
+//   Each obstacle's spans are computed once, not once per pair.
+template <class Grid>
+class BasicObstacleOcclusion {
+    public:
+        typedef typename Grid::Mask Mask;
+        typedef BasicObstacle<Grid> ObstacleType;
+
+        // obstacles must be sorted front to back. Writes the boxes of each one that may be
+        // visible to visible[]. Returns how many boxes were removed.
+        static int Cull(const OcclusionView& view, const ObstacleType *const *obstacles,
+                        int count, Mask *visible);
+
+        // the cells of an obstacle at position y that are (at least partly) in the view cone
+        static Mask GetViewMask(const OcclusionView& view, float y);
+
+        // the cells of target that are hidden behind a box of occluder (which must be nearer)
+        static Mask GetHiddenMask(const OcclusionView& view, const ObstacleType& occluder,
+                                  const ObstacleType& target);
+
+    private:
+        static constexpr float HALF_BOX = 0.5f * Grid::BOX_SIZE;
+        static constexpr int COVERAGE_WORDS = OCCLUSION_COVERAGE_SIZE / 64;
+
+        // an obstacle's columns and rows of boxes, in tangent space
+        struct Projection {
+            const ObstacleType *obstacle;
+            float d_front, d_back;    // depth of its faces (> 0 if in front of the eye)
+            float front_x[Grid::SIZE][2], front_z[Grid::SIZE][2];  // front faces
+            float hull_x[Grid::SIZE][2], hull_z[Grid::SIZE][2];    // front and back faces
+            // in coverage pixels: those entirely inside the front faces (clamped to the
+            // view), and those the hulls touch (-1 if that goes out of the view)
+            int inner_x[Grid::SIZE][2], inner_z[Grid::SIZE][2];
+            int outer_x[Grid::SIZE][2], outer_z[Grid::SIZE][2];
+        };
+
+        // bit c of word c / 64 of a row: the pixel is behind a box
+        struct Coverage {
+            uint64_t rows[OCCLUSION_COVERAGE_SIZE][COVERAGE_WORDS];
+        };
+
+        static unsigned CellsOverlapping(float lo, float hi, float half);
+        static void Project(const OcclusionView& view, const ObstacleType& o, Projection *p);
+        static void MapAxis(const float (*front)[2], const float (*hull)[2], float eye,
+                            float half, float d1, int *map);
+        static Mask HiddenCells(const OcclusionView& view, const Projection& occluder,
+                                const Projection& target, Mask cells);
+
+        static int FloorToInt(float v);
+        static void PixelSpans(const float *front, const float *hull, float tan, int *inner,
+                               int *outer);
+        static uint64_t SpanBits(int word, int c0, int c1);
+        static void AddToCoverage(Coverage *cov, const Projection& p, Mask cells);
+        static Mask CoveredCells(const Coverage& cov, const Projection& p, Mask cells);
+};
+
+// bits of the cells whose boxes overlap [lo, hi], on an axis where the tunnel spans
+// [-half, half]
+template <class Grid>
+unsigned BasicObstacleOcclusion<Grid>::CellsOverlapping(float lo, float hi, float half) {
+    unsigned bits = 0;
+    for (int i = 0; i < Grid::SIZE; i++) {
+        float c = -half + (i + 0.5f) * Grid::CELL_SIZE;
+        if (c + HALF_BOX >= lo && c - HALF_BOX <= hi) {
+            bits |= 1u << i;
+        }
+    }
+    return bits;
+}
+
+template <class Grid>
+void BasicObstacleOcclusion<Grid>::Project(const OcclusionView& view, const ObstacleType& o,
+                                           Projection *p) {
+    p->obstacle = &o;
+    p->d_front = o.y - HALF_BOX - view.eye_y;
+    p->d_back = o.y + HALF_BOX - view.eye_y;
+    if (p->d_front <= 0.0f) {
+        return;
+    }
+    float inv_f = 1.0f / p->d_front, inv_b = 1.0f / p->d_back;
+    for (int i = 0; i < Grid::SIZE; i++) {
+        // each edge's extreme comes from one face or the other, depending on which side of
+        // the eye it is: the near face projects bigger
+        float x0 = Grid::CellCenterX(i) - HALF_BOX - view.eye_x;
+        float x1 = Grid::CellCenterX(i) + HALF_BOX - view.eye_x;
+        p->front_x[i][0] = x0 * inv_f;
+        p->front_x[i][1] = x1 * inv_f;
+        p->hull_x[i][0] = x0 * (x0 < 0.0f ? inv_f : inv_b);
+        p->hull_x[i][1] = x1 * (x1 > 0.0f ? inv_f : inv_b);
+
+        float z0 = Grid::CellCenterZ(i) - HALF_BOX - view.eye_z;
+        float z1 = Grid::CellCenterZ(i) + HALF_BOX - view.eye_z;
+        p->front_z[i][0] = z0 * inv_f;
+        p->front_z[i][1] = z1 * inv_f;
+        p->hull_z[i][0] = z0 * (z0 < 0.0f ? inv_f : inv_b);
+        p->hull_z[i][1] = z1 * (z1 > 0.0f ? inv_f : inv_b);
+
+        PixelSpans(p->front_x[i], p->hull_x[i], view.tan_half_fov_x, p->inner_x[i],
+                   p->outer_x[i]);
+        PixelSpans(p->front_z[i], p->hull_z[i], view.tan_half_fov_z, p->inner_z[i],
+                   p->outer_z[i]);
+    }
+}
+
+// floorf() is a call on some targets, and this runs for every column and row of every obstacle
+template <class Grid>
+int BasicObstacleOcclusion<Grid>::FloorToInt(float v) {
+    int i = (int) v;
+    return i - (v < (float) i);
+}
+
+// the coverage pixels of a column (row) of boxes, on an axis where the view spans [-tan, tan]
+template <class Grid>
+void BasicObstacleOcclusion<Grid>::PixelSpans(const float *front, const float *hull, float tan,
+                                              int *inner, int *outer) {
+    const int last = OCCLUSION_COVERAGE_SIZE - 1;
+    float scale = OCCLUSION_COVERAGE_SIZE / (2.0f * tan);
+    inner[0] = std::max(-FloorToInt(-(front[0] + tan) * scale), 0);
+    inner[1] = std::min(FloorToInt((front[1] + tan) * scale) - 1, last);
+    outer[0] = FloorToInt((hull[0] + tan) * scale);
+    outer[1] = FloorToInt((hull[1] + tan) * scale);
+    if (outer[0] < 0 || outer[1] > last) {
+        outer[0] = outer[1] = -1;
+    }
+}
+
+// For each target cell along one axis: the occluder cell whose front face fully contains the
+// target's hull. -1 if there's none. d1 is the depth of the occluder's front face.
+template <class Grid>
+void BasicObstacleOcclusion<Grid>::MapAxis(const float (*front)[2], const float (*hull)[2],
+                                           float eye, float half, float d1, int *map) {
+    for (int i = 0; i < Grid::SIZE; i++) {
+        // the only candidate: the occluder cell the hull starts in
+        map[i] = -1;
+        float pos = (eye + hull[i][0] * d1 + half) * (1.0f / Grid::CELL_SIZE);
+        if (pos >= 0.0f && pos < Grid::SIZE) {
+            int k = (int) pos;
+            if (hull[i][0] >= front[k][0] && hull[i][1] <= front[k][1]) {
+                map[i] = k;
+            }
+        }
+    }
+}
+
+template <class Grid>
+typename Grid::Mask BasicObstacleOcclusion<Grid>::GetViewMask(const OcclusionView& view,
+                                                              float y) {
+    // the cone is widest at the far face
+    float d = y + HALF_BOX - view.eye_y;
+    if (d <= 0.0f) {
+        return 0;
+    }
+    unsigned cols = CellsOverlapping(view.eye_x - d * view.tan_half_fov_x,
+                                     view.eye_x + d * view.tan_half_fov_x, Grid::HALF_W);
+    unsigned rows = CellsOverlapping(view.eye_z - d * view.tan_half_fov_z,
+                                     view.eye_z + d * view.tan_half_fov_z, Grid::HALF_H);
+    return Grid::Expand(cols, rows);
+}
+
+// the cells (of those in cells) of the target that are hidden behind a box of the occluder
+template <class Grid>
+typename Grid::Mask BasicObstacleOcclusion<Grid>::HiddenCells(const OcclusionView& view,
+        const Projection& occluder, const Projection& target, Mask cells) {
+    float d1 = occluder.d_front;
+    if (d1 <= 0.0f || target.d_front <= d1 || !occluder.obstacle->mask || !cells) {
+        return 0;
+    }
+
+    int col_map[Grid::SIZE], row_map[Grid::SIZE];
+    MapAxis(occluder.front_x, target.hull_x, view.eye_x, Grid::HALF_W, d1, col_map);
+    MapAxis(occluder.front_z, target.hull_z, view.eye_z, Grid::HALF_H, d1, row_map);
+
+    // shuffle the occluder's boxes into the target's cells
+    Mask hidden = 0;
+    for (int r = 0; r < Grid::SIZE; r++) {
+        unsigned wanted = (unsigned) (cells >> (r * Grid::SIZE)) & Grid::AXIS_BITS;
+        if (!wanted || row_map[r] < 0) {
+            continue;
+        }
+        unsigned occ_row = (unsigned) (occluder.obstacle->mask >> (row_map[r] * Grid::SIZE)) &
+                           Grid::AXIS_BITS;
+        unsigned bits = 0;
+        for (int c = 0; c < Grid::SIZE; c++) {
+            if (col_map[c] >= 0) {
+                bits |= ((occ_row >> col_map[c]) & 1u) << c;
+            }
+        }
+        hidden |= (Mask) ((Mask) (bits & wanted) << (r * Grid::SIZE));
+    }
+    return hidden;
+}
+
+template <class Grid>
+typename Grid::Mask BasicObstacleOcclusion<Grid>::GetHiddenMask(const OcclusionView& view,
+        const ObstacleType& occluder, const ObstacleType& target) {
+    Projection o, t;
+    Project(view, occluder, &o);
+    Project(view, target, &t);
+    return HiddenCells(view, o, t, target.mask);
+}
+
+// the bits of pixels [c0, c1] that are in the given word of a row
+template <class Grid>
+uint64_t BasicObstacleOcclusion<Grid>::SpanBits(int word, int c0, int c1) {
+    int lo = c0 - word * 64, hi = c1 - word * 64;
+    if (hi < 0 || lo > 63) {
+        return 0;
+    }
+    lo = lo < 0 ? 0 : lo;
+    hi = hi > 63 ? 63 : hi;
+    return (~0ull >> (63 - hi)) & (~0ull << lo);
+}
+
+// sets the pixels entirely inside the front faces of the given boxes
+template <class Grid>
+void BasicObstacleOcclusion<Grid>::AddToCoverage(Coverage *cov, const Projection& p,
+                                                 Mask cells) {
+    for (; cells; cells &= cells - 1) {
+        int cell = __builtin_ctzll((uint64_t) cells);
+        int col = cell % Grid::SIZE, row = cell / Grid::SIZE;
+        int c0 = p.inner_x[col][0], c1 = p.inner_x[col][1];
+        int r0 = p.inner_z[row][0], r1 = p.inner_z[row][1];
+        if (c0 > c1) {
+            continue;
+        }
+        for (int w = 0; w < COVERAGE_WORDS; w++) {
+            uint64_t bits = SpanBits(w, c0, c1);
+            for (int r = r0; bits && r <= r1; r++) {
+                cov->rows[r][w] |= bits;
+            }
+        }
+    }
+}
+
+// the cells (of those in cells) whose hull only touches pixels that are set. A hull that
+// reaches outside the view (outer spans of -1, see PixelSpans()) is never covered: the bitmap
+// doesn't say what's out there.
+template <class Grid>
+typename Grid::Mask BasicObstacleOcclusion<Grid>::CoveredCells(const Coverage& cov,
+        const Projection& p, Mask cells) {
+    Mask covered = 0;
+    for (Mask left = cells; left; left &= left - 1) {
+        int cell = __builtin_ctzll((uint64_t) left);
+        int col = cell % Grid::SIZE, row = cell / Grid::SIZE;
+        int c0 = p.outer_x[col][0], c1 = p.outer_x[col][1];
+        int r0 = p.outer_z[row][0], r1 = p.outer_z[row][1];
+        if (c0 < 0 || r0 < 0) {
+            continue;
+        }
+        bool hidden = true;
+        for (int w = 0; w < COVERAGE_WORDS && hidden; w++) {
+            uint64_t bits = SpanBits(w, c0, c1);
+            for (int r = r0; bits && r <= r1 && hidden; r++) {
+                hidden = (cov.rows[r][w] & bits) == bits;
+            }
+        }
+        if (hidden) {
+            covered |= (Mask) left & (Mask) -(Mask) left;
+        }
+    }
+    return covered;
+}
+
+template <class Grid>
+int BasicObstacleOcclusion<Grid>::Cull(const OcclusionView& view,
+        const ObstacleType *const *obstacles, int count, Mask *visible) {
+    Coverage cov;
+    memset(cov.rows, 0, sizeof(cov.rows));
+    // the projections of the last few obstacles, by index modulo the size
+    Projection recent[OCCLUSION_NEAREST + 1];
+
+    int removed = 0;
+    for (int i = 0; i < count; i++) {
+        const ObstacleType *target = obstacles[i];
+        Projection& p = recent[i % (OCCLUSION_NEAREST + 1)];
+        Project(view, *target, &p);
+        Mask in_view = target->mask & GetViewMask(view, target->y);
+        Mask vis = in_view;
+
+        if (vis && p.d_front > 0.0f) {
+            vis &= ~CoveredCells(cov, p, vis);
+            // nearest first, only looking at what's still visible
+            for (int j = i - 1; j >= 0 && j >= i - OCCLUSION_NEAREST && vis; j--) {
+                vis &= ~HiddenCells(view, recent[j % (OCCLUSION_NEAREST + 1)], p, vis);
+            }
+            // a hidden box's face is inside the faces that hide it: nothing to add
+            AddToCoverage(&cov, p, vis);
+        }
+
+        visible[i] = vis;
+        removed += target->GetBoxCount() - Grid::Count(vis);
+    }
+    return removed;
+}
+
+// the game's grid is instantiated once, in occlusion.cpp
+extern template class BasicObstacleOcclusion<DefaultGrid>;
+typedef BasicObstacleOcclusion<DefaultGrid> ObstacleOcclusion;
+
+#endif
@@ -0,0 +1,431 @@
+#include <errno.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "overdraw.hpp"
+
+// every fragment adds one to its pass's channel (1/255 in an 8-bit normalized target)
+static const char *COUNTING_FS =
+    "#version 300 es\n"
+    "precision highp float;\n"
+    "out vec4 o_color;\n"
+    "void main() {\n"
+    "    o_color = vec4(1.0 / 255.0);\n"
+    "}\n";
+
+// a triangle covering the whole viewport
+static const char *HEATMAP_VS =
+    "#version 300 es\n"
+    "void main() {\n"
+    "    vec2 p = vec2(float((gl_VertexID & 1) << 2) - 1.0, float((gl_VertexID & 2) << 1) - 1.0);\n"
+    "    gl_Position = vec4(p, 0.0, 1.0);\n"
+    "}\n";
+
+// 0 fragments black, then blue, green, yellow, orange, red, fading to white at 10 and above
+static const char *HEATMAP_FS =
+    "#version 300 es\n"
+    "precision highp float;\n"
+    "uniform highp sampler2D u_counts;\n"
+    "out vec4 o_color;\n"
+    "const vec3 palette[6] = vec3[6](vec3(0.0), vec3(0.0, 0.2, 1.0), vec3(0.0, 0.8, 0.0),\n"
+    "        vec3(1.0, 1.0, 0.0), vec3(1.0, 0.5, 0.0), vec3(1.0, 0.0, 0.0));\n"
+    "void main() {\n"
+    "    ivec2 p = min(ivec2(gl_FragCoord.xy), textureSize(u_counts, 0) - 1);\n"
+    "    vec4 c = texelFetch(u_counts, p, 0) * 255.0;\n"
+    "    float n = c.r + c.g + c.b + c.a;\n"
+    "    vec3 color = palette[int(min(n + 0.5, 5.0))];\n"
+    "    o_color = vec4(mix(color, vec3(1.0), clamp((n - 5.0) / 5.0, 0.0, 1.0)), 1.0);\n"
+    "}\n";
+
+static const ShaderInput HEATMAP_UNIFORMS[] = {
+    SHADER_UNIFORM("u_counts", GL_SAMPLER_2D),
+};
+
+OverdrawMeter::OverdrawMeter() {
+    mActive = false;
+    mReportFile = NULL;
+    mCountingShader = mHeatmapProgram = mHeatmapVao = 0;
+    mTexture = mFramebuffer = 0;
+    mWidth = mHeight = 0;
+    memset(mReadbacks, 0, sizeof(mReadbacks));
+    mNext = 0;
+    mSkipped = 0;
+    mInFrame = false;
+    mFrame = 0;
+    memset(mPassNames, 0, sizeof(mPassNames));
+    mPassCount = 0;
+    memset(&mReport, 0, sizeof(mReport));
+    mHasReport = false;
+}
+
+OverdrawMeter::~OverdrawMeter() {
+    // the GL objects go away with the context
+    if (mReportFile) {
+        fclose(mReportFile);
+    }
+}
+
+GLuint OverdrawMeter::Compile(GLenum type, const char *src) {
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &src, NULL);
+    glCompileShader(shader);
+
+    GLint status = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if (status == GL_FALSE) {
+        char log[512] = "";
+        glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+        mError = std::string("shader compilation failed: ") + log;
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+bool OverdrawMeter::Init(const char *report_path) {
+    Shutdown();
+    mError.clear();
+
+    mCountingShader = Compile(GL_FRAGMENT_SHADER, COUNTING_FS);
+    GLuint vs = Compile(GL_VERTEX_SHADER, HEATMAP_VS);
+    GLuint fs = Compile(GL_FRAGMENT_SHADER, HEATMAP_FS);
+    if (mCountingShader && vs && fs) {
+        mHeatmapProgram = glCreateProgram();
+        glAttachShader(mHeatmapProgram, vs);
+        glAttachShader(mHeatmapProgram, fs);
+        glLinkProgram(mHeatmapProgram);
+        GLint status = GL_FALSE;
+        glGetProgramiv(mHeatmapProgram, GL_LINK_STATUS, &status);
+        if (status == GL_FALSE) {
+            mError = "heatmap program link failed";
+        } else if (!mHeatmapInterface.Build(mHeatmapProgram, nullptr, 0, HEATMAP_UNIFORMS,
+                                            SHADER_INPUT_COUNT(HEATMAP_UNIFORMS))) {
+            mError = "heatmap program interface mismatch: " + mHeatmapInterface.GetError();
+        }
+    }
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+
+    if (mError.empty() && report_path) {
+        mReportFile = fopen(report_path, "a");
+        if (!mReportFile) {
+            mError = std::string("can't open ") + report_path + ": " + strerror(errno);
+        }
+    }
+    if (!mError.empty()) {
+        Shutdown();
+        return false;
+    }
+
+    glGenVertexArrays(1, &mHeatmapVao);
+    for (Readback& rb : mReadbacks) {
+        glGenBuffers(1, &rb.buffer);
+    }
+    mActive = true;
+    return true;
+}
+
+void OverdrawMeter::Shutdown() {
+    for (Readback& rb : mReadbacks) {
+        if (rb.fence) {
+            glDeleteSync(rb.fence);
+        }
+        if (rb.buffer) {
+            glDeleteBuffers(1, &rb.buffer);
+        }
+    }
+    memset(mReadbacks, 0, sizeof(mReadbacks));
+    mNext = 0;
+
+    if (mFramebuffer) {
+        glDeleteFramebuffers(1, &mFramebuffer);
+    }
+    if (mTexture) {
+        glDeleteTextures(1, &mTexture);
+    }
+    if (mHeatmapVao) {
+        glDeleteVertexArrays(1, &mHeatmapVao);
+    }
+    if (mHeatmapProgram) {
+        glDeleteProgram(mHeatmapProgram);
+    }
+    mHeatmapInterface.Clear();
+    if (mCountingShader) {
+        glDeleteShader(mCountingShader);
+    }
+    mCountingShader = mHeatmapProgram = mHeatmapVao = 0;
+    mTexture = mFramebuffer = 0;
+    mWidth = mHeight = 0;
+
+    if (mReportFile) {
+        fclose(mReportFile);
+        mReportFile = NULL;
+    }
+    mActive = mInFrame = false;
+}
+
+bool OverdrawMeter::Resize(int width, int height) {
+    if (mFramebuffer) {
+        glDeleteFramebuffers(1, &mFramebuffer);
+        glDeleteTextures(1, &mTexture);
+    }
+    mWidth = width;
+    mHeight = height;
+
+    glGenTextures(1, &mTexture);
+    glBindTexture(GL_TEXTURE_2D, mTexture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, width, height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &mFramebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, mFramebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, mTexture, 0);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // readbacks of the old size are of no use anymore
+    for (Readback& rb : mReadbacks) {
+        if (rb.fence) {
+            glDeleteSync(rb.fence);
+            rb.fence = 0;
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, rb.buffer);
+        glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr) width * height * 4, NULL, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        char buf[64];
+        snprintf(buf, sizeof(buf), "count target incomplete (status 0x%x)", status);
+        mError = buf;
+        mWidth = mHeight = 0;
+        return false;
+    }
+    return true;
+}
+
+bool OverdrawMeter::BeginFrame(int width, int height, uint32_t frame) {
+    if (!mActive || width <= 0 || height <= 0) {
+        return false;
+    }
+    if ((width != mWidth || height != mHeight) && !Resize(width, height)) {
+        return false;
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, mFramebuffer);
+
+    // all the channels (alpha too) start at zero, everywhere
+    GLfloat clear_color[4];
+    glGetFloatv(GL_COLOR_CLEAR_VALUE, clear_color);
+    GLboolean scissor = glIsEnabled(GL_SCISSOR_TEST);
+    glDisable(GL_SCISSOR_TEST);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glClearColor(clear_color[0], clear_color[1], clear_color[2], clear_color[3]);
+    if (scissor) {
+        glEnable(GL_SCISSOR_TEST);
+    }
+    // outside of a pass, nothing is written
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+
+    mInFrame = true;
+    mFrame = frame;
+    mPassCount = 0;
+    return true;
+}
+
+void OverdrawMeter::BeginPass(const char *name) {
+    if (!mInFrame || mPassCount == OVERDRAW_MAX_PASSES) {
+        return;
+    }
+    mPassNames[mPassCount] = name;
+    glColorMask(mPassCount == 0, mPassCount == 1, mPassCount == 2, mPassCount == 3);
+    glEnable(GL_BLEND);
+    glBlendEquation(GL_FUNC_ADD);
+    glBlendFunc(GL_ONE, GL_ONE);
+}
+
+void OverdrawMeter::EndPass() {
+    if (!mInFrame || mPassCount == OVERDRAW_MAX_PASSES) {
+        return;
+    }
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glDisable(GL_BLEND);
+    mPassCount++;
+}
+
+void OverdrawMeter::EndFrame() {
+    if (!mInFrame) {
+        return;
+    }
+    mInFrame = false;
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    glDisable(GL_BLEND);
+
+    // make room for this frame's readback if the oldest one is done
+    ProcessReadbacks();
+
+    Readback& rb = mReadbacks[mNext];
+    if (rb.fence) {
+        mSkipped++;
+    } else {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, rb.buffer);
+        glReadPixels(0, 0, mWidth, mHeight, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        rb.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        rb.frame = mFrame;
+        rb.pass_count = mPassCount;
+        memcpy(rb.names, mPassNames, sizeof(rb.names));
+        mNext = (mNext + 1) % OVERDRAW_READBACKS;
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    DrawHeatmap();
+}
+
+void OverdrawMeter::DrawHeatmap() {
+    GLint program, vao, texture, active;
+    glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+    glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &vao);
+    glGetIntegerv(GL_ACTIVE_TEXTURE, &active);
+    glActiveTexture(GL_TEXTURE0);
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &texture);
+
+    glUseProgram(mHeatmapProgram);
+    glUniform1i(mHeatmapInterface.Uniform(NAME_HASH("u_counts")), 0);
+    glBindTexture(GL_TEXTURE_2D, mTexture);
+    glBindVertexArray(mHeatmapVao);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+
+    glBindVertexArray(vao);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glActiveTexture(active);
+    glUseProgram(program);
+}
+
+void OverdrawMeter::ProcessReadbacks() {
+    // oldest first; stop at the first one still in flight
+    for (int i = 0; i < OVERDRAW_READBACKS; i++) {
+        Readback& rb = mReadbacks[(mNext + i) % OVERDRAW_READBACKS];
+        if (!rb.fence) {
+            continue;
+        }
+        GLenum r = glClientWaitSync(rb.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        if (r != GL_ALREADY_SIGNALED && r != GL_CONDITION_SATISFIED) {
+            break;
+        }
+        glDeleteSync(rb.fence);
+        rb.fence = 0;
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, rb.buffer);
+        const uint8_t *pixels = (const uint8_t*) glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+                (GLsizeiptr) mWidth * mHeight * 4, GL_MAP_READ_BIT);
+        if (pixels) {
+            Reduce(pixels, rb, &mReport);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            mHasReport = true;
+            WriteReport(mReport);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+}
+
+void OverdrawMeter::Reduce(const uint8_t *pixels, const Readback& rb, OverdrawReport *out) {
+    memset(out, 0, sizeof(*out));
+    out->frame = rb.frame;
+    out->width = mWidth;
+    out->height = mHeight;
+    out->pass_count = rb.pass_count;
+    for (int p = 0; p < rb.pass_count; p++) {
+        out->passes[p].name = rb.names[p];
+    }
+
+    uint64_t tile_sum[OVERDRAW_HEATMAP_ROWS][OVERDRAW_HEATMAP_COLS] = {};
+    uint32_t tile_pixels[OVERDRAW_HEATMAP_ROWS][OVERDRAW_HEATMAP_COLS] = {};
+    const uint32_t last = OVERDRAW_BUCKETS - 1;
+
+    for (int y = 0; y < mHeight; y++) {
+        int tr = y * OVERDRAW_HEATMAP_ROWS / mHeight;
+        const uint8_t *row = pixels + (size_t) y * mWidth * 4;
+
+        // a tile at a time, so that there is no division per pixel
+        for (int tc = 0; tc < OVERDRAW_HEATMAP_COLS; tc++) {
+            int x0 = tc * mWidth / OVERDRAW_HEATMAP_COLS;
+            int x1 = (tc + 1) * mWidth / OVERDRAW_HEATMAP_COLS;
+            uint64_t sum = 0;
+            for (int x = x0; x < x1; x++) {
+                const uint8_t *px = row + x * 4;
+                uint32_t total = 0;
+                for (int p = 0; p < rb.pass_count; p++) {
+                    out->passes[p].histogram[std::min<uint32_t>(px[p], last)]++;
+                    out->passes[p].fragments += px[p];
+                    total += px[p];
+                }
+                out->histogram[std::min(total, last)]++;
+                out->covered += total > 0;
+                out->max = std::max(out->max, total);
+                sum += total;
+            }
+            tile_sum[tr][tc] += sum;
+            tile_pixels[tr][tc] += x1 - x0;
+            out->fragments += sum;
+        }
+    }
+
+    for (int r = 0; r < OVERDRAW_HEATMAP_ROWS; r++) {
+        for (int c = 0; c < OVERDRAW_HEATMAP_COLS; c++) {
+            out->heatmap[r][c] = tile_pixels[r][c] ?
+                    (float) tile_sum[r][c] / tile_pixels[r][c] : 0.0f;
+        }
+    }
+}
+
+static void WriteHistogram(FILE *f, const uint32_t *histogram) {
+    fputc('[', f);
+    for (int i = 0; i < OVERDRAW_BUCKETS; i++) {
+        fprintf(f, "%s%u", i ? "," : "", histogram[i]);
+    }
+    fputc(']', f);
+}
+
+void OverdrawMeter::WriteReport(const OverdrawReport& r) {
+    if (!mReportFile) {
+        return;
+    }
+    FILE *f = mReportFile;
+    fprintf(f, "{\"frame\":%u,\"width\":%d,\"height\":%d,\"overdraw\":%.3f,\"fill\":%.3f,"
+               "\"max\":%u,\"histogram\":", r.frame, r.width, r.height, r.GetOverdraw(),
+               r.GetFill(), r.max);
+    WriteHistogram(f, r.histogram);
+
+    fprintf(f, ",\"passes\":[");
+    for (int p = 0; p < r.pass_count; p++) {
+        fprintf(f, "%s{\"name\":\"%s\",\"fragments\":%llu,\"histogram\":", p ? "," : "",
+                r.passes[p].name ? r.passes[p].name : "", (unsigned long long) r.passes[p].fragments);
+        WriteHistogram(f, r.passes[p].histogram);
+        fputc('}', f);
+    }
+
+    // top row first, the way it looks on screen
+    fprintf(f, "],\"heatmap\":[");
+    for (int row = OVERDRAW_HEATMAP_ROWS - 1; row >= 0; row--) {
+        fputc('[', f);
+        for (int c = 0; c < OVERDRAW_HEATMAP_COLS; c++) {
+            fprintf(f, "%s%.2f", c ? "," : "", r.heatmap[row][c]);
+        }
+        fprintf(f, "]%s", row ? "," : "");
+    }
+    fprintf(f, "]}\n");
+}
+
+bool OverdrawMeter::Poll(OverdrawReport *report) {
+    if (!mHasReport) {
+        return false;
+    }
+    *report = mReport;
+    mHasReport = false;
+    return true;
+}
@@ -0,0 +1,142 @@
+#ifndef endlesstunnel_overdraw_hpp
+#define endlesstunnel_overdraw_hpp
+
+#include <GLES3/gl3.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+
+#include "program_interface.hpp"
+
+// render passes counted separately in a frame (one per channel of the count target)
+#define OVERDRAW_MAX_PASSES 4
+
+// histogram buckets: 0, 1, ... (OVERDRAW_BUCKETS - 2) fragments, and that many or more
+#define OVERDRAW_BUCKETS 9
+
+// readbacks that can be in flight; results are typically available 1-2 frames later
+#define OVERDRAW_READBACKS 3
+
+// heatmap resolution, in tiles
+#define OVERDRAW_HEATMAP_COLS 16
+#define OVERDRAW_HEATMAP_ROWS 9
+
+// overdraw of a frame, per pass and in total. Fragment counts saturate at 255 per pixel and
+// pass.
+struct OverdrawReport {
+    uint32_t frame;
+    int width, height;
+
+    struct Pass {
+        const char *name;
+        uint64_t fragments;
+        uint32_t histogram[OVERDRAW_BUCKETS];
+    };
+    Pass passes[OVERDRAW_MAX_PASSES];
+    int pass_count;
+
+    uint64_t fragments;
+    uint32_t covered;  // pixels with at least one fragment
+    uint32_t max;
+    uint32_t histogram[OVERDRAW_BUCKETS];
+
+    // average fragments per pixel of each tile; row 0 is the bottom of the surface
+    float heatmap[OVERDRAW_HEATMAP_ROWS][OVERDRAW_HEATMAP_COLS];
+
+    // fragments per pixel drawn (overdraw proper), and per pixel of the surface (fill)
+    float GetOverdraw() const { return covered ? (float) fragments / covered : 0.0f; }
+    float GetFill() const {
+        return width > 0 && height > 0 ? (float) fragments / ((float) width * height) : 0.0f;
+    }
+};
+
+// Debug render mode that measures overdraw. While a frame is being measured, passes draw
+// into an offscreen RGBA8 target instead of the surface, with programs linked against
+// GetCountingShader() and additive blending, so each channel ends up holding how many
+// fragments its pass produced on each pixel. The target is read back asynchronously (pixel
+// pack buffers and fences, never stalling the pipeline) and reduced to an OverdrawReport,
+// one JSON line per frame; the surface shows the overdraw as a heatmap instead of the frame.
+//
+// Only core GLES 3.0 is used, so this also runs on Mesa's software renderer, headless (see
+// tools/overdraw_check.cpp). Report heatmaps are written top row first.
+class OverdrawMeter {
+    public:
+        OverdrawMeter();
+        ~OverdrawMeter();
+
+        // needs a current context. Reports are appended to report_path (none if NULL).
+        // Returns false (see GetError()) if the shaders can't be built or the file opened.
+        bool Init(const char *report_path);
+
+        // deletes the GL objects (pending readbacks are lost) and closes the report. Needs the
+        // context that Init() was called with.
+        void Shutdown();
+
+        bool IsActive() const { return mActive; }
+        const std::string& GetError() const { return mError; }
+
+        // fragment shader for the passes' programs, with a "#version 300 es" vertex shader
+        GLuint GetCountingShader() const { return mCountingShader; }
+
+        // binds and clears the count target, and masks its channels until BeginPass().
+        // Returns false (and does nothing) if not active.
+        bool BeginFrame(int width, int height, uint32_t frame);
+
+        // draws until EndPass() are counted as the given pass (name must outlive the report).
+        // Draws outside of a pass, or in passes past OVERDRAW_MAX_PASSES, write nothing.
+        void BeginPass(const char *name);
+        void EndPass();
+
+        // unmasks the channels, starts the readback, draws the heatmap on the default
+        // framebuffer (with its viewport, scissor and program and vertex array bindings
+        // preserved) and processes the readbacks that have completed
+        void EndFrame();
+
+        // latest processed report (false if none yet). Each report is returned once.
+        bool Poll(OverdrawReport *report);
+
+        // frames that weren't measured because all the readbacks were in flight
+        uint32_t GetSkipped() const { return mSkipped; }
+
+    private:
+        struct Readback {
+            GLuint buffer;
+            GLsync fence;
+            uint32_t frame;
+            const char *names[OVERDRAW_MAX_PASSES];
+            int pass_count;
+        };
+
+        bool mActive;
+        std::string mError;
+        FILE *mReportFile;
+
+        GLuint mCountingShader;
+        GLuint mHeatmapProgram;
+        ProgramInterface mHeatmapInterface;
+        GLuint mHeatmapVao;
+        GLuint mTexture, mFramebuffer;
+        int mWidth, mHeight;
+
+        Readback mReadbacks[OVERDRAW_READBACKS];
+        int mNext;
+        uint32_t mSkipped;
+
+        // frame being measured
+        bool mInFrame;
+        uint32_t mFrame;
+        const char *mPassNames[OVERDRAW_MAX_PASSES];
+        int mPassCount;
+
+        OverdrawReport mReport;
+        bool mHasReport;
+
+        bool Resize(int width, int height);
+        void DrawHeatmap();
+        void ProcessReadbacks();
+        void Reduce(const uint8_t *pixels, const Readback& rb, OverdrawReport *out);
+        void WriteReport(const OverdrawReport& r);
+        GLuint Compile(GLenum type, const char *src);
+};
+
+#endif
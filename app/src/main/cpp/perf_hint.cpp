@@ -0,0 +1,295 @@
+#include <dirent.h>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <cstring>
+
+#include "log.hpp"
+#include "perf_hint.hpp"
+#include "trace.hpp"
+
+// how often we look at the thermal state
+#define THERMAL_POLL_INTERVAL_NS 1000000000ull
+
+// how far ahead the thermal headroom forecast looks
+#define THERMAL_FORECAST_SECONDS 3
+
+// signatures of the NDK functions we use (android/performance_hint.h, android/thermal.h)
+typedef void* (*PFN_getManager)();
+typedef void* (*PFN_createSession)(void *manager, const int32_t *tids, size_t size,
+                                   int64_t target);
+typedef int (*PFN_updateTarget)(void *session, int64_t target);
+typedef int (*PFN_reportActual)(void *session, int64_t actual);
+typedef void (*PFN_closeSession)(void *session);
+typedef void* (*PFN_acquireThermal)();
+typedef void (*PFN_releaseThermal)(void *manager);
+typedef int (*PFN_getStatus)(void *manager);
+typedef float (*PFN_getHeadroom)(void *manager, int forecast_seconds);
+
+// maps headroom (1.0 = throttling) to a state
+static ThermalState _state_from_headroom(float h) {
+    if (h < 0.7f) return ThermalState::Nominal;
+    if (h < 0.85f) return ThermalState::Light;
+    if (h < 0.95f) return ThermalState::Moderate;
+    if (h < 1.05f) return ThermalState::Severe;
+    return ThermalState::Critical;
+}
+
+PerformanceHint::PerformanceHint() {
+    mLib = mHintManager = mHintSession = mThermalManager = NULL;
+    mUpdateTarget = mReportActual = mCloseSession = NULL;
+    mGetHeadroom = mGetStatus = mReleaseThermal = NULL;
+    mTargetNs = 0;
+    mLastPollNs = 0;
+    mThermalState.store((int) ThermalState::Nominal);
+    mHeadroom.store(-1.0f);
+    mSysfsRoot = "/sys";
+    mSysfsOpened = false;
+}
+
+PerformanceHint::~PerformanceHint() {
+    Shutdown();
+}
+
+void PerformanceHint::LoadPlatformApis() {
+    mLib = dlopen("libandroid.so", RTLD_NOW | RTLD_LOCAL);
+    if (!mLib) {
+        return;
+    }
+
+    PFN_getManager get_manager = (PFN_getManager) dlsym(mLib, "APerformanceHint_getManager");
+    PFN_createSession create_session =
+            (PFN_createSession) dlsym(mLib, "APerformanceHint_createSession");
+    mUpdateTarget = dlsym(mLib, "APerformanceHint_updateTargetWorkDuration");
+    mReportActual = dlsym(mLib, "APerformanceHint_reportActualWorkDuration");
+    mCloseSession = dlsym(mLib, "APerformanceHint_closeSession");
+
+    if (get_manager && create_session && mUpdateTarget && mReportActual && mCloseSession) {
+        mHintManager = get_manager();
+        int32_t tid = gettid();
+        mHintSession = mHintManager ? create_session(mHintManager, &tid, 1, mTargetNs) : NULL;
+    }
+
+    PFN_acquireThermal acquire = (PFN_acquireThermal) dlsym(mLib, "AThermal_acquireManager");
+    mReleaseThermal = dlsym(mLib, "AThermal_releaseManager");
+    mGetStatus = dlsym(mLib, "AThermal_getCurrentThermalStatus");
+    mGetHeadroom = dlsym(mLib, "AThermal_getThermalHeadroom");
+    if (acquire && mReleaseThermal && mGetStatus) {
+        mThermalManager = acquire();
+    }
+}
+
+bool PerformanceHint::Init(int64_t target_ns) {
+    mTargetNs = target_ns;
+    LoadPlatformApis();
+
+    LOGD("PerformanceHint: hint session %s, thermal %s.", mHintSession ? "ADPF" : "none",
+         mThermalManager ? "AThermal" : "sysfs");
+    return mHintSession != NULL;
+}
+
+void PerformanceHint::Shutdown() {
+    if (mHintSession) {
+        ((PFN_closeSession) mCloseSession)(mHintSession);
+        mHintSession = NULL;
+    }
+    if (mThermalManager) {
+        ((PFN_releaseThermal) mReleaseThermal)(mThermalManager);
+        mThermalManager = NULL;
+    }
+    if (mLib) {
+        dlclose(mLib);
+        mLib = NULL;
+    }
+    CloseSysfs();
+}
+
+void PerformanceHint::UpdateTarget(int64_t target_ns) {
+    // the platform wants to hear about this only when it actually changes
+    if (target_ns == mTargetNs) {
+        return;
+    }
+    mTargetNs = target_ns;
+    if (mHintSession) {
+        ((PFN_updateTarget) mUpdateTarget)(mHintSession, target_ns);
+    }
+}
+
+void PerformanceHint::ReportWork(int64_t actual_ns) {
+    if (mHintSession && actual_ns > 0) {
+        ((PFN_reportActual) mReportActual)(mHintSession, actual_ns);
+    }
+}
+
+bool PerformanceHint::PollPlatform(float *headroom, ThermalState *state) {
+    if (!mThermalManager) {
+        return false;
+    }
+
+    // ATHERMAL_STATUS_*: 0 none, 1 light, 2 moderate, 3 severe, 4 critical, 5 emergency,
+    // 6 shutdown (and -1 on error)
+    int status = ((PFN_getStatus) mGetStatus)(mThermalManager);
+    *headroom = mGetHeadroom ?
+            ((PFN_getHeadroom) mGetHeadroom)(mThermalManager, THERMAL_FORECAST_SECONDS) : -1.0f;
+
+    if (status < 0) {
+        return false;
+    }
+    *state = (ThermalState) (status > (int) ThermalState::Critical ?
+            (int) ThermalState::Critical : status);
+
+    // the headroom forecast gives an earlier warning than the status
+    if (*headroom == *headroom && *headroom >= 0.0f) {
+        ThermalState forecast = _state_from_headroom(*headroom);
+        if (forecast > *state) {
+            *state = forecast;
+        }
+    }
+    return true;
+}
+
+static bool _read_long(const char *path, long *out) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        return false;
+    }
+    bool ok = (fscanf(f, "%ld", out) == 1);
+    fclose(f);
+    return ok;
+}
+
+// re-reads a sysfs attribute from an open fd (sysfs regenerates the contents on each read at
+// offset 0)
+static bool _pread_long(int fd, long *out) {
+    char buf[32];
+    ssize_t n = pread(fd, buf, sizeof(buf) - 1, 0);
+    if (n <= 0) {
+        return false;
+    }
+    buf[n] = 0;
+    char *end;
+    *out = strtol(buf, &end, 10);
+    return end != buf;
+}
+
+void PerformanceHint::OpenSysfs() {
+    mSysfsOpened = true;
+    std::string base = mSysfsRoot + "/class/thermal";
+
+    // thermal zones with a (passive) trip point to compare against
+    DIR *dir = opendir(base.c_str());
+    if (dir) {
+        struct dirent *ent;
+        while ((ent = readdir(dir)) != NULL) {
+            if (strncmp(ent->d_name, "thermal_zone", 12) != 0) {
+                continue;
+            }
+            std::string zone = base + "/" + ent->d_name;
+            long trip;
+            if (!_read_long((zone + "/trip_point_0_temp").c_str(), &trip) || trip <= 0) {
+                continue;
+            }
+            int fd = open((zone + "/temp").c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd >= 0) {
+                mZones.push_back({ fd, trip });
+            }
+        }
+        closedir(dir);
+    }
+
+    // cpufreq policies (one per cluster; CPUs in a cluster share their clock)
+    for (int policy = 0; policy < 64; policy++) {
+        std::string policy_dir = mSysfsRoot + "/devices/system/cpu/cpufreq/policy" +
+                std::to_string(policy);
+        long max_hw;
+        if (!_read_long((policy_dir + "/cpuinfo_max_freq").c_str(), &max_hw) || max_hw <= 0) {
+            continue;
+        }
+        int fd = open((policy_dir + "/scaling_max_freq").c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd >= 0) {
+            mPolicies.push_back({ fd, max_hw });
+        }
+    }
+
+    LOGD("PerformanceHint: polling %zu thermal zones, %zu cpufreq policies in %s.",
+         mZones.size(), mPolicies.size(), mSysfsRoot.c_str());
+}
+
+void PerformanceHint::CloseSysfs() {
+    for (ThermalZone& z : mZones) {
+        close(z.temp_fd);
+    }
+    for (CpuPolicy& p : mPolicies) {
+        close(p.max_now_fd);
+    }
+    mZones.clear();
+    mPolicies.clear();
+    mSysfsOpened = false;
+}
+
+bool PerformanceHint::PollSysfs(float *headroom, ThermalState *state) {
+    if (!mSysfsOpened) {
+        OpenSysfs();
+    }
+
+    // thermal zones: how close is each one to its first (passive) trip point?
+    float worst = -1.0f;
+    for (const ThermalZone& z : mZones) {
+        long temp;
+        if (_pread_long(z.temp_fd, &temp)) {
+            float h = (float) temp / (float) z.trip;
+            if (h > worst) {
+                worst = h;
+            }
+        }
+    }
+
+    // cpufreq: a cluster whose max clock was lowered below its hardware max is being throttled
+    float min_ratio = 1.0f;
+    for (const CpuPolicy& p : mPolicies) {
+        long max_now;
+        if (_pread_long(p.max_now_fd, &max_now)) {
+            float ratio = (float) max_now / (float) p.max_hw;
+            if (ratio < min_ratio) {
+                min_ratio = ratio;
+            }
+        }
+    }
+
+    if (worst < 0.0f && min_ratio >= 1.0f) {
+        return false;
+    }
+
+    *headroom = worst;
+    *state = worst >= 0.0f ? _state_from_headroom(worst) : ThermalState::Nominal;
+    if (min_ratio < 0.9f && *state < ThermalState::Severe) {
+        *state = ThermalState::Severe;
+    }
+    return true;
+}
+
+void PerformanceHint::Poll(uint64_t now_ns) {
+    if (mLastPollNs && now_ns - mLastPollNs < THERMAL_POLL_INTERVAL_NS) {
+        return;
+    }
+    mLastPollNs = now_ns;
+
+    float headroom = -1.0f;
+    ThermalState state = ThermalState::Nominal;
+    if (!PollPlatform(&headroom, &state) && !PollSysfs(&headroom, &state)) {
+        return;
+    }
+
+    ThermalState old = GetThermalState();
+    mHeadroom.store(headroom, std::memory_order_relaxed);
+    mThermalState.store((int) state, std::memory_order_relaxed);
+
+    Trace::GetInstance()->Counter("thermal_headroom", now_ns, headroom);
+    if (state != old) {
+        LOGI("PerformanceHint: thermal state %s -> %s (headroom %.2f)", ThermalStateName(old),
+             ThermalStateName(state), headroom);
+    }
+}
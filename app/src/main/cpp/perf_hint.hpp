@@ -0,0 +1,97 @@
+#ifndef endlesstunnel_perf_hint_hpp
+#define endlesstunnel_perf_hint_hpp
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <vector>
+
+// coarse thermal state, for the rest of the engine to react to
+enum class ThermalState : int {
+    Nominal = 0,  // plenty of headroom
+    Light,        // getting warm
+    Moderate,     // throttling is near; time to reduce load
+    Severe,       // throttling
+    Critical,     // heavy throttling, reduce load as much as possible
+};
+
+static inline const char *ThermalStateName(ThermalState s) {
+    static const char *names[] = { "nominal", "light", "moderate", "severe", "critical" };
+    return names[(int) s];
+}
+
+// Reports our per-frame work to the platform so it can pick CPU clocks that meet the frame
+// deadline (ADPF APerformanceHintManager on Android 13+), and keeps track of how close the
+// device is to thermal throttling.
+//
+// The platform APIs are looked up at runtime, since they are newer than our minSdk. Where the
+// thermal API is missing (older devices, or Linux), thermal state is derived from
+// /sys/class/thermal (zone temperature vs. its first trip point) and cpufreq (current vs. max
+// clock of the CPUs), so the control loop also runs off-device: see tools/perf_hint_check.cpp.
+// The sysfs files are found and opened on the first poll, and re-read in place after that.
+class PerformanceHint {
+    public:
+        PerformanceHint();
+        ~PerformanceHint();
+
+        // target_ns is the frame budget. Must be called on the thread doing the frame work
+        // (it is the one the hint session applies to).
+        bool Init(int64_t target_ns);
+
+        // where sysfs is ("/sys" unless testing). Before the first Poll().
+        void SetSysfsRoot(const char *root) { mSysfsRoot = root; }
+        void Shutdown();
+
+        void UpdateTarget(int64_t target_ns);
+
+        // reports how long this frame's work actually took
+        void ReportWork(int64_t actual_ns);
+
+        // re-reads the thermal state, at most once per THERMAL_POLL_INTERVAL_NS. Call every frame.
+        void Poll(uint64_t now_ns);
+
+        // may be read from any thread
+        ThermalState GetThermalState() const {
+            return (ThermalState) mThermalState.load(std::memory_order_relaxed);
+        }
+
+        // 1.0 is where throttling starts (0 = cold). Negative if unknown.
+        float GetThermalHeadroom() const { return mHeadroom.load(std::memory_order_relaxed); }
+
+    private:
+        // ADPF / thermal entry points (NULL if unavailable)
+        void *mLib;
+        void *mHintManager;
+        void *mHintSession;
+        void *mThermalManager;
+        void *mUpdateTarget, *mReportActual, *mCloseSession;
+        void *mGetHeadroom, *mGetStatus, *mReleaseThermal;
+
+        int64_t mTargetNs;
+        uint64_t mLastPollNs;
+
+        std::atomic<int> mThermalState;
+        std::atomic<float> mHeadroom;
+
+        // the sysfs files we poll, kept open; the maximums don't change, so they're read once
+        struct ThermalZone {
+            int temp_fd;
+            long trip;
+        };
+        struct CpuPolicy {
+            int max_now_fd;
+            long max_hw;
+        };
+        std::string mSysfsRoot;
+        bool mSysfsOpened;
+        std::vector<ThermalZone> mZones;
+        std::vector<CpuPolicy> mPolicies;
+
+        void LoadPlatformApis();
+        bool PollPlatform(float *headroom, ThermalState *state);
+        void OpenSysfs();
+        void CloseSysfs();
+        bool PollSysfs(float *headroom, ThermalState *state);
+};
+
+#endif
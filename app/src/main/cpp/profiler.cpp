@@ -0,0 +1,484 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/perf_event.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#include <cstring>
+
+#include "profiler.hpp"
+
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+static pid_t _gettid() {
+    return (pid_t) syscall(SYS_gettid);
+}
+
+SamplingProfiler *SamplingProfiler::GetInstance() {
+    static SamplingProfiler instance;
+    return &instance;
+}
+
+SamplingProfiler::SamplingProfiler() : mThreadCount(0), mHead(0), mTail(0), mDropped(0),
+                                       mStopCollector(false) {
+    memset(mThreads, 0, sizeof(mThreads));
+    for (uint32_t i = 0; i < PROFILER_RING_SIZE; i++) {
+        mRing[i].seq.store(i, std::memory_order_relaxed);
+    }
+    mRunning = false;
+    mUsePerf = false;
+    mSamples = 0;
+}
+
+bool SamplingProfiler::RegisterThread(const char *name) {
+    std::lock_guard<std::mutex> lock(mRegisterMutex);
+    int n = mThreadCount.load(std::memory_order_relaxed);
+    if (n == PROFILER_MAX_THREADS) {
+        return false;
+    }
+
+    Thread *t = &mThreads[n];
+    memset(t, 0, sizeof(*t));
+    t->tid = _gettid();
+    strncpy(t->name, name, sizeof(t->name) - 1);
+    t->perf_fd = -1;
+
+    // stack bounds, so that the unwinder never follows a frame pointer out of the stack
+    pthread_attr_t attr;
+    if (0 == pthread_getattr_np(pthread_self(), &attr)) {
+        void *addr;
+        size_t size;
+        pthread_attr_getstack(&attr, &addr, &size);
+        t->stack_lo = (uintptr_t) addr;
+        t->stack_hi = (uintptr_t) addr + size;
+        pthread_attr_destroy(&attr);
+    }
+    if (0 != pthread_getcpuclockid(pthread_self(), &t->cpu_clock)) {
+        return false;
+    }
+
+    // published last: the signal handler looks threads up by tid
+    mThreadCount.store(n + 1, std::memory_order_release);
+    return true;
+}
+
+bool SamplingProfiler::Start(int rate_hz, bool try_perf) {
+    if (mRunning || rate_hz <= 0) {
+        return false;
+    }
+    mStacks.clear();
+    mSamples = 0;
+    mDropped.store(0, std::memory_order_relaxed);
+
+    mUsePerf = try_perf && StartPerf(rate_hz);
+    if (!mUsePerf && !StartSigprof(rate_hz)) {
+        return false;
+    }
+
+    mRunning = true;
+    mStopCollector.store(false);
+    mCollector = std::thread([this] { CollectorMain(); });
+    return true;
+}
+
+bool SamplingProfiler::StartPerf(int rate_hz) {
+    long page = sysconf(_SC_PAGESIZE);
+    int n = mThreadCount.load(std::memory_order_acquire);
+
+    for (int i = 0; i < n; i++) {
+        Thread *t = &mThreads[i];
+
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_SOFTWARE;
+        attr.config = PERF_COUNT_SW_TASK_CLOCK;
+        // the task clock counts nanoseconds of the thread's CPU time
+        attr.sample_period = 1000000000ULL / rate_hz;
+        attr.sample_type = PERF_SAMPLE_TID | PERF_SAMPLE_CALLCHAIN;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.exclude_callchain_kernel = 1;
+
+        t->perf_fd = (int) syscall(SYS_perf_event_open, &attr, t->tid, -1, -1,
+                                   PERF_FLAG_FD_CLOEXEC);
+        if (t->perf_fd < 0) {
+            // not allowed (perf_event_paranoid) or not supported: fall back for all threads
+            StopSources();
+            return false;
+        }
+
+        // one metadata page, followed by the ring buffer
+        t->perf_buf = mmap(nullptr, (1 + PROFILER_PERF_PAGES) * page, PROT_READ | PROT_WRITE,
+                           MAP_SHARED, t->perf_fd, 0);
+        if (t->perf_buf == MAP_FAILED) {
+            t->perf_buf = nullptr;
+            StopSources();
+            return false;
+        }
+    }
+
+    for (int i = 0; i < n; i++) {
+        ioctl(mThreads[i].perf_fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+    return n > 0;
+}
+
+bool SamplingProfiler::StartSigprof(int rate_hz) {
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = OnSigprof;
+    sa.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    if (0 != sigaction(SIGPROF, &sa, nullptr)) {
+        return false;
+    }
+
+    long interval_ns = 1000000000L / rate_hz;
+    int n = mThreadCount.load(std::memory_order_acquire);
+    int started = 0;
+
+    for (int i = 0; i < n; i++) {
+        Thread *t = &mThreads[i];
+
+        // a timer on the thread's own CPU clock, delivering the signal to that thread
+        struct sigevent sev;
+        memset(&sev, 0, sizeof(sev));
+        sev.sigev_notify = SIGEV_THREAD_ID;
+        sev.sigev_signo = SIGPROF;
+        sev.sigev_notify_thread_id = t->tid;
+        if (0 != timer_create(t->cpu_clock, &sev, &t->timer)) {
+            continue;
+        }
+        t->has_timer = true;
+
+        struct itimerspec its;
+        its.it_interval.tv_sec = interval_ns / 1000000000L;
+        its.it_interval.tv_nsec = interval_ns % 1000000000L;
+        its.it_value = its.it_interval;
+        timer_settime(t->timer, 0, &its, nullptr);
+        started++;
+    }
+    return started > 0;
+}
+
+void SamplingProfiler::StopSources() {
+    int n = mThreadCount.load(std::memory_order_acquire);
+
+    for (int i = 0; i < n; i++) {
+        Thread *t = &mThreads[i];
+        if (t->perf_fd >= 0) {
+            ioctl(t->perf_fd, PERF_EVENT_IOC_DISABLE, 0);
+        }
+        if (t->has_timer) {
+            timer_delete(t->timer);
+            t->has_timer = false;
+        }
+    }
+}
+
+bool SamplingProfiler::Stop(const char *path) {
+    if (!mRunning) {
+        return false;
+    }
+    StopSources();
+
+    mStopCollector.store(true);
+    mCollectorGate.Open();
+    mCollector.join();
+    // whatever came in since the collector's last pass
+    Collect();
+
+    // unmap the perf buffers and restore the default SIGPROF action (a signal may still be
+    // pending, so ignore rather than default, which would kill us)
+    long page = sysconf(_SC_PAGESIZE);
+    int n = mThreadCount.load(std::memory_order_acquire);
+    for (int i = 0; i < n; i++) {
+        Thread *t = &mThreads[i];
+        if (t->perf_buf) {
+            munmap(t->perf_buf, (1 + PROFILER_PERF_PAGES) * page);
+            t->perf_buf = nullptr;
+        }
+        if (t->perf_fd >= 0) {
+            close(t->perf_fd);
+            t->perf_fd = -1;
+        }
+    }
+    if (!mUsePerf) {
+        signal(SIGPROF, SIG_IGN);
+    }
+
+    mRunning = false;
+    return Write(path);
+}
+
+// Walks the frame records: on both arm64 and x86-64, fp points at {previous fp, return address}.
+// Runs in the signal handler, so it only reads memory known to be in the thread's stack.
+//
+// A leaf function (or one still in its prologue) has no frame record of its own, so fp is
+// its caller's and the walk would skip the caller. On arm64 the caller is in the link register:
+// lr, if not 0, goes in right after pc. When the function does have a record, that's where lr
+// was saved, so the first return address found is then the same and isn't repeated. (When it
+// has called something since, lr points back into it; profile_symbolize drops that one.)
+static uint32_t UnwindFramePointers(uintptr_t pc, uintptr_t lr, uintptr_t fp, uintptr_t lo,
+                                    uintptr_t hi, uint64_t *ips) {
+    uint32_t depth = 0;
+    ips[depth++] = pc;
+    if (lr) {
+        ips[depth++] = lr;
+    }
+    while (depth < PROFILER_MAX_DEPTH) {
+        if (fp < lo || fp > hi - 2 * sizeof(uintptr_t) || (fp & (sizeof(uintptr_t) - 1))) {
+            break;
+        }
+        const uintptr_t *frame = (const uintptr_t*) fp;
+        uintptr_t ret = frame[1];
+        if (ret == 0) {
+            break;
+        }
+        if (!(depth == 2 && lr && ret == lr)) {
+            ips[depth++] = ret;
+        }
+        // the stack grows down, so callers' frames are at higher addresses
+        if (frame[0] <= fp) {
+            break;
+        }
+        fp = frame[0];
+    }
+    return depth;
+}
+
+void SamplingProfiler::OnSigprof(int, siginfo_t*, void *ucontext) {
+    SamplingProfiler *p = GetInstance();
+    int saved_errno = errno;
+
+    pid_t tid = _gettid();
+    const Thread *t = nullptr;
+    int n = p->mThreadCount.load(std::memory_order_acquire);
+    for (int i = 0; i < n; i++) {
+        if (p->mThreads[i].tid == tid) {
+            t = &p->mThreads[i];
+            break;
+        }
+    }
+    if (!t) {
+        errno = saved_errno;
+        return;
+    }
+
+    ucontext_t *uc = (ucontext_t*) ucontext;
+    // only seeded on arm64: x86 has the return address on the stack, and 32-bit arm frame
+    // records aren't standard enough to tell whether lr was saved in one
+    uintptr_t lr = 0;
+#if defined(__aarch64__)
+    uintptr_t pc = uc->uc_mcontext.pc;
+    uintptr_t fp = uc->uc_mcontext.regs[29];
+    lr = uc->uc_mcontext.regs[30];
+#elif defined(__x86_64__)
+    uintptr_t pc = uc->uc_mcontext.gregs[REG_RIP];
+    uintptr_t fp = uc->uc_mcontext.gregs[REG_RBP];
+#elif defined(__arm__)
+    uintptr_t pc = uc->uc_mcontext.arm_pc;
+    uintptr_t fp = uc->uc_mcontext.arm_fp;
+#elif defined(__i386__)
+    uintptr_t pc = uc->uc_mcontext.gregs[REG_EIP];
+    uintptr_t fp = uc->uc_mcontext.gregs[REG_EBP];
+#else
+    uintptr_t pc = 0, fp = 0;
+#endif
+
+    // claim a slot
+    uint32_t pos = p->mHead.load(std::memory_order_relaxed);
+    Sample *slot;
+    for (;;) {
+        slot = &p->mRing[pos % PROFILER_RING_SIZE];
+        uint32_t seq = slot->seq.load(std::memory_order_acquire);
+        int32_t diff = (int32_t) (seq - pos);
+        if (diff == 0) {
+            if (p->mHead.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // the collector is behind
+            p->mDropped.fetch_add(1, std::memory_order_relaxed);
+            errno = saved_errno;
+            return;
+        } else {
+            pos = p->mHead.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->tid = tid;
+    slot->depth = UnwindFramePointers(pc, lr, fp, t->stack_lo, t->stack_hi, slot->ips);
+    slot->seq.store(pos + 1, std::memory_order_release);
+    errno = saved_errno;
+}
+
+void SamplingProfiler::Suspend() {
+    if (mRunning) {
+        mCollectorGate.Close();
+        mCollectorGate.WaitParked(1, PROFILER_COLLECT_INTERVAL_MS);
+    }
+}
+
+void SamplingProfiler::Resume() {
+    mCollectorGate.Open();
+}
+
+void SamplingProfiler::CollectorMain() {
+    while (!mStopCollector.load()) {
+        mCollectorGate.Sleep(PROFILER_COLLECT_INTERVAL_MS);
+        Collect();
+        mCollectorGate.Pass();
+    }
+}
+
+void SamplingProfiler::Collect() {
+    if (mUsePerf) {
+        int n = mThreadCount.load(std::memory_order_acquire);
+        for (int i = 0; i < n; i++) {
+            CollectPerf(&mThreads[i]);
+        }
+        return;
+    }
+
+    for (;;) {
+        Sample *slot = &mRing[mTail % PROFILER_RING_SIZE];
+        if (slot->seq.load(std::memory_order_acquire) != mTail + 1) {
+            break;
+        }
+        Aggregate(slot->tid, slot->ips, slot->depth);
+        slot->seq.store(mTail + PROFILER_RING_SIZE, std::memory_order_release);
+        mTail++;
+    }
+}
+
+void SamplingProfiler::CollectPerf(Thread *t) {
+    if (!t->perf_buf) {
+        return;
+    }
+    long page = sysconf(_SC_PAGESIZE);
+    struct perf_event_mmap_page *meta = (struct perf_event_mmap_page*) t->perf_buf;
+    const uint8_t *data = (const uint8_t*) t->perf_buf + page;
+    uint64_t size = (uint64_t) PROFILER_PERF_PAGES * page;
+
+    uint64_t head = __atomic_load_n(&meta->data_head, __ATOMIC_ACQUIRE);
+    uint64_t tail = meta->data_tail;
+
+    // records may wrap around the end of the buffer; copy each one out first
+    uint8_t record[sizeof(struct perf_event_header) + 8 * (PROFILER_MAX_DEPTH + 8)];
+    while (tail < head) {
+        struct perf_event_header header;
+        for (size_t i = 0; i < sizeof(header); i++) {
+            ((uint8_t*) &header)[i] = data[(tail + i) % size];
+        }
+        if (header.size == 0) {
+            break;
+        }
+
+        if (header.type == PERF_RECORD_SAMPLE) {
+            size_t len = header.size < sizeof(record) ? header.size : sizeof(record);
+            for (size_t i = 0; i < len; i++) {
+                record[i] = data[(tail + i) % size];
+            }
+
+            // PERF_SAMPLE_TID (pid, tid), then PERF_SAMPLE_CALLCHAIN (nr, ips[nr])
+            const uint8_t *p = record + sizeof(header);
+            uint32_t tid;
+            uint64_t nr;
+            memcpy(&tid, p + 4, 4);
+            memcpy(&nr, p + 8, 8);
+            const uint8_t *ips = p + 16;
+            uint64_t max_nr = (len - (ips - record)) / 8;
+
+            uint64_t stack[PROFILER_MAX_DEPTH];
+            uint32_t depth = 0;
+            for (uint64_t i = 0; i < nr && i < max_nr && depth < PROFILER_MAX_DEPTH; i++) {
+                uint64_t ip;
+                memcpy(&ip, ips + 8 * i, 8);
+                // context markers (PERF_CONTEXT_USER, ...) aren't addresses
+                if (ip >= (uint64_t) PERF_CONTEXT_MAX) {
+                    continue;
+                }
+                stack[depth++] = ip;
+            }
+            if (depth) {
+                Aggregate((pid_t) tid, stack, depth);
+            }
+        } else if (header.type == PERF_RECORD_LOST) {
+            uint64_t lost;
+            for (size_t i = 0; i < 8; i++) {
+                ((uint8_t*) &lost)[i] = data[(tail + sizeof(header) + 8 + i) % size];
+            }
+            mDropped.fetch_add((uint32_t) lost, std::memory_order_relaxed);
+        }
+        tail += header.size;
+    }
+
+    __atomic_store_n(&meta->data_tail, tail, __ATOMIC_RELEASE);
+}
+
+void SamplingProfiler::Aggregate(pid_t tid, const uint64_t *ips, uint32_t depth) {
+    std::string key((const char*) &tid, sizeof(tid));
+    key.append((const char*) ips, depth * sizeof(uint64_t));
+    mStacks[key]++;
+    mSamples++;
+}
+
+// Text format, one record per line:
+//   profile <mode> <samples> <dropped>
+//   map <start> <end> <file offset> <path>      (executable mappings, hex)
+//   thread <tid> <name>
+//   stack <count> <tid> <addr> <addr> ...       (leaf first, hex)
+bool SamplingProfiler::Write(const char *path) {
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        return false;
+    }
+
+    fprintf(f, "profile %s %llu %u\n", GetMode(), (unsigned long long) mSamples, GetDropped());
+
+    FILE *maps = fopen("/proc/self/maps", "r");
+    if (maps) {
+        char line[512];
+        while (fgets(line, sizeof(line), maps)) {
+            unsigned long long start, end, offset;
+            char perms[8];
+            int path_pos = 0;
+            if (4 == sscanf(line, "%llx-%llx %7s %llx %*s %*s %n", &start, &end, perms, &offset,
+                            &path_pos) && perms[2] == 'x' && path_pos > 0 && line[path_pos]) {
+                line[strcspn(line, "\n")] = 0;
+                fprintf(f, "map %llx %llx %llx %s\n", start, end, offset, line + path_pos);
+            }
+        }
+        fclose(maps);
+    }
+
+    int n = mThreadCount.load(std::memory_order_acquire);
+    for (int i = 0; i < n; i++) {
+        fprintf(f, "thread %d %s\n", (int) mThreads[i].tid, mThreads[i].name);
+    }
+
+    for (const auto& it : mStacks) {
+        pid_t tid;
+        memcpy(&tid, it.first.data(), sizeof(tid));
+        size_t depth = (it.first.size() - sizeof(tid)) / sizeof(uint64_t);
+        fprintf(f, "stack %u %d", it.second, (int) tid);
+        for (size_t i = 0; i < depth; i++) {
+            uint64_t ip;
+            memcpy(&ip, it.first.data() + sizeof(tid) + i * sizeof(uint64_t), sizeof(ip));
+            fprintf(f, " %llx", (unsigned long long) ip);
+        }
+        fprintf(f, "\n");
+    }
+
+    return 0 == fclose(f);
+}
@@ -0,0 +1,126 @@
+#ifndef endlesstunnel_profiler_hpp
+#define endlesstunnel_profiler_hpp
+
+#include <signal.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <time.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include "suspend.hpp"
+
+// max threads that can be profiled
+#define PROFILER_MAX_THREADS 8
+
+// deepest stack recorded (frames past this, towards the root, are cut)
+#define PROFILER_MAX_DEPTH 64
+
+// samples that can be waiting for the collector thread (SIGPROF mode)
+#define PROFILER_RING_SIZE 1024
+
+// size of each thread's perf ring buffer, in pages (must be a power of 2)
+#define PROFILER_PERF_PAGES 64
+
+// how often the collector thread picks up samples
+#define PROFILER_COLLECT_INTERVAL_MS 20
+
+// Sampling CPU profiler. Threads register themselves; while running, each one is sampled at
+// the given rate of its own CPU time (so idle threads cost nothing), and its stack is unwound
+// with frame pointers (the library is built with -fno-omit-frame-pointer).
+//
+// Samples come from perf_event_open where allowed (the kernel unwinds the stack), or from
+// per-thread SIGPROF timers otherwise (e.g. perf_event_paranoid > 1, as on most Android
+// builds). CPU-time timers only fire on scheduler ticks, so SIGPROF rates are capped at the
+// kernel's HZ (usually 250 Hz). Identical stacks are aggregated as they come in, and written
+// out as raw addresses along with the executable mappings; tools/profile_symbolize turns that
+// into collapsed stacks for flame graphs.
+class SamplingProfiler {
+    public:
+        static SamplingProfiler *GetInstance();
+
+        // registers the calling thread. Threads registered while running aren't sampled until
+        // the next Start().
+        bool RegisterThread(const char *name);
+
+        // starts sampling the registered threads rate_hz times per second of CPU time. With
+        // try_perf false, goes straight to SIGPROF timers.
+        bool Start(int rate_hz, bool try_perf = true);
+
+        // stops sampling and writes the profile. Returns false if it wasn't running or the
+        // file can't be written.
+        bool Stop(const char *path);
+
+        bool IsRunning() const { return mRunning; }
+
+        // parks the collector thread (while the app is paused; sampling itself costs nothing
+        // when threads don't run), until Resume()
+        void Suspend();
+        void Resume();
+
+        // "perf_event" or "sigprof" (valid once started)
+        const char *GetMode() const { return mUsePerf ? "perf_event" : "sigprof"; }
+
+        uint64_t GetSampleCount() const { return mSamples; }
+        uint32_t GetDropped() const { return mDropped.load(std::memory_order_relaxed); }
+
+    private:
+        SamplingProfiler();
+
+        struct Thread {
+            pid_t tid;
+            char name[16];
+            uintptr_t stack_lo, stack_hi;
+            clockid_t cpu_clock;
+            int perf_fd;
+            void *perf_buf;
+            timer_t timer;
+            bool has_timer;
+        };
+
+        // a sample in flight from the signal handler to the collector (Vyukov bounded queue,
+        // like JavaRequestQueue: seq == pos means free for the producer at pos, pos + 1 full)
+        struct Sample {
+            std::atomic<uint32_t> seq;
+            pid_t tid;
+            uint32_t depth;
+            uint64_t ips[PROFILER_MAX_DEPTH];
+        };
+
+        Thread mThreads[PROFILER_MAX_THREADS];
+        std::atomic<int> mThreadCount;
+        std::mutex mRegisterMutex;
+
+        Sample mRing[PROFILER_RING_SIZE];
+        std::atomic<uint32_t> mHead;
+        uint32_t mTail;
+        std::atomic<uint32_t> mDropped;
+
+        bool mRunning;
+        bool mUsePerf;
+        std::atomic<bool> mStopCollector;
+        std::thread mCollector;
+        ParkingGate mCollectorGate;
+
+        // stack (tid followed by the addresses, leaf first, as raw bytes) -> samples
+        std::unordered_map<std::string, uint32_t> mStacks;
+        uint64_t mSamples;
+
+        bool StartPerf(int rate_hz);
+        bool StartSigprof(int rate_hz);
+        void StopSources();
+
+        void CollectorMain();
+        void Collect();
+        void CollectPerf(Thread *t);
+        void Aggregate(pid_t tid, const uint64_t *ips, uint32_t depth);
+
+        bool Write(const char *path);
+
+        static void OnSigprof(int sig, siginfo_t *info, void *ucontext);
+};
+
+#endif
@@ -0,0 +1,131 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <utility>
+#include <vector>
+
+#include "program_interface.hpp"
+
+ProgramInterface::ProgramInterface() {
+    mProgram = 0;
+}
+
+void ProgramInterface::BindAttributes(GLuint program, const ShaderInput *attribs, int count) {
+    for (int i = 0; i < count; i++) {
+        glBindAttribLocation(program, attribs[i].location, attribs[i].name);
+    }
+}
+
+void ProgramInterface::Clear() {
+    mProgram = 0;
+    mUniforms.Clear();
+    mAttributes.Clear();
+    mError.clear();
+}
+
+void ProgramInterface::AddError(const char *fmt, ...) {
+    char buf[256];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    if (!mError.empty()) {
+        mError += "; ";
+    }
+    mError += buf;
+}
+
+bool ProgramInterface::Build(GLuint program, const ShaderInput *attribs, int attrib_count,
+                             const ShaderInput *uniforms, int uniform_count) {
+    Clear();
+    mProgram = program;
+
+    GLint status = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (status == GL_FALSE) {
+        AddError("program %u isn't linked", program);
+        return false;
+    }
+    bool ok = Reflect(false, attribs, attrib_count);
+    ok &= Reflect(true, uniforms, uniform_count);
+    return ok;
+}
+
+// this is the only place names are handled as strings, once per program
+bool ProgramInterface::Reflect(bool uniforms, const ShaderInput *decls, int count) {
+    const char *kind = uniforms ? "uniform" : "attribute";
+    NameTable<GLint>& table = uniforms ? mUniforms : mAttributes;
+    GLint active = 0, max_length = 0;
+    glGetProgramiv(mProgram, uniforms ? GL_ACTIVE_UNIFORMS : GL_ACTIVE_ATTRIBUTES, &active);
+    glGetProgramiv(mProgram, uniforms ? GL_ACTIVE_UNIFORM_MAX_LENGTH :
+                   GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &max_length);
+
+    std::vector<char> name(max_length + 1);
+    std::vector<std::pair<uint32_t, std::string>> seen;
+    bool ok = true;
+    for (GLint i = 0; i < active; i++) {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        if (uniforms) {
+            glGetActiveUniform(mProgram, i, (GLsizei) name.size(), &length, &size, &type,
+                               name.data());
+        } else {
+            glGetActiveAttrib(mProgram, i, (GLsizei) name.size(), &length, &size, &type,
+                              name.data());
+        }
+        name[length] = 0;
+        // built-ins (some drivers list gl_VertexID) have no location
+        if (strncmp(name.data(), "gl_", 3) == 0) {
+            continue;
+        }
+        // arrays are reported as their first element, and looked up by the array's name
+        if (length > 3 && strcmp(&name[length - 3], "[0]") == 0) {
+            name[length - 3] = 0;
+        }
+
+        GLint location = uniforms ? glGetUniformLocation(mProgram, name.data())
+                                  : glGetAttribLocation(mProgram, name.data());
+        if (location < 0) {
+            // a member of a uniform block: set through the block's buffer
+            continue;
+        }
+
+        uint32_t hash = HashName(name.data());
+        if (!table.Insert(hash, location)) {
+            for (const auto& s : seen) {
+                if (s.first == hash) {
+                    AddError("%ss %s and %s have the same hash", kind, s.second.c_str(),
+                             name.data());
+                }
+            }
+            ok = false;
+            continue;
+        }
+        seen.emplace_back(hash, name.data());
+
+        const ShaderInput *decl = nullptr;
+        for (int d = 0; d < count && !decl; d++) {
+            if (decls[d].hash == hash) {
+                decl = &decls[d];
+            }
+        }
+        if (!decl) {
+            AddError("%s %s isn't declared", kind, name.data());
+            ok = false;
+        } else if (strcmp(decl->name, name.data()) != 0) {
+            AddError("%ss %s and %s have the same hash", kind, decl->name, name.data());
+            ok = false;
+        } else if (decl->type != type) {
+            AddError("%s %s is of type 0x%04x, declared as 0x%04x", kind, name.data(), type,
+                     decl->type);
+            ok = false;
+        } else if (!uniforms && decl->location != location) {
+            AddError("attribute %s is at location %d, declared at %d", name.data(), location,
+                     decl->location);
+            ok = false;
+        }
+    }
+    return ok;
+}
@@ -0,0 +1,67 @@
+#ifndef endlesstunnel_program_interface_hpp
+#define endlesstunnel_program_interface_hpp
+
+#include <GLES3/gl3.h>
+#include <stdint.h>
+#include <string>
+
+#include "name_hash.hpp"
+
+// An attribute or uniform a program is expected to have, as the C++ side uses it. The type is
+// what the program reports for it (GL_FLOAT_VEC2, GL_SAMPLER_2D, ...).
+struct ShaderInput {
+    uint32_t hash;
+    const char *name;   // for binding and messages
+    GLenum type;
+    GLint location;     // attributes: bound before linking. Uniforms: -1 (assigned by GL)
+};
+
+#define SHADER_ATTRIBUTE(name, type, location) { NAME_HASH(name), name, type, location }
+#define SHADER_UNIFORM(name, type) { NAME_HASH(name), name, type, -1 }
+#define SHADER_INPUT_COUNT(inputs) ((int) (sizeof(inputs) / sizeof((inputs)[0])))
+
+// A linked program's attribute and uniform locations, by hashed name: set uniforms with
+// glUniform*(iface.Uniform(NAME_HASH("u_scale")), ...), which is a lookup in a small flat
+// table, without any string handling nor calls into the driver.
+//
+// The tables are built once after linking, from the program's own list of active inputs, and
+// checked against what the C++ side declared: every active input must be declared, with the
+// same type (and for attributes, the same location), and no two names may share a hash.
+// Declared inputs the compiler optimized out are fine; their location is -1, which GL ignores.
+class ProgramInterface {
+    public:
+        ProgramInterface();
+
+        // binds the attributes to their declared locations; call before linking
+        static void BindAttributes(GLuint program, const ShaderInput *attribs, int count);
+
+        // Reflects the (linked) program and checks it against the declarations. Returns
+        // false (see GetError()) on any mismatch; lookups still work for what was found.
+        bool Build(GLuint program, const ShaderInput *attribs, int attrib_count,
+                   const ShaderInput *uniforms, int uniform_count);
+
+        void Clear();
+
+        // -1 if the program has no such active input
+        GLint Uniform(uint32_t hash) const {
+            const GLint *loc = mUniforms.Find(hash);
+            return loc ? *loc : -1;
+        }
+        GLint Attribute(uint32_t hash) const {
+            const GLint *loc = mAttributes.Find(hash);
+            return loc ? *loc : -1;
+        }
+
+        GLuint GetProgram() const { return mProgram; }
+        const std::string& GetError() const { return mError; }
+
+    private:
+        GLuint mProgram;
+        NameTable<GLint> mUniforms, mAttributes;
+        std::string mError;
+
+        bool Reflect(bool uniforms, const ShaderInput *decls, int count);
+        void AddError(const char *fmt, ...);
+};
+
+#endif
@@ -0,0 +1,210 @@
+#include <stddef.h>
+
+#include <algorithm>
+
+#include "quad_batch.hpp"
+
+static const char *QUAD_VS =
+    "#version 300 es\n"
+    "uniform vec2 u_scale;\n"
+    "in vec2 i_position;\n"
+    "in vec4 i_color;\n"
+    "out vec4 v_color;\n"
+    "void main() {\n"
+    "    v_color = i_color;\n"
+    "    gl_Position = vec4(i_position * u_scale - 1.0, 0.0, 1.0);\n"
+    "}\n";
+
+static const char *QUAD_FS =
+    "#version 300 es\n"
+    "precision mediump float;\n"
+    "in vec4 v_color;\n"
+    "out vec4 o_color;\n"
+    "void main() {\n"
+    "    o_color = v_color;\n"
+    "}\n";
+
+enum {
+    QUAD_ATTRIB_POSITION,
+    QUAD_ATTRIB_COLOR,
+};
+
+static const ShaderInput QUAD_ATTRIBS[] = {
+    SHADER_ATTRIBUTE("i_position", GL_FLOAT_VEC2, QUAD_ATTRIB_POSITION),
+    SHADER_ATTRIBUTE("i_color", GL_FLOAT_VEC4, QUAD_ATTRIB_COLOR),
+};
+
+static const ShaderInput QUAD_UNIFORMS[] = {
+    SHADER_UNIFORM("u_scale", GL_FLOAT_VEC2),
+};
+
+QuadBatcher::QuadBatcher() {
+    mProgram = mCountingProgram = 0;
+    mVao = mVbo = mIbo = 0;
+    mWidth = mHeight = 0;
+}
+
+GLuint QuadBatcher::Compile(GLenum type, const char *src) {
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &src, NULL);
+    glCompileShader(shader);
+
+    GLint status = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if (status == GL_FALSE) {
+        char log[512] = "";
+        glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+        mError = std::string("shader compilation failed: ") + log;
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+GLuint QuadBatcher::Link(GLuint vs, GLuint fs, ProgramInterface *iface) {
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vs);
+    glAttachShader(program, fs);
+    ProgramInterface::BindAttributes(program, QUAD_ATTRIBS, SHADER_INPUT_COUNT(QUAD_ATTRIBS));
+    glLinkProgram(program);
+
+    GLint status = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (status == GL_FALSE) {
+        char log[512] = "";
+        glGetProgramInfoLog(program, sizeof(log), NULL, log);
+        mError = std::string("program link failed: ") + log;
+        glDeleteProgram(program);
+        return 0;
+    }
+    if (!iface->Build(program, QUAD_ATTRIBS, SHADER_INPUT_COUNT(QUAD_ATTRIBS), QUAD_UNIFORMS,
+                      SHADER_INPUT_COUNT(QUAD_UNIFORMS))) {
+        mError = "program interface mismatch: " + iface->GetError();
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+bool QuadBatcher::Init(GLuint counting_shader) {
+    Shutdown();
+    mError.clear();
+
+    GLuint vs = Compile(GL_VERTEX_SHADER, QUAD_VS);
+    GLuint fs = Compile(GL_FRAGMENT_SHADER, QUAD_FS);
+    if (vs && fs) {
+        mProgram = Link(vs, fs, &mInterface);
+        if (mProgram && counting_shader) {
+            mCountingProgram = Link(vs, counting_shader, &mCountingInterface);
+        }
+    }
+    // the programs keep what they need
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+    if (!mProgram || (counting_shader && !mCountingProgram)) {
+        Shutdown();
+        return false;
+    }
+    // the same two triangles for every quad
+    std::vector<uint16_t> indices(QUAD_BATCH_MAX * 6);
+    for (int i = 0; i < QUAD_BATCH_MAX; i++) {
+        uint16_t v = (uint16_t) (i * 4);
+        uint16_t quad[6] = { v, (uint16_t) (v + 1), (uint16_t) (v + 2),
+                             (uint16_t) (v + 2), (uint16_t) (v + 1), (uint16_t) (v + 3) };
+        std::copy(quad, quad + 6, &indices[i * 6]);
+    }
+
+    glGenVertexArrays(1, &mVao);
+    glGenBuffers(1, &mVbo);
+    glGenBuffers(1, &mIbo);
+    glBindVertexArray(mVao);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mIbo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint16_t), indices.data(),
+                 GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, mVbo);
+    glBufferData(GL_ARRAY_BUFFER, QUAD_BATCH_MAX * 4 * sizeof(Vertex), NULL, GL_STREAM_DRAW);
+    glEnableVertexAttribArray(QUAD_ATTRIB_POSITION);
+    glEnableVertexAttribArray(QUAD_ATTRIB_COLOR);
+    glVertexAttribPointer(QUAD_ATTRIB_POSITION, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                          (void*) offsetof(Vertex, x));
+    glVertexAttribPointer(QUAD_ATTRIB_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex),
+                          (void*) offsetof(Vertex, color));
+    glBindVertexArray(0);
+
+    mVertices.reserve(64 * 4);
+    return true;
+}
+
+void QuadBatcher::Shutdown() {
+    if (mProgram) {
+        glDeleteProgram(mProgram);
+    }
+    if (mCountingProgram) {
+        glDeleteProgram(mCountingProgram);
+    }
+    if (mVao) {
+        glDeleteVertexArrays(1, &mVao);
+    }
+    if (mVbo) {
+        glDeleteBuffers(1, &mVbo);
+    }
+    if (mIbo) {
+        glDeleteBuffers(1, &mIbo);
+    }
+    mProgram = mCountingProgram = 0;
+    mInterface.Clear();
+    mCountingInterface.Clear();
+    mVao = mVbo = mIbo = 0;
+    mVertices.clear();
+}
+
+void QuadBatcher::Begin(int width, int height) {
+    mWidth = width;
+    mHeight = height;
+    mVertices.clear();
+}
+
+void QuadBatcher::Add(float x, float y, float w, float h, uint32_t color) {
+    // RRGGBBAA -> r, g, b, a bytes in memory (little-endian)
+    uint32_t c = ((color >> 24) & 0xff) | ((color >> 8) & 0xff00) |
+                 ((color << 8) & 0xff0000) | ((color & 0xff) << 24);
+    mVertices.push_back({ x, y, c });
+    mVertices.push_back({ x + w, y, c });
+    mVertices.push_back({ x, y + h, c });
+    mVertices.push_back({ x + w, y + h, c });
+}
+
+int QuadBatcher::End(bool counting) {
+    GLuint program = counting && mCountingProgram ? mCountingProgram : mProgram;
+    int quads = GetQuadCount();
+    if (!program || !quads || mWidth <= 0 || mHeight <= 0) {
+        return 0;
+    }
+
+    const ProgramInterface& iface = program == mProgram ? mInterface : mCountingInterface;
+    glUseProgram(program);
+    glUniform2f(iface.Uniform(NAME_HASH("u_scale")), 2.0f / mWidth, 2.0f / mHeight);
+    glBindVertexArray(mVao);
+    glBindBuffer(GL_ARRAY_BUFFER, mVbo);
+    if (program == mProgram) {
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    }
+
+    int draws = 0;
+    for (int first = 0; first < quads; first += QUAD_BATCH_MAX) {
+        int count = std::min(quads - first, QUAD_BATCH_MAX);
+        // orphan the buffer, so that we never wait for the GPU to be done with the last draw
+        glBufferData(GL_ARRAY_BUFFER, QUAD_BATCH_MAX * 4 * sizeof(Vertex), NULL, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, count * 4 * sizeof(Vertex), &mVertices[first * 4]);
+        glDrawElements(GL_TRIANGLES, count * 6, GL_UNSIGNED_SHORT, NULL);
+        draws++;
+    }
+
+    if (program == mProgram) {
+        glDisable(GL_BLEND);
+    }
+    glBindVertexArray(0);
+    mVertices.clear();
+    return draws;
+}
@@ -0,0 +1,64 @@
+#ifndef endlesstunnel_quad_batch_hpp
+#define endlesstunnel_quad_batch_hpp
+
+#include <GLES3/gl3.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "program_interface.hpp"
+
+// quads per draw call (indices are 16-bit, 4 vertices per quad)
+#define QUAD_BATCH_MAX 1024
+
+// Draws solid-colored, axis-aligned quads, all of a frame's in as few draw calls as possible:
+// Add() only appends 4 vertices to a CPU-side array, End() uploads them into a streamed buffer
+// and draws them with one glDrawElements per QUAD_BATCH_MAX quads (the index buffer is static).
+// Quads are drawn in the order they were added, alpha-blended.
+//
+// Coordinates are surface pixels, origin at the bottom-left. The batcher has its own VAO and
+// program; End() leaves VAO 0 bound.
+class QuadBatcher {
+    public:
+        QuadBatcher();
+
+        // needs a current context. With a counting shader (see OverdrawMeter), also links the
+        // program End() uses when asked to count. Returns false (see GetError()) on failure.
+        bool Init(GLuint counting_shader = 0);
+
+        // deletes the GL objects; needs the context that Init() was called with
+        void Shutdown();
+
+        bool IsReady() const { return mProgram != 0; }
+        const std::string& GetError() const { return mError; }
+
+        // starts a batch for a surface of the given size
+        void Begin(int width, int height);
+
+        // color is 0xRRGGBBAA
+        void Add(float x, float y, float w, float h, uint32_t color);
+
+        // draws the batch. When counting, the counting program is used and blending is left
+        // as the overdraw meter set it. Returns the number of draw calls issued.
+        int End(bool counting = false);
+
+        int GetQuadCount() const { return (int) mVertices.size() / 4; }
+
+    private:
+        struct Vertex {
+            float x, y;
+            uint32_t color;  // bytes in memory: r, g, b, a
+        };
+
+        GLuint mProgram, mCountingProgram;
+        ProgramInterface mInterface, mCountingInterface;
+        GLuint mVao, mVbo, mIbo;
+        std::string mError;
+        int mWidth, mHeight;
+        std::vector<Vertex> mVertices;
+
+        GLuint Compile(GLenum type, const char *src);
+        GLuint Link(GLuint vs, GLuint fs, ProgramInterface *iface);
+};
+
+#endif
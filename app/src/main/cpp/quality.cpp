@@ -0,0 +1,124 @@
+#include "quality.hpp"
+
+// above this load, we go down a tier...
+#define QUALITY_LOAD_HIGH 0.9f
+// ...after this many consecutive frames
+#define QUALITY_DOWNGRADE_FRAMES 20
+
+// below this load, we consider going up a tier...
+#define QUALITY_LOAD_LOW 0.6f
+// ...after this many consecutive frames (doubling each time an upgrade fails)
+#define QUALITY_UPGRADE_FRAMES 180
+#define QUALITY_UPGRADE_FRAMES_MAX 3600
+
+// an upgrade followed by a downgrade within this many frames counts as a failed upgrade
+#define QUALITY_UPGRADE_PROBATION 300
+
+// smoothing factor for the load average
+#define QUALITY_LOAD_ALPHA 0.1f
+
+// after a change, give the load average this many frames to catch up before judging again
+#define QUALITY_SETTLE_FRAMES 15
+
+static const QualitySettings _tiers[QUALITY_TIER_COUNT] = {
+    //  particles  sections                        lod near/far    hud  scale
+    {   250,       2,                              30.0f,  60.0f,  10,  0.5f  },
+    {   1000,      3,                              45.0f,  90.0f,  15,  0.7f  },
+    {   4000,      RENDER_TUNNEL_SECTION_COUNT,    60.0f, 120.0f,  30,  0.85f },
+    {   10000,     RENDER_TUNNEL_SECTION_COUNT,    80.0f, 160.0f,  30,  1.0f  },
+};
+
+// highest tier allowed in each thermal state
+static const int _thermal_cap[] = {
+    QUALITY_TIER_COUNT - 1,  // nominal
+    QUALITY_TIER_COUNT - 1,  // light
+    QUALITY_TIER_COUNT - 2,  // moderate
+    1,                       // severe
+    0,                       // critical
+};
+
+QualityController::QualityController() {
+    mListenerCount = 0;
+    mTier = QUALITY_TIER_COUNT - 1;
+    mAppliedTier = -1;
+    mLoad = 0.0f;
+    mHighFrames = mLowFrames = 0;
+    mUpgradeHold = QUALITY_UPGRADE_FRAMES;
+    mSinceUpgrade = -1;
+}
+
+const QualitySettings& QualityController::GetTierSettings(int tier) {
+    return _tiers[tier];
+}
+
+bool QualityController::Subscribe(Listener listener, void *data) {
+    if (mListenerCount == QUALITY_MAX_LISTENERS) {
+        return false;
+    }
+    mListeners[mListenerCount++] = { listener, data };
+    return true;
+}
+
+void QualityController::SetTier(int tier) {
+    mTier = tier;
+    mHighFrames = mLowFrames = -QUALITY_SETTLE_FRAMES;
+}
+
+void QualityController::Update(float cpu_ms, float gpu_ms, float budget_ms,
+                               ThermalState thermal) {
+    if (budget_ms <= 0.0f) {
+        return;
+    }
+
+    float load = (gpu_ms > cpu_ms ? gpu_ms : cpu_ms) / budget_ms;
+    mLoad += (load - mLoad) * QUALITY_LOAD_ALPHA;
+    if (mSinceUpgrade >= 0) {
+        mSinceUpgrade++;
+    }
+
+    // the thermal cap applies right away
+    int cap = _thermal_cap[(int) thermal];
+    if (mTier > cap) {
+        SetTier(cap);
+        return;
+    }
+
+    if (mHighFrames < 0) {
+        // settling after a change
+        mHighFrames++;
+        mLowFrames++;
+        return;
+    }
+    mHighFrames = (mLoad > QUALITY_LOAD_HIGH) ? mHighFrames + 1 : 0;
+    mLowFrames = (mLoad < QUALITY_LOAD_LOW) ? mLowFrames + 1 : 0;
+
+    if (mHighFrames >= QUALITY_DOWNGRADE_FRAMES && mTier > 0) {
+        if (mSinceUpgrade >= 0 && mSinceUpgrade < QUALITY_UPGRADE_PROBATION) {
+            // we just came from here: wait longer before trying again
+            mUpgradeHold *= 2;
+            if (mUpgradeHold > QUALITY_UPGRADE_FRAMES_MAX) {
+                mUpgradeHold = QUALITY_UPGRADE_FRAMES_MAX;
+            }
+        }
+        mSinceUpgrade = -1;
+        SetTier(mTier - 1);
+    } else if (mLowFrames >= mUpgradeHold && mTier < cap) {
+        mSinceUpgrade = 0;
+        SetTier(mTier + 1);
+    } else if (mSinceUpgrade >= QUALITY_UPGRADE_PROBATION * 4) {
+        // the last upgrade stuck for a long while: go back to being optimistic
+        mUpgradeHold = QUALITY_UPGRADE_FRAMES;
+        mSinceUpgrade = -1;
+    }
+}
+
+bool QualityController::ApplyPending() {
+    if (mTier == mAppliedTier) {
+        return false;
+    }
+    mAppliedTier = mTier;
+    for (int i = 0; i < mListenerCount; i++) {
+        mListeners[i].listener(_tiers[mTier], mTier, mListeners[i].data);
+    }
+    return true;
+}
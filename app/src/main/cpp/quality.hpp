@@ -0,0 +1,75 @@
+#ifndef endlesstunnel_quality_hpp
+#define endlesstunnel_quality_hpp
+
+#include "game_consts.hpp"
+#include "perf_hint.hpp"
+
+// the tunable workload budgets
+struct QualitySettings {
+    int particle_cap;        // max live particles
+    int tunnel_sections;     // sections rendered ahead (at most RENDER_TUNNEL_SECTION_COUNT)
+    float lod_near;          // beyond this distance, objects use the medium LOD
+    float lod_far;           // beyond this distance, objects use the low LOD
+    int hud_refresh_hz;      // how often the HUD is redrawn
+    float render_scale;      // fraction of the native resolution we render at
+};
+
+#define QUALITY_TIER_COUNT 4
+
+// max listeners that can subscribe to quality changes
+#define QUALITY_MAX_LISTENERS 8
+
+// Owns the workload budgets, and moves between quality tiers (0 = lowest) based on how loaded
+// the frames are and on the thermal state.
+//
+// Load is the frame work time over the frame budget, smoothed. The tiers cut both CPU work
+// (particles, sections, LOD) and GPU work (render scale), so the work time is the CPU's or the
+// GPU's, whichever is the bottleneck. We drop a tier quickly when load stays too high, but only
+// go up after a long stretch of low load, and the wait before going up again doubles every time
+// an upgrade turns out to be too much (so we settle instead of bouncing between two tiers). The
+// thermal state caps the tier we can be at.
+//
+// Changes are only announced to listeners in ApplyPending(), which the engine calls at frame
+// boundaries, so subsystems never see the settings change mid-frame.
+class QualityController {
+    public:
+        typedef void (*Listener)(const QualitySettings& settings, int tier, void *data);
+
+        QualityController();
+
+        static const QualitySettings& GetTierSettings(int tier);
+
+        // returns false if there's no room for more listeners
+        bool Subscribe(Listener listener, void *data);
+
+        // feeds one frame's signals. gpu_ms < 0 if the GPU time isn't known.
+        void Update(float cpu_ms, float gpu_ms, float budget_ms, ThermalState thermal);
+
+        // notifies listeners if the tier changed since last time. Returns whether it did.
+        bool ApplyPending();
+
+        int GetTier() const { return mTier; }
+        const QualitySettings& GetSettings() const { return GetTierSettings(mTier); }
+        float GetLoad() const { return mLoad; }
+
+    private:
+        struct Subscriber {
+            Listener listener;
+            void *data;
+        };
+
+        Subscriber mListeners[QUALITY_MAX_LISTENERS];
+        int mListenerCount;
+
+        int mTier;          // tier we're at
+        int mAppliedTier;   // tier listeners were last told about (-1 if never)
+        float mLoad;        // smoothed max(cpu_ms, gpu_ms) / budget_ms
+        int mHighFrames;    // consecutive frames with high load
+        int mLowFrames;     // consecutive frames with low load
+        int mUpgradeHold;   // low-load frames needed before going up
+        int mSinceUpgrade;  // frames since the last upgrade (-1 if none)
+
+        void SetTier(int tier);
+};
+
+#endif
@@ -0,0 +1,247 @@
+#include <math.h>
+#include <string.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define RESAMPLER_NEON 1
+#elif defined(__SSE__) || defined(__x86_64__)
+#include <xmmintrin.h>
+#define RESAMPLER_SSE 1
+#endif
+
+#include "resampler.hpp"
+
+struct QualityPreset {
+    int taps;       // per phase; a multiple of 8 (two vectors of 4)
+    double beta;    // Kaiser window shape: stopband attenuation
+    double cutoff;  // passband edge, as a fraction of the lower Nyquist frequency
+};
+
+static const QualityPreset PRESETS[] = {
+    { 8, 5.0, 0.80 },    // Fast
+    { 24, 7.5, 0.90 },   // Medium
+    { 48, 10.0, 0.94 },  // High
+};
+
+static int Gcd(int a, int b) {
+    while (b) {
+        int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// zeroth-order modified Bessel function of the first kind, for the Kaiser window
+static double BesselI0(double x) {
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 50 && term > 1e-12 * sum; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+static float DotScalar(const float *a, const float *b, int n) {
+    float acc0 = 0.0f, acc1 = 0.0f;
+    for (int i = 0; i < n; i += 2) {
+        acc0 += a[i] * b[i];
+        acc1 += a[i + 1] * b[i + 1];
+    }
+    return acc0 + acc1;
+}
+
+// n is a multiple of 8; two accumulators, to hide the latency of the adds
+static inline float DotSimd(const float *a, const float *b, int n) {
+#if RESAMPLER_NEON
+    float32x4_t acc0 = vdupq_n_f32(0.0f), acc1 = vdupq_n_f32(0.0f);
+    for (int i = 0; i < n; i += 8) {
+        acc0 = vmlaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+        acc1 = vmlaq_f32(acc1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+    }
+    float32x4_t acc = vaddq_f32(acc0, acc1);
+#if defined(__aarch64__)
+    return vaddvq_f32(acc);
+#else
+    float32x2_t sum = vadd_f32(vget_low_f32(acc), vget_high_f32(acc));
+    return vget_lane_f32(vpadd_f32(sum, sum), 0);
+#endif
+#elif RESAMPLER_SSE
+    __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+    for (int i = 0; i < n; i += 8) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    __m128 acc = _mm_add_ps(acc0, acc1);
+    acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+    acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+    return _mm_cvtss_f32(acc);
+#else
+    return DotScalar(a, b, n);
+#endif
+}
+
+// both channels of a stereo frame at once, with a single reduction at the end
+static inline void Dot2Simd(const float *a, const float *b0, const float *b1, int n,
+                            float *out) {
+#if RESAMPLER_NEON
+    float32x4_t acc0 = vdupq_n_f32(0.0f), acc1 = vdupq_n_f32(0.0f);
+    for (int i = 0; i < n; i += 4) {
+        float32x4_t c = vld1q_f32(a + i);
+        acc0 = vmlaq_f32(acc0, c, vld1q_f32(b0 + i));
+        acc1 = vmlaq_f32(acc1, c, vld1q_f32(b1 + i));
+    }
+    float32x2_t sum = vpadd_f32(vadd_f32(vget_low_f32(acc0), vget_high_f32(acc0)),
+                                vadd_f32(vget_low_f32(acc1), vget_high_f32(acc1)));
+    vst1_f32(out, sum);
+#elif RESAMPLER_SSE
+    __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+    for (int i = 0; i < n; i += 4) {
+        __m128 c = _mm_loadu_ps(a + i);
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(c, _mm_loadu_ps(b0 + i)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(c, _mm_loadu_ps(b1 + i)));
+    }
+    // [a0 + a2, b0 + b2, a1 + a3, b1 + b3], then the two halves
+    __m128 t = _mm_add_ps(_mm_unpacklo_ps(acc0, acc1), _mm_unpackhi_ps(acc0, acc1));
+    t = _mm_add_ps(t, _mm_movehl_ps(t, t));
+    _mm_storel_pi((__m64*) out, t);
+#else
+    out[0] = DotScalar(a, b0, n);
+    out[1] = DotScalar(a, b1, n);
+#endif
+}
+
+Resampler::Resampler() {
+    mChannels = 0;
+    mTaps = 0;
+    mL = mM = 1;
+    mPhase = 0;
+    mPos = 0;
+    mScalar = false;
+}
+
+bool Resampler::Init(int in_rate, int out_rate, int channels, ResamplerQuality quality,
+                     bool scalar) {
+    if (in_rate <= 0 || out_rate <= 0 || channels < 1 || channels > RESAMPLER_MAX_CHANNELS) {
+        return false;
+    }
+    int g = Gcd(in_rate, out_rate);
+    int l = out_rate / g, m = in_rate / g;
+    if (l > RESAMPLER_MAX_PHASES) {
+        return false;
+    }
+
+    mChannels = channels;
+    mL = l;
+    mM = m;
+    mScalar = scalar;
+    mBank.clear();
+    if (l == m) {
+        // same rate: straight copy
+        mTaps = 0;
+        Reset();
+        return true;
+    }
+
+    // Prototype lowpass at L times the input rate, taps * L long. Its cutoff is the lower
+    // of the two Nyquist frequencies (normalized to the upsampled rate), a bit below it so
+    // that the transition band doesn't alias.
+    const QualityPreset& preset = PRESETS[(int) quality];
+    mTaps = preset.taps;
+    mScalar = scalar || mTaps <= RESAMPLER_SCALAR_MAX_TAPS;
+    int length = mTaps * l;
+    double fc = preset.cutoff * 0.5 / (l > m ? l : m);
+    double center = 0.5 * (length - 1);
+    double i0_beta = BesselI0(preset.beta);
+
+    // each phase gets every L-th coefficient, oldest input first; scaled by L to make up for
+    // the zeros that upsampling stuffs in
+    mBank.resize((size_t) l * mTaps);
+    for (int p = 0; p < l; p++) {
+        for (int k = 0; k < mTaps; k++) {
+            int i = p + (mTaps - 1 - k) * l;
+            double t = i - center;
+            double sinc = t == 0.0 ? 2.0 * fc : sin(2.0 * M_PI * fc * t) / (M_PI * t);
+            double r = t / (0.5 * length);
+            double window = r * r < 1.0 ? BesselI0(preset.beta * sqrt(1.0 - r * r)) / i0_beta
+                                        : 0.0;
+            mBank[(size_t) p * mTaps + k] = (float) (sinc * window * l);
+        }
+    }
+
+    Reset();
+    return true;
+}
+
+void Resampler::Reset() {
+    mPhase = 0;
+    mPos = 0;
+    for (int c = 0; c < RESAMPLER_MAX_CHANNELS; c++) {
+        mHistory[c].assign(c < mChannels ? 2 * mTaps : 0, 0.0f);
+    }
+}
+
+int Resampler::GetMaxOutputFrames(int in_frames) const {
+    // one more for the partial step carried over from the previous call
+    return (int) (((int64_t) in_frames * mL + mM - 1) / mM) + 1;
+}
+
+int Resampler::GetLatencyFrames() const {
+    return mTaps ? (int) (((int64_t) mTaps * mL / 2 + mM / 2) / mM) : 0;
+}
+
+const char *Resampler::GetSimdName() const {
+#if RESAMPLER_NEON
+    return mScalar ? "scalar" : "neon";
+#elif RESAMPLER_SSE
+    return mScalar ? "scalar" : "sse";
+#else
+    return "scalar";
+#endif
+}
+
+int Resampler::Process(const float *in, int in_frames, float *out) {
+    if (!mTaps) {
+        memcpy(out, in, (size_t) in_frames * mChannels * sizeof(float));
+        return in_frames;
+    }
+    return mScalar ? ProcessImpl<false>(in, in_frames, out)
+                   : ProcessImpl<true>(in, in_frames, out);
+}
+
+// Each input frame is L sub-steps long, and there's an output frame every M sub-steps: after
+// pushing a frame, the outputs that fall within it use the phase of their sub-step.
+template <bool Simd>
+int Resampler::ProcessImpl(const float *in, int in_frames, float *out) {
+    const int taps = mTaps, channels = mChannels;
+    float *hist[RESAMPLER_MAX_CHANNELS];
+    for (int c = 0; c < channels; c++) {
+        hist[c] = mHistory[c].data();
+    }
+
+    int written = 0;
+    for (int f = 0; f < in_frames; f++) {
+        for (int c = 0; c < channels; c++) {
+            float x = in[f * channels + c];
+            hist[c][mPos] = x;
+            hist[c][mPos + taps] = x;
+        }
+        mPos = mPos + 1 == taps ? 0 : mPos + 1;
+
+        for (; mPhase < mL; mPhase += mM) {
+            const float *coefs = &mBank[(size_t) mPhase * taps];
+            if (Simd && channels == 2) {
+                Dot2Simd(coefs, hist[0] + mPos, hist[1] + mPos, taps, &out[written * 2]);
+                written++;
+                continue;
+            }
+            for (int c = 0; c < channels; c++) {
+                out[written * channels + c] = Simd ? DotSimd(coefs, hist[c] + mPos, taps)
+                                                   : DotScalar(coefs, hist[c] + mPos, taps);
+            }
+            written++;
+        }
+        mPhase -= mL;
+    }
+    return written;
+}
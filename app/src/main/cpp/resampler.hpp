@@ -0,0 +1,78 @@
+#ifndef endlesstunnel_resampler_hpp
+#define endlesstunnel_resampler_hpp
+
+#include <stdint.h>
+#include <vector>
+
+// max channels (interleaved)
+#define RESAMPLER_MAX_CHANNELS 2
+
+// max filter phases, i.e. max L once the ratio is reduced to L/M (44.1 <-> 48 kHz is 147/160)
+#define RESAMPLER_MAX_PHASES 1024
+
+// filters up to this long run in plain C: with so few taps, the vector code's loads and
+// horizontal adds cost more than they save (0.8-1.0x of plain C in tools/resampler_bench)
+#define RESAMPLER_SCALAR_MAX_TAPS 8
+
+enum class ResamplerQuality {
+    Fast,    // 8 taps, ~50 dB stopband
+    Medium,  // 24 taps, ~75 dB
+    High,    // 48 taps, ~100 dB
+};
+
+// Polyphase FIR sample rate converter, for float audio (interleaved, up to 2 channels): the
+// synth and mixer run at a fixed rate, the output stream at the device's native one.
+//
+// The ratio is exact: it's reduced to L/M, and there is one filter (phase) per L, each a
+// slice of a Kaiser-windowed sinc lowpass designed for the upsampled rate. Each output frame
+// is then one dot product per channel over the last taps input frames, which are kept
+// contiguous (in a doubled ring buffer) so that it vectorizes: NEON on ARM, SSE on x86, plain
+// C elsewhere and for short filters (stereo frames share one horizontal add). Latency is
+// fixed, half the filter (GetLatencyFrames()). Equal rates bypass the filter.
+class Resampler {
+    public:
+        Resampler();
+
+        // Returns false if the channel count isn't supported or the reduced ratio needs more
+        // than RESAMPLER_MAX_PHASES phases. With scalar, the vector code isn't used (for
+        // comparisons); it isn't either for filters of up to RESAMPLER_SCALAR_MAX_TAPS taps.
+        bool Init(int in_rate, int out_rate, int channels, ResamplerQuality quality,
+                  bool scalar = false);
+
+        // back to silence, as after Init()
+        void Reset();
+
+        // Converts in_frames input frames, all of which are consumed. Returns the number of
+        // frames written to out, which must have room for GetMaxOutputFrames(in_frames).
+        int Process(const float *in, int in_frames, float *out);
+
+        int GetMaxOutputFrames(int in_frames) const;
+
+        // delay through the filter, in output frames
+        int GetLatencyFrames() const;
+
+        int GetTaps() const { return mTaps; }
+        int GetPhases() const { return mL; }
+
+        // "neon", "sse" or "scalar": what Process() uses
+        const char *GetSimdName() const;
+
+    private:
+        int mChannels, mTaps;
+        int mL, mM;         // output frames come every M of L sub-steps per input frame
+        int mPhase;         // sub-step of the next output frame, within the current input frame
+        int mPos;           // ring buffer position of the oldest frame
+        bool mScalar;
+
+        // mBank[p * taps + k] is tap k (oldest input first) of phase p
+        std::vector<float> mBank;
+
+        // per channel, the last taps input frames twice over, so that they're always
+        // contiguous at [mPos, mPos + taps)
+        std::vector<float> mHistory[RESAMPLER_MAX_CHANNELS];
+
+        template <bool Simd>
+        int ProcessImpl(const float *in, int in_frames, float *out);
+};
+
+#endif
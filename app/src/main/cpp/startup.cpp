@@ -0,0 +1,138 @@
+#include <algorithm>
+#include <cstring>
+
+#include "log.hpp"
+#include "startup.hpp"
+#include "trace.hpp"
+
+StartupPipeline::~StartupPipeline() {
+    for (Stage *s : mStages) {
+        if (s->worker.joinable()) {
+            s->worker.join();
+        }
+        delete s;
+    }
+}
+
+void StartupPipeline::Add(const char *name, Kind kind, std::function<bool()> fn) {
+    MY_ASSERT(mBeginNs == 0);
+    mStages.push_back(new Stage{ name, kind, std::move(fn), State::Pending, 0, 0, std::thread() });
+}
+
+void StartupPipeline::RunStage(Stage *s) {
+    s->start_ns = TimeNowNs();
+    bool ok = s->fn();
+    s->end_ns = TimeNowNs();
+    s->state = ok ? State::Done : State::Failed;
+    Trace::GetInstance()->Complete(s->name, s->start_ns, s->end_ns - s->start_ns);
+}
+
+void StartupPipeline::Begin() {
+    mBeginNs = TimeNowNs();
+    Trace::GetInstance()->Instant("startup_begin", mBeginNs);
+
+    for (Stage *s : mStages) {
+        if (s->kind == Kind::Background) {
+            s->state = State::Running;
+            s->worker = std::thread(RunStage, s);
+        }
+    }
+}
+
+bool StartupPipeline::Wait(const char *name) {
+    for (Stage *s : mStages) {
+        if (s->kind == Kind::Background && strcmp(s->name, name) == 0) {
+            if (s->worker.joinable()) {
+                s->worker.join();
+            }
+            return s->state == State::Done;
+        }
+    }
+    LOGE("StartupPipeline: no background stage named %s", name);
+    return false;
+}
+
+bool StartupPipeline::RunAll(Kind kind) {
+    for (Stage *s : mStages) {
+        if (s->kind != kind || (kind == Kind::Deferred && s->state == State::Done)) {
+            continue;
+        }
+        RunStage(s);
+        if (s->state != State::Done) {
+            LOGW("StartupPipeline: stage %s failed (will retry).", s->name);
+            s->state = State::Pending;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool StartupPipeline::RunCritical() {
+    return RunAll(Kind::Critical);
+}
+
+void StartupPipeline::MarkFirstFrame() {
+    if (mFirstFrameNs) {
+        return;
+    }
+    mFirstFrameNs = TimeNowNs();
+    Trace::GetInstance()->Instant("first_frame", mFirstFrameNs);
+    LOGI("StartupPipeline: time to first frame %.2f ms", NsToMs(mFirstFrameNs - mBeginNs));
+}
+
+void StartupPipeline::MarkFirstContent() {
+    if (mFirstContentNs) {
+        return;
+    }
+    mFirstContentNs = TimeNowNs();
+    Trace::GetInstance()->Instant("first_content", mFirstContentNs);
+    LOGI("StartupPipeline: time to first content %.2f ms", NsToMs(mFirstContentNs - mBeginNs));
+}
+
+bool StartupPipeline::RunDeferred() {
+    if (!mFirstFrameNs) {
+        // the first frame didn't make it to the screen (the swap failed, say): not worth
+        // holding up the rest of startup for
+        LOGW("StartupPipeline: running deferred stages before the first frame.");
+    }
+    mDeferredDone = RunAll(Kind::Deferred);
+    return mDeferredDone;
+}
+
+void StartupPipeline::Finish(const char *trace_path) {
+    if (mFinished) {
+        return;
+    }
+
+    static const char *kind_names[] = { "background", "critical", "deferred" };
+    uint64_t end_ns = mBeginNs;
+
+    for (Stage *s : mStages) {
+        if (s->worker.joinable()) {
+            s->worker.join();
+        }
+        if (s->end_ns > end_ns) {
+            end_ns = s->end_ns;
+        }
+        LOGI("StartupPipeline: %-10s %-16s %8.2f .. %8.2f ms (%6.2f ms)%s",
+             kind_names[(int) s->kind], s->name, NsToMs(s->start_ns - mBeginNs), NsToMs(s->end_ns - mBeginNs),
+             NsToMs(s->end_ns - s->start_ns), s->state == State::Done ? "" : " FAILED");
+    }
+
+    if (mFirstFrameNs) {
+        end_ns = std::max(end_ns, std::max(mFirstFrameNs, mFirstContentNs));
+        LOGI("StartupPipeline: first frame at %.2f ms, first content at %.2f ms, startup done "
+             "at %.2f ms", NsToMs(mFirstFrameNs - mBeginNs),
+             mFirstContentNs ? NsToMs(mFirstContentNs - mBeginNs) : 0.0,
+             NsToMs(end_ns - mBeginNs));
+    } else {
+        LOGI("StartupPipeline: no first frame, startup done at %.2f ms",
+             NsToMs(end_ns - mBeginNs));
+    }
+
+    Trace::GetInstance()->Complete("startup", mBeginNs, end_ns - mBeginNs);
+    if (trace_path) {
+        Trace::GetInstance()->WriteJson(trace_path);
+    }
+    mFinished = true;
+}
@@ -0,0 +1,83 @@
+#ifndef endlesstunnel_startup_hpp
+#define endlesstunnel_startup_hpp
+
+#include <stdint.h>
+#include <functional>
+#include <thread>
+#include <vector>
+
+// Orchestrates engine initialization, from android_main to the first presented frame.
+//
+// Stages come in three kinds:
+//   Background -- independent of the GL thread; each one runs on its own worker thread as soon
+//                 as Begin() is called (e.g. EGL display init, asset index loading).
+//   Critical   -- required to present the first frame; run in order on the GL thread.
+//   Deferred   -- everything that can wait until after the first frame (shader compile, buffers).
+//
+// Every stage is timed, and the resulting timeline is logged and written out as a trace.
+class StartupPipeline {
+    public:
+        enum class Kind { Background, Critical, Deferred };
+
+        ~StartupPipeline();
+
+        // registers a stage. Must be called before Begin(). The name must be a string literal.
+        void Add(const char *name, Kind kind, std::function<bool()> fn);
+
+        // starts the clock and launches the background stages
+        void Begin();
+
+        // blocks until the named background stage is done. Returns whether it succeeded.
+        bool Wait(const char *name);
+
+        // runs the critical stages in order. Returns false (and stops) on the first stage that
+        // fails. Critical stages must be idempotent: all of them run again on the next call,
+        // since e.g. the window may have gone away in the meantime.
+        bool RunCritical();
+
+        // to be called right after the first frame was presented
+        void MarkFirstFrame();
+
+        // to be called right after the first frame with the scene in it was presented, which
+        // may be a few frames after the deferred stages if they only queue work up
+        void MarkFirstContent();
+
+        // runs the deferred stages (normally after the first frame). Returns true when they're
+        // done.
+        bool RunDeferred();
+
+        // waits for the background stages, logs the timeline and writes the trace file
+        void Finish(const char *trace_path);
+
+        bool HasPresentedFirstFrame() const { return mFirstFrameNs != 0; }
+        bool HasPresentedContent() const { return mFirstContentNs != 0; }
+        bool HasRunDeferred() const { return mDeferredDone; }
+        bool IsFinished() const { return mFinished; }
+
+    private:
+        enum class State { Pending, Running, Done, Failed };
+
+        struct Stage {
+            const char *name;
+            Kind kind;
+            std::function<bool()> fn;
+            State state;
+            uint64_t start_ns, end_ns;
+            std::thread worker;
+        };
+
+        // a vector of pointers because Stage (std::thread) is not copyable and workers keep
+        // a pointer to their stage
+        std::vector<Stage*> mStages;
+
+        uint64_t mBeginNs = 0;
+        uint64_t mFirstFrameNs = 0;
+        uint64_t mFirstContentNs = 0;
+        bool mDeferredDone = false;
+        bool mFinished = false;
+
+        static void RunStage(Stage *s);
+        bool RunAll(Kind kind);
+};
+
+#endif
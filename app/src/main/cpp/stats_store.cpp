@@ -0,0 +1,206 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+
+#include "stats_store.hpp"
+
+#define STATS_MAGIC 0x53545354  // "TSTS"
+// version 1 had a single top index, where version 2 has tops[0]
+#define STATS_VERSION 2
+
+// records live after the header page
+#define STATS_HEADER_SIZE 4096
+
+// the file grows by this many bytes at a time
+#define STATS_GROW_SIZE (64 * 1024)
+
+static_assert(STATS_GROW_SIZE % sizeof(RunRecord) == 0, "records must not straddle chunks");
+
+StatsStore::StatsStore() {
+    mFd = -1;
+    mMap = NULL;
+    mMapSize = 0;
+    mHeader = NULL;
+}
+
+StatsStore::~StatsStore() {
+    Close();
+}
+
+RunRecord *StatsStore::Records() const {
+    return (RunRecord*) (mMap + STATS_HEADER_SIZE);
+}
+
+bool StatsStore::Map(size_t size) {
+    if (mMap) {
+        munmap(mMap, mMapSize);
+        mMap = NULL;
+        mHeader = NULL;
+    }
+    void *p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, mFd, 0);
+    if (p == MAP_FAILED) {
+        return false;
+    }
+    mMap = (uint8_t*) p;
+    mMapSize = size;
+    mHeader = (Header*) mMap;
+    return true;
+}
+
+bool StatsStore::Open(const char *path) {
+    Close();
+
+    mFd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (mFd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(mFd, &st) < 0) {
+        Close();
+        return false;
+    }
+
+    size_t size = (size_t) st.st_size;
+    bool fresh = size < STATS_HEADER_SIZE;
+    if (!fresh && Map(size)) {
+        Header *h = mHeader;
+        // the size is what counts: Grow() extends the file before it updates the header, so
+        // a kill in between leaves a stale (smaller) capacity there, and nothing is wrong
+        size_t capacity = (size - STATS_HEADER_SIZE) / sizeof(RunRecord);
+        fresh = h->magic != STATS_MAGIC ||
+                (h->version != STATS_VERSION && h->version != 1) ||
+                h->record_size != sizeof(RunRecord) || h->count > capacity;
+        if (!fresh && h->version == 1) {
+            h->tops[1] = h->tops[0];
+            h->version = STATS_VERSION;
+        }
+        fresh = fresh || h->tops[h->count & 1].count > STATS_TOP_N;
+        if (!fresh) {
+            h->capacity = (uint32_t) capacity;
+            // a version 1 file killed mid-append can have its index pointing at the
+            // unpublished record
+            TopIndex& top = h->tops[h->count & 1];
+            uint32_t n = 0;
+            for (uint32_t i = 0; i < top.count; i++) {
+                if (top.top[i] < h->count) {
+                    top.top[n++] = top.top[i];
+                }
+            }
+            top.count = n;
+        }
+    } else if (!fresh) {
+        Close();
+        return false;
+    }
+
+    if (fresh) {
+        // new (or unusable) file: start over
+        size = STATS_HEADER_SIZE + STATS_GROW_SIZE;
+        if (ftruncate(mFd, 0) < 0 || ftruncate(mFd, (off_t) size) < 0 || !Map(size)) {
+            Close();
+            return false;
+        }
+        memset(mHeader, 0, sizeof(Header));
+        mHeader->magic = STATS_MAGIC;
+        mHeader->version = STATS_VERSION;
+        mHeader->record_size = sizeof(RunRecord);
+        mHeader->capacity = STATS_GROW_SIZE / sizeof(RunRecord);
+    }
+    return true;
+}
+
+void StatsStore::Close() {
+    if (mMap) {
+        msync(mMap, mMapSize, MS_ASYNC);
+        munmap(mMap, mMapSize);
+        mMap = NULL;
+        mHeader = NULL;
+        mMapSize = 0;
+    }
+    if (mFd >= 0) {
+        close(mFd);
+        mFd = -1;
+    }
+}
+
+bool StatsStore::Grow() {
+    size_t size = mMapSize + STATS_GROW_SIZE;
+    if (ftruncate(mFd, (off_t) size) < 0 || !Map(size)) {
+        return false;
+    }
+    mHeader->capacity = (uint32_t) ((size - STATS_HEADER_SIZE) / sizeof(RunRecord));
+    return true;
+}
+
+void StatsStore::BuildTop(uint32_t index) {
+    const RunRecord *recs = Records();
+    const TopIndex& from = mHeader->tops[index & 1];
+    TopIndex& to = mHeader->tops[(index + 1) & 1];
+    uint32_t score = recs[index].score;
+    uint32_t n = from.count;
+
+    // find the insertion point (ties: older runs stay ahead)
+    uint32_t pos = n;
+    while (pos > 0 && recs[from.top[pos - 1]].score < score) {
+        pos--;
+    }
+    if (pos >= STATS_TOP_N) {
+        to = from;
+        return;
+    }
+
+    if (n < STATS_TOP_N) {
+        n++;
+    }
+    memcpy(to.top, from.top, pos * sizeof(uint32_t));
+    to.top[pos] = index;
+    memcpy(&to.top[pos + 1], &from.top[pos], (n - 1 - pos) * sizeof(uint32_t));
+    to.count = n;
+}
+
+bool StatsStore::Append(const RunRecord& r) {
+    if (!mHeader) {
+        return false;
+    }
+    if (mHeader->count == mHeader->capacity && !Grow()) {
+        return false;
+    }
+
+    uint32_t index = mHeader->count;
+    Records()[index] = r;
+    BuildTop(index);
+
+    // publish the record and the index that has it only after both are fully written
+    __atomic_store_n(&mHeader->count, index + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+uint32_t StatsStore::GetCount() const {
+    return mHeader ? __atomic_load_n(&mHeader->count, __ATOMIC_ACQUIRE) : 0;
+}
+
+const RunRecord *StatsStore::GetRecord(uint32_t index) const {
+    return index < GetCount() ? &Records()[index] : NULL;
+}
+
+uint32_t StatsStore::GetTop(const RunRecord **out, uint32_t max) const {
+    if (!mHeader) {
+        return 0;
+    }
+    const TopIndex& top = mHeader->tops[GetCount() & 1];
+    uint32_t n = top.count < max ? top.count : max;
+    for (uint32_t i = 0; i < n; i++) {
+        out[i] = &Records()[top.top[i]];
+    }
+    return n;
+}
+
+void StatsStore::Sync() {
+    if (mMap) {
+        msync(mMap, mMapSize, MS_ASYNC);
+    }
+}
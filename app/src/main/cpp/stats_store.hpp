@@ -0,0 +1,87 @@
+#ifndef endlesstunnel_stats_store_hpp
+#define endlesstunnel_stats_store_hpp
+
+#include <stddef.h>
+#include <stdint.h>
+
+// how many different causes of death a run record can count
+#define STATS_DEATH_CAUSES 4
+
+// how many best runs the top index keeps
+#define STATS_TOP_N 16
+
+// One finished run. Fixed size, stored as-is in the file.
+struct RunRecord {
+    uint64_t timestamp;      // end of the run, seconds since the epoch
+    uint32_t score;
+    uint32_t duration_ms;
+    uint16_t level;          // difficulty level reached
+    uint16_t deaths[STATS_DEATH_CAUSES];  // lives lost, by cause (game-defined indices)
+    uint16_t reserved[3];
+};
+
+static_assert(sizeof(RunRecord) == 32, "RunRecord layout changed; bump STATS_VERSION");
+
+// Persistent store of run statistics, in a memory-mapped file:
+//
+//   [header page: header + top-N index][record][record]...
+//
+// Records are only ever appended. The header keeps the count and the indices of the best
+// STATS_TOP_N runs by score, sorted, so appending a run touches the page its record lands on
+// plus the header page, and queries read the mapping directly: nothing is ever parsed.
+//
+// The file grows (and is remapped) in chunks as needed; the capacity is derived from the file
+// size on open. The top index is double-buffered: the one in use is tops[count & 1], and an
+// append writes its record and the updated index (into the other slot) before it bumps the
+// count, which publishes both at once. So a crash mid-append (or mid-grow) loses that record
+// but never corrupts the store.
+class StatsStore {
+    public:
+        StatsStore();
+        ~StatsStore();
+
+        // opens (creating if needed) the store at path. Returns false on error; a file that
+        // isn't a valid store is recreated from scratch.
+        bool Open(const char *path);
+        void Close();
+        bool IsOpen() const { return mHeader != NULL; }
+
+        bool Append(const RunRecord& r);
+
+        // records are numbered in the order they were appended
+        uint32_t GetCount() const;
+        const RunRecord *GetRecord(uint32_t index) const;
+
+        // the best runs by score, best first. Returns how many there are (<= STATS_TOP_N).
+        uint32_t GetTop(const RunRecord **out, uint32_t max) const;
+
+        // schedules the dirty pages to be written back (doesn't wait)
+        void Sync();
+
+    private:
+        struct TopIndex {
+            uint32_t count;
+            uint32_t top[STATS_TOP_N];  // record indices, by descending score
+        };
+
+        struct Header {
+            uint32_t magic;
+            uint32_t version;
+            uint32_t record_size;
+            uint32_t count;
+            uint32_t capacity;        // records the file currently has room for
+            TopIndex tops[2];         // the one for count records is tops[count & 1]
+        };
+
+        int mFd;
+        uint8_t *mMap;
+        size_t mMapSize;
+        Header *mHeader;
+
+        bool Map(size_t size);
+        bool Grow();
+        void BuildTop(uint32_t index);
+        RunRecord *Records() const;
+};
+
+#endif
@@ -0,0 +1,118 @@
+#include <limits.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "suspend.hpp"
+#include "timing.hpp"
+
+static long Futex(std::atomic<uint32_t> *word, int op, uint32_t val,
+                  const struct timespec *timeout) {
+    return syscall(SYS_futex, (uint32_t*) word, op, val, timeout, NULL, 0);
+}
+
+void ParkingGate::Close() {
+    // only the controlling thread changes the state, so there's no race between load and add
+    if (!IsClosed()) {
+        mState.fetch_add(1, std::memory_order_acq_rel);
+        // wakes the threads in Sleep()
+        Futex(&mState, FUTEX_WAKE_PRIVATE, INT_MAX, NULL);
+    }
+}
+
+void ParkingGate::Open() {
+    if (IsClosed()) {
+        mState.fetch_add(1, std::memory_order_acq_rel);
+        Futex(&mState, FUTEX_WAKE_PRIVATE, INT_MAX, NULL);
+    }
+}
+
+void ParkingGate::Pass() {
+    uint32_t state = mState.load(std::memory_order_acquire);
+    if (!(state & 1)) {
+        return;
+    }
+
+    mParked.fetch_add(1, std::memory_order_acq_rel);
+    Futex(&mParked, FUTEX_WAKE_PRIVATE, INT_MAX, NULL);
+    // the kernel only puts us to sleep if the state is still the one we saw closed, so an
+    // Open() in between can't be missed
+    while ((state = mState.load(std::memory_order_acquire)) & 1) {
+        Futex(&mState, FUTEX_WAIT_PRIVATE, state, NULL);
+    }
+    mParked.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+void ParkingGate::Sleep(int ms) {
+    uint32_t state = mState.load(std::memory_order_acquire);
+    if (state & 1) {
+        return;
+    }
+    struct timespec ts = { ms / 1000, (long) (ms % 1000) * 1000000 };
+    Futex(&mState, FUTEX_WAIT_PRIVATE, state, &ts);
+}
+
+bool ParkingGate::WaitParked(int count, int timeout_ms) {
+    uint64_t deadline = TimeNowNs() + (uint64_t) timeout_ms * 1000000ull;
+    for (;;) {
+        uint32_t parked = mParked.load(std::memory_order_acquire);
+        if ((int) parked >= count) {
+            return true;
+        }
+        uint64_t now = TimeNowNs();
+        if (now >= deadline) {
+            return false;
+        }
+        uint64_t left = deadline - now;
+        struct timespec ts = { (time_t) (left / 1000000000ull), (long) (left % 1000000000ull) };
+        Futex(&mParked, FUTEX_WAIT_PRIVATE, parked, &ts);
+    }
+}
+
+void SuspendCoordinator::Add(const char *name, std::function<void()> suspend,
+                             std::function<void()> resume) {
+    mSubsystems.push_back({ name, std::move(suspend), std::move(resume) });
+}
+
+void SuspendCoordinator::Suspend() {
+    if (mSuspended) {
+        return;
+    }
+    uint64_t start = TimeNowNs();
+    for (auto it = mSubsystems.rbegin(); it != mSubsystems.rend(); ++it) {
+        it->suspend();
+    }
+    mSuspended = true;
+    mSuspendNs = TimeNowNs() - start;
+    // from here on, anything the process does counts against the suspension
+    mCpuAtSuspendNs = ProcessCpuNs();
+}
+
+void SuspendCoordinator::Resume() {
+    if (!mSuspended) {
+        return;
+    }
+    mCpuAtResumeNs = ProcessCpuNs();
+    uint64_t start = TimeNowNs();
+    for (Subsystem& s : mSubsystems) {
+        s.resume();
+    }
+    mSuspended = false;
+    mResumeNs = TimeNowNs() - start;
+}
+
+uint64_t SuspendCoordinator::GetSuspendedCpuNs() const {
+    return (mSuspended ? ProcessCpuNs() : mCpuAtResumeNs) - mCpuAtSuspendNs;
+}
+
+uint64_t ClockNs(clockid_t clock) {
+    struct timespec ts;
+    if (clock_gettime(clock, &ts) != 0) {
+        return 0;
+    }
+    return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+uint64_t ProcessCpuNs() {
+    return ClockNs(CLOCK_PROCESS_CPUTIME_ID);
+}
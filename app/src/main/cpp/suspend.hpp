@@ -0,0 +1,83 @@
+#ifndef endlesstunnel_suspend_hpp
+#define endlesstunnel_suspend_hpp
+
+#include <stdint.h>
+#include <time.h>
+#include <atomic>
+#include <functional>
+#include <vector>
+
+// Where a worker thread parks while the app is paused. Workers call Pass() at the top of
+// their loop (and wake up from any timed wait when Close() is called, see IsClosed()): while
+// the gate is open it costs one atomic load, while it's closed the thread sleeps on a futex
+// (no timeout, so no wakeups) until Open().
+class ParkingGate {
+    public:
+        ParkingGate() : mState(0), mParked(0) {}
+
+        // from now on, threads block in Pass()
+        void Close();
+
+        // releases the parked threads (one syscall, however many there are)
+        void Open();
+
+        bool IsClosed() const { return mState.load(std::memory_order_acquire) & 1; }
+
+        // returns right away if the gate is open, otherwise blocks until it's opened
+        void Pass();
+
+        // sleeps for ms, or until the gate is closed: for workers that wake up periodically,
+        // so that they get to Pass() as soon as they're asked to
+        void Sleep(int ms);
+
+        // blocks until count threads are parked, or timeout_ms. Returns whether they are.
+        bool WaitParked(int count, int timeout_ms);
+
+        int GetParked() const { return mParked.load(std::memory_order_acquire); }
+
+    private:
+        // bumped by Close() and Open(): odd while closed. Futex words are 32 bits.
+        std::atomic<uint32_t> mState;
+        std::atomic<uint32_t> mParked;
+};
+
+// Suspends and resumes the engine's subsystems on APP_CMD_PAUSE / APP_CMD_RESUME. Subsystems
+// are added in dependency order (each one may rely on those added before it): Suspend() goes
+// through them backwards, Resume() forwards. Both are timed.
+//
+// While suspended, the process should use no CPU at all; the CPU time it used anyway is
+// measured (GetSuspendedCpuNs()), so that the engine can complain about it on resume.
+class SuspendCoordinator {
+    public:
+        // registers a subsystem. The name must be a string literal.
+        void Add(const char *name, std::function<void()> suspend, std::function<void()> resume);
+
+        void Suspend();
+        void Resume();
+
+        bool IsSuspended() const { return mSuspended; }
+
+        // process CPU time used during the last suspension (so far, if still suspended)
+        uint64_t GetSuspendedCpuNs() const;
+
+        // how long the last Suspend() and Resume() took
+        uint64_t GetSuspendNs() const { return mSuspendNs; }
+        uint64_t GetResumeNs() const { return mResumeNs; }
+
+    private:
+        struct Subsystem {
+            const char *name;
+            std::function<void()> suspend, resume;
+        };
+        std::vector<Subsystem> mSubsystems;
+
+        bool mSuspended = false;
+        uint64_t mCpuAtSuspendNs = 0, mCpuAtResumeNs = 0;
+        uint64_t mSuspendNs = 0, mResumeNs = 0;
+};
+
+// CPU time used by the whole process, and by one thread (from pthread_getcpuclockid())
+uint64_t ProcessCpuNs();
+uint64_t ClockNs(clockid_t clock);
+
+#endif
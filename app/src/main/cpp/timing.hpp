@@ -0,0 +1,18 @@
+#ifndef endlesstunnel_timing_hpp
+#define endlesstunnel_timing_hpp
+
+#include <stdint.h>
+#include <time.h>
+
+// monotonic clock, in nanoseconds. Same time base as AChoreographer and input event timestamps.
+static inline uint64_t TimeNowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+static inline double NsToMs(uint64_t ns) {
+    return (double) ns / 1000000.0;
+}
+
+#endif
@@ -0,0 +1,149 @@
+// Measures AnalyticsLog::Log() (see analytics.hpp), the hot path, with the flush thread running,
+// and what attaching a thread costs (it used to happen in the first Log()). Then checks that
+// events survive the process being killed right after a Sync() (APP_CMD_SAVE_STATE) or a
+// Suspend() (APP_CMD_PAUSE), partial blocks included, by counting the records in the files.
+//
+// Build (host):
+//   g++ -std=c++17 -O2 -I.. analytics_bench.cpp ../analytics.cpp ../lz4.cpp ../suspend.cpp
+//       ../profiler.cpp -lpthread -o analytics_bench
+//
+// Usage:
+//   analytics_bench [events]
+//
+// Exits with 1 if events were lost.
+
+#include <dirent.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "analytics.hpp"
+#include "timing.hpp"
+
+// fewer than a compressed block, so that they can only be written as a partial one
+#define KILL_EVENTS 1000
+
+// logged between two drains, so that nothing is dropped for lack of room
+#define BATCH (ANALYTICS_THREAD_BUFFER / 2)
+
+// records in all the logs in dir, from the block headers
+static uint64_t CountRecords(const std::string& dir) {
+    uint64_t count = 0;
+    DIR *d = opendir(dir.c_str());
+    struct dirent *ent;
+    while (d && (ent = readdir(d)) != NULL) {
+        if (strncmp(ent->d_name, "analytics_", 10) != 0) {
+            continue;
+        }
+        FILE *f = fopen((dir + "/" + ent->d_name).c_str(), "rb");
+        if (!f) {
+            continue;
+        }
+        AnalyticsFileHeader fh;
+        AnalyticsBlockHeader bh;
+        if (fread(&fh, sizeof(fh), 1, f) == 1 && fh.magic == ANALYTICS_MAGIC) {
+            while (fread(&bh, sizeof(bh), 1, f) == 1 && fseek(f, bh.comp_size, SEEK_CUR) == 0) {
+                count += bh.raw_size / sizeof(AnalyticsRecord);
+            }
+        }
+        fclose(f);
+    }
+    if (d) {
+        closedir(d);
+    }
+    return count;
+}
+
+static std::string MakeDir() {
+    char dir[] = "/tmp/analytics_bench.XXXXXX";
+    return mkdtemp(dir) ? dir : "";
+}
+
+static void RemoveDir(const std::string& dir) {
+    std::string rm = "rm -rf " + dir;
+    if (system(rm.c_str()) != 0) {
+        fprintf(stderr, "couldn't remove %s\n", dir.c_str());
+    }
+}
+
+// logs KILL_EVENTS in a child process, which then saves them the way the engine would and is
+// killed. Returns how many made it to the files.
+static uint64_t LogAndKill(bool suspend) {
+    std::string dir = MakeDir();
+    pid_t pid = fork();
+    if (pid == 0) {
+        AnalyticsLog *log = AnalyticsLog::GetInstance();
+        if (!log->Start(dir.c_str(), 1 << 20, 4 << 20) || !AnalyticsLog::AttachThread()) {
+            _exit(1);
+        }
+        for (int i = 0; i < KILL_EVENTS; i++) {
+            AnalyticsLog::Log(GameEvent::CloseCall, i, 0.0f, 0.0f);
+        }
+        if (suspend) {
+            log->Suspend();
+        } else {
+            log->Sync();
+        }
+        kill(getpid(), SIGKILL);
+    }
+    waitpid(pid, NULL, 0);
+    uint64_t count = CountRecords(dir);
+    RemoveDir(dir);
+    return count;
+}
+
+static bool Check(bool cond, const char *what, uint64_t count) {
+    printf("  %-52s %s: %llu\n", what, cond ? "ok" : "FAILED", (unsigned long long) count);
+    return cond;
+}
+
+int main(int argc, char **argv) {
+    int events = argc > 1 ? atoi(argv[1]) : 2000000;
+    bool ok = true;
+
+    printf("killed after logging %d events:\n", KILL_EVENTS);
+    uint64_t n = LogAndKill(false);
+    ok &= Check(n == KILL_EVENTS, "after Sync() (APP_CMD_SAVE_STATE)", n);
+    n = LogAndKill(true);
+    ok &= Check(n == KILL_EVENTS, "after Suspend() (APP_CMD_PAUSE)", n);
+
+    std::string dir = MakeDir();
+    AnalyticsLog *log = AnalyticsLog::GetInstance();
+    if (!log->Start(dir.c_str(), 64 << 20, 256 << 20)) {
+        fprintf(stderr, "can't start the log in %s\n", dir.c_str());
+        return 1;
+    }
+    uint64_t start = TimeNowNs();
+    AnalyticsLog::AttachThread();
+    double attach_us = (double) (TimeNowNs() - start) / 1000.0;
+
+    uint64_t log_ns = 0;
+    int logged = 0;
+    for (; logged < events; logged += BATCH) {
+        AnalyticsLog::SetFrameTime(logged);
+        start = TimeNowNs();
+        for (int i = 0; i < BATCH; i++) {
+            AnalyticsLog::Log(GameEvent::CloseCall, i, (float) i, 1.0f);
+        }
+        log_ns += TimeNowNs() - start;
+        log->Flush();
+    }
+    log->Stop();
+    uint64_t dropped = log->GetDropped();
+    n = CountRecords(dir);
+    RemoveDir(dir);
+
+    printf("AttachThread(): %.1f us\n", attach_us);
+    printf("Log(): %.1f ns/event (%d events, %llu written, %llu dropped)\n",
+           (double) log_ns / logged, logged, (unsigned long long) n,
+           (unsigned long long) dropped);
+    ok &= n == (uint64_t) logged && dropped == 0;
+
+    printf("%s\n", ok ? "OK" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,86 @@
+// Converts analytics logs (analytics_<n>.bin, see analytics.hpp) to CSV.
+//
+// Build (host):
+//   g++ -std=c++17 -O2 -I.. analytics_decode.cpp ../lz4.cpp -o analytics_decode
+//
+// Usage:
+//   analytics_decode analytics_0.bin [analytics_1.bin ...] > events.csv
+
+#include <stdio.h>
+#include <vector>
+
+#include "analytics.hpp"
+#include "lz4.hpp"
+
+static const char *event_name(uint16_t type) {
+    switch ((GameEvent) type) {
+        case GameEvent::Collision: return "collision";
+        case GameEvent::CloseCall: return "close_call";
+        case GameEvent::BonusPickup: return "bonus_pickup";
+        case GameEvent::LevelUp: return "level_up";
+    }
+    return "unknown";
+}
+
+static bool decode_file(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+
+    AnalyticsFileHeader fh;
+    if (fread(&fh, sizeof(fh), 1, f) != 1 || fh.magic != ANALYTICS_MAGIC ||
+            fh.version != ANALYTICS_VERSION || fh.record_size != sizeof(AnalyticsRecord)) {
+        fprintf(stderr, "%s: not an analytics log (or unsupported version)\n", path);
+        fclose(f);
+        return false;
+    }
+
+    std::vector<uint8_t> comp, raw;
+    AnalyticsBlockHeader bh;
+    size_t blocks = 0;
+    while (fread(&bh, sizeof(bh), 1, f) == 1) {
+        comp.resize(bh.comp_size);
+        raw.resize(bh.raw_size);
+        if (fread(comp.data(), 1, bh.comp_size, f) != bh.comp_size) {
+            fprintf(stderr, "%s: truncated block %zu (ignored)\n", path, blocks);
+            break;
+        }
+
+        if (bh.comp_size == bh.raw_size) {
+            raw = comp;
+        } else if (Lz4DecompressBlock(comp.data(), comp.size(), raw.data(), raw.size()) !=
+                (long) bh.raw_size) {
+            fprintf(stderr, "%s: corrupt block %zu (skipped)\n", path, blocks);
+            blocks++;
+            continue;
+        }
+
+        const AnalyticsRecord *r = (const AnalyticsRecord*) raw.data();
+        for (size_t i = 0; i < bh.raw_size / sizeof(AnalyticsRecord); i++) {
+            printf("%llu,%u,%s,%u,%.3f,%.3f\n", (unsigned long long) r[i].time_ns, r[i].thread,
+                   event_name(r[i].type), r[i].a, r[i].x, r[i].y);
+        }
+        blocks++;
+    }
+
+    fclose(f);
+    return true;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s analytics_<n>.bin...\n", argv[0]);
+        return 2;
+    }
+
+    printf("time_ns,thread,event,a,x,y\n");
+    int ret = 0;
+    for (int i = 1; i < argc; i++) {
+        if (!decode_file(argv[i])) {
+            ret = 1;
+        }
+    }
+    return ret;
+}
@@ -0,0 +1,389 @@
+// Compares two sets of benchmark results (bench_<scenario>.json, as written by BenchmarkRunner)
+// and reports, per scenario and metric, the change in the median with a bootstrap confidence
+// interval and a Mann-Whitney U test. A change is only flagged when it is both statistically
+// significant and larger than the threshold, so run-to-run noise doesn't trip it.
+//
+// The unit is the repetition, not the frame: frames of one run share its clocks, temperature
+// and background load, so they aren't independent samples, and pooling them makes any
+// run-to-run difference look significant. Each run is reduced to its median; the test and the
+// bootstrap work on those. The U test is exact (all the ways of splitting the runs between the
+// two sides) up to MAX_EXACT_RUNS runs in total. Telling apart two sets of n runs at all takes
+// p < alpha to be reachable: at the default alpha of 0.01, that's 5 runs each.
+//
+// Build (host):
+//   g++ -std=c++17 -O2 bench_compare.cpp -o bench_compare
+//
+// Usage:
+//   bench_compare [-t threshold_pct] [-a alpha] [-n resamples] base new
+//
+// base and new are either two result files or two directories (files with the same name are
+// compared). Prints a markdown report; exits with 1 if any metric regressed.
+
+#include <dirent.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#define METRIC_COUNT 5
+
+// beyond this many runs in total, the U test uses the normal approximation
+#define MAX_EXACT_RUNS 20
+
+// for all of them, higher is worse
+static const char *_metrics[METRIC_COUNT] = {
+    "cpu_ms", "gpu_ms", "swap_ms", "allocs", "draw_calls"
+};
+
+struct Options {
+    double threshold;  // minimum relative change of the median that matters, in percent
+    double alpha;      // significance level
+    int resamples;     // bootstrap resamples
+};
+
+struct Comparison {
+    int base_runs, new_runs;
+    double base_median, new_median;  // medians of the run medians
+    double delta_pct;          // relative change of the median
+    double ci_lo, ci_hi;       // bootstrap confidence interval of delta_pct
+    double p;                  // Mann-Whitney two-sided p-value
+    int verdict;               // 1 regression, -1 improvement, 0 no significant change
+};
+
+static bool ReadFile(const std::string& path, std::string *out) {
+    FILE *f = fopen(path.c_str(), "rb");
+    if (!f) {
+        return false;
+    }
+    char buf[65536];
+    size_t n;
+    out->clear();
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        out->append(buf, n);
+    }
+    fclose(f);
+    return true;
+}
+
+// The samples of a metric, per repetition: the contents of each `"<metric>": [...]` array in
+// the file (summaries are objects, so they don't match). Nulls are skipped.
+static std::vector<std::vector<double>> ReadRuns(const std::string& json, const char *metric) {
+    std::vector<std::vector<double>> runs;
+    std::string key = std::string("\"") + metric + "\": [";
+    size_t pos = 0;
+    while ((pos = json.find(key, pos)) != std::string::npos) {
+        std::vector<double> v;
+        const char *p = json.c_str() + pos + key.size();
+        while (*p && *p != ']') {
+            if (*p == ',' || *p == ' ') {
+                p++;
+            } else if (0 == strncmp(p, "null", 4)) {
+                p += 4;
+            } else {
+                char *end;
+                double x = strtod(p, &end);
+                if (end == p) {
+                    break;
+                }
+                v.push_back(x);
+                p = end;
+            }
+        }
+        pos = p - json.c_str();
+        runs.push_back(v);
+    }
+    return runs;
+}
+
+static double Median(std::vector<double> v) {
+    if (v.empty()) {
+        return 0.0;
+    }
+    size_t mid = v.size() / 2;
+    std::nth_element(v.begin(), v.begin() + mid, v.end());
+    double m = v[mid];
+    if (v.size() % 2 == 0) {
+        m = (m + *std::max_element(v.begin(), v.begin() + mid)) / 2.0;
+    }
+    return m;
+}
+
+static double RelativeChange(double base, double now) {
+    if (base == 0.0) {
+        return now == 0.0 ? 0.0 : 100.0;
+    }
+    return (now - base) / base * 100.0;
+}
+
+// two-sided p-value of the Mann-Whitney U test (with ties getting the average of their ranks).
+// Exact for small samples, by going through every way of splitting the values between the two
+// groups; otherwise the normal approximation, with tie correction.
+static double MannWhitney(const std::vector<double>& a, const std::vector<double>& b) {
+    std::vector<double> all(a);
+    all.insert(all.end(), b.begin(), b.end());
+    std::vector<size_t> order(all.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&](size_t l, size_t r) { return all[l] < all[r]; });
+
+    // ranks[i]: rank (1-based) of all[i]
+    std::vector<double> ranks(all.size());
+    double tie_term = 0.0;
+    for (size_t i = 0; i < order.size();) {
+        size_t j = i;
+        while (j < order.size() && all[order[j]] == all[order[i]]) {
+            j++;
+        }
+        for (size_t k = i; k < j; k++) {
+            ranks[order[k]] = (i + 1 + j) / 2.0;
+        }
+        double t = (double) (j - i);
+        tie_term += t * t * t - t;
+        i = j;
+    }
+
+    double n1 = (double) a.size(), n2 = (double) b.size(), n = n1 + n2;
+    double rank_sum = 0.0;
+    for (size_t i = 0; i < a.size(); i++) {
+        rank_sum += ranks[i];
+    }
+    double mean = n1 * (n + 1) / 2.0;
+    double observed = fabs(rank_sum - mean);
+
+    if (all.size() <= MAX_EXACT_RUNS) {
+        // every subset of a.size() values is equally likely under the null hypothesis
+        uint64_t extreme = 0, total = 0;
+        for (uint32_t mask = 0; mask < (1u << all.size()); mask++) {
+            if (__builtin_popcount(mask) != (int) a.size()) {
+                continue;
+            }
+            double sum = 0.0;
+            for (size_t i = 0; i < all.size(); i++) {
+                if (mask & (1u << i)) {
+                    sum += ranks[i];
+                }
+            }
+            total++;
+            extreme += fabs(sum - mean) >= observed - 1e-9;
+        }
+        return (double) extreme / total;
+    }
+
+    double var = n1 * n2 / 12.0 * ((n + 1) - tie_term / (n * (n - 1)));
+    if (var <= 0.0) {
+        // all values equal
+        return 1.0;
+    }
+    double z = (observed - 0.5) / sqrt(var);
+    return std::min(1.0, erfc(std::max(z, 0.0) / sqrt(2.0)));
+}
+
+// the smallest p-value MannWhitney() can return for samples of these sizes (when they don't
+// overlap at all)
+static double MinPValue(size_t n1, size_t n2) {
+    double ways = 1.0;
+    for (size_t i = 1; i <= n1; i++) {
+        ways = ways * (n2 + i) / i;
+    }
+    return std::min(1.0, 2.0 / ways);
+}
+
+static uint32_t _seed = 12345;
+
+static uint32_t Rand() {
+    _seed ^= _seed << 13;
+    _seed ^= _seed >> 17;
+    _seed ^= _seed << 5;
+    return _seed;
+}
+
+static void Resample(const std::vector<double>& in, std::vector<double> *out) {
+    out->resize(in.size());
+    for (size_t i = 0; i < in.size(); i++) {
+        (*out)[i] = in[Rand() % in.size()];
+    }
+}
+
+// a and b are the run medians
+static Comparison Compare(const std::vector<double>& a, const std::vector<double>& b,
+                          const Options& opt) {
+    Comparison c;
+    c.base_runs = (int) a.size();
+    c.new_runs = (int) b.size();
+    c.base_median = Median(a);
+    c.new_median = Median(b);
+    c.delta_pct = RelativeChange(c.base_median, c.new_median);
+    c.p = MannWhitney(a, b);
+
+    // percentile bootstrap of the relative change of the median, resampling runs
+    std::vector<double> deltas, ra, rb;
+    deltas.reserve(opt.resamples);
+    for (int i = 0; i < opt.resamples; i++) {
+        Resample(a, &ra);
+        Resample(b, &rb);
+        deltas.push_back(RelativeChange(Median(ra), Median(rb)));
+    }
+    std::sort(deltas.begin(), deltas.end());
+    double tail = opt.alpha / 2.0;
+    c.ci_lo = deltas[(size_t) (tail * (deltas.size() - 1))];
+    c.ci_hi = deltas[(size_t) ((1.0 - tail) * (deltas.size() - 1))];
+
+    // the whole interval has to be beyond the threshold, not just the point estimate
+    c.verdict = 0;
+    if (c.p < opt.alpha) {
+        if (c.ci_lo > opt.threshold) {
+            c.verdict = 1;
+        } else if (c.ci_hi < -opt.threshold) {
+            c.verdict = -1;
+        }
+    }
+    return c;
+}
+
+static bool IsDirectory(const char *path) {
+    struct stat st;
+    return 0 == stat(path, &st) && S_ISDIR(st.st_mode);
+}
+
+// result files in dir, sorted by name
+static std::vector<std::string> ListResults(const char *dir) {
+    std::vector<std::string> names;
+    DIR *d = opendir(dir);
+    if (!d) {
+        return names;
+    }
+    while (struct dirent *e = readdir(d)) {
+        std::string name = e->d_name;
+        if (name.compare(0, 6, "bench_") == 0 && name.size() > 5 &&
+                name.compare(name.size() - 5, 5, ".json") == 0) {
+            names.push_back(name);
+        }
+    }
+    closedir(d);
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
+static std::string ScenarioName(const std::string& path) {
+    size_t slash = path.rfind('/');
+    std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+    if (name.compare(0, 6, "bench_") == 0) {
+        name = name.substr(6);
+    }
+    if (name.size() > 5 && name.compare(name.size() - 5, 5, ".json") == 0) {
+        name = name.substr(0, name.size() - 5);
+    }
+    return name;
+}
+
+// compares one scenario and prints its rows. Returns the number of regressions.
+static int CompareFiles(const std::string& base_path, const std::string& new_path,
+                        const Options& opt) {
+    std::string base_json, new_json;
+    if (!ReadFile(base_path, &base_json) || !ReadFile(new_path, &new_json)) {
+        fprintf(stderr, "can't read %s or %s\n", base_path.c_str(), new_path.c_str());
+        return 0;
+    }
+
+    int regressions = 0;
+    for (int m = 0; m < METRIC_COUNT; m++) {
+        // one value per run: its median (runs without samples, e.g. no GPU timer, don't count)
+        std::vector<double> a, b;
+        for (const std::vector<double>& run : ReadRuns(base_json, _metrics[m])) {
+            if (!run.empty()) {
+                a.push_back(Median(run));
+            }
+        }
+        for (const std::vector<double>& run : ReadRuns(new_json, _metrics[m])) {
+            if (!run.empty()) {
+                b.push_back(Median(run));
+            }
+        }
+        if (a.size() < 2 || b.size() < 2) {
+            continue;
+        }
+
+        Comparison c = Compare(a, b, opt);
+        const char *verdict = c.verdict > 0 ? "**REGRESSION**" :
+                              c.verdict < 0 ? "improvement" : "";
+        if (MinPValue(a.size(), b.size()) >= opt.alpha) {
+            verdict = "(too few runs)";
+        }
+        printf("| %s | %s | %d/%d | %.3f | %.3f | %+.1f%% | [%+.1f%%, %+.1f%%] | %.2g | %s |\n",
+               ScenarioName(base_path).c_str(), _metrics[m], c.base_runs, c.new_runs,
+               c.base_median, c.new_median, c.delta_pct, c.ci_lo, c.ci_hi, c.p, verdict);
+        if (c.verdict > 0) {
+            regressions++;
+        }
+    }
+    return regressions;
+}
+
+static void Usage() {
+    fprintf(stderr, "usage: bench_compare [-t threshold_pct] [-a alpha] [-n resamples] "
+                    "base new\n");
+}
+
+int main(int argc, char **argv) {
+    Options opt = { 5.0, 0.01, 2000 };
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-'; i++) {
+        if (i + 1 >= argc) {
+            Usage();
+            return 2;
+        }
+        if (0 == strcmp(argv[i], "-t")) {
+            opt.threshold = atof(argv[++i]);
+        } else if (0 == strcmp(argv[i], "-a")) {
+            opt.alpha = atof(argv[++i]);
+        } else if (0 == strcmp(argv[i], "-n")) {
+            opt.resamples = std::max(100, atoi(argv[++i]));
+        } else {
+            Usage();
+            return 2;
+        }
+    }
+    if (argc - i != 2) {
+        Usage();
+        return 2;
+    }
+    const char *base = argv[i], *now = argv[i + 1];
+
+    std::vector<std::pair<std::string, std::string>> pairs;
+    if (IsDirectory(base) && IsDirectory(now)) {
+        std::vector<std::string> now_names = ListResults(now);
+        for (const std::string& name : ListResults(base)) {
+            if (std::binary_search(now_names.begin(), now_names.end(), name)) {
+                pairs.push_back({ std::string(base) + "/" + name, std::string(now) + "/" + name });
+            } else {
+                fprintf(stderr, "%s: not in %s, skipped\n", name.c_str(), now);
+            }
+        }
+    } else {
+        pairs.push_back({ base, now });
+    }
+    if (pairs.empty()) {
+        fprintf(stderr, "nothing to compare\n");
+        return 2;
+    }
+
+    printf("Change in the median of the run medians, %.0f%% bootstrap CI over runs (%d "
+           "resamples), Mann-Whitney p over runs. Flagged if p < %g and the CI is beyond "
+           "%.1f%%.\n\n", (1.0 - opt.alpha) * 100.0, opt.resamples, opt.alpha, opt.threshold);
+    printf("| scenario | metric | runs | base | new | change | CI | p | |\n");
+    printf("|---|---|---:|---:|---:|---:|---|---:|---|\n");
+
+    int regressions = 0;
+    for (const auto& p : pairs) {
+        regressions += CompareFiles(p.first, p.second, opt);
+    }
+
+    printf("\n%d regression(s).\n", regressions);
+    return regressions > 0 ? 1 : 0;
+}
@@ -0,0 +1,73 @@
+// Measures EventBus dispatch cost per event, against a std::function-based equivalent.
+//
+// Build (host):
+//   g++ -std=c++17 -O2 -I.. bench_event_bus.cpp -o bench_event_bus
+
+#include <stdio.h>
+#include <functional>
+#include <vector>
+
+#include "event_bus.hpp"
+#include "timing.hpp"
+
+struct TouchEvent { int32_t id; float x, y; };
+struct CommandEvent { int32_t cmd; };
+
+typedef EventBus<4, 1024, TouchEvent, CommandEvent> Bus;
+
+struct Listener {
+    float sum = 0.0f;
+    void OnTouch(const TouchEvent& ev) { sum += ev.x; }
+};
+
+#define ITERATIONS 20000000
+#define BATCH 1000
+
+template <typename F>
+static double ns_per_event(F fn) {
+    uint64_t start = TimeNowNs();
+    fn();
+    return (double) (TimeNowNs() - start) / ITERATIONS;
+}
+
+int main() {
+    Listener l1, l2;
+    Bus bus;
+    bus.Subscribe(Delegate<TouchEvent>::Bind<Listener, &Listener::OnTouch>(&l1));
+    bus.Subscribe(Delegate<TouchEvent>::Bind<Listener, &Listener::OnTouch>(&l2));
+
+    std::vector<std::function<void(const TouchEvent&)>> fns;
+    fns.push_back([&l1](const TouchEvent& ev) { l1.OnTouch(ev); });
+    fns.push_back([&l2](const TouchEvent& ev) { l2.OnTouch(ev); });
+
+    double publish = ns_per_event([&] {
+        for (int i = 0; i < ITERATIONS; i++) {
+            bus.Publish(TouchEvent{ i, (float) i, 0.0f });
+        }
+    });
+
+    double deferred = ns_per_event([&] {
+        for (int i = 0; i < ITERATIONS; i += BATCH) {
+            for (int j = 0; j < BATCH; j++) {
+                bus.Post(TouchEvent{ j, (float) j, 0.0f });
+            }
+            bus.Drain();
+        }
+    });
+
+    double function = ns_per_event([&] {
+        for (int i = 0; i < ITERATIONS; i++) {
+            TouchEvent ev{ i, (float) i, 0.0f };
+            for (auto& f : fns) {
+                f(ev);
+            }
+        }
+    });
+
+    printf("2 subscribers, %d events:\n", ITERATIONS);
+    printf("  EventBus::Publish         %6.2f ns/event\n", publish);
+    printf("  EventBus::Post + Drain    %6.2f ns/event\n", deferred);
+    printf("  std::function vector      %6.2f ns/event\n", function);
+    printf("(checksum %g)\n", (double) (l1.sum + l2.sum));
+    return 0;
+}
@@ -0,0 +1,163 @@
+// Measures StatsStore append and query throughput, then checks that the store survives being
+// reopened, a kill halfway through growing the file, and kills at random points of appending
+// (after which the top index must still be exactly the best runs among the records).
+//
+// Build (host):
+//   g++ -std=c++17 -O2 -I.. bench_stats_store.cpp ../stats_store.cpp -o bench_stats_store
+//
+// Usage:
+//   bench_stats_store [path] [records]
+
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "stats_store.hpp"
+#include "timing.hpp"
+
+// kills of a process appending runs
+#define KILL_ROUNDS 50
+
+// whether the store's top index is the best STATS_TOP_N records by score (ties: older first)
+static bool TopMatches(const StatsStore& store) {
+    uint32_t count = store.GetCount();
+    std::vector<uint32_t> best(count);
+    for (uint32_t i = 0; i < count; i++) {
+        best[i] = i;
+    }
+    size_t want = std::min<size_t>(count, STATS_TOP_N);
+    std::partial_sort(best.begin(), best.begin() + want, best.end(),
+                      [&store](uint32_t a, uint32_t b) {
+        uint32_t sa = store.GetRecord(a)->score, sb = store.GetRecord(b)->score;
+        return sa > sb || (sa == sb && a < b);
+    });
+
+    const RunRecord *top[STATS_TOP_N];
+    uint32_t n = store.GetTop(top, STATS_TOP_N);
+    if (n != want) {
+        return false;
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        if (top[i] != store.GetRecord(best[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// appends runs in a child process until it's killed, some time into it. Returns false if the
+// store doesn't reopen with a consistent top index.
+static bool AppendAndKill(const char *path, uint32_t delay_us) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        StatsStore store;
+        if (!store.Open(path)) {
+            _exit(1);
+        }
+        // rising scores (in pairs, for ties), so that every run makes it into the index
+        for (uint32_t i = store.GetCount(); ; i++) {
+            RunRecord r = {};
+            r.score = i / 2;
+            store.Append(r);
+        }
+    }
+    usleep(delay_us);
+    kill(pid, SIGKILL);
+    waitpid(pid, NULL, 0);
+
+    StatsStore store;
+    return store.Open(path) && TopMatches(store);
+}
+
+int main(int argc, char **argv) {
+    const char *path = argc > 1 ? argv[1] : "/tmp/bench_runs.dat";
+    int n = argc > 2 ? atoi(argv[2]) : 1000000;
+
+    unlink(path);
+    StatsStore store;
+    if (!store.Open(path)) {
+        perror(path);
+        return 1;
+    }
+
+    uint32_t seed = 12345;
+    uint64_t start = TimeNowNs();
+    for (int i = 0; i < n; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        RunRecord r = {};
+        r.timestamp = 1700000000ull + i;
+        r.score = seed >> 12;
+        r.duration_ms = 60000 + (seed & 0xffff);
+        r.level = (uint16_t) (r.score / 500);
+        r.deaths[0] = 4;
+        if (!store.Append(r)) {
+            fprintf(stderr, "append failed at %d\n", i);
+            return 1;
+        }
+    }
+    double append_ns = (double) (TimeNowNs() - start) / n;
+
+    const RunRecord *top[STATS_TOP_N];
+    uint64_t checksum = 0;
+    const int queries = 1000000;
+    start = TimeNowNs();
+    for (int i = 0; i < queries; i++) {
+        uint32_t count = store.GetTop(top, STATS_TOP_N);
+        checksum += top[i % count]->score + store.GetRecord(i % n)->level;
+    }
+    double query_ns = (double) (TimeNowNs() - start) / queries;
+
+    printf("%d records: append %.1f ns/record (%.2f M/s), top-%d + lookup query %.1f ns\n",
+           n, append_ns, 1000.0 / append_ns, STATS_TOP_N, query_ns);
+    printf("best score %u, store has %u records (checksum %llu)\n", top[0]->score,
+           store.GetCount(), (unsigned long long) checksum);
+
+    // reopen, to check the data survived
+    store.Close();
+    if (!store.Open(path) || store.GetCount() != (uint32_t) n) {
+        fprintf(stderr, "reopen check failed\n");
+        return 1;
+    }
+    uint32_t best = top[0]->score;
+
+    // killed in Grow(), after extending the file but before the header was updated
+    store.Close();
+    int fd = open(path, O_RDWR);
+    struct stat st;
+    bool extended = fd >= 0 && fstat(fd, &st) == 0 && ftruncate(fd, st.st_size + 64 * 1024) == 0;
+    if (fd >= 0) {
+        close(fd);
+    }
+    if (!extended || !store.Open(path) || store.GetCount() != (uint32_t) n ||
+            store.GetTop(top, 1) != 1 || top[0]->score != best) {
+        fprintf(stderr, "reopen after an interrupted grow failed: %u records\n",
+                store.GetCount());
+        return 1;
+    }
+    RunRecord r = {};
+    r.score = best + 1;
+    if (!store.Append(r) || store.GetTop(top, 1) != 1 || top[0]->score != best + 1) {
+        fprintf(stderr, "append after an interrupted grow failed\n");
+        return 1;
+    }
+    printf("reopened, and after an interrupted grow: ok\n");
+    store.Close();
+
+    unlink(path);
+    for (int i = 0; i < KILL_ROUNDS; i++) {
+        if (!AppendAndKill(path, 1000 + (i * 7919) % 4000)) {
+            fprintf(stderr, "top index wrong after a kill mid-append (round %d)\n", i);
+            return 1;
+        }
+    }
+    store.Open(path);
+    printf("%d kills while appending (%u records): ok\n", KILL_ROUNDS, store.GetCount());
+    return 0;
+}
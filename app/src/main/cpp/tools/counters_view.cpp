@@ -0,0 +1,79 @@
+// Live view of the engine's counters page (see live_counters.hpp): values of gauges and
+// per-second rates of counters, refreshed periodically. It only reads the file, so it doesn't
+// disturb the game however often it refreshes.
+//
+// Build (host, or with the NDK to run it on the device through run-as):
+//   g++ -std=c++17 -O2 -I.. counters_view.cpp -o counters_view
+//
+// Usage:
+//   counters_view <counters file> [interval_ms] [iterations]
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "live_counters.hpp"
+#include "timing.hpp"
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: counters_view <counters file> [interval_ms] [iterations]\n");
+        return 2;
+    }
+    int interval_ms = argc > 2 ? atoi(argv[2]) : 1000;
+    int iterations = argc > 3 ? atoi(argv[3]) : -1;
+
+    int fd = open(argv[1], O_RDONLY);
+    if (fd < 0) {
+        perror(argv[1]);
+        return 1;
+    }
+    void *p = mmap(nullptr, sizeof(LiveCountersPage), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    const LiveCountersPage *page = (const LiveCountersPage*) p;
+    if (page->header.magic != LIVE_COUNTERS_MAGIC ||
+            page->header.version != LIVE_COUNTERS_VERSION) {
+        fprintf(stderr, "%s: not a counters file (or not initialized yet)\n", argv[1]);
+        return 1;
+    }
+
+    int64_t prev[LIVE_COUNTERS_MAX] = {};
+    uint64_t prev_ns = 0;
+    bool interactive = isatty(STDOUT_FILENO);
+
+    for (int it = 0; iterations < 0 || it < iterations; it++) {
+        uint64_t now = TimeNowNs();
+        uint32_t count = page->header.count.load(std::memory_order_acquire);
+        double dt = prev_ns ? (now - prev_ns) / 1e9 : 0.0;
+
+        if (interactive) {
+            // clear screen, cursor home
+            printf("\033[2J\033[H");
+        }
+        printf("pid %u, up %.1f s\n", page->header.pid, (now - page->header.start_ns) / 1e9);
+        printf("%-32s %16s %14s\n", "name", "value", "rate/s");
+        for (uint32_t i = 0; i < count; i++) {
+            const LiveCounter& c = page->counters[i];
+            int64_t v = c.value.load(std::memory_order_relaxed);
+            if (c.kind == (uint32_t) LiveCounterKind::Counter && dt > 0.0) {
+                printf("%-32.*s %16lld %14.1f\n", LIVE_COUNTER_NAME_LEN, c.name, (long long) v,
+                       (v - prev[i]) / dt);
+            } else {
+                printf("%-32.*s %16lld %14s\n", LIVE_COUNTER_NAME_LEN, c.name, (long long) v, "");
+            }
+            prev[i] = v;
+        }
+        printf("\n");
+        fflush(stdout);
+
+        prev_ns = now;
+        usleep(interval_ms * 1000);
+    }
+    return 0;
+}
@@ -0,0 +1,196 @@
+// Checks the flight recorder (see flight_recorder.hpp): child processes record frames and
+// events, then crash (like ABORT_GAME), get SIGKILLed mid-recording, or exit cleanly. The
+// recording must survive the first two and be recognized as interrupted, and decode to a trace
+// with every completed record in it. Also measures the cost of recording a frame against a
+// 60 Hz frame budget.
+//
+// Build (host):
+//   g++ -std=c++17 -O2 -I.. flight_check.cpp ../flight_recorder.cpp -o flight_check
+//
+// Usage:
+//   flight_check [-b max_overhead_pct]
+//   flight_check -d <recorder file> <trace.json>    (decodes a file pulled from a device)
+//
+// Exits with 1 if a check fails or recording costs more than max_overhead_pct of a frame.
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "flight_recorder.hpp"
+#include "timing.hpp"
+
+#define FRAME_BUDGET_NS 16666667ull
+
+// records per frame in the engine: the frame, and now and then a command or a GL error
+#define RECORDS_PER_FRAME 2
+
+static void RecordFrames(FlightRecorder *rec, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        FlightFrame f = { i, 4000 + i % 1000, 2000, 3, (uint16_t) (i % 5) };
+        rec->RecordFrame((int64_t) TimeNowNs(), f);
+        if (i % 100 == 0) {
+            rec->RecordCommand(i % 20);
+        }
+    }
+}
+
+// runs body in a child process that records to path; returns its wait status
+template <typename Fn>
+static int RunChild(const char *path, Fn body) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        FlightRecorder *rec = FlightRecorder::GetInstance();
+        if (!rec->Open(path)) {
+            _exit(3);
+        }
+        body(rec);
+        _exit(0);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return status;
+}
+
+static bool FileContains(const char *path, const char *needle) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        return false;
+    }
+    std::string s;
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        s.append(buf, n);
+    }
+    fclose(f);
+    return s.find(needle) != std::string::npos;
+}
+
+static bool Check(bool cond, const char *what) {
+    printf("  %-56s %s\n", what, cond ? "ok" : "FAILED");
+    return cond;
+}
+
+int main(int argc, char **argv) {
+    double max_overhead_pct = 0.1;
+    int opt;
+    while ((opt = getopt(argc, argv, "b:d")) != -1) {
+        switch (opt) {
+            case 'b': max_overhead_pct = atof(optarg); break;
+            case 'd':
+                if (optind + 2 != argc) {
+                    fprintf(stderr, "usage: %s -d <recorder file> <trace.json>\n", argv[0]);
+                    return 2;
+                }
+                {
+                    int n = FlightRecorder::DecodeToJson(argv[optind], argv[optind + 1]);
+                    if (n < 0) {
+                        fprintf(stderr, "%s: can't decode\n", argv[optind]);
+                        return 1;
+                    }
+                    printf("%d records%s\n", n,
+                           FlightRecorder::WasInterrupted(argv[optind]) ? ", interrupted" : "");
+                }
+                return 0;
+            default:
+                fprintf(stderr, "usage: %s [-b max_overhead_pct] | -d <file> <trace.json>\n",
+                        argv[0]);
+                return 2;
+        }
+    }
+
+    char dir[] = "/tmp/flight_check.XXXXXX";
+    if (!mkdtemp(dir)) {
+        perror("mkdtemp");
+        return 1;
+    }
+    std::string path = std::string(dir) + "/flight", json = path + ".json";
+    bool ok = true;
+
+    // a few frames, then an abort: everything must be there, the abort last
+    printf("crash after 1000 frames:\n");
+    int status = RunChild(path.c_str(), [](FlightRecorder *rec) {
+        RecordFrames(rec, 1000);
+        rec->RecordGlError(0x0502);
+        rec->RecordAbort(__FILE__, __LINE__);
+        *((volatile char*) 0) = 'a';
+    });
+    ok &= Check(WIFSIGNALED(status) && WTERMSIG(status) == SIGSEGV, "child crashed");
+    ok &= Check(FlightRecorder::WasInterrupted(path.c_str()), "recording is interrupted");
+    int n = FlightRecorder::DecodeToJson(path.c_str(), json.c_str());
+    ok &= Check(n == 1000 + 10 + 2, "all records decoded");
+    ok &= Check(FileContains(json.c_str(), "\"file\":\"flight_check.cpp\""),
+                "abort location in the trace");
+    ok &= Check(FileContains(json.c_str(), "\"error\":\"0x0502\""), "GL error in the trace");
+
+    // killed while recording as fast as it can: the ring is full, and at most the record that
+    // was being written is lost
+    printf("SIGKILL while recording:\n");
+    pid_t pid = fork();
+    if (pid == 0) {
+        FlightRecorder *rec = FlightRecorder::GetInstance();
+        if (!rec->Open(path.c_str())) {
+            _exit(3);
+        }
+        for (;;) {
+            RecordFrames(rec, 1000);
+        }
+    }
+    usleep(200000);
+    kill(pid, SIGKILL);
+    waitpid(pid, &status, 0);
+    ok &= Check(WIFSIGNALED(status) && WTERMSIG(status) == SIGKILL, "child killed");
+    ok &= Check(FlightRecorder::WasInterrupted(path.c_str()), "recording is interrupted");
+    n = FlightRecorder::DecodeToJson(path.c_str(), json.c_str());
+    printf("  (%d of %d records decoded)\n", n, FLIGHT_RECORDER_RECORDS);
+    ok &= Check(n >= FLIGHT_RECORDER_RECORDS - 1, "ring decoded");
+
+    // a clean exit isn't a crash
+    printf("clean exit:\n");
+    status = RunChild(path.c_str(), [](FlightRecorder *rec) {
+        RecordFrames(rec, 100);
+        rec->Close();
+    });
+    ok &= Check(WIFEXITED(status) && WEXITSTATUS(status) == 0, "child exited");
+    ok &= Check(!FlightRecorder::WasInterrupted(path.c_str()), "recording isn't interrupted");
+
+    // stopped (APP_CMD_STOP marks the exit clean), then aborting: still a crash
+    printf("crash after a clean exit was marked:\n");
+    status = RunChild(path.c_str(), [](FlightRecorder *rec) {
+        RecordFrames(rec, 100);
+        rec->SetCleanExit(true);
+        rec->RecordAbort(__FILE__, __LINE__);
+        *((volatile char*) 0) = 'a';
+    });
+    ok &= Check(WIFSIGNALED(status) && WTERMSIG(status) == SIGSEGV, "child crashed");
+    ok &= Check(FlightRecorder::WasInterrupted(path.c_str()), "recording is interrupted");
+
+    // what a frame costs to record, in this process
+    FlightRecorder *rec = FlightRecorder::GetInstance();
+    std::string bench = path + ".bench";
+    if (!rec->Open(bench.c_str())) {
+        fprintf(stderr, "can't open %s\n", bench.c_str());
+        return 1;
+    }
+    const uint32_t frames = 2000000;
+    uint64_t start = TimeNowNs();
+    for (uint32_t i = 0; i < frames; i++) {
+        FlightFrame f = { i, 4000, 2000, 3, 1 };
+        rec->RecordFrame((int64_t) start, f);
+    }
+    double ns = (double) (TimeNowNs() - start) / frames;
+    double pct = 100.0 * ns * RECORDS_PER_FRAME / FRAME_BUDGET_NS;
+    printf("recording: %.1f ns per record, %.5f%% of a 60 Hz frame at %d per frame\n", ns, pct,
+           RECORDS_PER_FRAME);
+    ok &= Check(pct <= max_overhead_pct, "overhead within budget");
+    rec->Close();
+
+    printf("%s (files in %s)\n", ok ? "OK" : "FAILED", dir);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,175 @@
+// Simulates the GL thread's frame loop with FrameWorkQueue (see frame_work.hpp): 60 Hz frames
+// with some fixed work each, and bursts of loading work (shader compiles, program links, a
+// chunked buffer upload) posted at startup and again on a simulated resume, when the context was
+// lost. Work is busy-waiting, so the timings are real. Compares the frame times of running each
+// burst at once (as InitGLObjects() used to) with running it in the frames' spare time.
+//
+// Build (host):
+//   g++ -std=c++17 -O2 -I.. frame_work_sim.cpp ../frame_work.cpp -o frame_work_sim
+//
+// Usage:
+//   frame_work_sim [-f frame_work_ms] [-t target_fraction]
+//
+// Exits with 1 if, in budgeted mode, a frame misses the vsync period, a task is late, or some
+// work is never done. The first burst goes by the default estimate of what tasks cost, so with
+// heavy frames (-f), the tasks much bigger than that can still overrun once, at loading. A
+// preempted host misses frames whatever the queue does, so the budgeted run gets a few tries.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "frame_work.hpp"
+#include "timing.hpp"
+
+#define VSYNC_NS 16666667ull
+#define FRAMES 150
+#define LOAD_FRAME 5
+#define RESUME_FRAME 75
+
+// loading deadlines, like the engine's
+#define SCENE_DEADLINE_NS 150000000ull
+#define UI_DEADLINE_NS 400000000ull
+
+// kept free at the end of the vsync period
+#define MARGIN_NS 1000000ull
+
+#define UPLOAD_CHUNKS 24
+#define UPLOAD_CHUNK_NS 700000ull
+
+#define BUDGETED_TRIES 3
+
+static void Spin(uint64_t ns) {
+    uint64_t end = TimeNowNs() + ns;
+    while (TimeNowNs() < end) {
+    }
+}
+
+struct Burst {
+    int done;        // tasks finished
+    int chunks;      // upload progress
+    int done_frame;  // frame in which the last task finished (-1 if not yet)
+};
+
+// a one-shot task costing ns
+static void PostSpin(FrameWorkQueue *q, Burst *b, const char *name, WorkPriority priority,
+                     uint64_t deadline_ns, uint64_t ns) {
+    q->Post(name, priority, deadline_ns, [b, ns] {
+        Spin(ns);
+        b->done++;
+        return true;
+    });
+}
+
+static void PostBurst(FrameWorkQueue *q, Burst *b, uint64_t now) {
+    b->done = b->chunks = 0;
+    b->done_frame = -1;
+    uint64_t scene = now + SCENE_DEADLINE_NS, ui = now + UI_DEADLINE_NS;
+    PostSpin(q, b, "vertex_shader", WorkPriority::High, scene, 3000000);
+    PostSpin(q, b, "fragment_shader", WorkPriority::High, scene, 2500000);
+    PostSpin(q, b, "program", WorkPriority::High, scene, 4000000);
+    PostSpin(q, b, "vertex_buffer", WorkPriority::High, scene, 500000);
+    PostSpin(q, b, "quads", WorkPriority::Normal, ui, 5000000);
+    q->Post("upload", WorkPriority::Low, 0, [b] {
+        Spin(UPLOAD_CHUNK_NS);
+        if (++b->chunks < UPLOAD_CHUNKS) {
+            return false;
+        }
+        b->done++;
+        return true;
+    });
+}
+#define BURST_TASKS 6
+
+struct Result {
+    double max_ms[2];   // loading, resume
+    int janky[2];       // frames over the vsync period
+    int frames[2];      // frames until the burst was done
+};
+
+static Result Simulate(bool budgeted, uint64_t frame_work_ns, double target_fraction,
+                       FrameWorkQueue *q) {
+    Result r = {};
+    Burst burst = {};
+    int phase = -1;
+    int posted_frame = 0;
+    uint64_t next = TimeNowNs();
+    for (int f = 0; f < FRAMES; f++) {
+        // wait for "vsync"
+        while (TimeNowNs() < next) {
+            usleep(200);
+        }
+        uint64_t start = TimeNowNs();
+        next = start + VSYNC_NS;
+
+        if (f == LOAD_FRAME || f == RESUME_FRAME) {
+            phase = f == LOAD_FRAME ? 0 : 1;
+            posted_frame = f;
+            PostBurst(q, &burst, start);
+        }
+        Spin(frame_work_ns);
+
+        // the engine's RunGlWork(): what's left of the target after the frame's own work, and
+        // of the vsync period, less a margin
+        uint64_t target = (uint64_t) (VSYNC_NS * target_fraction);
+        uint64_t limit = VSYNC_NS - MARGIN_NS;
+        uint64_t elapsed = TimeNowNs() - start;
+        if (budgeted) {
+            q->Run(target > elapsed ? target - elapsed : 0, limit > elapsed ? limit - elapsed : 0);
+        } else {
+            q->Run(~0ull);
+        }
+
+        double ms = NsToMs(TimeNowNs() - start);
+        if (phase >= 0) {
+            r.max_ms[phase] = std::max(r.max_ms[phase], ms);
+            r.janky[phase] += ms > NsToMs(VSYNC_NS);
+            if (burst.done == BURST_TASKS && burst.done_frame < 0) {
+                burst.done_frame = f;
+                r.frames[phase] = f - posted_frame + 1;
+            }
+        }
+    }
+    return r;
+}
+
+int main(int argc, char **argv) {
+    double frame_work_ms = 6.0, target_fraction = 0.75;
+    int opt;
+    while ((opt = getopt(argc, argv, "f:t:")) != -1) {
+        switch (opt) {
+            case 'f': frame_work_ms = atof(optarg); break;
+            case 't': target_fraction = atof(optarg); break;
+            default:
+                fprintf(stderr, "usage: %s [-f frame_work_ms] [-t target_fraction]\n", argv[0]);
+                return 2;
+        }
+    }
+    uint64_t frame_work_ns = (uint64_t) (frame_work_ms * 1e6);
+    printf("%.1f ms of frame work, target %.0f%% of a %.2f ms vsync period\n\n", frame_work_ms,
+           100.0 * target_fraction, NsToMs(VSYNC_NS));
+    printf("mode        burst     max frame  frames > vsync  frames to finish\n");
+
+    bool ok = false;
+    for (int run = 0; run <= BUDGETED_TRIES && !ok; run++) {
+        bool budgeted = run > 0;
+        FrameWorkQueue q;
+        Result r = Simulate(budgeted, frame_work_ns, target_fraction, &q);
+        ok = budgeted && q.GetLateCount() == 0 && q.IsEmpty();
+        for (int phase = 0; phase < 2; phase++) {
+            printf("%-11s %-9s %7.2f ms  %14d  %16d\n", budgeted ? "budgeted" : "at once",
+                   phase ? "resume" : "loading", r.max_ms[phase], r.janky[phase],
+                   r.frames[phase]);
+            ok &= r.janky[phase] == 0 && r.frames[phase] > 0;
+        }
+        if (budgeted) {
+            printf("  %u late tasks, %u slices over budget, %d tasks left\n", q.GetLateCount(),
+                   q.GetOverrunCount(), q.GetPendingCount());
+        }
+    }
+    printf("%s\n", ok ? "OK" : "FAILED");
+    return ok ? 0 : 1;
+}
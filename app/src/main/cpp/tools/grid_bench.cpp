@@ -0,0 +1,149 @@
+// Benchmarks the obstacle code built for several grid sizes side by side (each variant is a
+// separate instantiation of the templates, so none of them branches on the grid size): time
+// per occlusion pass, and per collision and close-call test. Collision and close-call
+// results are checked against a straightforward geometric version.
+//
+// Build (host):
+//   g++ -std=c++17 -O2 -I.. grid_bench.cpp ../occlusion.cpp -o grid_bench
+//
+// Usage:
+//   grid_bench [iterations]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include "collision.hpp"
+#include "occlusion.hpp"
+#include "timing.hpp"
+
+#define OBSTACLE_COUNT 30
+#define OBSTACLE_SPACING 20.0f
+#define FILL 0.5f
+
+static uint32_t _seed = 1234;
+
+static float RandFloat() {
+    _seed = _seed * 1664525u + 1013904223u;
+    return (_seed >> 8) / (float) (1u << 24);
+}
+
+// keeps results alive, so that the compiler doesn't drop the work being timed
+static volatile uint32_t _sink;
+
+// the player is in a box if it's within its depth and its cell (boxes are checked one by one)
+template <class Grid>
+static bool ReferenceCollides(const BasicObstacle<Grid>& o, float x, float y, float z) {
+    if (fabsf(y - o.y) > 0.5f * Grid::BOX_SIZE) {
+        return false;
+    }
+    for (int r = 0; r < Grid::SIZE; r++) {
+        for (int c = 0; c < Grid::SIZE; c++) {
+            float cx = o.GetCellCenterX(c), cz = o.GetCellCenterZ(r);
+            if (o.HasBox(c, r) && fabsf(x - cx) <= 0.5f * Grid::CELL_SIZE &&
+                    fabsf(z - cz) <= 0.5f * Grid::CELL_SIZE) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+template <class Grid>
+static bool ReferenceCloseCall(const BasicObstacle<Grid>& o, float x, float y, float z) {
+    const float d = BasicObstacleCollision<Grid>::CLOSE_CALL_DELTA;
+    return !ReferenceCollides(o, x, y, z) &&
+           (ReferenceCollides(o, x - d, y, z) || ReferenceCollides(o, x + d, y, z) ||
+            ReferenceCollides(o, x, y, z - d) || ReferenceCollides(o, x, y, z + d));
+}
+
+template <class Grid>
+static void RunVariant(int iterations) {
+    typedef BasicObstacle<Grid> Obs;
+    typedef BasicObstacleCollision<Grid> Collision;
+    typedef BasicObstacleOcclusion<Grid> Occlusion;
+
+    std::vector<Obs> obstacles(OBSTACLE_COUNT);
+    std::vector<const Obs*> ptrs(OBSTACLE_COUNT);
+    std::vector<typename Grid::Mask> visible(OBSTACLE_COUNT);
+
+    OcclusionView view;
+    view.tan_half_fov_z = tanf(0.5f * RENDER_FOV * 3.14159265f / 180.0f);
+    view.tan_half_fov_x = view.tan_half_fov_z * (16.0f / 9.0f);
+
+    uint64_t boxes = 0, removed = 0, occlusion_ns = 0, collision_ns = 0, close_call_ns = 0;
+    uint64_t tests = 0, mismatches = 0;
+    for (int it = 0; it < iterations; it++) {
+        for (int i = 0; i < OBSTACLE_COUNT; i++) {
+            Obs& o = obstacles[i];
+            o.Reset();
+            for (int cell = 0; cell < Grid::CELLS; cell++) {
+                o.SetBox(cell % Grid::SIZE, cell / Grid::SIZE, RandFloat() < FILL);
+            }
+            o.SetBox(0, 0, false);
+            o.y = OBS_BOX_SIZE + i * OBSTACLE_SPACING;
+            ptrs[i] = &o;
+            boxes += o.GetBoxCount();
+        }
+
+        view.eye_x = PLAYER_MIN_X + RandFloat() * (PLAYER_MAX_X - PLAYER_MIN_X);
+        view.eye_z = PLAYER_MIN_Z + RandFloat() * (PLAYER_MAX_Z - PLAYER_MIN_Z);
+        view.eye_y = 0.0f;
+        uint64_t start = TimeNowNs();
+        removed += Occlusion::Cull(view, ptrs.data(), OBSTACLE_COUNT, visible.data());
+        occlusion_ns += TimeNowNs() - start;
+
+        // player positions within the obstacles' depth
+        float px[OBSTACLE_COUNT], py[OBSTACLE_COUNT], pz[OBSTACLE_COUNT];
+        for (int i = 0; i < OBSTACLE_COUNT; i++) {
+            px[i] = PLAYER_MIN_X + RandFloat() * (PLAYER_MAX_X - PLAYER_MIN_X);
+            pz[i] = PLAYER_MIN_Z + RandFloat() * (PLAYER_MAX_Z - PLAYER_MIN_Z);
+            py[i] = obstacles[i].y + (RandFloat() - 0.5f) * Grid::BOX_SIZE;
+        }
+
+        uint32_t hits = 0;
+        start = TimeNowNs();
+        for (int i = 0; i < OBSTACLE_COUNT; i++) {
+            hits += Collision::Collides(obstacles[i], px[i], py[i], pz[i]);
+        }
+        collision_ns += TimeNowNs() - start;
+
+        start = TimeNowNs();
+        for (int i = 0; i < OBSTACLE_COUNT; i++) {
+            hits += Collision::IsCloseCall(obstacles[i], px[i], py[i], pz[i]);
+        }
+        close_call_ns += TimeNowNs() - start;
+        _sink = hits;
+        tests += OBSTACLE_COUNT;
+
+        for (int i = 0; i < OBSTACLE_COUNT; i++) {
+            const Obs& o = obstacles[i];
+            mismatches += Collision::Collides(o, px[i], py[i], pz[i]) !=
+                          ReferenceCollides(o, px[i], py[i], pz[i]);
+            mismatches += Collision::IsCloseCall(o, px[i], py[i], pz[i]) !=
+                          ReferenceCloseCall(o, px[i], py[i], pz[i]);
+        }
+    }
+
+    printf("%dx%d  %5zu  %9.1f  %8.1f%%  %11.0f  %13.1f  %14.1f  %10llu\n", Grid::SIZE,
+           Grid::SIZE, sizeof(typename Grid::Mask), boxes / (double) tests,
+           100.0 * removed / boxes, occlusion_ns / (double) iterations,
+           collision_ns / (double) tests, close_call_ns / (double) tests,
+           (unsigned long long) mismatches);
+}
+
+int main(int argc, char **argv) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 2000;
+
+    printf("%d obstacles, %.0f apart, %.0f%% filled; %d iterations\n\n", OBSTACLE_COUNT,
+           OBSTACLE_SPACING, 100.0f * FILL, iterations);
+    printf("grid  mask  boxes/obs  removed  ns/occlusion  ns/collision  ns/close call  "
+           "mismatches\n");
+    RunVariant<GridConfig<4>>(iterations);
+    RunVariant<GridConfig<5>>(iterations);
+    RunVariant<GridConfig<6>>(iterations);
+    RunVariant<GridConfig<8>>(iterations);
+    return 0;
+}
@@ -0,0 +1,181 @@
+// Checks JniBridge's queueing (see jni_bridge.hpp) on the host, with a stub sink standing in
+// for the Java side: one batch per flush, in order, with nothing lost or duplicated; a full
+// queue drops (and counts) requests rather than blocking; and several threads posting while
+// the "GL thread" flushes every frame. Also times Post(), the hot path.
+//
+// Build (host):
+//   g++ -std=c++17 -O2 -I.. jni_bridge_check.cpp ../jni_bridge.cpp -lpthread
+//       -o jni_bridge_check
+//
+// Usage:
+//   jni_bridge_check
+//
+// Exits with 1 if any check fails.
+
+#include <stdio.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "jni_bridge.hpp"
+#include "timing.hpp"
+
+#define PRODUCERS 4
+#define POSTS_PER_PRODUCER 50000
+#define TIMED_POSTS 1000000
+
+// what MainActivity.onNativeRequests() would have received
+class StubSink : public JavaRequestSink {
+    public:
+        struct Request { int32_t type, a, b; };
+
+        std::vector<Request> received;
+        int batches = 0;
+        size_t max_batch = 0;
+
+        void Send(const int32_t *data, size_t count) override {
+            for (size_t i = 0; i < count; i++) {
+                const int32_t *r = data + i * JAVA_REQUEST_INTS;
+                received.push_back({ r[0], r[1], r[2] });
+            }
+            batches++;
+            max_batch = std::max(max_batch, count);
+        }
+};
+
+static bool Check(bool cond, const char *what, const std::string& detail = "") {
+    printf("  %-52s %s%s%s\n", what, cond ? "ok" : "FAILED", detail.empty() ? "" : ": ",
+           detail.c_str());
+    return cond;
+}
+
+static bool CheckSingleThread() {
+    bool ok = true;
+    JniBridge bridge;
+    StubSink sink;
+    bridge.SetSink(&sink);
+
+    bridge.Flush();
+    ok &= Check(sink.batches == 0, "nothing queued, no call");
+
+    bridge.Post(JavaRequest::HapticFeedback, 3);
+    bridge.Post(JavaRequest::Vibrate, 40);
+    bridge.Post(JavaRequest::KeepScreenOn, 1, 7);
+    bridge.Flush();
+    ok &= Check(sink.batches == 1 && sink.received.size() == 3, "three posts, one call");
+    ok &= Check(sink.received.size() == 3 &&
+                sink.received[0].type == (int32_t) JavaRequest::HapticFeedback &&
+                sink.received[0].a == 3 && sink.received[1].a == 40 &&
+                sink.received[2].type == (int32_t) JavaRequest::KeepScreenOn &&
+                sink.received[2].b == 7, "in order, arguments intact");
+
+    // more than a frame's worth: the excess is dropped, not waited for
+    sink.received.clear();
+    sink.batches = 0;
+    int accepted = 0;
+    for (int i = 0; i < JAVA_REQUEST_QUEUE_SIZE + 10; i++) {
+        accepted += bridge.Post(JavaRequest::Vibrate, i);
+    }
+    bridge.Flush();
+    ok &= Check(accepted == JAVA_REQUEST_QUEUE_SIZE && sink.received.size() ==
+                JAVA_REQUEST_QUEUE_SIZE && sink.batches == 1, "full queue: one full batch");
+    ok &= Check(bridge.GetDropped() == 10, "full queue: the rest counted as dropped",
+                std::to_string(bridge.GetDropped()));
+
+    // many frames, so that positions wrap around the ring many times
+    sink.received.clear();
+    int posted = 0;
+    for (int frame = 0; frame < 10000; frame++) {
+        for (int i = 0; i < frame % (JAVA_REQUEST_QUEUE_SIZE + 1); i++) {
+            bridge.Post(JavaRequest::Vibrate, posted++);
+        }
+        bridge.Flush();
+    }
+    bool in_order = (int) sink.received.size() == posted;
+    for (size_t i = 0; in_order && i < sink.received.size(); i++) {
+        in_order = sink.received[i].a == (int32_t) i;
+    }
+    ok &= Check(in_order, "10000 frames: every request, once, in order");
+    return ok;
+}
+
+static bool CheckProducers() {
+    JniBridge bridge;
+    StubSink sink;
+    bridge.SetSink(&sink);
+
+    std::atomic<int> running(PRODUCERS);
+    std::atomic<uint32_t> accepted(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < PRODUCERS; t++) {
+        threads.emplace_back([&, t] {
+            uint32_t n = 0;
+            for (int i = 0; i < POSTS_PER_PRODUCER; i++) {
+                if (bridge.Post(JavaRequest::Vibrate, t, i)) {
+                    n++;
+                } else {
+                    // full: let the flushing thread catch up (a dropped request stays dropped)
+                    std::this_thread::yield();
+                }
+            }
+            accepted += n;
+            running--;
+        });
+    }
+    // the GL thread, flushing as fast as it can
+    while (running > 0) {
+        bridge.Flush();
+    }
+    for (std::thread& t : threads) {
+        t.join();
+    }
+    bridge.Flush();
+
+    // per producer, what came through must be in order and without duplicates
+    bool ordered = true;
+    std::vector<int32_t> last(PRODUCERS, -1);
+    for (const StubSink::Request& r : sink.received) {
+        if (r.a < 0 || r.a >= PRODUCERS || r.b <= last[r.a]) {
+            ordered = false;
+            break;
+        }
+        last[r.a] = r.b;
+    }
+    uint32_t posted = PRODUCERS * POSTS_PER_PRODUCER;
+    printf("  (%u posted, %zu delivered in %d batches of up to %zu, %u dropped)\n", posted,
+           sink.received.size(), sink.batches, sink.max_batch, bridge.GetDropped());
+    bool ok = Check(ordered, "each producer's requests in order, no duplicates");
+    ok &= Check(sink.received.size() == accepted &&
+                accepted + bridge.GetDropped() == posted,
+                "delivered + dropped == posted");
+    return ok;
+}
+
+int main() {
+    bool ok = true;
+    printf("one thread:\n");
+    ok &= CheckSingleThread();
+    printf("%d producers, flushing continuously:\n", PRODUCERS);
+    ok &= CheckProducers();
+
+    // the hot path: a post, with a flush every JAVA_REQUEST_QUEUE_SIZE / 2 posts (frames)
+    JniBridge bridge;
+    StubSink sink;
+    bridge.SetSink(&sink);
+    uint64_t post_ns = 0;
+    for (int i = 0; i < TIMED_POSTS; i += JAVA_REQUEST_QUEUE_SIZE / 2) {
+        uint64_t start = TimeNowNs();
+        for (int j = 0; j < JAVA_REQUEST_QUEUE_SIZE / 2; j++) {
+            bridge.Post(JavaRequest::HapticFeedback, j);
+        }
+        post_ns += TimeNowNs() - start;
+        sink.received.clear();
+        bridge.Flush();
+    }
+    printf("Post(): %.1f ns\n", (double) post_ns / TIMED_POSTS);
+
+    printf("%s\n", ok ? "OK" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,359 @@
+// Compiles text obstacle pattern definitions into the flat binary library the game maps at
+// runtime (see obstacle_patterns.hpp), with an alias table per difficulty level so that
+// picking a pattern is O(1).
+//
+// Definitions look like this (the grid is OBS_GRID_SIZE rows of OBS_GRID_SIZE cells, top row
+// first, as the player sees it: '#' is a box, '.' a free cell and '*' the bonus):
+//
+//   # comment
+//   pattern wall_with_door
+//   levels 2-5          (or "2-" for level 2 and up, or just "2")
+//   weight 3            (optional, 1 by default)
+//   #####
+//   #####
+//   ##*##
+//   ##.##
+//   #####
+//
+// Every pattern needs at least one free cell, and every level up to the highest one named
+// needs at least one pattern. Levels past the last one use its table.
+//
+// Build (host):
+//   g++ -std=c++17 -O2 -I.. obstacle_compiler.cpp ../obstacle_patterns.cpp -o obstacle_compiler
+//
+// Usage:
+//   obstacle_compiler [-c samples] patterns.txt obstacles.bin
+//
+// With -c, the written library is opened again and sampled to check that every level picks
+// its patterns in proportion to their weights.
+
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "obstacle_patterns.hpp"
+
+struct Definition {
+    std::string name;
+    int line;
+    int min_level = -1, max_level = -1;
+    int weight = 1;
+    uint64_t mask = 0;
+    int bonus_cell = -1;
+    std::vector<std::string> rows;
+};
+
+static const char *_path;
+
+static void Fail(int line, const char *message, const std::string& detail = "") {
+    fprintf(stderr, "%s:%d: %s%s\n", _path, line, message, detail.c_str());
+    exit(1);
+}
+
+static std::string Trim(const std::string& s) {
+    size_t b = 0, e = s.size();
+    while (b < e && isspace((unsigned char) s[b])) b++;
+    while (e > b && isspace((unsigned char) s[e - 1])) e--;
+    return s.substr(b, e - b);
+}
+
+static void FinishDefinition(Definition *d) {
+    if (d->min_level < 0) {
+        Fail(d->line, "missing levels for pattern ", d->name);
+    }
+    if ((int) d->rows.size() != OBS_GRID_SIZE) {
+        Fail(d->line, "wrong number of grid rows in pattern ", d->name);
+    }
+    for (int i = 0; i < OBS_GRID_SIZE; i++) {
+        // top row first
+        int row = OBS_GRID_SIZE - 1 - i;
+        for (int col = 0; col < OBS_GRID_SIZE; col++) {
+            int cell = row * OBS_GRID_SIZE + col;
+            char c = d->rows[i][col];
+            if (c == '#') {
+                d->mask |= 1ull << cell;
+            } else if (c == '*') {
+                if (d->bonus_cell >= 0) {
+                    Fail(d->line, "more than one bonus in pattern ", d->name);
+                }
+                d->bonus_cell = cell;
+            }
+        }
+    }
+    if (__builtin_popcountll(d->mask) == OBS_GRID_SIZE * OBS_GRID_SIZE) {
+        Fail(d->line, "no way through pattern ", d->name);
+    }
+}
+
+static std::vector<Definition> Parse(FILE *f) {
+    std::vector<Definition> defs;
+    Definition *cur = NULL;
+    char buf[256];
+    for (int line = 1; fgets(buf, sizeof(buf), f); line++) {
+        std::string s = Trim(buf);
+        if (s.empty()) {
+            continue;
+        }
+
+        // grid rows first: they can start with '#'
+        if (cur && cur->rows.size() < OBS_GRID_SIZE && s.size() == OBS_GRID_SIZE &&
+                s.find_first_not_of("#.*") == std::string::npos) {
+            cur->rows.push_back(s);
+            continue;
+        }
+        if (s[0] == '#') {
+            continue;
+        }
+
+        std::string key = s.substr(0, s.find(' '));
+        std::string value = Trim(s.substr(key.size()));
+        if (key == "pattern") {
+            if (cur) {
+                FinishDefinition(cur);
+            }
+            if (value.empty()) {
+                Fail(line, "pattern needs a name");
+            }
+            defs.push_back(Definition());
+            cur = &defs.back();
+            cur->name = value;
+            cur->line = line;
+        } else if (!cur) {
+            Fail(line, "expected 'pattern'");
+        } else if (key == "levels") {
+            int a = -1, b = -1;
+            char dash = 0;
+            int n = sscanf(value.c_str(), "%d%c%d", &a, &dash, &b);
+            if (n == 1) {
+                b = a;
+            } else if (n == 2 && dash == '-') {
+                b = OBS_PATTERN_ANY_LEVEL;
+            } else if (n != 3 || dash != '-') {
+                Fail(line, "bad levels: ", value);
+            }
+            if (a < 0 || b < a || a >= OBS_PATTERN_ANY_LEVEL) {
+                Fail(line, "bad levels: ", value);
+            }
+            cur->min_level = a;
+            cur->max_level = b;
+        } else if (key == "weight") {
+            cur->weight = atoi(value.c_str());
+            if (cur->weight < 1 || cur->weight > 0xffff) {
+                Fail(line, "weight must be 1-65535: ", value);
+            }
+        } else {
+            Fail(line, "unexpected: ", s);
+        }
+    }
+    if (cur) {
+        FinishDefinition(cur);
+    }
+    return defs;
+}
+
+// Vose's construction of the alias table for the given patterns of a level
+static void BuildAliasTable(const std::vector<Definition>& defs, const std::vector<int>& members,
+                            std::vector<ObstaclePatternAlias> *out) {
+    size_t n = members.size();
+    double total = 0.0;
+    for (int m : members) {
+        total += defs[m].weight;
+    }
+
+    std::vector<double> scaled(n);
+    std::vector<size_t> small, large;
+    for (size_t i = 0; i < n; i++) {
+        scaled[i] = defs[members[i]].weight * n / total;
+        (scaled[i] < 1.0 ? small : large).push_back(i);
+    }
+
+    size_t first = out->size();
+    for (size_t i = 0; i < n; i++) {
+        // by default, an entry always picks its own pattern
+        out->push_back({ OBS_PATTERN_ONE, (uint16_t) members[i], (uint16_t) members[i] });
+    }
+    while (!small.empty() && !large.empty()) {
+        size_t s = small.back(), l = large.back();
+        small.pop_back();
+        large.pop_back();
+        ObstaclePatternAlias& a = (*out)[first + s];
+        a.threshold = (uint32_t) std::min<double>(llround(scaled[s] * OBS_PATTERN_ONE),
+                                                  OBS_PATTERN_ONE);
+        a.alias = (uint16_t) members[l];
+        scaled[l] -= 1.0 - scaled[s];
+        (scaled[l] < 1.0 ? small : large).push_back(l);
+    }
+    // whatever is left is 1 up to rounding errors
+}
+
+static bool Check(const char *path, const std::vector<Definition>& defs, int level_count,
+                  int samples) {
+    ObstaclePatternLibrary lib;
+    if (!lib.OpenFile(path)) {
+        fprintf(stderr, "%s: can't open the library that was written\n", path);
+        return false;
+    }
+
+    uint64_t state = 0x9e3779b97f4a7c15ull;
+    bool ok = true;
+    for (int level = 0; level < level_count; level++) {
+        std::vector<int> counts(defs.size());
+        double total = 0.0;
+        for (const Definition& d : defs) {
+            if (level >= d.min_level && level <= d.max_level) {
+                total += d.weight;
+            }
+        }
+        for (int i = 0; i < samples; i++) {
+            // splitmix64
+            uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+            const ObstaclePattern *p = lib.Pick(level, z ^ (z >> 31));
+            counts[p - &lib.GetPattern(0)]++;
+        }
+
+        // every pattern's frequency within 5 standard deviations of its weight's share
+        double worst = 0.0;
+        for (size_t i = 0; i < defs.size(); i++) {
+            bool member = level >= defs[i].min_level && level <= defs[i].max_level;
+            double expected = member ? defs[i].weight / total : 0.0;
+            double sd = sqrt(samples * expected * (1.0 - expected));
+            double dev = fabs(counts[i] - samples * expected);
+            if ((!member && counts[i] > 0) || dev > 5.0 * sd + 1.0) {
+                fprintf(stderr, "level %d: %s picked %d times, expected %.0f\n", level,
+                        defs[i].name.c_str(), counts[i], samples * expected);
+                ok = false;
+            }
+            worst = std::max(worst, sd > 0.0 ? dev / sd : 0.0);
+        }
+        printf("level %d: %d samples, worst deviation %.2f sd\n", level, samples, worst);
+    }
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    int samples = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "c:")) != -1) {
+        if (opt == 'c') {
+            samples = atoi(optarg);
+        } else {
+            fprintf(stderr, "usage: obstacle_compiler [-c samples] patterns.txt obstacles.bin\n");
+            return 2;
+        }
+    }
+    if (optind + 2 != argc) {
+        fprintf(stderr, "usage: obstacle_compiler [-c samples] patterns.txt obstacles.bin\n");
+        return 2;
+    }
+    _path = argv[optind];
+
+    FILE *f = fopen(_path, "r");
+    if (!f) {
+        perror(_path);
+        return 1;
+    }
+    std::vector<Definition> defs = Parse(f);
+    fclose(f);
+    if (defs.empty() || defs.size() > 0xffff) {
+        fprintf(stderr, "%s: need 1-65535 patterns\n", _path);
+        return 1;
+    }
+
+    // levels named explicitly; open-ended patterns join every table from their first level
+    int level_count = 0;
+    for (const Definition& d : defs) {
+        level_count = std::max(level_count, d.min_level + 1);
+        if (d.max_level != OBS_PATTERN_ANY_LEVEL) {
+            level_count = std::max(level_count, d.max_level + 1);
+        }
+    }
+
+    std::vector<ObstaclePattern> patterns;
+    std::string names;
+    for (const Definition& d : defs) {
+        ObstaclePattern p;
+        memset(&p, 0, sizeof(p));
+        p.mask_lo = (uint32_t) d.mask;
+        p.mask_hi = (uint32_t) (d.mask >> 32);
+        p.name = (uint32_t) names.size();
+        p.weight = (uint16_t) d.weight;
+        p.min_level = (uint8_t) d.min_level;
+        p.max_level = (uint8_t) d.max_level;
+        p.bonus_cell = (int16_t) d.bonus_cell;
+        patterns.push_back(p);
+        names += d.name;
+        names += '\0';
+    }
+    // keeps the file size a multiple of 4
+    names.resize((names.size() + 3) & ~3u, '\0');
+
+    std::vector<ObstaclePatternLevel> levels;
+    std::vector<ObstaclePatternAlias> aliases;
+    for (int level = 0; level < level_count; level++) {
+        std::vector<int> members;
+        for (size_t i = 0; i < defs.size(); i++) {
+            if (level >= defs[i].min_level && level <= defs[i].max_level) {
+                members.push_back((int) i);
+            }
+        }
+        if (members.empty()) {
+            fprintf(stderr, "%s: no patterns for level %d\n", _path, level);
+            return 1;
+        }
+        levels.push_back({ (uint32_t) aliases.size(), (uint32_t) members.size() });
+        BuildAliasTable(defs, members, &aliases);
+    }
+
+    ObstaclePatternHeader h;
+    memset(&h, 0, sizeof(h));
+    h.magic = OBS_PATTERNS_MAGIC;
+    h.version = OBS_PATTERNS_VERSION;
+    h.grid_size = OBS_GRID_SIZE;
+    h.pattern_count = (uint32_t) patterns.size();
+    h.level_count = (uint32_t) levels.size();
+    h.alias_count = (uint32_t) aliases.size();
+    h.names_size = (uint32_t) names.size();
+    h.file_size = (uint32_t) (sizeof(h) + patterns.size() * sizeof(ObstaclePattern) +
+                              levels.size() * sizeof(ObstaclePatternLevel) +
+                              aliases.size() * sizeof(ObstaclePatternAlias) + names.size());
+
+    const char *out_path = argv[optind + 1];
+    FILE *out = fopen(out_path, "wb");
+    if (!out) {
+        perror(out_path);
+        return 1;
+    }
+    bool ok = fwrite(&h, sizeof(h), 1, out) == 1 &&
+              fwrite(patterns.data(), sizeof(ObstaclePattern), patterns.size(), out) ==
+                      patterns.size() &&
+              fwrite(levels.data(), sizeof(ObstaclePatternLevel), levels.size(), out) ==
+                      levels.size() &&
+              fwrite(aliases.data(), sizeof(ObstaclePatternAlias), aliases.size(), out) ==
+                      aliases.size() &&
+              fwrite(names.data(), 1, names.size(), out) == names.size();
+    ok = (fclose(out) == 0) && ok;
+    if (!ok) {
+        fprintf(stderr, "%s: write failed\n", out_path);
+        return 1;
+    }
+
+    printf("%s: %zu patterns, %d levels, %u bytes\n", out_path, patterns.size(), level_count,
+           h.file_size);
+    for (int level = 0; level < level_count; level++) {
+        printf("  level %d: %u patterns\n", level, levels[level].count);
+    }
+
+    if (samples > 0 && !Check(out_path, defs, level_count, samples)) {
+        return 1;
+    }
+    return 0;
+}
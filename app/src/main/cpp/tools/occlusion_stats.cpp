@@ -0,0 +1,189 @@
+// Measures how many obstacle boxes ObstacleOcclusion removes at each difficulty level, and how
+// long a pass takes. Obstacles are random, getting denser with the level (as they do in the
+// game), spread over the RENDER_TUNNEL_SECTION_COUNT sections ahead of the player.
+//
+// With -v, every removed box is checked by casting rays from the eye to points on its faces:
+// all of them must hit a nearer box, or the pass isn't conservative.
+//
+// Build (host):
+//   g++ -std=c++17 -O2 -I.. occlusion_stats.cpp ../occlusion.cpp -o occlusion_stats
+//
+// Usage:
+//   occlusion_stats [-v] [frames per level] [spacing]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "occlusion.hpp"
+#include "timing.hpp"
+
+#define MAX_LEVEL 8
+#define ASPECT (16.0f / 9.0f)
+
+static uint32_t _seed = 1234;
+
+static float RandFloat() {
+    _seed = _seed * 1664525u + 1013904223u;
+    return (_seed >> 8) / (float) (1u << 24);
+}
+
+// random obstacle: each cell has a box with probability fill, but one cell is always free
+static void RandomObstacle(Obstacle *o, float fill) {
+    o->Reset();
+    for (int r = 0; r < OBS_GRID_SIZE; r++) {
+        for (int c = 0; c < OBS_GRID_SIZE; c++) {
+            o->SetBox(c, r, RandFloat() < fill);
+        }
+    }
+    int free_cell = (int) (RandFloat() * OBS_GRID_SIZE * OBS_GRID_SIZE);
+    o->mask &= ~((ObstacleMask) 1 << free_cell);
+}
+
+// does the segment from the eye to p go through any box of the obstacle?
+static bool SegmentHitsObstacle(const float *eye, const float *p, const Obstacle& o) {
+    float h = 0.5f * OBS_BOX_SIZE;
+    for (int r = 0; r < OBS_GRID_SIZE; r++) {
+        for (int c = 0; c < OBS_GRID_SIZE; c++) {
+            if (!o.HasBox(c, r)) {
+                continue;
+            }
+            float lo[3] = { Obstacle::GetCellCenterX(c) - h, o.y - h, Obstacle::GetCellCenterZ(r) - h };
+            float hi[3] = { Obstacle::GetCellCenterX(c) + h, o.y + h, Obstacle::GetCellCenterZ(r) + h };
+            // slab test, t in [0, 1)
+            float t0 = 0.0f, t1 = 0.999f;
+            bool hit = true;
+            for (int a = 0; a < 3 && hit; a++) {
+                float d = p[a] - eye[a];
+                if (fabsf(d) < 1e-9f) {
+                    hit = eye[a] >= lo[a] && eye[a] <= hi[a];
+                    continue;
+                }
+                float ta = (lo[a] - eye[a]) / d, tb = (hi[a] - eye[a]) / d;
+                if (ta > tb) {
+                    float tmp = ta; ta = tb; tb = tmp;
+                }
+                t0 = fmaxf(t0, ta);
+                t1 = fminf(t1, tb);
+                hit = t0 <= t1;
+            }
+            if (hit) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// is the box entirely hidden by the obstacles before it? Checks rays to a grid of points on
+// the faces the eye can see.
+static bool IsHidden(const OcclusionView& v, const Obstacle *const *obs, int index, int c, int r) {
+    const float eye[3] = { v.eye_x, v.eye_y, v.eye_z };
+    const Obstacle& o = *obs[index];
+    float h = 0.5f * OBS_BOX_SIZE;
+    float center[3] = { Obstacle::GetCellCenterX(c), o.y, Obstacle::GetCellCenterZ(r) };
+
+    const int n = 6;
+    for (int face = 0; face < 3; face++) {
+        for (int i = 0; i <= n; i++) {
+            for (int j = 0; j <= n; j++) {
+                float p[3];
+                float u = -h + 2 * h * i / n, w = -h + 2 * h * j / n;
+                // face 0: front (y), 1: side facing the eye in x, 2: side facing the eye in z
+                int a = face == 0 ? 1 : face == 1 ? 0 : 2;
+                int b = a == 1 ? 0 : 1, e = a == 2 ? 0 : 2;
+                p[a] = center[a] + (eye[a] < center[a] ? -h : h);
+                p[b] = center[b] + u;
+                p[e] = center[e] + w;
+
+                bool blocked = false;
+                for (int k = 0; k < index && !blocked; k++) {
+                    blocked = SegmentHitsObstacle(eye, p, *obs[k]);
+                }
+                if (!blocked) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    bool verify = false;
+    int argi = 1;
+    if (argi < argc && 0 == strcmp(argv[argi], "-v")) {
+        verify = true;
+        argi++;
+    }
+    int frames = argi < argc ? atoi(argv[argi++]) : 2000;
+    float spacing = argi < argc ? (float) atof(argv[argi++]) : 20.0f;
+
+    OcclusionView view;
+    view.tan_half_fov_z = tanf(0.5f * RENDER_FOV * 3.14159265f / 180.0f);
+    view.tan_half_fov_x = view.tan_half_fov_z * ASPECT;
+
+    int count = (int) (RENDER_TUNNEL_SECTION_COUNT * TUNNEL_SECTION_LENGTH / spacing);
+    std::vector<Obstacle> obstacles(count);
+    std::vector<const Obstacle*> ptrs(count);
+    std::vector<ObstacleMask> visible(count);
+    bool conservative = true;
+
+    printf("%d obstacles, %.0f apart; %d frames per level\n\n", count, spacing, frames);
+    printf("level  fill  boxes/frame  removed  removed%%  (by view cone)  ns/pass\n");
+
+    for (int level = 0; level < MAX_LEVEL; level++) {
+        float fill = fminf(0.3f + 0.08f * level, 0.9f);
+        uint64_t boxes = 0, removed = 0, by_view = 0, ns = 0;
+
+        for (int f = 0; f < frames; f++) {
+            view.eye_x = PLAYER_MIN_X + RandFloat() * (PLAYER_MAX_X - PLAYER_MIN_X);
+            view.eye_z = PLAYER_MIN_Z + RandFloat() * (PLAYER_MAX_Z - PLAYER_MIN_Z);
+            view.eye_y = 0.0f;
+            float first = OBS_BOX_SIZE + RandFloat() * spacing;
+            for (int i = 0; i < count; i++) {
+                RandomObstacle(&obstacles[i], fill);
+                obstacles[i].y = first + i * spacing;
+                ptrs[i] = &obstacles[i];
+                boxes += obstacles[i].GetBoxCount();
+            }
+
+            uint64_t start = TimeNowNs();
+            removed += ObstacleOcclusion::Cull(view, ptrs.data(), count, visible.data());
+            ns += TimeNowNs() - start;
+
+            for (int i = 0; i < count; i++) {
+                by_view += DefaultGrid::Count(obstacles[i].mask &
+                        ~ObstacleOcclusion::GetViewMask(view, obstacles[i].y));
+            }
+
+            if (verify) {
+                for (int i = 0; i < count; i++) {
+                    ObstacleMask culled = obstacles[i].mask & ~visible[i] &
+                                          ObstacleOcclusion::GetViewMask(view, obstacles[i].y);
+                    for (int cell = 0; cell < OBS_GRID_SIZE * OBS_GRID_SIZE; cell++) {
+                        if ((culled >> cell & 1) && !IsHidden(view, ptrs.data(), i,
+                                cell % OBS_GRID_SIZE, cell / OBS_GRID_SIZE)) {
+                            printf("NOT CONSERVATIVE: level %d frame %d obstacle %d cell %d\n",
+                                   level, f, i, cell);
+                            conservative = false;
+                        }
+                    }
+                }
+            }
+        }
+
+        printf("%5d  %4.2f  %11.1f  %7.1f  %7.1f%%  %13.1f%%  %7.0f\n", level, fill,
+               boxes / (double) frames, removed / (double) frames,
+               100.0 * removed / (double) boxes, 100.0 * by_view / (double) boxes,
+               ns / (double) frames);
+    }
+
+    if (verify) {
+        printf("\n%s\n", conservative ? "all removed boxes verified hidden" : "FAILED");
+    }
+    return conservative ? 0 : 1;
+}
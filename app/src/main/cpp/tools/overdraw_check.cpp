@@ -0,0 +1,276 @@
+// Runs OverdrawMeter headless (Mesa's surfaceless EGL platform, or the default display) on
+// a few synthetic scenes, to check the meter itself and to catch overdraw regressions in CI:
+//
+//   layers      N full-screen quads in one pass: the overdraw must be exactly N everywhere
+//   triangles   the engine's benchmark grid of N triangles, over a full-screen background
+//               pass
+//   stray       OVERDRAW_MAX_PASSES passes of two full-screen quads, then N more, with a quad
+//               drawn outside of any pass before, between and after them: only the first
+//               OVERDRAW_MAX_PASSES passes may be counted (a stray quad written unblended
+//               would reset a count to 1)
+//
+// Build (host):
+//   g++ -std=c++17 -O2 -I.. overdraw_check.cpp ../overdraw.cpp ../program_interface.cpp -lEGL
+//       -lGLESv2 -o overdraw_check
+//
+// Usage:
+//   overdraw_check [-s WxH] [-m max_overdraw] [-o report.jsonl]
+//                  [layers N | triangles N | stray N]...
+//
+// Without scenes, runs "layers 1 layers 3 triangles 100 stray 1". Exits with 1 if a layers
+// or stray scene isn't measured exactly, or any scene's overdraw exceeds max_overdraw.
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "overdraw.hpp"
+
+// enough frames for the readbacks to come back
+#define FRAMES (OVERDRAW_READBACKS + 2)
+
+static const char *SCENE_VS =
+    "#version 300 es\n"
+    "in vec2 i_position;\n"
+    "void main() {\n"
+    "    gl_Position = vec4(i_position, 0.0, 1.0);\n"
+    "}\n";
+
+static bool InitEgl(int width, int height) {
+    EGLDisplay display = EGL_NO_DISPLAY;
+    PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+            (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (get_platform_display) {
+        display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    }
+    if (display == EGL_NO_DISPLAY) {
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL)) {
+        fprintf(stderr, "can't initialize EGL (error 0x%x)\n", eglGetError());
+        return false;
+    }
+
+    const EGLint config_attribs[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_ES3_BIT,
+        EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint count = 0;
+    if (!eglChooseConfig(display, config_attribs, &config, 1, &count) || count == 0) {
+        fprintf(stderr, "no GLES 3 pbuffer config\n");
+        return false;
+    }
+
+    const EGLint surface_attribs[] = { EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE };
+    EGLSurface surface = eglCreatePbufferSurface(display, config, surface_attribs);
+    eglBindAPI(EGL_OPENGL_ES_API);
+    const EGLint context_attribs[] = { EGL_CONTEXT_CLIENT_VERSION, 3, EGL_NONE };
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, context_attribs);
+    if (surface == EGL_NO_SURFACE || context == EGL_NO_CONTEXT ||
+            !eglMakeCurrent(display, surface, surface, context)) {
+        fprintf(stderr, "can't create the pbuffer/context (error 0x%x)\n", eglGetError());
+        return false;
+    }
+    fprintf(stderr, "renderer: %s\n", (const char*) glGetString(GL_RENDERER));
+    return true;
+}
+
+static GLuint LinkCountingProgram(GLuint counting_fs) {
+    GLuint vs = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vs, 1, &SCENE_VS, NULL);
+    glCompileShader(vs);
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vs);
+    glAttachShader(program, counting_fs);
+    glBindAttribLocation(program, 0, "i_position");
+    glLinkProgram(program);
+    glDeleteShader(vs);
+
+    GLint status = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    return status ? program : 0;
+}
+
+static void AddQuad(std::vector<float> *v, float x0, float y0, float x1, float y1) {
+    const float q[12] = { x0, y0, x1, y0, x1, y1, x0, y0, x1, y1, x0, y1 };
+    v->insert(v->end(), q, q + 12);
+}
+
+// same layout as NativeEngine::SetTriangleCount(): one triangle per cell of a grid
+static void AddTriangleGrid(std::vector<float> *v, int count) {
+    static const float base[6] = { -0.5f, 0.0f, 0.5f, -0.5f, 0.5f, 0.5f };
+    int grid = (int) ceilf(sqrtf((float) count));
+    float scale = 1.0f / grid;
+    for (int t = 0; t < count; t++) {
+        float ox = -1.0f + (2.0f * (t % grid) + 1.0f) / grid;
+        float oy = -1.0f + (2.0f * (t / grid) + 1.0f) / grid;
+        for (int i = 0; i < 3; i++) {
+            v->push_back(ox + base[i * 2] * scale);
+            v->push_back(oy + base[i * 2 + 1] * scale);
+        }
+    }
+}
+
+struct ScenePass {
+    const char *name;  // NULL: drawn outside of a pass
+    std::vector<float> vertices;
+};
+
+static bool RunScene(OverdrawMeter *meter, GLuint program, int width, int height,
+                     const std::vector<ScenePass>& passes, OverdrawReport *report) {
+    GLuint vao, vbo;
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &vbo);
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, 0);
+    glUseProgram(program);
+    glViewport(0, 0, width, height);
+
+    bool got = false;
+    for (uint32_t frame = 0; frame < FRAMES; frame++) {
+        meter->BeginFrame(width, height, frame);
+        for (const ScenePass& p : passes) {
+            if (p.name) {
+                meter->BeginPass(p.name);
+            }
+            glBufferData(GL_ARRAY_BUFFER, p.vertices.size() * sizeof(float), p.vertices.data(),
+                         GL_STREAM_DRAW);
+            glDrawArrays(GL_TRIANGLES, 0, (GLsizei) p.vertices.size() / 2);
+            if (p.name) {
+                meter->EndPass();
+            }
+        }
+        meter->EndFrame();
+        got |= meter->Poll(report);
+    }
+
+    glDeleteBuffers(1, &vbo);
+    glDeleteVertexArrays(1, &vao);
+    return got;
+}
+
+static void PrintReport(const char *scene, const OverdrawReport& r) {
+    printf("%-16s overdraw %.3f  fill %.3f  max %u  histogram", scene, r.GetOverdraw(),
+           r.GetFill(), r.max);
+    for (int i = 0; i < OVERDRAW_BUCKETS; i++) {
+        printf(" %.1f%%", 100.0 * r.histogram[i] / ((double) r.width * r.height));
+    }
+    printf("\n");
+    for (int p = 0; p < r.pass_count; p++) {
+        printf("  %-14s %.3f fragments/pixel\n", r.passes[p].name,
+               (double) r.passes[p].fragments / ((double) r.width * r.height));
+    }
+}
+
+int main(int argc, char **argv) {
+    int width = 1280, height = 720;
+    float max_overdraw = 0.0f;
+    const char *report_path = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "s:m:o:")) != -1) {
+        switch (opt) {
+            case 's': sscanf(optarg, "%dx%d", &width, &height); break;
+            case 'm': max_overdraw = (float) atof(optarg); break;
+            case 'o': report_path = optarg; break;
+            default:
+                fprintf(stderr, "usage: overdraw_check [-s WxH] [-m max_overdraw] "
+                                "[-o report.jsonl] [layers N | triangles N | stray N]...\n");
+                return 2;
+        }
+    }
+
+    std::vector<std::pair<std::string, int>> scenes;
+    for (int i = optind; i + 1 < argc; i += 2) {
+        scenes.push_back({ argv[i], atoi(argv[i + 1]) });
+    }
+    if (scenes.empty()) {
+        scenes = { { "layers", 1 }, { "layers", 3 }, { "triangles", 100 }, { "stray", 1 } };
+    }
+
+    if (!InitEgl(width, height)) {
+        return 1;
+    }
+    OverdrawMeter meter;
+    if (!meter.Init(report_path)) {
+        fprintf(stderr, "overdraw meter: %s\n", meter.GetError().c_str());
+        return 1;
+    }
+    GLuint program = LinkCountingProgram(meter.GetCountingShader());
+    if (!program) {
+        fprintf(stderr, "can't link the scene program\n");
+        return 1;
+    }
+
+    bool ok = true;
+    for (const auto& s : scenes) {
+        std::vector<ScenePass> passes;
+        if (s.first == "layers") {
+            passes.push_back({ "layers", {} });
+            for (int i = 0; i < s.second; i++) {
+                AddQuad(&passes.back().vertices, -1.0f, -1.0f, 1.0f, 1.0f);
+            }
+        } else if (s.first == "triangles") {
+            passes.push_back({ "background", {} });
+            AddQuad(&passes.back().vertices, -1.0f, -1.0f, 1.0f, 1.0f);
+            passes.push_back({ "triangles", {} });
+            AddTriangleGrid(&passes.back().vertices, s.second);
+        } else if (s.first == "stray") {
+            for (int i = 0; i < OVERDRAW_MAX_PASSES + s.second; i++) {
+                passes.push_back({ NULL, {} });
+                AddQuad(&passes.back().vertices, -1.0f, -1.0f, 1.0f, 1.0f);
+                passes.push_back({ "pass", {} });
+                AddQuad(&passes.back().vertices, -1.0f, -1.0f, 1.0f, 1.0f);
+                AddQuad(&passes.back().vertices, -1.0f, -1.0f, 1.0f, 1.0f);
+            }
+            passes.push_back({ NULL, {} });
+            AddQuad(&passes.back().vertices, -1.0f, -1.0f, 1.0f, 1.0f);
+        } else {
+            fprintf(stderr, "unknown scene %s\n", s.first.c_str());
+            return 2;
+        }
+
+        OverdrawReport r;
+        std::string name = s.first + " " + std::to_string(s.second);
+        if (!RunScene(&meter, program, width, height, passes, &r)) {
+            printf("%-16s FAILED: no report (error: %s)\n", name.c_str(),
+                   meter.GetError().c_str());
+            ok = false;
+            continue;
+        }
+        PrintReport(name.c_str(), r);
+
+        if (s.first == "layers" || s.first == "stray") {
+            uint32_t expected = s.first == "stray" ? 2 * OVERDRAW_MAX_PASSES :
+                                std::min(s.second, 255);
+            uint32_t bucket = std::min<uint32_t>(expected, OVERDRAW_BUCKETS - 1);
+            if (r.max != expected || r.histogram[bucket] != (uint32_t) (width * height)) {
+                printf("  FAILED: expected %u fragments on every pixel\n", expected);
+                ok = false;
+            }
+        }
+        if (max_overdraw > 0.0f && r.GetOverdraw() > max_overdraw) {
+            printf("  FAILED: overdraw above %.2f\n", max_overdraw);
+            ok = false;
+        }
+    }
+
+    if (meter.GetSkipped()) {
+        printf("%u frames skipped (readbacks in flight)\n", meter.GetSkipped());
+    }
+    glDeleteProgram(program);
+    meter.Shutdown();
+    return ok ? 0 : 1;
+}
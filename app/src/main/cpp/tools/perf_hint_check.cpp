@@ -0,0 +1,229 @@
+// Runs PerformanceHint's thermal control loop (see perf_hint.hpp) off-device, against a fake
+// sysfs tree: warms the thermal zones up through every state and back, throttles a cpufreq
+// policy, and checks the state the engine would see after each poll, and that polls are rate
+// limited. Then times a poll on a phone-sized tree (30 zones, 3 clusters), against opening and
+// reading every file each time, as the first version did.
+//
+// Build (host):
+//   g++ -std=c++17 -O2 -I.. perf_hint_check.cpp ../perf_hint.cpp ../trace.cpp
+//       ../suspend.cpp ../flight_recorder.cpp -ldl -o perf_hint_check
+//
+// Usage:
+//   perf_hint_check
+//
+// Exits with 1 if any check fails.
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "perf_hint.hpp"
+#include "timing.hpp"
+
+#define ZONES 30
+#define POLICIES 3
+#define TRIP_MILLIDEGREES 95000
+#define MAX_FREQ_KHZ 2400000
+#define TIMED_POLLS 2000
+
+// poll interval, as far as the checks are concerned (PerformanceHint's is 1 s)
+#define SECOND_NS 1000000000ull
+
+static void WriteLong(const std::string& path, long value) {
+    FILE *f = fopen(path.c_str(), "w");
+    if (f) {
+        fprintf(f, "%ld\n", value);
+        fclose(f);
+    }
+}
+
+static void MakeDirs(const std::string& path) {
+    for (size_t i = 1; i <= path.size(); i++) {
+        if (i == path.size() || path[i] == '/') {
+            mkdir(path.substr(0, i).c_str(), 0700);
+        }
+    }
+}
+
+// /sys/class/thermal and /sys/devices/system/cpu/cpufreq, as a phone has them
+static void MakeTree(const std::string& root) {
+    for (int z = 0; z <= ZONES; z++) {
+        std::string dir = root + "/class/thermal/thermal_zone" + std::to_string(z);
+        MakeDirs(dir);
+        WriteLong(dir + "/temp", 35000);
+        // the last one has no trip point, and must be ignored
+        if (z < ZONES) {
+            WriteLong(dir + "/trip_point_0_temp", TRIP_MILLIDEGREES);
+        }
+    }
+    // cooling devices live there too
+    MakeDirs(root + "/class/thermal/cooling_device0");
+    for (int p = 0; p < POLICIES; p++) {
+        std::string dir = root + "/devices/system/cpu/cpufreq/policy" + std::to_string(p * 4);
+        MakeDirs(dir);
+        WriteLong(dir + "/cpuinfo_max_freq", MAX_FREQ_KHZ);
+        WriteLong(dir + "/scaling_max_freq", MAX_FREQ_KHZ);
+    }
+}
+
+static void SetTemp(const std::string& root, int zone, double fraction_of_trip) {
+    WriteLong(root + "/class/thermal/thermal_zone" + std::to_string(zone) + "/temp",
+              (long) (fraction_of_trip * TRIP_MILLIDEGREES));
+}
+
+static void SetMaxFreq(const std::string& root, int policy, double fraction) {
+    WriteLong(root + "/devices/system/cpu/cpufreq/policy" + std::to_string(policy * 4) +
+              "/scaling_max_freq", (long) (fraction * MAX_FREQ_KHZ));
+}
+
+static bool Check(ThermalState state, ThermalState expected, const char *what) {
+    bool ok = state == expected;
+    printf("  %-48s %-8s %s\n", what, ThermalStateName(state), ok ? "ok" : "FAILED");
+    return ok;
+}
+
+// the first version: find and open every file on every poll
+static float PollOpeningEverything(const std::string& root) {
+    float worst = -1.0f;
+    std::string base = root + "/class/thermal";
+    DIR *dir = opendir(base.c_str());
+    struct dirent *ent;
+    while (dir && (ent = readdir(dir)) != NULL) {
+        if (strncmp(ent->d_name, "thermal_zone", 12) != 0) {
+            continue;
+        }
+        long temp = 0, trip = 0;
+        FILE *f = fopen((base + "/" + ent->d_name + "/temp").c_str(), "r");
+        if (!f) {
+            continue;
+        }
+        bool ok = fscanf(f, "%ld", &temp) == 1;
+        fclose(f);
+        f = fopen((base + "/" + ent->d_name + "/trip_point_0_temp").c_str(), "r");
+        if (!f) {
+            continue;
+        }
+        ok &= fscanf(f, "%ld", &trip) == 1;
+        fclose(f);
+        if (ok && trip > 0 && (float) temp / trip > worst) {
+            worst = (float) temp / trip;
+        }
+    }
+    if (dir) {
+        closedir(dir);
+    }
+    for (int cpu = 0; cpu < 64; cpu++) {
+        long max_hw = 0, max_now = 0;
+        std::string cpufreq = root + "/devices/system/cpu/cpufreq/policy" + std::to_string(cpu);
+        FILE *f = fopen((cpufreq + "/cpuinfo_max_freq").c_str(), "r");
+        if (!f) {
+            continue;
+        }
+        bool ok = fscanf(f, "%ld", &max_hw) == 1;
+        fclose(f);
+        f = fopen((cpufreq + "/scaling_max_freq").c_str(), "r");
+        if (f) {
+            ok &= fscanf(f, "%ld", &max_now) == 1;
+            fclose(f);
+        }
+        (void) ok;
+    }
+    return worst;
+}
+
+int main() {
+    char root_buf[] = "/tmp/perf_hint_check.XXXXXX";
+    if (!mkdtemp(root_buf)) {
+        perror("mkdtemp");
+        return 1;
+    }
+    std::string root = root_buf;
+    MakeTree(root);
+
+    PerformanceHint hint;
+    hint.SetSysfsRoot(root.c_str());
+    hint.Init(16666667);
+    uint64_t now = SECOND_NS;
+    auto poll = [&] {
+        now += SECOND_NS;
+        hint.Poll(now);
+        return hint.GetThermalState();
+    };
+
+    bool ok = true;
+    printf("thermal states:\n");
+    ok &= Check(poll(), ThermalState::Nominal, "cool");
+    static const struct {
+        double fraction;
+        ThermalState expected;
+        const char *what;
+    } steps[] = {
+        { 0.75, ThermalState::Light, "one zone at 75% of its trip point" },
+        { 0.90, ThermalState::Moderate, "90%" },
+        { 1.00, ThermalState::Severe, "at the trip point" },
+        { 1.10, ThermalState::Critical, "past it" },
+        { 0.50, ThermalState::Nominal, "cooled down" },
+    };
+    for (const auto& step : steps) {
+        SetTemp(root, 7, step.fraction);
+        ok &= Check(poll(), step.expected, step.what);
+    }
+    SetTemp(root, ZONES, 2.0);
+    ok &= Check(poll(), ThermalState::Nominal, "a hot zone without a trip point: ignored");
+
+    SetMaxFreq(root, 1, 0.8);
+    ok &= Check(poll(), ThermalState::Severe, "big cluster capped at 80% of its clock");
+    SetMaxFreq(root, 1, 1.0);
+    ok &= Check(poll(), ThermalState::Nominal, "cap lifted");
+
+    SetTemp(root, 3, 1.10);
+    now += SECOND_NS / 2;
+    hint.Poll(now);
+    ok &= Check(hint.GetThermalState(), ThermalState::Nominal,
+                "half a second later: not polled yet");
+    now += SECOND_NS / 2;
+    hint.Poll(now);
+    ok &= Check(hint.GetThermalState(), ThermalState::Critical, "a second later: polled");
+
+    // cost on the game thread, per poll
+    uint64_t start = TimeNowNs();
+    for (int i = 0; i < TIMED_POLLS; i++) {
+        poll();
+    }
+    double cached_us = (double) (TimeNowNs() - start) / TIMED_POLLS / 1000.0;
+    float sink = 0.0f;
+    start = TimeNowNs();
+    for (int i = 0; i < TIMED_POLLS; i++) {
+        sink += PollOpeningEverything(root);
+    }
+    double reopen_us = (double) (TimeNowNs() - start) / TIMED_POLLS / 1000.0;
+    printf("poll, %d zones and %d policies: %.1f us with open files, %.1f us opening them "
+           "each time (%.0f)\n", ZONES, POLICIES, cached_us, reopen_us, sink);
+    ok &= cached_us < reopen_us;
+
+    // the real thing, if this machine has any
+    if (access("/sys/class/thermal/thermal_zone0/temp", R_OK) == 0) {
+        PerformanceHint real;
+        real.Init(16666667);
+        start = TimeNowNs();
+        for (int i = 1; i <= 100; i++) {
+            real.Poll(i * SECOND_NS);
+        }
+        printf("this machine: %.1f us per poll, state %s (headroom %.2f)\n",
+               (double) (TimeNowNs() - start) / 100 / 1000.0,
+               ThermalStateName(real.GetThermalState()), real.GetThermalHeadroom());
+    }
+
+    hint.Shutdown();
+    std::string rm = "rm -rf " + root;
+    if (system(rm.c_str()) != 0) {
+        fprintf(stderr, "couldn't remove %s\n", root.c_str());
+    }
+    printf("%s\n", ok ? "OK" : "FAILED");
+    return ok ? 0 : 1;
+}
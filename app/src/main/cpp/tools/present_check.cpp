@@ -0,0 +1,124 @@
+// Checks the present-timestamp providers (see frame_timestamps.hpp) on the host: the EGL one
+// must decline a surface without EGL_ANDROID_get_frame_timestamps (a Mesa pbuffer, here), so
+// that the engine falls back to the simulated one; and the simulated one must put each frame
+// on the vsync after its swap and scan it out one vsync later, whatever the swap time, with
+// FrameStats turning that into input-to-display latency.
+//
+// Build (host):
+//   g++ -std=c++17 -O2 -I.. present_check.cpp ../frame_timestamps.cpp ../frame_stats.cpp
+//       ../trace.cpp ../suspend.cpp ../flight_recorder.cpp -lEGL -o present_check
+//
+// Usage:
+//   present_check
+//
+// Exits with 1 if any check fails.
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <stdio.h>
+
+#include <string>
+
+#include "frame_timestamps.hpp"
+#include "timing.hpp"
+
+#define PERIOD_NS 16666667ll
+
+static std::string Ms(int64_t ns) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.2f ms", NsToMs(ns));
+    return buf;
+}
+
+static bool Check(bool cond, const char *what, const std::string& detail = "") {
+    printf("  %-52s %s%s%s\n", what, cond ? "ok" : "FAILED", detail.empty() ? "" : ": ",
+           detail.c_str());
+    return cond;
+}
+
+static bool CheckEglFallback() {
+    EGLDisplay display = EGL_NO_DISPLAY;
+    PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+            (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (get_platform_display) {
+        display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    }
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL)) {
+        printf("  (no EGL display, skipping the EGL provider)\n");
+        return true;
+    }
+    const EGLint config_attribs[] = { EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_NONE };
+    EGLConfig config;
+    EGLint count = 0;
+    eglChooseConfig(display, config_attribs, &config, 1, &count);
+    const EGLint surface_attribs[] = { EGL_WIDTH, 16, EGL_HEIGHT, 16, EGL_NONE };
+    EGLSurface surface = count ? eglCreatePbufferSurface(display, config, surface_attribs) :
+            EGL_NO_SURFACE;
+    EglFrameTimestamps egl;
+    bool declined = !egl.Init(display, surface);
+    if (surface != EGL_NO_SURFACE) {
+        eglDestroySurface(display, surface);
+    }
+    eglTerminate(display);
+    return Check(declined, "EGL provider declines a surface without timestamps");
+}
+
+// a frame started by the vsync at frame * PERIOD_NS, whose swap returned swap_ms after it
+static FrameTiming Frame(int64_t frame, double swap_ms, double input_ms_before) {
+    FrameTiming t = {};
+    t.frame = frame;
+    t.vsync_ns = (frame + 1) * PERIOD_NS;
+    t.cpu_start_ns = t.vsync_ns + 100000;
+    t.swap_start_ns = t.vsync_ns + (int64_t) (swap_ms * 0.5e6);
+    t.swap_end_ns = t.vsync_ns + (int64_t) (swap_ms * 1e6);
+    t.input_ns = input_ms_before > 0 ? t.vsync_ns - (int64_t) (input_ms_before * 1e6) : 0;
+    return t;
+}
+
+int main() {
+    bool ok = true;
+    printf("EGL_ANDROID_get_frame_timestamps:\n");
+    ok &= CheckEglFallback();
+
+    printf("simulated:\n");
+    struct Case {
+        const char *what;
+        double swap_ms;
+        int64_t present_periods;  // actual present, in periods after the frame's vsync
+    };
+    static const Case cases[] = {
+        { "swap within the period: shown 2 vsyncs later", 5.0, 2 },
+        { "swap right before the next vsync: same", 16.0, 2 },
+        { "swap past the next vsync: one more", 20.0, 3 },
+        { "swap past two vsyncs: two more", 35.0, 4 },
+    };
+    SimulatedFrameTimestamps sim;
+    sim.SetVsyncPeriod(PERIOD_NS);
+    FrameStats stats;
+    int64_t frame = 0;
+    for (const Case& c : cases) {
+        FrameTiming t = Frame(frame++, c.swap_ms, 4.0);
+        sim.BeforeSwap();
+        sim.AfterSwap(t);
+        sim.Collect(&stats);
+        int64_t expected = t.vsync_ns + c.present_periods * PERIOD_NS;
+        // the latency FrameStats derives has to match the present time we expect
+        int64_t latency = stats.GetLastInputLatencyNs();
+        ok &= Check(latency == expected - t.input_ns, c.what,
+                    Ms(latency) + " input-to-display");
+    }
+
+    // more frames than the provider keeps between two collects: the excess are dropped, the
+    // rest come out in order
+    for (int i = 0; i < 2 * FRAME_TIMESTAMPS_PENDING; i++) {
+        sim.AfterSwap(Frame(frame++, 5.0, 1.0 + i));
+    }
+    sim.Collect(&stats);
+    int64_t expected = 2 * PERIOD_NS + FRAME_TIMESTAMPS_PENDING * 1000000ll;
+    ok &= Check(stats.GetLastInputLatencyNs() == expected,
+                "a backlog: the oldest FRAME_TIMESTAMPS_PENDING kept",
+                Ms(stats.GetLastInputLatencyNs()));
+
+    printf("%s\n", ok ? "OK" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,263 @@
+// Symbolizes a profile written by SamplingProfiler and prints it as collapsed stacks
+// ("thread;root;...;leaf count", one per line), the input format of flamegraph.pl and
+// speedscope.
+//
+// Symbols are read from the ELF files' .symtab (or .dynsym), so point it at the unstripped
+// libraries: on-device paths are looked up by file name in the -s directories (e.g.
+// app/build/intermediates/merged_native_libs/debug/out/lib/arm64-v8a); otherwise the paths in
+// the profile are opened as they are (profiles taken on this machine).
+//
+// Build (host):
+//   g++ -std=c++17 -O2 profile_symbolize.cpp -o profile_symbolize
+//
+// Usage:
+//   profile_symbolize [-s symbol_dir]... profile.txt > profile.folded
+
+#include <cxxabi.h>
+#include <elf.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct Symbol {
+    uint64_t addr, size;
+    std::string name;
+};
+
+// function symbols of one ELF file, and its loadable segments (to map file offsets to
+// virtual addresses)
+struct Module {
+    bool loaded = false;
+    std::vector<Symbol> symbols;  // sorted by address
+    std::vector<Elf64_Phdr> segments;
+};
+
+struct Mapping {
+    uint64_t start, end, offset;
+    std::string path;
+};
+
+static std::vector<std::string> _symbol_dirs;
+static std::map<std::string, std::unique_ptr<Module>> _modules;
+
+static std::string Demangle(const char *name) {
+    int status = 0;
+    char *d = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+    if (status != 0 || !d) {
+        return name;
+    }
+    std::string s = d;
+    free(d);
+    return s;
+}
+
+static bool ReadWholeFile(const std::string& path, std::vector<uint8_t> *out) {
+    FILE *f = fopen(path.c_str(), "rb");
+    if (!f) {
+        return false;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    out->resize(size > 0 ? size : 0);
+    bool ok = size > 0 && fread(out->data(), 1, size, f) == (size_t) size;
+    fclose(f);
+    return ok;
+}
+
+static void LoadSymbols(const std::vector<uint8_t>& elf, Module *m) {
+    const Elf64_Ehdr *eh = (const Elf64_Ehdr*) elf.data();
+    if (elf.size() < sizeof(Elf64_Ehdr) || memcmp(eh->e_ident, ELFMAG, SELFMAG) != 0 ||
+            eh->e_ident[EI_CLASS] != ELFCLASS64) {
+        fprintf(stderr, "warning: not a 64-bit ELF file\n");
+        return;
+    }
+
+    for (int i = 0; i < eh->e_phnum; i++) {
+        const Elf64_Phdr *ph = (const Elf64_Phdr*) (elf.data() + eh->e_phoff + i * eh->e_phentsize);
+        if (ph->p_type == PT_LOAD) {
+            m->segments.push_back(*ph);
+        }
+    }
+
+    const Elf64_Shdr *sh = (const Elf64_Shdr*) (elf.data() + eh->e_shoff);
+    // prefer the full symbol table; stripped libraries only have the dynamic one
+    for (uint32_t want : { (uint32_t) SHT_SYMTAB, (uint32_t) SHT_DYNSYM }) {
+        for (int i = 0; i < eh->e_shnum; i++) {
+            if (sh[i].sh_type != want) {
+                continue;
+            }
+            const Elf64_Sym *syms = (const Elf64_Sym*) (elf.data() + sh[i].sh_offset);
+            const char *strtab = (const char*) (elf.data() + sh[sh[i].sh_link].sh_offset);
+            size_t count = sh[i].sh_size / sizeof(Elf64_Sym);
+            for (size_t j = 0; j < count; j++) {
+                if (ELF64_ST_TYPE(syms[j].st_info) == STT_FUNC && syms[j].st_value != 0) {
+                    m->symbols.push_back({ syms[j].st_value, syms[j].st_size,
+                                           Demangle(strtab + syms[j].st_name) });
+                }
+            }
+        }
+        if (!m->symbols.empty()) {
+            break;
+        }
+    }
+
+    std::sort(m->symbols.begin(), m->symbols.end(),
+              [](const Symbol& a, const Symbol& b) { return a.addr < b.addr; });
+}
+
+static Module *GetModule(const std::string& path) {
+    auto it = _modules.find(path);
+    if (it != _modules.end()) {
+        return it->second.get();
+    }
+    Module *m = new Module();
+    _modules[path].reset(m);
+
+    std::string base = path.substr(path.rfind('/') + 1);
+    std::vector<std::string> candidates;
+    for (const std::string& dir : _symbol_dirs) {
+        candidates.push_back(dir + "/" + base);
+    }
+    candidates.push_back(path);
+
+    std::vector<uint8_t> elf;
+    for (const std::string& c : candidates) {
+        if (ReadWholeFile(c, &elf)) {
+            LoadSymbols(elf, m);
+            m->loaded = true;
+            break;
+        }
+    }
+    return m;
+}
+
+static std::string Symbolize(const std::vector<Mapping>& maps, uint64_t addr) {
+    for (const Mapping& map : maps) {
+        if (addr < map.start || addr >= map.end) {
+            continue;
+        }
+        std::string base = map.path.substr(map.path.rfind('/') + 1);
+        uint64_t file_offset = addr - map.start + map.offset;
+
+        Module *m = GetModule(map.path);
+        for (const Elf64_Phdr& ph : m->segments) {
+            if (file_offset >= ph.p_offset && file_offset < ph.p_offset + ph.p_filesz) {
+                uint64_t vaddr = file_offset - ph.p_offset + ph.p_vaddr;
+                auto it = std::upper_bound(m->symbols.begin(), m->symbols.end(), vaddr,
+                        [](uint64_t a, const Symbol& s) { return a < s.addr; });
+                if (it != m->symbols.begin()) {
+                    --it;
+                    if (vaddr < it->addr + std::max<uint64_t>(it->size, 1)) {
+                        return it->name;
+                    }
+                }
+                break;
+            }
+        }
+
+        char buf[64];
+        snprintf(buf, sizeof(buf), "+0x%llx", (unsigned long long) file_offset);
+        return base + buf;
+    }
+    return "[unknown]";
+}
+
+int main(int argc, char **argv) {
+    int opt;
+    while ((opt = getopt(argc, argv, "s:")) != -1) {
+        if (opt == 's') {
+            _symbol_dirs.push_back(optarg);
+        } else {
+            fprintf(stderr, "usage: profile_symbolize [-s symbol_dir]... profile.txt\n");
+            return 2;
+        }
+    }
+    if (optind >= argc) {
+        fprintf(stderr, "usage: profile_symbolize [-s symbol_dir]... profile.txt\n");
+        return 2;
+    }
+
+    FILE *f = fopen(argv[optind], "r");
+    if (!f) {
+        perror(argv[optind]);
+        return 1;
+    }
+
+    std::vector<Mapping> maps;
+    std::map<int, std::string> threads;
+    std::map<std::string, uint64_t> folded;
+    uint64_t samples = 0;
+
+    char *line = nullptr;
+    size_t cap = 0;
+    while (getline(&line, &cap, f) > 0) {
+        line[strcspn(line, "\n")] = 0;
+
+        if (0 == strncmp(line, "map ", 4)) {
+            unsigned long long start, end, offset;
+            int pos = 0;
+            if (3 == sscanf(line + 4, "%llx %llx %llx %n", &start, &end, &offset, &pos)) {
+                maps.push_back({ start, end, offset, line + 4 + pos });
+            }
+        } else if (0 == strncmp(line, "thread ", 7)) {
+            int tid, pos = 0;
+            if (1 == sscanf(line + 7, "%d %n", &tid, &pos)) {
+                threads[tid] = line + 7 + pos;
+            }
+        } else if (0 == strncmp(line, "stack ", 6)) {
+            char *p = line + 6;
+            unsigned long count = strtoul(p, &p, 10);
+            int tid = (int) strtol(p, &p, 10);
+
+            std::vector<std::string> frames;
+            for (int depth = 0; *p; depth++) {
+                char *end;
+                unsigned long long addr = strtoull(p, &end, 16);
+                if (end == p) {
+                    break;
+                }
+                p = end;
+                // return addresses point after the call: step back into it
+                std::string frame = Symbolize(maps, depth == 0 ? addr : addr - 1);
+                // the second address may be the link register (arm64), and the function may
+                // have called something since it was set, in which case it points back into
+                // the function itself rather than at its caller
+                if (depth == 1 && frame == frames[0]) {
+                    continue;
+                }
+                frames.push_back(frame);
+            }
+
+            auto t = threads.find(tid);
+            std::string key = t != threads.end() ? t->second : std::to_string(tid);
+            for (auto it = frames.rbegin(); it != frames.rend(); ++it) {
+                key += ";" + *it;
+            }
+            folded[key] += count;
+            samples += count;
+        }
+    }
+    free(line);
+    fclose(f);
+
+    for (const auto& it : _modules) {
+        if (!it.second->loaded) {
+            fprintf(stderr, "warning: no symbols for %s\n", it.first.c_str());
+        }
+    }
+
+    for (const auto& it : folded) {
+        printf("%s %llu\n", it.first.c_str(), (unsigned long long) it.second);
+    }
+    fprintf(stderr, "%llu samples, %zu distinct stacks\n", (unsigned long long) samples,
+            folded.size());
+    return 0;
+}
@@ -0,0 +1,201 @@
+// Checks ProgramInterface (see program_interface.hpp) headless, on Mesa's surfaceless EGL
+// platform or the default display: links a few programs and makes sure that their hashed
+// lookups agree with the driver's, and that the consistency check catches each kind of
+// mismatch (undeclared input, wrong type, wrong attribute location). Then times a lookup
+// against glGetUniformLocation().
+//
+// Build (host):
+//   g++ -std=c++17 -O2 -I.. program_interface_check.cpp ../program_interface.cpp -lEGL
+//       -lGLESv2 -o program_interface_check
+//
+// Usage:
+//   program_interface_check
+//
+// Exits with 1 if any check fails.
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+
+#include "program_interface.hpp"
+#include "timing.hpp"
+
+#define LOOKUPS 1000000
+
+static const char *VS =
+    "#version 300 es\n"
+    "uniform vec2 u_scale;\n"
+    "uniform vec4 u_tints[4];\n"
+    "uniform float u_unused;\n"
+    "in vec2 i_position;\n"
+    "in vec4 i_color;\n"
+    "out vec4 v_color;\n"
+    "void main() {\n"
+    "    v_color = i_color * u_tints[gl_VertexID & 3];\n"
+    "    gl_Position = vec4(i_position * u_scale - 1.0, 0.0, 1.0);\n"
+    "}\n";
+
+static const char *FS =
+    "#version 300 es\n"
+    "precision mediump float;\n"
+    "uniform highp sampler2D u_texture;\n"
+    "in vec4 v_color;\n"
+    "out vec4 o_color;\n"
+    "void main() {\n"
+    "    o_color = v_color * texture(u_texture, vec2(0.5));\n"
+    "}\n";
+
+static const ShaderInput ATTRIBS[] = {
+    SHADER_ATTRIBUTE("i_position", GL_FLOAT_VEC2, 0),
+    SHADER_ATTRIBUTE("i_color", GL_FLOAT_VEC4, 1),
+};
+
+static const ShaderInput UNIFORMS[] = {
+    SHADER_UNIFORM("u_scale", GL_FLOAT_VEC2),
+    SHADER_UNIFORM("u_tints", GL_FLOAT_VEC4),
+    SHADER_UNIFORM("u_texture", GL_SAMPLER_2D),
+    SHADER_UNIFORM("u_unused", GL_FLOAT),      // optimized out
+};
+
+static bool InitEgl() {
+    EGLDisplay display = EGL_NO_DISPLAY;
+    PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+            (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (get_platform_display) {
+        display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    }
+    if (display == EGL_NO_DISPLAY) {
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL)) {
+        fprintf(stderr, "can't initialize EGL (error 0x%x)\n", eglGetError());
+        return false;
+    }
+
+    const EGLint config_attribs[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_ES3_BIT,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint count = 0;
+    if (!eglChooseConfig(display, config_attribs, &config, 1, &count) || count == 0) {
+        fprintf(stderr, "no GLES 3 pbuffer config\n");
+        return false;
+    }
+
+    const EGLint surface_attribs[] = { EGL_WIDTH, 16, EGL_HEIGHT, 16, EGL_NONE };
+    EGLSurface surface = eglCreatePbufferSurface(display, config, surface_attribs);
+    eglBindAPI(EGL_OPENGL_ES_API);
+    const EGLint context_attribs[] = { EGL_CONTEXT_CLIENT_VERSION, 3, EGL_NONE };
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, context_attribs);
+    if (surface == EGL_NO_SURFACE || context == EGL_NO_CONTEXT ||
+            !eglMakeCurrent(display, surface, surface, context)) {
+        fprintf(stderr, "can't create the pbuffer/context (error 0x%x)\n", eglGetError());
+        return false;
+    }
+    fprintf(stderr, "renderer: %s\n", (const char*) glGetString(GL_RENDERER));
+    return true;
+}
+
+static GLuint Compile(GLenum type, const char *src) {
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &src, NULL);
+    glCompileShader(shader);
+    return shader;
+}
+
+// links VS and FS, with the given attribute bindings
+static GLuint Link(const ShaderInput *attribs, int count) {
+    GLuint program = glCreateProgram();
+    GLuint vs = Compile(GL_VERTEX_SHADER, VS), fs = Compile(GL_FRAGMENT_SHADER, FS);
+    glAttachShader(program, vs);
+    glAttachShader(program, fs);
+    ProgramInterface::BindAttributes(program, attribs, count);
+    glLinkProgram(program);
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+    return program;
+}
+
+static bool Check(bool cond, const char *what, const std::string& detail = "") {
+    printf("  %-52s %s%s%s\n", what, cond ? "ok" : "FAILED", detail.empty() ? "" : ": ",
+           detail.c_str());
+    return cond;
+}
+
+// Build() with one declaration changed must fail, naming the input
+static bool ExpectMismatch(const char *what, const ShaderInput *attribs, int attrib_count,
+                           const ShaderInput *uniforms, int uniform_count, const char *name) {
+    GLuint program = Link(ATTRIBS, SHADER_INPUT_COUNT(ATTRIBS));
+    ProgramInterface iface;
+    bool built = iface.Build(program, attribs, attrib_count, uniforms, uniform_count);
+    glDeleteProgram(program);
+    return Check(!built && iface.GetError().find(name) != std::string::npos, what,
+                 iface.GetError());
+}
+
+int main() {
+    if (!InitEgl()) {
+        return 1;
+    }
+    bool ok = true;
+
+    printf("matching declarations:\n");
+    GLuint program = Link(ATTRIBS, SHADER_INPUT_COUNT(ATTRIBS));
+    ProgramInterface iface;
+    ok &= Check(iface.Build(program, ATTRIBS, SHADER_INPUT_COUNT(ATTRIBS), UNIFORMS,
+                            SHADER_INPUT_COUNT(UNIFORMS)), "builds", iface.GetError());
+    for (const ShaderInput& u : UNIFORMS) {
+        std::string what = std::string("uniform ") + u.name + " as the driver has it";
+        ok &= Check(iface.Uniform(u.hash) == glGetUniformLocation(program, u.name),
+                    what.c_str());
+    }
+    ok &= Check(iface.Uniform(NAME_HASH("u_unused")) == -1, "optimized-out uniform is -1");
+    for (const ShaderInput& a : ATTRIBS) {
+        std::string what = std::string("attribute ") + a.name + " at its bound location";
+        ok &= Check(iface.Attribute(a.hash) == a.location &&
+                    a.location == glGetAttribLocation(program, a.name), what.c_str());
+    }
+    ok &= Check(iface.Uniform(NAME_HASH("u_nothing")) == -1, "unknown name is -1");
+
+    printf("mismatches:\n");
+    ShaderInput wrong_type[SHADER_INPUT_COUNT(UNIFORMS)];
+    memcpy(wrong_type, UNIFORMS, sizeof(UNIFORMS));
+    wrong_type[0].type = GL_FLOAT_VEC3;
+    ok &= ExpectMismatch("uniform of the wrong type", ATTRIBS, SHADER_INPUT_COUNT(ATTRIBS),
+                         wrong_type, SHADER_INPUT_COUNT(UNIFORMS), "u_scale");
+    ok &= ExpectMismatch("undeclared uniform", ATTRIBS, SHADER_INPUT_COUNT(ATTRIBS), UNIFORMS,
+                         SHADER_INPUT_COUNT(UNIFORMS) - 2, "u_texture");
+    ShaderInput moved[SHADER_INPUT_COUNT(ATTRIBS)];
+    memcpy(moved, ATTRIBS, sizeof(ATTRIBS));
+    moved[1].location = 5;
+    ok &= ExpectMismatch("attribute at another location", moved, SHADER_INPUT_COUNT(ATTRIBS),
+                         UNIFORMS, SHADER_INPUT_COUNT(UNIFORMS), "i_color");
+    ok &= ExpectMismatch("undeclared attribute", ATTRIBS, 1, UNIFORMS,
+                         SHADER_INPUT_COUNT(UNIFORMS), "i_color");
+
+    // the hot path: one lookup per uniform set
+    uint64_t start = TimeNowNs();
+    GLint sum = 0;
+    for (int i = 0; i < LOOKUPS; i++) {
+        sum += iface.Uniform(NAME_HASH("u_scale"));
+        sum += iface.Uniform(NAME_HASH("u_texture"));
+    }
+    double hashed_ns = (double) (TimeNowNs() - start) / (2.0 * LOOKUPS);
+    start = TimeNowNs();
+    for (int i = 0; i < LOOKUPS / 10; i++) {
+        sum -= glGetUniformLocation(program, "u_scale");
+        sum -= glGetUniformLocation(program, "u_texture");
+    }
+    double driver_ns = (double) (TimeNowNs() - start) / (2.0 * LOOKUPS / 10);
+    printf("lookup: %.1f ns hashed, %.1f ns glGetUniformLocation (%d)\n", hashed_ns, driver_ns,
+           sum);
+    glDeleteProgram(program);
+
+    printf("%s\n", ok ? "OK" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,168 @@
+// Replays a recorded frame-time trace through QualityController, to check that it converges
+// to a tier instead of oscillating, and follows the thermal state down and back up.
+//
+// Build (host):
+//   g++ -std=c++17 -O2 -I.. quality_sim.cpp ../quality.cpp -o quality_sim
+//
+// Usage:
+//   quality_sim [trace.txt] [recorded_tier]
+//
+// The trace has one frame per line: "<cpu ms> <gpu ms> <budget ms> <thermal state 0-4>", as
+// measured while running at recorded_tier (default: the highest tier); gpu ms is -1 where it
+// wasn't measured. Costs at other tiers are extrapolated: GPU time from the render scale (fill
+// cost goes with its square), CPU time from the particle cap. Without a trace file, a synthetic
+// one is used: a GPU-bound scene that's too heavy for the top tier, warming up through every
+// thermal state and cooling down again.
+//
+// Exits with status 1 if the controller oscillated, or (synthetic trace) didn't follow the
+// thermal state.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "quality.hpp"
+
+struct Frame {
+    float cpu_ms;
+    float gpu_ms;
+    float budget_ms;
+    int thermal;
+};
+
+// fraction of the GPU time that scales with resolution; the rest is fixed
+#define FILL_FRACTION 0.8f
+// fraction of the CPU time that scales with the particle cap
+#define PARTICLE_FRACTION 0.3f
+
+// a tier change that undoes the previous one within this many frames is an oscillation
+#define OSCILLATION_WINDOW 600
+
+#define SYNTHETIC_FRAMES 20000
+
+static float gpu_cost(int tier) {
+    float s = QualityController::GetTierSettings(tier).render_scale;
+    return (1.0f - FILL_FRACTION) + FILL_FRACTION * s * s;
+}
+
+static float cpu_cost(int tier) {
+    float p = (float) QualityController::GetTierSettings(tier).particle_cap;
+    return (1.0f - PARTICLE_FRACTION) + PARTICLE_FRACTION * p /
+           QualityController::GetTierSettings(QUALITY_TIER_COUNT - 1).particle_cap;
+}
+
+// the thermal state of the synthetic trace at frame i: a few seconds at each state on the way
+// up, then cooling down
+static ThermalState synthetic_thermal(int i) {
+    if (i < 6000) return ThermalState::Nominal;
+    if (i < 7000) return ThermalState::Light;
+    if (i < 8000) return ThermalState::Moderate;
+    if (i < 9500) return ThermalState::Severe;
+    if (i < 10500) return ThermalState::Critical;
+    if (i < 11500) return ThermalState::Severe;
+    return ThermalState::Nominal;
+}
+
+static std::vector<Frame> synthetic_trace() {
+    std::vector<Frame> frames;
+    for (int i = 0; i < SYNTHETIC_FRAMES; i++) {
+        // GPU bound: the GPU about at its budget at the top tier, with some jitter; the CPU
+        // well within it
+        float jitter = (float) ((i * 7919) % 17) * 0.125f - 1.0f;
+        frames.push_back({ 9.0f + jitter * 0.5f, 16.5f + jitter, 16.67f,
+                           (int) synthetic_thermal(i) });
+    }
+    return frames;
+}
+
+// the synthetic trace's tier must follow the thermal caps down, and come back once it cools
+static bool check_thermal(const std::vector<int>& tiers) {
+    struct {
+        int frame;
+        int max_tier;
+        int min_tier;
+        const char *what;
+    } checks[] = {
+        { 5999, 2, 2, "nominal: settled below the top tier" },
+        { 8999, 1, 0, "severe: capped at tier 1" },
+        { 10499, 0, 0, "critical: capped at tier 0" },
+        { 11499, 1, 0, "severe again: at most tier 1" },
+        { SYNTHETIC_FRAMES - 1, 2, 2, "cooled down: back where it was" },
+    };
+    bool ok = true;
+    for (const auto& c : checks) {
+        int tier = tiers[c.frame];
+        bool pass = tier >= c.min_tier && tier <= c.max_tier;
+        printf("  frame %6d, tier %d: %-40s %s\n", c.frame, tier, c.what, pass ? "ok" : "FAILED");
+        ok &= pass;
+    }
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    std::vector<Frame> frames;
+    int recorded_tier = QUALITY_TIER_COUNT - 1;
+
+    if (argc > 1) {
+        FILE *f = fopen(argv[1], "r");
+        if (!f) {
+            perror(argv[1]);
+            return 2;
+        }
+        Frame fr;
+        while (fscanf(f, "%f %f %f %d", &fr.cpu_ms, &fr.gpu_ms, &fr.budget_ms, &fr.thermal) == 4) {
+            if (fr.thermal < 0 || fr.thermal > (int) ThermalState::Critical) {
+                fr.thermal = 0;
+            }
+            frames.push_back(fr);
+        }
+        fclose(f);
+        if (argc > 2) {
+            recorded_tier = atoi(argv[2]);
+        }
+    } else {
+        frames = synthetic_trace();
+    }
+
+    QualityController qc;
+    int transitions = 0, thermal_transitions = 0, oscillations = 0;
+    int prev_tier = qc.GetTier(), before_prev = -1;
+    size_t last_change = 0;
+    std::vector<int> tiers;
+
+    for (size_t i = 0; i < frames.size(); i++) {
+        const Frame& fr = frames[i];
+        int tier = qc.GetTier();
+        float cpu_ms = fr.cpu_ms * cpu_cost(tier) / cpu_cost(recorded_tier);
+        float gpu_ms = fr.gpu_ms < 0.0f ? -1.0f :
+                       fr.gpu_ms * gpu_cost(tier) / gpu_cost(recorded_tier);
+        qc.Update(cpu_ms, gpu_ms, fr.budget_ms, (ThermalState) fr.thermal);
+
+        if (qc.ApplyPending() && i > 0 && qc.GetTier() != prev_tier) {
+            transitions++;
+            bool thermal_changed = fr.thermal != frames[last_change].thermal;
+            thermal_transitions += thermal_changed;
+            // a reversal of the most recent change within the window, not caused by the
+            // thermal state changing
+            if (qc.GetTier() == before_prev && i - last_change < OSCILLATION_WINDOW &&
+                    !thermal_changed) {
+                oscillations++;
+            }
+            printf("frame %6zu: tier %d -> %d (load %.2f, thermal %s)\n", i, prev_tier,
+                   qc.GetTier(), qc.GetLoad(), ThermalStateName((ThermalState) fr.thermal));
+            before_prev = prev_tier;
+            prev_tier = qc.GetTier();
+            last_change = i;
+        }
+        tiers.push_back(qc.GetTier());
+    }
+
+    printf("%zu frames, %d transitions (%d with the thermal state), %d oscillations, final tier "
+           "%d, settled since frame %zu\n", frames.size(), transitions, thermal_transitions,
+           oscillations, qc.GetTier(), last_change);
+    bool ok = oscillations == 0;
+    if (argc <= 1) {
+        ok &= check_thermal(tiers);
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,302 @@
+// Measures time to first frame on the host, on Mesa's surfaceless EGL platform or the default
+// display, the way the engine used to start (everything in order once the window is there:
+// display, surface, context, shaders, program, buffers, then the first frame) against the
+// StartupPipeline way (see startup.hpp): the display and the asset index in the background from
+// the start, a cleared frame as soon as the context is bound, the GL objects after it. Each
+// startup runs in a fresh process, so the driver is loaded each time, as on a cold start.
+// Reports both the first frame and the first one with the scene in it, which for the pipeline
+// comes after the deferred stages.
+//
+// The window is a pbuffer here; -w is how long it takes to arrive (APP_CMD_INIT_WINDOW), which
+// is time the display init can hide behind. The asset index is a directory scan (-a).
+//
+// Build (host):
+//   g++ -std=c++17 -O2 -I.. startup_bench.cpp ../startup.cpp ../trace.cpp
+//       ../suspend.cpp ../flight_recorder.cpp -lEGL -lGLESv2 -lpthread -o startup_bench
+//
+// Usage:
+//   startup_bench [-n runs] [-w window_ms] [-a asset_dir]
+//
+// Exits with 1 if a startup fails, or the pipeline's median time to first frame isn't below
+// the serial one.
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES3/gl3.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "startup.hpp"
+#include "timing.hpp"
+
+// the engine's triangles
+static const char *VS =
+    "#version 300 es\n"
+    "in vec2 i_position;\n"
+    "in vec4 i_color;\n"
+    "in vec2 i_offset;\n"
+    "out vec4 v_color;\n"
+    "void main() {\n"
+    "    v_color = i_color;\n"
+    "    gl_Position = vec4( (i_offset + i_position), 0.0, 1.0 );\n"
+    "}\n";
+
+static const char *FS =
+    "#version 300 es\n"
+    "precision mediump float;\n"
+    "in vec4 v_color;\n"
+    "out vec4 o_color;\n"
+    "void main() {\n"
+    "    o_color = v_color;\n"
+    "}\n";
+
+#define VERTEX_BUFFER_SIZE (3 * 1024 * 32)
+
+// since the start of the process
+struct Times {
+    uint64_t first_frame_ns;
+    uint64_t content_ns;  // first frame with the scene in it
+};
+
+struct Egl {
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLConfig config = nullptr;
+    EGLSurface surface = EGL_NO_SURFACE;
+    EGLContext context = EGL_NO_CONTEXT;
+};
+
+static bool InitDisplay(Egl *egl) {
+    PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+            (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (get_platform_display) {
+        egl->display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY,
+                                            NULL);
+    }
+    if (egl->display == EGL_NO_DISPLAY) {
+        egl->display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+    return egl->display != EGL_NO_DISPLAY && eglInitialize(egl->display, NULL, NULL);
+}
+
+static bool InitSurface(Egl *egl) {
+    const EGLint config_attribs[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_ES3_BIT,
+        EGL_NONE
+    };
+    EGLint count = 0;
+    if (!eglChooseConfig(egl->display, config_attribs, &egl->config, 1, &count) || !count) {
+        return false;
+    }
+    const EGLint surface_attribs[] = { EGL_WIDTH, 1080, EGL_HEIGHT, 2400, EGL_NONE };
+    egl->surface = eglCreatePbufferSurface(egl->display, egl->config, surface_attribs);
+    return egl->surface != EGL_NO_SURFACE;
+}
+
+static bool InitContext(Egl *egl) {
+    eglBindAPI(EGL_OPENGL_ES_API);
+    const EGLint context_attribs[] = { EGL_CONTEXT_CLIENT_VERSION, 3, EGL_NONE };
+    egl->context = eglCreateContext(egl->display, egl->config, EGL_NO_CONTEXT, context_attribs);
+    return egl->context != EGL_NO_CONTEXT;
+}
+
+static bool BindContext(Egl *egl) {
+    return eglMakeCurrent(egl->display, egl->surface, egl->surface, egl->context);
+}
+
+static bool LoadAssetIndex(const char *dir_path, std::vector<std::string> *index) {
+    DIR *dir = opendir(dir_path);
+    if (!dir) {
+        return false;
+    }
+    while (struct dirent *e = readdir(dir)) {
+        index->push_back(e->d_name);
+    }
+    closedir(dir);
+    return true;
+}
+
+static GLuint Compile(GLenum type, const char *src) {
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &src, NULL);
+    glCompileShader(shader);
+    GLint status = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    return status ? shader : 0;
+}
+
+static bool InitGLObjects() {
+    GLuint vs = Compile(GL_VERTEX_SHADER, VS), fs = Compile(GL_FRAGMENT_SHADER, FS);
+    if (!vs || !fs) {
+        return false;
+    }
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vs);
+    glAttachShader(program, fs);
+    glLinkProgram(program);
+    GLint status = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    glUseProgram(program);
+
+    GLuint vao, vbo;
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &vbo);
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    std::vector<float> data(VERTEX_BUFFER_SIZE);
+    glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(float), data.data(), GL_DYNAMIC_DRAW);
+    return status == GL_TRUE;
+}
+
+// a cleared frame (plus the triangles, if there are GL objects), on the screen
+static void Present(Egl *egl, bool draw) {
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    if (draw) {
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
+    eglSwapBuffers(egl->display, egl->surface);
+    glFinish();
+}
+
+// one startup; all zeroes on failure
+static Times StartSerial(uint64_t window_ns, const char *asset_dir) {
+    uint64_t begin = TimeNowNs();
+    Egl egl;
+    std::vector<std::string> index;
+    while (TimeNowNs() - begin < window_ns) {
+        usleep(100);
+    }
+    if (!InitDisplay(&egl) || !LoadAssetIndex(asset_dir, &index) || !InitSurface(&egl) ||
+            !InitContext(&egl) || !BindContext(&egl) || !InitGLObjects()) {
+        return Times{ 0, 0 };
+    }
+    Present(&egl, true);
+    uint64_t ns = TimeNowNs() - begin;
+    return Times{ ns, ns };
+}
+
+static Times StartPipelined(uint64_t window_ns, const char *asset_dir) {
+    uint64_t begin = TimeNowNs();
+    Egl egl;
+    std::vector<std::string> index;
+    StartupPipeline startup;
+    using Kind = StartupPipeline::Kind;
+    startup.Add("egl_display", Kind::Background, [&egl] { return InitDisplay(&egl); });
+    startup.Add("asset_index", Kind::Background, [asset_dir, &index] {
+        return LoadAssetIndex(asset_dir, &index);
+    });
+    startup.Add("egl_surface", Kind::Critical, [&] {
+        return startup.Wait("egl_display") && InitSurface(&egl);
+    });
+    startup.Add("egl_context", Kind::Critical, [&egl] { return InitContext(&egl); });
+    startup.Add("egl_bind", Kind::Critical, [&egl] { return BindContext(&egl); });
+    startup.Add("gl_objects", Kind::Deferred, [] { return InitGLObjects(); });
+    startup.Begin();
+
+    while (TimeNowNs() - begin < window_ns) {
+        usleep(100);
+    }
+    Times t = { 0, 0 };
+    if (!startup.RunCritical()) {
+        return t;
+    }
+    Present(&egl, false);
+    uint64_t first_frame_ns = TimeNowNs() - begin;
+    startup.MarkFirstFrame();
+    if (!startup.RunDeferred() || !startup.Wait("asset_index")) {
+        return t;
+    }
+    Present(&egl, true);
+    t = Times{ first_frame_ns, TimeNowNs() - begin };
+    startup.MarkFirstContent();
+    startup.Finish(nullptr);
+    return t;
+}
+
+// runs a startup in a child process
+static Times RunChild(bool pipelined, uint64_t window_ns, const char *asset_dir) {
+    Times t = { 0, 0 };
+    int fds[2];
+    if (pipe(fds) != 0) {
+        return t;
+    }
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        // the pipeline logs its timeline
+        int null_fd = open("/dev/null", O_WRONLY);
+        dup2(null_fd, STDERR_FILENO);
+        t = pipelined ? StartPipelined(window_ns, asset_dir) : StartSerial(window_ns, asset_dir);
+        ssize_t written = write(fds[1], &t, sizeof(t));
+        _exit(written == sizeof(t) ? 0 : 1);
+    }
+    close(fds[1]);
+    if (read(fds[0], &t, sizeof(t)) != sizeof(t)) {
+        t = Times{ 0, 0 };
+    }
+    close(fds[0]);
+    waitpid(pid, NULL, 0);
+    return t;
+}
+
+// median of one of the times, in ms
+static double Median(const std::vector<Times>& runs, uint64_t Times::*field) {
+    std::vector<uint64_t> v;
+    for (const Times& t : runs) {
+        v.push_back(t.*field);
+    }
+    std::sort(v.begin(), v.end());
+    return NsToMs(v[v.size() / 2]);
+}
+
+int main(int argc, char **argv) {
+    int runs = 15;
+    double window_ms = 0.0;
+    const char *asset_dir = "../../assets";
+    int opt;
+    while ((opt = getopt(argc, argv, "n:w:a:")) != -1) {
+        switch (opt) {
+            case 'n': runs = std::max(1, atoi(optarg)); break;
+            case 'w': window_ms = atof(optarg); break;
+            case 'a': asset_dir = optarg; break;
+            default:
+                fprintf(stderr, "usage: %s [-n runs] [-w window_ms] [-a asset_dir]\n", argv[0]);
+                return 2;
+        }
+    }
+    uint64_t window_ns = (uint64_t) (window_ms * 1e6);
+
+    // interleaved, so that both see the same conditions
+    std::vector<Times> serial, pipelined;
+    for (int i = 0; i < runs; i++) {
+        Times s = RunChild(false, window_ns, asset_dir);
+        Times p = RunChild(true, window_ns, asset_dir);
+        if (!s.first_frame_ns || !p.first_frame_ns) {
+            fprintf(stderr, "startup failed (no EGL/GLES 3 display, or no %s?)\n", asset_dir);
+            return 1;
+        }
+        serial.push_back(s);
+        pipelined.push_back(p);
+    }
+
+    printf("window after %.1f ms, median of %d cold starts:\n", window_ms, runs);
+    printf("             first frame  with content\n");
+    double s = Median(serial, &Times::first_frame_ns);
+    double p = Median(pipelined, &Times::first_frame_ns);
+    printf("  serial     %8.2f ms   %8.2f ms\n", s, Median(serial, &Times::content_ns));
+    printf("  pipelined  %8.2f ms   %8.2f ms\n", p, Median(pipelined, &Times::content_ns));
+    printf("  first frame %.2f ms (%.0f%%) sooner\n", s - p, 100.0 * (s - p) / s);
+    bool ok = p < s;
+    printf("%s\n", ok ? "OK" : "FAILED");
+    return ok ? 0 : 1;
+}
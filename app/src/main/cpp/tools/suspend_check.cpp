@@ -0,0 +1,220 @@
+// Checks the suspend protocol (see suspend.hpp): runs the analytics flush thread, the profiler's
+// collector and a few worker threads (busy, and logging analytics events) under a
+// SuspendCoordinator, then suspends and resumes them a few times. While suspended, the CPU time
+// of every thread in the process (from /proc/self/task/<tid>/schedstat) must stay flat; on
+// resume, every worker must be running again within the latency limit. The main thread, which
+// does the measuring, doesn't count.
+//
+// Build (host):
+//   g++ -std=c++17 -O2 -I.. suspend_check.cpp ../suspend.cpp ../analytics.cpp ../lz4.cpp
+//       ../profiler.cpp -lpthread -o suspend_check
+//
+// Usage:
+//   suspend_check [-w workers] [-c cycles] [-p pause_ms] [-b cpu_budget_us] [-l latency_us]
+//
+// Exits with 1 if any thread used more than cpu_budget_us while suspended, or a worker took
+// longer than latency_us to resume.
+
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "analytics.hpp"
+#include "profiler.hpp"
+#include "suspend.hpp"
+#include "timing.hpp"
+
+#define MAX_WORKERS 6
+
+struct Worker {
+    std::thread thread;
+    std::atomic<uint64_t> passes{0};
+};
+
+static ParkingGate _gate;
+static std::atomic<bool> _stop(false);
+static Worker _workers[MAX_WORKERS];
+
+static void WorkerMain(Worker *w, int index) {
+    char name[16];
+    snprintf(name, sizeof(name), "worker%d", index);
+    pthread_setname_np(pthread_self(), name);
+    SamplingProfiler::GetInstance()->RegisterThread(name);
+    AnalyticsLog::AttachThread();
+
+    volatile uint32_t x = index;
+    while (!_stop.load()) {
+        _gate.Pass();
+        w->passes.fetch_add(1, std::memory_order_release);
+
+        // a few tens of us of work, then sleep like a thread waiting for its next buffer
+        for (int i = 0; i < 20000; i++) {
+            x = x * 1664525u + 1013904223u;
+        }
+        AnalyticsLog::Log(GameEvent::CloseCall, x, 0.0f, (float) index);
+        _gate.Sleep(1);
+    }
+}
+
+// CPU time of each of the process' threads, by tid
+static std::map<int, uint64_t> ThreadCpuNs() {
+    std::map<int, uint64_t> cpu;
+    DIR *d = opendir("/proc/self/task");
+    if (!d) {
+        return cpu;
+    }
+    struct dirent *ent;
+    while ((ent = readdir(d)) != NULL) {
+        int tid = atoi(ent->d_name);
+        if (tid <= 0) {
+            continue;
+        }
+        std::string path = std::string("/proc/self/task/") + ent->d_name + "/schedstat";
+        FILE *f = fopen(path.c_str(), "r");
+        unsigned long long ns;
+        if (f && fscanf(f, "%llu", &ns) == 1) {
+            cpu[tid] = ns;
+        }
+        if (f) {
+            fclose(f);
+        }
+    }
+    closedir(d);
+    return cpu;
+}
+
+static std::string ThreadName(int tid) {
+    char buf[32] = "";
+    std::string path = "/proc/self/task/" + std::to_string(tid) + "/comm";
+    FILE *f = fopen(path.c_str(), "r");
+    if (f) {
+        if (fgets(buf, sizeof(buf), f)) {
+            buf[strcspn(buf, "\n")] = 0;
+        }
+        fclose(f);
+    }
+    return buf;
+}
+
+int main(int argc, char **argv) {
+    int workers = 3, cycles = 3, pause_ms = 500, budget_us = 200, latency_us = 5000;
+    int opt;
+    while ((opt = getopt(argc, argv, "w:c:p:b:l:")) != -1) {
+        switch (opt) {
+            case 'w': workers = atoi(optarg); break;
+            case 'c': cycles = atoi(optarg); break;
+            case 'p': pause_ms = atoi(optarg); break;
+            case 'b': budget_us = atoi(optarg); break;
+            case 'l': latency_us = atoi(optarg); break;
+            default:
+                fprintf(stderr, "usage: %s [-w workers] [-c cycles] [-p pause_ms] "
+                        "[-b cpu_budget_us] [-l latency_us]\n", argv[0]);
+                return 2;
+        }
+    }
+    if (workers < 1 || workers > MAX_WORKERS) {
+        fprintf(stderr, "1 to %d workers\n", MAX_WORKERS);
+        return 2;
+    }
+
+    char dir[] = "/tmp/suspend_check.XXXXXX";
+    if (!mkdtemp(dir) || !AnalyticsLog::GetInstance()->Start(dir, 1 << 20, 4 << 20)) {
+        fprintf(stderr, "can't start the analytics log\n");
+        return 1;
+    }
+    SamplingProfiler *profiler = SamplingProfiler::GetInstance();
+    profiler->RegisterThread("main");
+    for (int i = 0; i < workers; i++) {
+        _workers[i].thread = std::thread(WorkerMain, &_workers[i], i);
+    }
+    usleep(50000);
+    if (!profiler->Start(100, false)) {
+        fprintf(stderr, "can't start the profiler\n");
+    }
+
+    // same order as the engine: the workers depend on analytics and are profiled
+    SuspendCoordinator coordinator;
+    coordinator.Add("analytics", [] {
+        AnalyticsLog::GetInstance()->Suspend();
+    }, [] {
+        AnalyticsLog::GetInstance()->Resume();
+    });
+    coordinator.Add("profiler", [profiler] { profiler->Suspend(); }, [profiler] {
+        profiler->Resume();
+    });
+    coordinator.Add("workers", [workers] {
+        _gate.Close();
+        if (!_gate.WaitParked(workers, 100)) {
+            fprintf(stderr, "only %d of %d workers parked\n", _gate.GetParked(), workers);
+        }
+    }, [] {
+        _gate.Open();
+    });
+
+    int self = (int) syscall(SYS_gettid);
+    bool ok = true;
+    for (int c = 0; c < cycles; c++) {
+        usleep(200000);
+
+        coordinator.Suspend();
+        std::map<int, uint64_t> before = ThreadCpuNs();
+        usleep(pause_ms * 1000);
+        std::map<int, uint64_t> after = ThreadCpuNs();
+
+        uint64_t passes[MAX_WORKERS];
+        for (int i = 0; i < workers; i++) {
+            passes[i] = _workers[i].passes.load(std::memory_order_acquire);
+        }
+        uint64_t start = TimeNowNs();
+        coordinator.Resume();
+        // until every worker has gone through the gate again
+        uint64_t latency = 0;
+        for (int i = 0; i < workers; i++) {
+            // yield rather than spin: the workers may need this CPU
+            while (_workers[i].passes.load(std::memory_order_acquire) == passes[i] &&
+                    TimeNowNs() - start < 1000000000ull) {
+                sched_yield();
+            }
+            latency = TimeNowNs() - start;
+        }
+
+        printf("cycle %d: suspend %.3f ms, resume %.3f ms, all workers running after %.3f ms, "
+               "%.3f ms process CPU while suspended\n", c, NsToMs(coordinator.GetSuspendNs()),
+               NsToMs(coordinator.GetResumeNs()), NsToMs(latency),
+               NsToMs(coordinator.GetSuspendedCpuNs()));
+        for (const auto& t : after) {
+            auto b = before.find(t.first);
+            uint64_t used = b != before.end() ? t.second - b->second : t.second;
+            bool over = t.first != self && used > (uint64_t) budget_us * 1000;
+            const char *note = t.first == self ? "  (measuring)" : over ? "  OVER BUDGET" : "";
+            printf("  %6d %-16s %8.1f us%s\n", t.first, ThreadName(t.first).c_str(),
+                   used / 1000.0, note);
+            ok &= !over;
+        }
+        if (latency > (uint64_t) latency_us * 1000) {
+            printf("  resume too slow (limit %d us)\n", latency_us);
+            ok = false;
+        }
+    }
+
+    _stop.store(true);
+    for (int i = 0; i < workers; i++) {
+        _workers[i].thread.join();
+    }
+    profiler->Stop((std::string(dir) + "/profile.txt").c_str());
+    AnalyticsLog::GetInstance()->Stop();
+    printf("%s (logs in %s, %llu events dropped)\n", ok ? "OK" : "FAILED", dir,
+           (unsigned long long) AnalyticsLog::GetInstance()->GetDropped());
+    return ok ? 0 : 1;
+}
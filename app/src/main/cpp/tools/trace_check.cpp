@@ -0,0 +1,166 @@
+// Checks trace streaming (see trace.hpp) the way the engine uses it: the startup events are
+// written out at once, then the trace is streamed while counters keep coming, several times
+// more of them than the in-memory buffer holds. Every counter has to reach the file, in order,
+// including the ones written right before a suspend and right before the stream is stopped,
+// and the file has to be readable both while it's being written and once it's closed.
+//
+// Build (host):
+//   g++ -std=c++17 -O2 -I.. trace_check.cpp ../trace.cpp ../suspend.cpp -lpthread
+//       -o trace_check
+//
+// Usage:
+//   trace_check [-n counters] [-o dir]
+//
+// Exits with 1 if any check fails.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "timing.hpp"
+#include "trace.hpp"
+
+static bool Check(bool cond, const char *what, const std::string& detail = "") {
+    printf("  %-52s %s%s%s\n", what, cond ? "ok" : "FAILED", detail.empty() ? "" : ": ",
+           detail.c_str());
+    return cond;
+}
+
+struct Contents {
+    std::vector<long> values;   // of the mem_rss_kb counters, in file order
+    int events = 0;
+    bool opened = false;        // starts with "["
+    bool closed = false;        // ends with "]"
+};
+
+// the streamed file has one event per line, between "[" and an optional "]"
+static Contents Read(const std::string& path) {
+    Contents c;
+    FILE *f = fopen(path.c_str(), "r");
+    if (!f) {
+        return c;
+    }
+    char line[512];
+    std::string last;
+    while (fgets(line, sizeof(line), f)) {
+        if (line[0] == '{') {
+            c.events++;
+            const char *value = strstr(line, "\"value\":");
+            if (strstr(line, "\"name\":\"mem_rss_kb\"") && value) {
+                c.values.push_back(atol(value + 8));
+            }
+        } else if (line[0] == '[' && c.events == 0) {
+            c.opened = true;
+        }
+        last = line;
+    }
+    fclose(f);
+    c.closed = (last == "]\n");
+    return c;
+}
+
+// whether values is 0, 1, ... count - 1
+static bool InOrder(const std::vector<long>& values, long count) {
+    if ((long) values.size() != count) {
+        return false;
+    }
+    for (long i = 0; i < count; i++) {
+        if (values[i] != i) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    long count = 200000;
+    std::string dir = "/tmp";
+    int opt;
+    while ((opt = getopt(argc, argv, "n:o:")) != -1) {
+        switch (opt) {
+            case 'n': count = atol(optarg); break;
+            case 'o': dir = optarg; break;
+            default:
+                fprintf(stderr, "usage: %s [-n counters] [-o dir]\n", argv[0]);
+                return 2;
+        }
+    }
+    const std::string startup_path = dir + "/trace_check_startup.json";
+    const std::string path = dir + "/trace_check.json";
+    bool ok = true;
+    Trace *trace = Trace::GetInstance();
+
+    // startup: written out at once, then forgotten (StartupPipeline::Finish, StartTrace())
+    trace->Instant("startup_begin", TimeNowNs());
+    trace->Complete("startup", TimeNowNs(), 1000);
+    ok &= Check(trace->WriteJson(startup_path.c_str()), "startup trace written");
+    trace->Clear();
+    if (!Check(trace->StartStreaming(path.c_str()), "streaming started")) {
+        return 1;
+    }
+
+    // counters from a sampling thread, like MemoryReporter's, while the flusher runs
+    printf("%ld counters after startup:\n", count);
+    const long half = count / 2;
+    std::thread sampler([trace, half] {
+        for (long i = 0; i < half; i++) {
+            trace->Counter("mem_rss_kb", TimeNowNs(), (double) i);
+            if (i % 1000 == 999) {
+                // slow enough for the flusher to keep up
+                usleep(20000);
+            }
+        }
+    });
+    sampler.join();
+
+    // a pause writes everything out, and the file reads fine without its closing bracket
+    trace->Suspend();
+    Contents c = Read(path);
+    ok &= Check(c.opened && !c.closed && InOrder(c.values, half),
+                "suspended: all of them in the file",
+                std::to_string(c.values.size()) + " of " + std::to_string(half));
+    trace->Resume();
+
+    // a burst bigger than the buffer, flushed on demand as it goes
+    for (long i = half; i < count; i++) {
+        trace->Counter("mem_rss_kb", TimeNowNs(), (double) i);
+        if (i % 10000 == 9999) {
+            trace->Flush();
+        }
+    }
+    trace->Complete("frame", TimeNowNs(), 1000);
+    trace->StopStreaming();
+
+    c = Read(path);
+    ok &= Check(c.opened && c.closed, "stopped: the file is terminated");
+    ok &= Check(InOrder(c.values, count), "stopped: every counter, in order",
+                std::to_string(c.values.size()) + " of " + std::to_string(count));
+    ok &= Check(c.events == count + 1, "stopped: nothing else, nothing lost",
+                std::to_string(c.events) + " events");
+
+    Contents startup = Read(startup_path);
+    ok &= Check(startup.values.empty(), "startup trace: no counters from later on");
+
+    // not streaming (the property isn't set): events are dropped right away
+    trace->SetEnabled(false);
+    trace->Counter("mem_rss_kb", TimeNowNs(), 0.0);
+    trace->SetEnabled(true);
+    trace->WriteJson(path.c_str());
+    FILE *f = fopen(path.c_str(), "r");
+    char buf[256] = "";
+    size_t len = f ? fread(buf, 1, sizeof(buf) - 1, f) : 0;
+    if (f) {
+        fclose(f);
+    }
+    ok &= Check(len > 0 && !strstr(buf, "mem_rss_kb"), "disabled: nothing recorded");
+
+    unlink(startup_path.c_str());
+    unlink(path.c_str());
+    printf("%s\n", ok ? "OK" : "FAILED");
+    return ok ? 0 : 1;
+}
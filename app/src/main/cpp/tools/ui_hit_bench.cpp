@@ -0,0 +1,103 @@
+// Checks and times UiTree hit-testing (see ui.hpp): lays out menus of increasingly many
+// buttons, compares the grid lookup against a scan of every widget at random points, and
+// times both. Also checks that updates without changes don't lay the tree out again.
+//
+// Build (host):
+//   g++ -std=c++17 -O2 -I.. ui_hit_bench.cpp ../ui.cpp ../quad_batch.cpp ../program_interface.cpp
+//       -lGLESv2 -o ui_hit_bench
+//
+// Usage:
+//   ui_hit_bench [points]
+//
+// Exits with 1 on any mismatch.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include "timing.hpp"
+#include "ui.hpp"
+
+#define SURFACE_WIDTH 1920
+#define SURFACE_HEIGHT 1080
+
+static uint32_t _seed = 1234;
+
+static float RandFloat() {
+    _seed = _seed * 1664525u + 1013904223u;
+    return (_seed >> 8) / (float) (1u << 24);
+}
+
+// the topmost visible button at x, y, looking at every widget
+static int ScanHitTest(const UiTree& ui, const std::vector<int>& buttons, float x, float y) {
+    for (int i = (int) buttons.size() - 1; i >= 0; i--) {
+        if (ui.GetRect(buttons[i]).Contains(x, y)) {
+            return buttons[i];
+        }
+    }
+    return -1;
+}
+
+// a rows x cols grid of buttons, in rows of panels
+static bool RunMenu(int rows, int cols, int points) {
+    UiTree ui;
+    std::vector<int> buttons;
+    int column = ui.AddPanel(0, 0.95f, 0.95f, UiDirection::Column, 0.01f, 0.005f, 0x000000ff);
+    for (int r = 0; r < rows; r++) {
+        int row = ui.AddPanel(column, 1.0f, 1.0f / rows - 0.01f, UiDirection::Row, 0.0f,
+                              0.005f, 0);
+        for (int c = 0; c < cols; c++) {
+            buttons.push_back(ui.AddButton(row, "", 1.0f / cols - 0.01f, 0.9f, 0xffffffff));
+        }
+    }
+    ui.SetSurfaceSize(SURFACE_WIDTH, SURFACE_HEIGHT);
+    for (int i = 0; i < 100; i++) {
+        ui.Update(0.016f);
+    }
+    if (ui.GetLayoutCount() != 1) {
+        printf("%d buttons: laid out %u times\n", (int) buttons.size(), ui.GetLayoutCount());
+        return false;
+    }
+
+    std::vector<float> xs(points), ys(points);
+    for (int i = 0; i < points; i++) {
+        xs[i] = RandFloat() * SURFACE_WIDTH;
+        ys[i] = RandFloat() * SURFACE_HEIGHT;
+    }
+
+    int mismatches = 0, hits = 0;
+    uint64_t start = TimeNowNs();
+    for (int i = 0; i < points; i++) {
+        hits += ui.HitTest(xs[i], ys[i]) >= 0;
+    }
+    uint64_t grid_ns = TimeNowNs() - start;
+
+    start = TimeNowNs();
+    for (int i = 0; i < points; i++) {
+        hits -= ScanHitTest(ui, buttons, xs[i], ys[i]) >= 0;
+    }
+    uint64_t scan_ns = TimeNowNs() - start;
+
+    for (int i = 0; i < points; i++) {
+        mismatches += ui.HitTest(xs[i], ys[i]) != ScanHitTest(ui, buttons, xs[i], ys[i]);
+    }
+
+    printf("%6d  %14.1f  %14.1f  %10d\n", (int) buttons.size(), (double) grid_ns / points,
+           (double) scan_ns / points, mismatches);
+    return mismatches == 0 && hits == 0;
+}
+
+int main(int argc, char **argv) {
+    int points = argc > 1 ? atoi(argv[1]) : 200000;
+
+    printf("buttons  ns/lookup (grid)  ns/lookup (scan)  mismatches\n");
+    bool ok = true;
+    ok &= RunMenu(1, 3, points);
+    ok &= RunMenu(4, 4, points);
+    ok &= RunMenu(8, 16, points);
+    ok &= RunMenu(16, 32, points);
+    ok &= RunMenu(40, 64, points);
+    printf("%s\n", ok ? "OK" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,94 @@
+// Runs FrameScheduler's fake vsync (see frame_scheduler.hpp: the timerfd stand-in for
+// AChoreographer) the way the game loop does, requesting the next frame from each callback,
+// and checks the frame times it hands out: evenly spaced at the nominal period, a measured
+// period that matches it, and how late the callbacks run after their frame time (the jitter
+// the simulation would see).
+//
+// Build (host):
+//   g++ -std=c++17 -O2 -I.. vsync_check.cpp ../frame_scheduler.cpp ../flight_recorder.cpp
+//       -o vsync_check
+//
+// Usage:
+//   vsync_check [-n frames] [-w work_ms]
+//
+// Exits with 1 if frame times aren't whole periods apart, frames are skipped when the work
+// fits in a period, or the measured period is off by more than 1%.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "frame_scheduler.hpp"
+#include "timing.hpp"
+
+struct Loop {
+    FrameScheduler *scheduler;
+    uint64_t work_ns;
+    std::vector<int64_t> frame_times;
+    std::vector<int64_t> wake_delays;  // callback start - frame time
+};
+
+static void OnFrame(int64_t frame_time_ns, void *data) {
+    Loop *loop = (Loop*) data;
+    loop->wake_delays.push_back((int64_t) TimeNowNs() - frame_time_ns);
+    loop->frame_times.push_back(frame_time_ns);
+    // the frame's work, then the next one
+    uint64_t end = TimeNowNs() + loop->work_ns;
+    while (TimeNowNs() < end) {
+    }
+    loop->scheduler->RequestFrame();
+}
+
+int main(int argc, char **argv) {
+    int frames = 300;
+    double work_ms = 4.0;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:w:")) != -1) {
+        switch (opt) {
+            case 'n': frames = std::max(10, atoi(optarg)); break;
+            case 'w': work_ms = atof(optarg); break;
+            default:
+                fprintf(stderr, "usage: %s [-n frames] [-w work_ms]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    FrameScheduler scheduler;
+    Loop loop = { &scheduler, (uint64_t) (work_ms * 1e6), {}, {} };
+    if (!scheduler.Start(OnFrame, &loop)) {
+        return 1;
+    }
+    int64_t nominal = scheduler.GetVsyncPeriodNs();
+    scheduler.RequestFrame();
+    while ((int) loop.frame_times.size() < frames) {
+        if (!scheduler.WaitAndDispatch(100)) {
+            fprintf(stderr, "no fake vsync within 100 ms\n");
+            return 1;
+        }
+    }
+    int64_t measured = scheduler.GetVsyncPeriodNs();
+    scheduler.Stop();
+
+    int misaligned = 0, skipped = 0;
+    for (int i = 1; i < frames; i++) {
+        int64_t delta = loop.frame_times[i] - loop.frame_times[i - 1];
+        misaligned += delta % nominal != 0;
+        skipped += delta / nominal - 1;
+    }
+    std::vector<int64_t> delays = loop.wake_delays;
+    std::sort(delays.begin(), delays.end());
+    printf("%d frames, %.1f ms of work each: period %.3f ms (nominal %.3f)\n", frames, work_ms,
+           NsToMs(measured), NsToMs(nominal));
+    printf("callback after its frame time: median %.3f ms, p99 %.3f ms, max %.3f ms\n",
+           NsToMs(delays[delays.size() / 2]), NsToMs(delays[delays.size() * 99 / 100]),
+           NsToMs(delays.back()));
+    printf("%d frame times off the vsync grid, %d vsyncs skipped\n", misaligned, skipped);
+
+    bool ok = misaligned == 0 && llabs(measured - nominal) * 100 <= nominal &&
+            (loop.work_ns >= (uint64_t) nominal || skipped == 0);
+    printf("%s\n", ok ? "OK" : "FAILED");
+    return ok ? 0 : 1;
+}
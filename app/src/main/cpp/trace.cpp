@@ -0,0 +1,177 @@
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "log.hpp"
+#include "trace.hpp"
+
+// we stop recording after this many events, to bound memory use
+#define TRACE_MAX_EVENTS 65536
+
+Trace* Trace::GetInstance() {
+    static Trace instance;
+    return &instance;
+}
+
+void Trace::Push(const Event& ev) {
+    if (!mEnabled.load(std::memory_order_relaxed)) {
+        return;
+    }
+    std::lock_guard<std::mutex> guard(mLock);
+    if (mEvents.size() >= TRACE_MAX_EVENTS) {
+        mDropped++;
+        return;
+    }
+    mEvents.push_back(ev);
+}
+
+void Trace::Complete(const char *name, uint64_t start_ns, uint64_t dur_ns) {
+    Push({ name, Kind::Complete, gettid(), start_ns, dur_ns, 0.0 });
+}
+
+void Trace::Instant(const char *name, uint64_t ts_ns) {
+    Push({ name, Kind::Instant, gettid(), ts_ns, 0, 0.0 });
+}
+
+void Trace::Counter(const char *name, uint64_t ts_ns, double value) {
+    Push({ name, Kind::Counter, gettid(), ts_ns, 0, value });
+}
+
+// one event, without a separator. Timestamps in the Chrome format are in microseconds.
+void Trace::WriteEvent(FILE *f, const Event& ev, int pid) {
+    switch (ev.kind) {
+        case Kind::Complete:
+            fprintf(f, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                    ev.name, pid, ev.tid, ev.ts_ns / 1000.0, ev.dur_ns / 1000.0);
+            break;
+        case Kind::Instant:
+            fprintf(f, "{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f}",
+                    ev.name, pid, ev.tid, ev.ts_ns / 1000.0);
+            break;
+        case Kind::Counter:
+            fprintf(f, "{\"name\":\"%s\",\"ph\":\"C\",\"pid\":%d,\"ts\":%.3f,\"args\":{\"value\":%g}}",
+                    ev.name, pid, ev.ts_ns / 1000.0, ev.value);
+            break;
+    }
+}
+
+bool Trace::WriteJson(const char *path) {
+    std::lock_guard<std::mutex> guard(mLock);
+
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        LOGE("Trace: can't open %s for writing (errno %d).", path, errno);
+        return false;
+    }
+
+    const int pid = getpid();
+    fprintf(f, "{\"traceEvents\":[\n");
+    for (size_t i = 0; i < mEvents.size(); i++) {
+        WriteEvent(f, mEvents[i], pid);
+        fprintf(f, "%s\n", (i + 1 < mEvents.size()) ? "," : "");
+    }
+    fprintf(f, "]}\n");
+
+    bool ok = (ferror(f) == 0);
+    fclose(f);
+
+    if (mDropped) {
+        LOGW("Trace: %llu events were dropped (buffer full).", (unsigned long long) mDropped);
+    }
+    LOGD("Trace: wrote %zu events to %s", mEvents.size(), path);
+    return ok;
+}
+
+void Trace::Clear() {
+    std::lock_guard<std::mutex> guard(mLock);
+    mEvents.clear();
+    mDropped = 0;
+}
+
+bool Trace::StartStreaming(const char *path) {
+    if (mFlusher.joinable()) {
+        return true;
+    }
+    mStream = fopen(path, "w");
+    if (!mStream) {
+        LOGE("Trace: can't open %s for writing (errno %d).", path, errno);
+        return false;
+    }
+    fprintf(mStream, "[\n");
+    mStreamed = 0;
+    mStopFlusher.store(false);
+    mFlusher = std::thread([this] { FlusherMain(); });
+    LOGI("Trace: streaming to %s", path);
+    return true;
+}
+
+void Trace::StopStreaming() {
+    if (!mFlusher.joinable()) {
+        return;
+    }
+    mStopFlusher.store(true);
+    // wakes it up if it's sleeping, or parked
+    mGate.Close();
+    mGate.Open();
+    mFlusher.join();
+
+    Flush();
+    std::lock_guard<std::mutex> guard(mStreamLock);
+    fprintf(mStream, "\n]\n");
+    fclose(mStream);
+    mStream = nullptr;
+    LOGD("Trace: streamed %llu events", (unsigned long long) mStreamed);
+}
+
+void Trace::Flush() {
+    std::lock_guard<std::mutex> stream_guard(mStreamLock);
+    if (!mStream) {
+        return;
+    }
+    // only hold the recording lock for the swap; the writing is done without it
+    uint64_t dropped;
+    {
+        std::lock_guard<std::mutex> guard(mLock);
+        mWriting.swap(mEvents);
+        dropped = mDropped;
+        mDropped = 0;
+    }
+    const int pid = getpid();
+    for (const Event& ev : mWriting) {
+        // separators go before events, so that the file is valid wherever it stops
+        fprintf(mStream, "%s", mStreamed++ ? ",\n" : "");
+        WriteEvent(mStream, ev, pid);
+    }
+    mWriting.clear();
+    fflush(mStream);
+    if (dropped) {
+        LOGW("Trace: %llu events were dropped (buffer full).", (unsigned long long) dropped);
+    }
+}
+
+void Trace::Suspend() {
+    if (mFlusher.joinable()) {
+        mGate.Close();
+        mGate.WaitParked(1, TRACE_FLUSH_INTERVAL_MS);
+    }
+}
+
+void Trace::Resume() {
+    mGate.Open();
+}
+
+void Trace::FlusherMain() {
+    while (!mStopFlusher.load()) {
+        // a flush that starts once the gate is closed has everything recorded before
+        // Suspend() (the threads recording events are parked by then), so only that one may be
+        // followed by parking
+        bool closed = mGate.IsClosed();
+        Flush();
+        if (closed) {
+            mGate.Pass();
+        } else {
+            // woken up early by Suspend()
+            mGate.Sleep(TRACE_FLUSH_INTERVAL_MS);
+        }
+    }
+}
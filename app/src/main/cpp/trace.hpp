@@ -0,0 +1,104 @@
+#ifndef endlesstunnel_trace_hpp
+#define endlesstunnel_trace_hpp
+
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "suspend.hpp"
+#include "timing.hpp"
+
+// while streaming, recorded events are written out this often
+#define TRACE_FLUSH_INTERVAL_MS 1000
+
+// Small in-memory trace recorder. Events are kept in memory (bounded) and written out in the
+// Chrome trace event format, so they can be opened in chrome://tracing or Perfetto: all at
+// once on demand (WriteJson()), or streamed to a file by a background thread, which empties
+// the buffer every TRACE_FLUSH_INTERVAL_MS so that it never fills up. Event names must be
+// string literals (we only store the pointer).
+class Trace {
+    public:
+        // returns the (singleton) instance
+        static Trace* GetInstance();
+
+        ~Trace() { StopStreaming(); }
+
+        // a span [start, start + dur) on the calling thread
+        void Complete(const char *name, uint64_t start_ns, uint64_t dur_ns);
+
+        // a point in time on the calling thread
+        void Instant(const char *name, uint64_t ts_ns);
+
+        // a sample of a numeric time series
+        void Counter(const char *name, uint64_t ts_ns, double value);
+
+        // writes all recorded events to the given file. Returns false on I/O error.
+        bool WriteJson(const char *path);
+
+        // forgets all recorded events
+        void Clear();
+
+        // while disabled (it's enabled to begin with), events are dropped without being
+        // counted
+        void SetEnabled(bool enabled) { mEnabled.store(enabled, std::memory_order_relaxed); }
+
+        // Creates path and starts the thread that moves the recorded events there. The file
+        // is in the JSON array format, which may be left unterminated (if the process dies).
+        bool StartStreaming(const char *path);
+
+        // writes what's left, terminates the file and stops the thread
+        void StopStreaming();
+
+        // writes the recorded events to the stream right away, and forgets them
+        void Flush();
+
+        // parks the streaming thread, once it has written everything out, until Resume()
+        void Suspend();
+        void Resume();
+
+    private:
+        enum class Kind : uint8_t { Complete, Instant, Counter };
+
+        struct Event {
+            const char *name;
+            Kind kind;
+            int32_t tid;
+            uint64_t ts_ns;
+            uint64_t dur_ns;
+            double value;
+        };
+
+        std::mutex mLock;
+        std::vector<Event> mEvents;
+        uint64_t mDropped = 0;
+        std::atomic<bool> mEnabled { true };
+
+        // the stream; mWriting is what's being written out, swapped with mEvents
+        std::mutex mStreamLock;
+        FILE *mStream = nullptr;
+        uint64_t mStreamed = 0;
+        std::vector<Event> mWriting;
+        std::thread mFlusher;
+        std::atomic<bool> mStopFlusher { false };
+        ParkingGate mGate;
+
+        void Push(const Event& ev);
+        static void WriteEvent(FILE *f, const Event& ev, int pid);
+        void FlusherMain();
+};
+
+// records a Complete event covering the lifetime of the object
+class TraceScope {
+    public:
+        TraceScope(const char *name) : mName(name), mStart(TimeNowNs()) {}
+        ~TraceScope() { Trace::GetInstance()->Complete(mName, mStart, TimeNowNs() - mStart); }
+
+    private:
+        const char *mName;
+        uint64_t mStart;
+};
+
+#endif
@@ -0,0 +1,369 @@
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "game_consts.hpp"
+#include "ui.hpp"
+
+// pressed buttons are drawn this much darker
+#define UI_PRESSED_SHADE 0.7f
+
+static UiRect Union(const UiRect& a, const UiRect& b) {
+    if (a.w <= 0.0f || a.h <= 0.0f) {
+        return b;
+    }
+    if (b.w <= 0.0f || b.h <= 0.0f) {
+        return a;
+    }
+    float x0 = std::min(a.x, b.x), y0 = std::min(a.y, b.y);
+    float x1 = std::max(a.x + a.w, b.x + b.w), y1 = std::max(a.y + a.h, b.y + b.h);
+    return { x0, y0, x1 - x0, y1 - y0 };
+}
+
+UiTree::UiTree() {
+    mSurfWidth = mSurfHeight = 0;
+    mLayoutValid = false;
+    mLayoutCount = 0;
+    mAction = nullptr;
+    mActionData = nullptr;
+    mPressed = -1;
+    mPressedPointer = -1;
+    mHighlight = -1;
+    mPulseTime = 0.0f;
+    mDamageCount = 0;
+    mGridCols = mGridRows = 0;
+
+    // the root: the whole surface, children stacked in a column
+    Widget root;
+    memset(&root, 0, sizeof(root));
+    root.parent = root.first_child = root.last_child = root.next_sibling = -1;
+    root.width = root.height = 1.0f;
+    root.direction = UiDirection::Column;
+    root.visible = true;
+    mWidgets.push_back(root);
+}
+
+int UiTree::Add(int parent, const Widget& w) {
+    if (parent < 0 || parent >= (int) mWidgets.size() || mWidgets.size() > 0xffff) {
+        return -1;
+    }
+    int index = (int) mWidgets.size();
+    mWidgets.push_back(w);
+    Widget& added = mWidgets.back();
+    added.parent = parent;
+    added.first_child = added.last_child = added.next_sibling = -1;
+    added.visible = true;
+    added.shown = false;
+
+    Widget& p = mWidgets[parent];
+    if (p.last_child >= 0) {
+        mWidgets[p.last_child].next_sibling = index;
+    } else {
+        p.first_child = index;
+    }
+    p.last_child = index;
+    Invalidate();
+    return index;
+}
+
+int UiTree::AddPanel(int parent, float width, float height, UiDirection direction,
+                     float padding, float spacing, uint32_t color) {
+    Widget w;
+    memset(&w, 0, sizeof(w));
+    w.width = width;
+    w.height = height;
+    w.direction = direction;
+    w.padding = padding;
+    w.spacing = spacing;
+    w.color = color;
+    return Add(parent, w);
+}
+
+int UiTree::AddButton(int parent, const char *label, float width, float height,
+                      uint32_t color) {
+    Widget w;
+    memset(&w, 0, sizeof(w));
+    w.label = label ? label : "";
+    w.width = width;
+    w.height = height;
+    w.color = color;
+    return Add(parent, w);
+}
+
+void UiTree::SetAction(Action fn, void *data) {
+    mAction = fn;
+    mActionData = data;
+}
+
+void UiTree::SetVisible(int widget, bool visible) {
+    if (widget > 0 && widget < (int) mWidgets.size() && mWidgets[widget].visible != visible) {
+        mWidgets[widget].visible = visible;
+        Invalidate();
+    }
+}
+
+void UiTree::SetHighlight(int widget) {
+    if (widget == mHighlight) {
+        return;
+    }
+    if (mLayoutValid && mHighlight >= 0 && mWidgets[mHighlight].shown) {
+        AddDamage(GetPulseRect(mHighlight, MENUITEM_PULSE_AMOUNT));
+    }
+    mHighlight = widget >= 0 && widget < (int) mWidgets.size() ? widget : -1;
+    mPulseTime = 0.0f;
+    if (mLayoutValid && mHighlight >= 0 && mWidgets[mHighlight].shown) {
+        AddDamage(GetPulseRect(mHighlight, MENUITEM_PULSE_AMOUNT));
+    }
+}
+
+void UiTree::SetSurfaceSize(int width, int height) {
+    if (width != mSurfWidth || height != mSurfHeight) {
+        mSurfWidth = width;
+        mSurfHeight = height;
+        Invalidate();
+    }
+}
+
+void UiTree::Invalidate() {
+    mLayoutValid = false;
+}
+
+void UiTree::Update(float dt) {
+    if (!mLayoutValid) {
+        Layout();
+    }
+    if (mHighlight >= 0 && mWidgets[mHighlight].shown && dt > 0.0f) {
+        mPulseTime = fmodf(mPulseTime + dt, MENUITEM_PULSE_PERIOD);
+        AddDamage(GetPulseRect(mHighlight, MENUITEM_PULSE_AMOUNT));
+    }
+}
+
+UiRect UiTree::GetBounds() const {
+    UiRect bounds = { 0.0f, 0.0f, 0.0f, 0.0f };
+    for (size_t i = 1; i < mWidgets.size(); i++) {
+        if (mWidgets[i].shown) {
+            bounds = Union(bounds, (int) i == mHighlight ?
+                    GetPulseRect((int) i, MENUITEM_PULSE_AMOUNT) : mWidgets[i].rect);
+        }
+    }
+    return bounds;
+}
+
+void UiTree::Layout() {
+    // what was drawn before has to go, whatever replaces it
+    AddDamage(GetBounds());
+
+    Widget& root = mWidgets[0];
+    root.rect = { 0.0f, 0.0f, (float) mSurfWidth, (float) mSurfHeight };
+    root.shown = mSurfWidth > 0 && mSurfHeight > 0;
+    LayoutChildren(0);
+
+    mLayoutValid = true;
+    mLayoutCount++;
+    BuildGrid();
+
+    // a press on a widget that went away is cancelled
+    if (mPressed >= 0 && !mWidgets[mPressed].shown) {
+        mPressed = -1;
+    }
+    AddDamage(GetBounds());
+}
+
+void UiTree::LayoutChildren(int parent) {
+    const Widget& p = mWidgets[parent];
+    float unit = (float) std::min(mSurfWidth, mSurfHeight);
+    float pad = p.padding * unit;
+    UiRect content = { p.rect.x + pad, p.rect.y + pad, std::max(0.0f, p.rect.w - 2.0f * pad),
+                       std::max(0.0f, p.rect.h - 2.0f * pad) };
+    bool column = p.direction == UiDirection::Column;
+
+    // the children are centered as a group along the main axis, each one on the cross axis
+    float total = 0.0f;
+    int count = 0;
+    for (int c = p.first_child; c >= 0; c = mWidgets[c].next_sibling) {
+        Widget& w = mWidgets[c];
+        w.shown = p.shown && w.visible;
+        if (w.shown) {
+            total += column ? w.height * content.h : w.width * content.w;
+            count++;
+        }
+    }
+    float spacing = p.spacing * unit;
+    total += spacing * std::max(0, count - 1);
+
+    // columns go top to bottom, rows left to right
+    float pos = column ? content.y + 0.5f * (content.h + total) :
+                         content.x + 0.5f * (content.w - total);
+    for (int c = p.first_child; c >= 0; c = mWidgets[c].next_sibling) {
+        Widget& w = mWidgets[c];
+        if (w.shown) {
+            float width = w.width * content.w, height = w.height * content.h;
+            if (column) {
+                pos -= height;
+                w.rect = { content.x + 0.5f * (content.w - width), pos, width, height };
+                pos -= spacing;
+            } else {
+                w.rect = { pos, content.y + 0.5f * (content.h - height), width, height };
+                pos += width + spacing;
+            }
+        }
+        LayoutChildren(c);
+    }
+}
+
+void UiTree::BuildGrid() {
+    mCellStart.clear();
+    mCellWidgets.clear();
+    mGridCols = mGridRows = 0;
+    if (mSurfWidth <= 0 || mSurfHeight <= 0) {
+        return;
+    }
+
+    int buttons = 0;
+    for (size_t i = 1; i < mWidgets.size(); i++) {
+        buttons += mWidgets[i].shown && IsButton((int) i);
+    }
+    mGridCols = mGridRows = UI_GRID_MIN;
+    while (mGridCols * mGridRows < 2 * buttons && mGridCols < UI_GRID_MAX) {
+        mGridCols *= 2;
+        mGridRows *= 2;
+    }
+    float sx = (float) mGridCols / mSurfWidth, sy = (float) mGridRows / mSurfHeight;
+
+    // the cells each button overlaps
+    auto for_cells = [&](const UiRect& r, auto fn) {
+        int c0 = std::max(0, (int) (r.x * sx));
+        int c1 = std::min(mGridCols - 1, (int) ((r.x + r.w) * sx));
+        int r0 = std::max(0, (int) (r.y * sy));
+        int r1 = std::min(mGridRows - 1, (int) ((r.y + r.h) * sy));
+        for (int row = r0; row <= r1; row++) {
+            for (int col = c0; col <= c1; col++) {
+                fn(row * mGridCols + col);
+            }
+        }
+    };
+
+    // two passes: count per cell, then fill in (drawing order, so bottom to top)
+    mCellStart.assign(mGridCols * mGridRows + 1, 0);
+    for (size_t i = 1; i < mWidgets.size(); i++) {
+        const Widget& w = mWidgets[i];
+        if (w.shown && IsButton((int) i) && w.rect.w > 0.0f && w.rect.h > 0.0f) {
+            for_cells(w.rect, [&](int cell) { mCellStart[cell + 1]++; });
+        }
+    }
+    for (size_t i = 1; i < mCellStart.size(); i++) {
+        mCellStart[i] += mCellStart[i - 1];
+    }
+    mCellWidgets.resize(mCellStart.back());
+    std::vector<uint32_t> next(mCellStart.begin(), mCellStart.end() - 1);
+    for (size_t i = 1; i < mWidgets.size(); i++) {
+        const Widget& w = mWidgets[i];
+        if (w.shown && IsButton((int) i) && w.rect.w > 0.0f && w.rect.h > 0.0f) {
+            for_cells(w.rect, [&](int cell) { mCellWidgets[next[cell]++] = (uint16_t) i; });
+        }
+    }
+}
+
+int UiTree::HitTest(float x, float y) const {
+    if (!mLayoutValid || !mGridCols || x < 0.0f || y < 0.0f || x >= mSurfWidth ||
+            y >= mSurfHeight) {
+        return -1;
+    }
+    int cell = (int) (y * mGridRows / mSurfHeight) * mGridCols +
+               (int) (x * mGridCols / mSurfWidth);
+    for (uint32_t i = mCellStart[cell + 1]; i > mCellStart[cell]; i--) {
+        int w = mCellWidgets[i - 1];
+        if (mWidgets[w].rect.Contains(x, y)) {
+            return w;
+        }
+    }
+    return -1;
+}
+
+bool UiTree::OnPointer(UiPointer action, int32_t id, float x, float y) {
+    int hit = HitTest(x, y);
+    switch (action) {
+        case UiPointer::Down:
+            if (hit >= 0 && mPressed < 0) {
+                mPressed = hit;
+                mPressedPointer = id;
+                AddDamage(GetPulseRect(hit, hit == mHighlight ? MENUITEM_PULSE_AMOUNT : 1.0f));
+            }
+            break;
+        case UiPointer::Move:
+            // sliding off a button cancels the press
+            if (mPressed >= 0 && id == mPressedPointer && hit != mPressed) {
+                AddDamage(GetPulseRect(mPressed,
+                                       mPressed == mHighlight ? MENUITEM_PULSE_AMOUNT : 1.0f));
+                mPressed = -1;
+            }
+            break;
+        case UiPointer::Up:
+            if (mPressed >= 0 && id == mPressedPointer) {
+                int pressed = mPressed;
+                mPressed = -1;
+                AddDamage(GetPulseRect(pressed,
+                                       pressed == mHighlight ? MENUITEM_PULSE_AMOUNT : 1.0f));
+                if (hit == pressed && mAction) {
+                    mAction(pressed, mActionData);
+                }
+            }
+            break;
+    }
+    return hit >= 0;
+}
+
+float UiTree::GetPulseScale() const {
+    const float two_pi = 6.2831853f;
+    return 1.0f + (MENUITEM_PULSE_AMOUNT - 1.0f) * 0.5f *
+                  (1.0f - cosf(two_pi * mPulseTime / MENUITEM_PULSE_PERIOD));
+}
+
+UiRect UiTree::GetPulseRect(int widget, float scale) const {
+    const UiRect& r = mWidgets[widget].rect;
+    float w = r.w * scale, h = r.h * scale;
+    return { r.x - 0.5f * (w - r.w), r.y - 0.5f * (h - r.h), w, h };
+}
+
+void UiTree::AddDamage(const UiRect& r) {
+    if (r.w <= 0.0f || r.h <= 0.0f) {
+        return;
+    }
+    if (mDamageCount < UI_MAX_DAMAGE) {
+        mDamage[mDamageCount++] = r;
+    } else {
+        mDamage[UI_MAX_DAMAGE - 1] = Union(mDamage[UI_MAX_DAMAGE - 1], r);
+    }
+}
+
+int UiTree::TakeDamage(UiRect *out) {
+    int count = mDamageCount;
+    memcpy(out, mDamage, count * sizeof(UiRect));
+    mDamageCount = 0;
+    return count;
+}
+
+void UiTree::Draw(QuadBatcher *batch) const {
+    if (!mLayoutValid) {
+        return;
+    }
+    float pulse = GetPulseScale();
+    for (size_t i = 1; i < mWidgets.size(); i++) {
+        const Widget& w = mWidgets[i];
+        if (!w.shown || !(w.color & 0xff)) {
+            continue;
+        }
+        UiRect r = (int) i == mHighlight ? GetPulseRect((int) i, pulse) : w.rect;
+        uint32_t color = w.color;
+        if ((int) i == mPressed) {
+            uint32_t shaded = color & 0xff;
+            for (int shift = 8; shift < 32; shift += 8) {
+                uint32_t c = (uint32_t) (((color >> shift) & 0xff) * UI_PRESSED_SHADE);
+                shaded |= c << shift;
+            }
+            color = shaded;
+        }
+        batch->Add(r.x, r.y, r.w, r.h, color);
+    }
+}
@@ -0,0 +1,142 @@
+#ifndef endlesstunnel_ui_hpp
+#define endlesstunnel_ui_hpp
+
+#include <stdint.h>
+#include <vector>
+
+#include "quad_batch.hpp"
+
+// hit-testing grid resolution, in cells along each side of the surface: starts at the min,
+// doubled (up to the max) until there are at least two cells per button
+#define UI_GRID_MIN 16
+#define UI_GRID_MAX 256
+
+// damage rectangles kept between two TakeDamage() calls (then merged into their bounds)
+#define UI_MAX_DAMAGE 8
+
+// a rectangle in surface pixels, with the origin at the bottom-left corner (like DamageRect)
+struct UiRect {
+    float x, y, w, h;
+
+    bool Contains(float px, float py) const {
+        return px >= x && px < x + w && py >= y && py < y + h;
+    }
+};
+
+// how a panel lays out its children
+enum class UiDirection { Column, Row };
+
+enum class UiPointer { Down, Move, Up };
+
+// Retained-mode UI: a tree of panels and buttons, built once. Layout only runs when something
+// invalidates it (a resize, widgets shown or hidden); hit-testing goes through a uniform grid
+// over the surface that is rebuilt with the layout, its resolution scaled to the number of
+// buttons, so a lookup only looks at the few buttons listed in one cell however many there
+// are. Draw() goes through a QuadBatcher, so the whole tree costs one draw call.
+//
+// Everything that changes on screen (layout, presses, the highlighted item's pulse) is
+// reported as damage, for the DamageTracker.
+//
+// Widgets are referred to by index; 0 is the root, which covers the surface. Children are
+// always added after their parent, so index order is also drawing order.
+class UiTree {
+    public:
+        // a button was tapped (pressed and released over it)
+        typedef void (*Action)(int widget, void *data);
+
+        UiTree();
+
+        // Sizes are fractions of the parent's content area; padding (around the children) and
+        // spacing (between them) are fractions of the surface's shorter side. Colors are
+        // 0xRRGGBBAA; panels with alpha 0 aren't drawn. Return the widget's index.
+        int AddPanel(int parent, float width, float height, UiDirection direction,
+                     float padding, float spacing, uint32_t color);
+        int AddButton(int parent, const char *label, float width, float height, uint32_t color);
+
+        void SetAction(Action fn, void *data);
+
+        // hidden widgets (and their children) take no space, aren't drawn nor hit
+        void SetVisible(int widget, bool visible);
+
+        // the highlighted button pulses (-1 for none)
+        void SetHighlight(int widget);
+
+        void SetSurfaceSize(int width, int height);
+
+        // forces a layout on the next Update()
+        void Invalidate();
+
+        // advances the pulse animation and lays out if needed
+        void Update(float dt);
+
+        // Touch input, in surface pixels. A button is tapped when a pointer goes down and up
+        // on it. Returns whether the UI used the event (it was over a button).
+        bool OnPointer(UiPointer action, int32_t id, float x, float y);
+
+        // the visible button at x, y (-1 if none). Valid after Update().
+        int HitTest(float x, float y) const;
+
+        // damage reported since the last call. Returns how many rects were written to out
+        // (at most UI_MAX_DAMAGE).
+        int TakeDamage(UiRect *out);
+
+        // adds the visible widgets to the batch
+        void Draw(QuadBatcher *batch) const;
+
+        const UiRect& GetRect(int widget) const { return mWidgets[widget].rect; }
+        const char *GetLabel(int widget) const { return mWidgets[widget].label; }
+        int GetWidgetCount() const { return (int) mWidgets.size(); }
+
+        // how many times the tree was laid out
+        uint32_t GetLayoutCount() const { return mLayoutCount; }
+
+    private:
+        struct Widget {
+            int parent, first_child, last_child, next_sibling;
+            const char *label;        // NULL for panels
+            float width, height;      // fractions of the parent's content area
+            UiDirection direction;
+            float padding, spacing;
+            uint32_t color;
+            bool visible;
+            bool shown;               // visible, and so are all of its parents (from layout)
+            UiRect rect;
+        };
+
+        std::vector<Widget> mWidgets;
+
+        // the buttons overlapping cell i (bottom to top) are
+        // mCellWidgets[mCellStart[i] .. mCellStart[i + 1]), cells being in rows from the bottom
+        int mGridCols, mGridRows;
+        std::vector<uint32_t> mCellStart;
+        std::vector<uint16_t> mCellWidgets;
+
+        int mSurfWidth, mSurfHeight;
+        bool mLayoutValid;
+        uint32_t mLayoutCount;
+
+        Action mAction;
+        void *mActionData;
+
+        // the pressed button, and the pointer pressing it
+        int mPressed;
+        int32_t mPressedPointer;
+
+        int mHighlight;
+        float mPulseTime;
+
+        UiRect mDamage[UI_MAX_DAMAGE];
+        int mDamageCount;
+
+        int Add(int parent, const Widget& w);
+        void Layout();
+        void LayoutChildren(int parent);
+        void BuildGrid();
+        bool IsButton(int widget) const { return mWidgets[widget].label != nullptr; }
+        UiRect GetBounds() const;
+        UiRect GetPulseRect(int widget, float scale) const;
+        float GetPulseScale() const;
+        void AddDamage(const UiRect& r);
+};
+
+#endif
@@ -1,10 +1,17 @@
 package com.example.gametest
 
+import android.os.VibrationEffect
+import android.os.Vibrator
 import android.view.View
+import android.view.WindowManager
 import com.google.androidgamesdk.GameActivity
 
 class MainActivity : GameActivity() {
     companion object {
+        private const val REQUEST_HAPTIC_FEEDBACK = 1
+        private const val REQUEST_VIBRATE = 2
+        private const val REQUEST_KEEP_SCREEN_ON = 3
+
         init {
             System.out.println("TESTEEEEEEEEEEEEEEEEEEEEEEE")
             System.loadLibrary("gametest")
@@ -19,6 +26,39 @@ class MainActivity : GameActivity() {
         }
     }
 
+    // Called from native code (JniBridge) once per frame with all the requests queued during
+    // that frame, as (type, a, b) triples. The array is reused by native code, so copy it.
+    // The request types must match the JavaRequest enum in jni_bridge.hpp.
+    @Suppress("unused")
+    fun onNativeRequests(data: IntArray, count: Int) {
+        val batch = data.copyOf(count * 3)
+        runOnUiThread {
+            for (i in 0 until count) {
+                val a = batch[i * 3 + 1]
+                when (batch[i * 3]) {
+                    REQUEST_HAPTIC_FEEDBACK -> window.decorView.performHapticFeedback(a)
+                    REQUEST_VIBRATE -> vibrate(a.toLong())
+                    REQUEST_KEEP_SCREEN_ON -> if (a != 0) {
+                        window.addFlags(WindowManager.LayoutParams.FLAG_KEEP_SCREEN_ON)
+                    } else {
+                        window.clearFlags(WindowManager.LayoutParams.FLAG_KEEP_SCREEN_ON)
+                    }
+                }
+            }
+        }
+    }
+
+    // Benchmark scenarios to run, comma separated (see benchmark.cpp), e.g.
+    // adb shell am start -n com.example.gametest/.MainActivity -e benchmark triangles_1000,menu_idle
+    // Results are written to files/bench_<scenario>.json and the activity finishes when done.
+    @Suppress("unused")
+    fun getBenchmarkScenarios(): String = intent?.getStringExtra("benchmark") ?: ""
+
+    private fun vibrate(ms: Long) {
+        val vibrator = getSystemService(Vibrator::class.java) ?: return
+        vibrator.vibrate(VibrationEffect.createOneShot(ms, VibrationEffect.DEFAULT_AMPLITUDE))
+    }
+
     private fun hideSystemUi() {
         val decorView = window.decorView
         decorView.systemUiVisibility = (View.SYSTEM_UI_FLAG_IMMERSIVE_STICKY